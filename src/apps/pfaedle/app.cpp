@@ -1,11 +1,16 @@
 #include "app.h"
 
+#include <algorithm>
 #include <climits>
+#include <memory>
+#include <optional>
 #include <pwd.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string>
+#include <thread>
 #include <fstream>
+#include <vector>
 
 
 #include <pfaedle/config.h>
@@ -13,6 +18,7 @@
 #include <pfaedle/config/mot_config.h>
 #include <pfaedle/eval/collector.h>
 #include <pfaedle/netgraph/graph.h>
+#include <pfaedle/osm/osm_builder.h>
 #include <pfaedle/router/shape_builder.h>
 #include <pfaedle/trgraph/graph.h>
 #include <pfaedle/trgraph/station_group.h>
@@ -27,6 +33,7 @@
 
 #include <gtfs/access/feed_reader.h>
 #include <gtfs/access/feed_writter.h>
+#include <gtfs/misc.h>
 
 #ifndef CFG_HOME_SUFFIX
 #define CFG_HOME_SUFFIX "/.config"
@@ -52,6 +59,22 @@ std::string get_file_name_mot_str(const pfaedle::router::route_type_set& mots)
     return mot_str;
 }
 
+/*
+ * The graph of a single MOT configuration. The graphs of all configurations
+ * are built from a single read of the OSM file
+ */
+struct mot_graph
+{
+    explicit mot_graph(const pfaedle::config::mot_config& cfg) :
+        cfg(cfg) {}
+
+    const pfaedle::config::mot_config& cfg;
+    pfaedle::router::route_type_set used_mots;
+    pfaedle::router::feed_stops f_stops;
+    pfaedle::trgraph::restrictor restrictor;
+    pfaedle::trgraph::graph graph;
+};
+
 std::vector<std::string> get_cfg_paths(const pfaedle::config::config& cfg)
 {
     if (!cfg.configPaths.empty())
@@ -160,6 +183,16 @@ ret_code app::run()
         pfaedle::gtfs::access::feed_reader reader(feeds_.front(), cfg_.feedPaths.front());
         pfaedle::gtfs::access::feed_reader::read_config read_config;
         read_config.shapes = cfg_.evaluate;
+
+        // The output passes everything but the shapes through from the input.
+        read_config.calendar = false;
+        read_config.calendar_dates = false;
+        read_config.transfers = false;
+        read_config.frequencies = false;
+        read_config.fare_attributes = false;
+        read_config.fare_rules = false;
+        read_config.feed_info = false;
+        read_config.descriptive_columns = false;
         if(auto res = reader.read(read_config); res != pfaedle::gtfs::access::result_code::OK)
         {
             LOG(ERROR) << "Could not parse input GTFS feed, reason was:";
@@ -281,11 +314,17 @@ ret_code app::run()
     for (const auto& st : df_bin_strings)
         df_bins.push_back(atof(st.c_str()));
 
-    pfaedle::eval::collector collector(cfg_.evalPath, df_bins);
+    // the matching threads and the evaluation workers share the cores, a
+    // quarter of them evaluates
+    const size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t num_eval_threads = cfg_.evaluate ? std::max<size_t>(1, num_threads / 4) : 0;
+    const size_t num_match_threads = std::max<size_t>(1, num_threads - num_eval_threads);
 
+    pfaedle::eval::collector collector(cfg_.evalPath, df_bins, cfg_.evalSingleFile, num_eval_threads);
+
+    std::vector<std::unique_ptr<mot_graph>> mot_graphs;
     for (const auto& mot_cfg : mot_cfg_reader_.get_configs())
     {
-        std::string file_post;
         auto used_mots = pfaedle::router::route_type_section(mot_cfg.route_types, cmd_route_types);
 
         if (used_mots.empty())
@@ -294,34 +333,48 @@ ret_code app::run()
         if (single_trip && single_trip->route().has_value() && !used_mots.count(single_trip->route().value().get().route_type))
             continue;
 
-        if (mot_cfg_reader_.get_configs().size() > 1)
-            file_post = get_file_name_mot_str(used_mots);
-
-        const std::string mot_str = pfaedle::router::get_mot_str(used_mots);
-        LOG(INFO) << "Calculating shapes for mots " << mot_str;
-
-        pfaedle::router::feed_stops f_stops =
-                pfaedle::router::write_mot_stops(feeds_.front(), used_mots, cfg_.shapeTripId);
-
-        pfaedle::trgraph::restrictor restrictor;
-        pfaedle::trgraph::graph graph;
+        auto mg = std::make_unique<mot_graph>(mot_cfg);
+        mg->used_mots = used_mots;
+        mg->f_stops = pfaedle::router::write_mot_stops(feeds_.front(), used_mots, cfg_.shapeTripId);
+        mot_graphs.push_back(std::move(mg));
+    }
 
+    // the OSM file is only read once, for all configurations with stops
+    {
         pfaedle::osm::bounding_box box(BOX_PADDING);
         pfaedle::router::shape_builder::get_gtfs_box(feeds_.front(), cmd_route_types, cfg_.shapeTripId, cfg_.dropShapes, box);
 
-        if (!f_stops.empty())
+        std::vector<pfaedle::osm::osm_read_job> jobs;
+        for (auto& mg : mot_graphs)
         {
-            pfaedle::osm::osm_builder osm_builder;
-            osm_builder.read(cfg_.osmPath,
-                             mot_cfg.osmBuildOpts,
-                             graph,
-                             box,
-                             cfg_.gridSize,
-                             f_stops,
-                             restrictor,
-                             cfg_.import_osm_stops);
+            if (!mg->f_stops.empty())
+                jobs.push_back({mg->cfg.osmBuildOpts, mg->graph, mg->f_stops, mg->restrictor});
         }
 
+        std::optional<pfaedle::osm::graph_cache> graph_cache;
+        if (!cfg_.graphCachePath.empty())
+            graph_cache.emplace(cfg_.graphCachePath);
+
+        pfaedle::osm::osm_builder::read(cfg_.osmPath, jobs, box, cfg_.gridSize, cfg_.spatialIndex == "rtree",
+                                        cfg_.import_osm_stops,
+                                        graph_cache ? &*graph_cache : nullptr);
+    }
+
+    for (auto& mg : mot_graphs)
+    {
+        const auto& mot_cfg = mg->cfg;
+        const auto& used_mots = mg->used_mots;
+        auto& f_stops = mg->f_stops;
+        auto& restrictor = mg->restrictor;
+        auto& graph = mg->graph;
+
+        std::string file_post;
+        if (mot_cfg_reader_.get_configs().size() > 1)
+            file_post = get_file_name_mot_str(used_mots);
+
+        const std::string mot_str = pfaedle::router::get_mot_str(used_mots);
+        LOG(INFO) << "Calculating shapes for mots " << mot_str;
+
         // TODO(patrick): move this somewhere else
         for (auto& feed_stop : f_stops)
         {
@@ -353,7 +406,8 @@ ret_code app::run()
                                                     graph,
                                                     f_stops,
                                                      restrictor,
-                                                    cfg_);
+                                                    cfg_,
+                                                    num_match_threads);
 
         if (cfg_.writeGraph)
         {
@@ -395,17 +449,26 @@ ret_code app::run()
             out.printLatLng(ng, fstr);
             fstr.close();
         }
+
+        // this graph is no longer needed
+        mg.reset();
     }
 
     if (cfg_.evaluate)
+    {
+        collector.finish();
         collector.print_stats(std::cout);
+    }
 
     if (!cfg_.feedPaths.empty())
     {
-        mkdir(cfg_.outputPath.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+        if (!pfaedle::gtfs::is_zip_path(cfg_.outputPath))
+            mkdir(cfg_.outputPath.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
         LOG(INFO) << "Writing output GTFS to " << cfg_.outputPath << " ...";
         pfaedle::gtfs::access::feed_writter writter(feeds_[0], cfg_.outputPath);
         pfaedle::gtfs::access::feed_writter::write_config config;
+        if (cfg_.feedPaths.size() == 1)
+            config.pass_through = cfg_.feedPaths.front();
         if(auto res = writter.write(config); res != pfaedle::gtfs::access::result_code::OK)
         {
             LOG(ERROR) << "Could not write final GTFS feed, reason was:";
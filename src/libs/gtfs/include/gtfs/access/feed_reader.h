@@ -3,9 +3,12 @@
 #include <gtfs/feed.h>
 #include <gtfs/access/result_code.h>
 
+#include <memory>
+
 namespace pfaedle::gtfs::access
 {
-using parsed_csv_row = std::map<std::string, std::string>;
+class csv_row;
+class zip_reader;
 
 class feed_reader
 {
@@ -35,15 +38,23 @@ public:
         bool attributions = true;
         bool feed_info = true;
         bool translations = true;
+
+        // Headsigns and block ids of trips and stop times, and the boarding and timepoint
+        // columns of stop times. Without them the feed is meant to be written with
+        // feed_writter::write_config::pass_through, which copies them from the input.
+        bool descriptive_columns = true;
     };
 
+    // The directory of the feed, or its zip archive.
     feed_reader(feed& feed, const std::string& directory);
+    ~feed_reader();
+
     result read(const read_config& config) noexcept;
 
 protected:
 
     result parse_csv(const std::string& filename,
-                     const std::function<result(const parsed_csv_row& record)>& add_entity) noexcept;
+                     const std::function<result(const csv_row& record)>& add_entity) noexcept;
 
     result read_agencies();
 
@@ -78,6 +89,8 @@ protected:
 private:
     feed& feed_;
     std::string gtfs_directory_;
+    std::unique_ptr<zip_reader> archive_;
+    bool descriptive_columns_ = true;
 };
 }
 
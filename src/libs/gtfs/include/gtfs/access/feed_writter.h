@@ -2,11 +2,17 @@
 #include <string>
 #include <gtfs/access/result.h>
 #include <functional>
+#include <memory>
 namespace pfaedle::gtfs
 {
 class feed;
 namespace access
 {
+class csv_parser;
+class csv_writer;
+class zip_reader;
+class zip_writer;
+
 class feed_writter
 {
 public:
@@ -35,15 +41,24 @@ public:
         bool attributions = true;
         bool feed_info = true;
         bool translations = true;
+
+        // Directory or zip archive the feed was read from. If set, trips and stop times are
+        // written as they are there, with only their shape_id and shape_dist_traveled taken from
+        // the feed, and all other files but shapes.txt are copied as they are.
+        std::string pass_through = {};
     };
 
+    // The directory of the feed, or a zip archive if the path ends in .zip.
     feed_writter(feed& feed, const std::string& directory);
+    ~feed_writter();
+
+    // The files are written concurrently.
     result write(const write_config& config) noexcept;
 
 protected:
-    static result write_csv(const std::string & path, const std::string & file,
-                                  const std::function<void(std::ofstream & out)> & write_header,
-                                  const std::function<void(std::ofstream & out)> & write_entities);
+    result write_csv(const std::string & file,
+                     const std::function<void(csv_writer & out)> & write_header,
+                     const std::function<void(csv_writer & out)> & write_entities) const;
 
     result write_agencies() const;
     result write_routes() const;
@@ -58,9 +73,19 @@ protected:
     result write_fare_attributes() const;
     result write_fare_rules() const;
     result write_feed_info() const;
+
+    // See write_config::pass_through.
+    result pass_trips() const;
+    result pass_stop_times() const;
+    result copy_file(const std::string & file) const;
 private:
+    csv_parser source_parser() const;
+
     feed& feed_;
     std::string gtfs_directory_;
+    std::unique_ptr<zip_writer> archive_;
+    std::string source_directory_;
+    std::unique_ptr<zip_reader> source_archive_;
 };
 }
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <tuple>
 
 namespace pfaedle::gtfs
@@ -9,7 +10,7 @@ class date
 public:
     date() = default;
     date(uint16_t year, uint16_t month, uint16_t day);
-    explicit date(const std::string & raw_date_str);
+    explicit date(std::string_view raw_date_str);
     bool is_provided() const;
     std::tuple<uint16_t, uint16_t, uint16_t> get_yyyy_mm_dd() const;
     std::string get_raw_date() const;
@@ -5,6 +5,7 @@
 #include <gtfs/stop.h>
 #include <gtfs/stop_time.h>
 #include <gtfs/shape.h>
+#include <gtfs/shape_store.h>
 #include <gtfs/feed_info.h>
 #include <gtfs/calendar_item.h>
 #include <gtfs/calendar_date.h>
@@ -14,6 +15,7 @@
 #include <gtfs/fare_attributes_item.h>
 
 #include <gtfs/access/result.h>
+#include <gtfs/id_map.h>
 
 #include <vector>
 #include <functional>
@@ -23,17 +25,17 @@ namespace pfaedle::gtfs
 {
 
 // Main classes for working with GTFS feeds
-using agency_map = std::map<Id,agency>;
-using stop_map = std::map<Id,stop>;
-using route_map = std::map<Id,route>;
-using trip_map = std::map<Id,trip>;
-using stop_time_vector = std::vector<stop_time>;
+using agency_map = id_map<agency>;
+using stop_map = id_map<stop>;
+using route_map = id_map<route>;
+using trip_map = id_map<trip>;
+using stop_time_vector = stop_time_store;
 using calendar_map = std::map<Id,calendar_item>;
 using calendar_dates_map = std::map<Id,calendar_date>;
 
 using fare_map = std::map<Id,fare_rule>;
 using fare_attributes_map = std::map<Id,fare_attributes_item>;
-using shape_map = std::map<Id,shape>;
+using shape_map = id_map<shape>;
 using frequency_vector = std::vector<frequency>;
 using transfer_map = std::map<std::tuple<Id, Id>,transfer>;
 
@@ -55,16 +57,25 @@ public:
     explicit stop_time_provider(feed& feed);
 
 
-    const std::vector<std::reference_wrapper<stop_time>>& get_for_stop(const Id& id) const;
-    std::vector<std::reference_wrapper<stop_time>>& get_for_stop(const Id& id);
-    const std::vector<std::reference_wrapper<stop_time>>& get_for_trip(const Id& id) const;
-    std::vector<std::reference_wrapper<stop_time>>& get_for_trip(const Id& id);
+    // Empty if the stop or trip has no stop times.
+    stop_time_range get_for_stop(const Id& id) const;
+    stop_time_range get_for_trip(const Id& id) const;
 
     void prepare() override;
 
 private:
-    std::map<Id, std::vector<std::reference_wrapper<stop_time>>> stop_based_map;
-    std::map<Id, std::vector<std::reference_wrapper<stop_time>>> trip_based_map;
+    // Indices of the stop times of each interned stop and trip of the store. The ones of a stop
+    // are in file order, the ones of a trip are sorted by stop_sequence.
+    struct index
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> stop_times;
+
+        stop_time_range get(stop_time_store& store, std::optional<uint32_t> i) const;
+    };
+
+    index stop_based_index;
+    index trip_based_index;
     feed& feed_;
 };
 
@@ -82,7 +93,8 @@ public:
     const std::vector<std::reference_wrapper<pfaedle::gtfs::route>>& get_for_agency(const Id& id) const;
 
 private:
-    std::map<Id, std::vector<std::reference_wrapper<route>>> agency_based_map;
+    // By index of the agency.
+    std::vector<std::vector<std::reference_wrapper<route>>> agency_based_routes;
     feed& feed_;
 };
 
@@ -100,7 +112,8 @@ public:
     const std::vector<std::reference_wrapper<pfaedle::gtfs::trip>>& get_for_route(const Id& id) const;
 
 private:
-    std::map<Id, std::vector<std::reference_wrapper<trip>>> route_based_map;
+    // By index of the route.
+    std::vector<std::vector<std::reference_wrapper<trip>>> route_based_trips;
     feed& feed_;
 };
 
@@ -113,7 +126,10 @@ public:
     pfaedle::gtfs::routes_provider& routes_provider() const;
     pfaedle::gtfs::trips_provider& trips_provider() const;
 
+    // Prepares the providers and resolves the references between the entities.
     void build();
+    // Resolves the shapes of the trips again, after shapes were added or erased.
+    void link_shapes();
 public:
     agency_map agencies;
     stop_map stops;
@@ -127,6 +143,9 @@ public:
     fare_map fare_rules;
     fare_attributes_map fare_attributes;
     shape_map shapes;
+    // Shapes that are only written out, kept on disk until then. Trips do not resolve them, see
+    // trip::shape(), and they are written after the ones in shapes.
+    shape_store spilled_shapes;
     frequency_vector frequencies;
     transfer_map transfers;
     pfaedle::gtfs::feed_info feed_info;
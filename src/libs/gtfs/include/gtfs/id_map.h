@@ -0,0 +1,266 @@
+#pragma once
+#include <gtfs/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+namespace pfaedle::gtfs
+{
+/**
+ * @brief entities of one kind by their GTFS id
+ *
+ * Ids are interned to dense indices in the order the entities are added. A lookup by id is a
+ * single hash lookup, a lookup by index an array access. Entities keep their address until they
+ * are erased, and the map is iterated in index order, i.e. in the order of the GTFS file.
+ */
+template<class T>
+class id_map
+{
+public:
+    using key_type = Id;
+    using mapped_type = T;
+    using value_type = std::pair<const Id, T>;
+    using index_type = uint32_t;
+
+    // Index that is never handed out.
+    static constexpr index_type npos = std::numeric_limits<index_type>::max();
+
+private:
+    // Erased entities leave an empty slot, so that the indices of the others do not change.
+    using slots_type = std::deque<std::optional<value_type>>;
+
+    template<class Value, class Slots>
+    class basic_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::remove_const_t<Value>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+        basic_iterator(Slots* slots, size_t pos) :
+            slots(slots),
+            pos(pos)
+        {
+            skip_erased();
+        }
+
+        // iterator to const_iterator
+        template<class V, class S, class = std::enable_if_t<std::is_const_v<Value> && !std::is_const_v<V>>>
+        basic_iterator(const basic_iterator<V, S>& other) : //NOLINT
+            slots(other.slots),
+            pos(other.pos)
+        {
+        }
+
+        reference operator*() const
+        {
+            return *(*slots)[pos];
+        }
+        pointer operator->() const
+        {
+            return &*(*slots)[pos];
+        }
+
+        basic_iterator& operator++()
+        {
+            ++pos;
+            skip_erased();
+            return *this;
+        }
+        basic_iterator operator++(int)
+        {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+
+        index_type index() const
+        {
+            return static_cast<index_type>(pos);
+        }
+
+        bool operator==(const basic_iterator& other) const
+        {
+            return pos == other.pos && slots == other.slots;
+        }
+        bool operator!=(const basic_iterator& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        template<class, class>
+        friend class basic_iterator;
+
+        void skip_erased()
+        {
+            while (pos < slots->size() && !(*slots)[pos])
+                ++pos;
+        }
+
+        Slots* slots;
+        size_t pos;
+    };
+
+public:
+    using iterator = basic_iterator<value_type, slots_type>;
+    using const_iterator = basic_iterator<const value_type, const slots_type>;
+
+    id_map() = default;
+
+    // The lookup table refers to the ids in the slots.
+    id_map(const id_map&) = delete;
+    id_map& operator=(const id_map&) = delete;
+    id_map(id_map&&) noexcept = default;
+    id_map& operator=(id_map&&) noexcept = default;
+
+    iterator begin()
+    {
+        return {&slots, 0};
+    }
+    iterator end()
+    {
+        return {&slots, slots.size()};
+    }
+    const_iterator begin() const
+    {
+        return {&slots, 0};
+    }
+    const_iterator end() const
+    {
+        return {&slots, slots.size()};
+    }
+
+    size_t size() const
+    {
+        return lookup.size();
+    }
+    bool empty() const
+    {
+        return lookup.empty();
+    }
+
+    // Indices handed out so far, including the ones of erased entities.
+    size_t index_count() const
+    {
+        return slots.size();
+    }
+
+    std::optional<index_type> index_of(std::string_view id) const
+    {
+        const auto it = lookup.find(id);
+        if (it == lookup.end())
+            return std::nullopt;
+
+        return it->second;
+    }
+
+    // Null if the index was never handed out or its entity is erased.
+    T* get(index_type index)
+    {
+        if (index >= slots.size() || !slots[index])
+            return nullptr;
+
+        return &slots[index]->second;
+    }
+    const T* get(index_type index) const
+    {
+        return const_cast<id_map&>(*this).get(index);
+    }
+
+    // Null if there is no entity with the id.
+    T* get(std::string_view id)
+    {
+        const auto index = index_of(id);
+        return index ? &slots[*index]->second : nullptr;
+    }
+    const T* get(std::string_view id) const
+    {
+        return const_cast<id_map&>(*this).get(id);
+    }
+
+    iterator find(std::string_view id)
+    {
+        const auto index = index_of(id);
+        return index ? iterator(&slots, *index) : end();
+    }
+    const_iterator find(std::string_view id) const
+    {
+        const auto index = index_of(id);
+        return index ? const_iterator(&slots, *index) : end();
+    }
+
+    size_t count(std::string_view id) const
+    {
+        return lookup.count(id);
+    }
+
+    T& at(std::string_view id)
+    {
+        T* entity = get(id);
+        if (entity == nullptr)
+            throw std::out_of_range("No entity with id " + std::string(id));
+
+        return *entity;
+    }
+    const T& at(std::string_view id) const
+    {
+        return const_cast<id_map&>(*this).at(id);
+    }
+
+    // Adds a default constructed entity if there is none with the id.
+    T& operator[](const Id& id)
+    {
+        return emplace(id).first->second;
+    }
+
+    // Does nothing if there is an entity with the id already, like std::map::emplace.
+    template<class... Args>
+    std::pair<iterator, bool> emplace(Id id, Args&&... args)
+    {
+        const auto index = index_of(id);
+        if (index)
+            return {iterator(&slots, *index), false};
+
+        const auto new_index = static_cast<index_type>(slots.size());
+        slots.emplace_back(std::in_place, std::piecewise_construct, std::forward_as_tuple(std::move(id)),
+                           std::forward_as_tuple(std::forward<Args>(args)...));
+        lookup.emplace(slots.back()->first, new_index);
+        return {iterator(&slots, new_index), true};
+    }
+
+    std::pair<iterator, bool> insert(std::pair<Id, T>&& value)
+    {
+        return emplace(std::move(value.first), std::move(value.second));
+    }
+
+    // The index of the entity is not reused, an entity added with the same id gets a new one.
+    size_t erase(std::string_view id)
+    {
+        const auto it = lookup.find(id);
+        if (it == lookup.end())
+            return 0;
+
+        const index_type index = it->second;
+        lookup.erase(it);
+        slots[index].reset();
+        return 1;
+    }
+
+private:
+    slots_type slots;
+    std::unordered_map<std::string_view, index_type> lookup;
+};
+}
@@ -3,6 +3,7 @@
 #include <gtfs/exceptions/invalid_field_format.h>
 #include <set>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -23,6 +24,10 @@ const std::string file_shapes = "shapes.txt";
 const std::string file_frequencies = "frequencies.txt";
 const std::string file_transfers = "transfers.txt";
 const std::string file_feed_info = "feed_info.txt";
+const std::string file_pathways = "pathways.txt";
+const std::string file_levels = "levels.txt";
+const std::string file_attributions = "attributions.txt";
+const std::string file_translations = "translations.txt";
 
 constexpr char csv_separator = ',';
 constexpr char quote = '"';
@@ -31,6 +36,9 @@ std::string append_leading_zero(const std::string& s, bool check = true);
 
 std::string add_trailing_slash(const std::string & path);
 
+// True if the feed at path is a zip archive: an existing regular file, or a path ending in .zip.
+bool is_zip_path(const std::string & path);
+
 void write_joined(std::ofstream & out, std::vector<std::string> && elements);
 
 std::string quote_text(const std::string & text);
@@ -54,6 +62,13 @@ std::string trim_spaces(const std::string & token);
 
 std::string normalize(std::string & token, bool has_quotes);
 
+// Integer at the start of the text, without allocating. Like std::stoi, throws
+// std::invalid_argument if there is none and std::out_of_range if it does not fit.
+int parse_int(std::string_view text);
+
+// Same as parse_int() for a floating point number, like std::stod.
+double parse_double(std::string_view text);
+
 
 
 
@@ -4,10 +4,10 @@
 
 namespace pfaedle::gtfs
 {
+// The shape_id of a point is the one of the shape it belongs to.
 struct shape_point
 {
     // Required:
-    Id shape_id;
     double shape_pt_lat = 0.0;
     double shape_pt_lon = 0.0;
     size_t shape_pt_sequence = 0;
@@ -0,0 +1,100 @@
+#pragma once
+#include <gtfs/shape.h>
+#include <gtfs/types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace pfaedle::gtfs
+{
+/**
+ * @brief shapes that are only added and written out again, kept in a temporary file
+ *
+ * The points are stored in 12 bytes each, without their shape id, and appended to an unlinked
+ * temporary file whenever the buffer is full. Only the ids and the position of every shape
+ * stay in memory. Shapes are read back in the order they were added.
+ */
+class shape_store
+{
+public:
+    struct point
+    {
+        // In 1e-7 degrees, about a centimeter.
+        int32_t lat = 0;
+        int32_t lon = 0;
+        float dist = 0.0f;
+
+        double latitude() const;
+        double longitude() const;
+    };
+
+    static constexpr size_t buffer_points = (1 << 20) / sizeof(point);
+
+    // The temporary file is created in directory once the first buffer is full, in TMPDIR or /tmp
+    // if it is empty.
+    explicit shape_store(std::string directory = {});
+    ~shape_store();
+
+    shape_store(const shape_store&) = delete;
+    shape_store& operator=(const shape_store&) = delete;
+
+    // Adds the shape, unless there is one with its id already. Several threads can add shapes
+    // at once. Throws std::runtime_error if the temporary file cannot be written.
+    bool add(const shape& s);
+
+    // The points stay in the file, but the shape is skipped when the shapes are read.
+    size_t erase(std::string_view id);
+
+    size_t count(std::string_view id) const;
+    size_t size() const;
+    bool empty() const;
+
+    // Calls f(id, points) for every shape in the order they were added. False if the temporary
+    // file could not be read.
+    template<class F>
+    bool for_each(const F& f) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<point> points;
+        for (const auto& e : entries)
+        {
+            if (e.erased)
+                continue;
+
+            if (!read(e, points))
+                return false;
+
+            f(e.id, points);
+        }
+        return true;
+    }
+
+private:
+    struct entry
+    {
+        Id id;
+        uint64_t first_point = 0;
+        uint32_t num_points = 0;
+        bool erased = false;
+    };
+
+    void flush();
+    bool read(const entry& e, std::vector<point>& points) const;
+
+    std::string directory;
+    int fd = -1;
+    // Points in the file, the ones after them are in the buffer.
+    uint64_t num_flushed = 0;
+    std::vector<point> buffer;
+
+    std::deque<entry> entries;
+    std::unordered_map<std::string_view, size_t> lookup;
+    mutable std::mutex mutex;
+};
+}
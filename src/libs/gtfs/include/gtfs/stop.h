@@ -8,7 +8,7 @@
 
 namespace pfaedle::gtfs
 {
-struct stop_time;
+class stop_time_range;
 class feed;
 
 struct stop: public record
@@ -37,8 +37,7 @@ struct stop: public record
     Id level_id;
     Text platform_code;
 
-    const std::vector<std::reference_wrapper<stop_time>>& get_stop_times() const;
-    std::vector<std::reference_wrapper<stop_time>>& get_stop_times();
+    stop_time_range get_stop_times() const;
     std::optional<std::reference_wrapper<stop>> get_parent_station() const;
 
 };
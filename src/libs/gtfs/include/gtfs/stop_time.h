@@ -1,26 +1,31 @@
 #pragma once
 #include <gtfs/enums/stop_time_boarding.h>
 #include <gtfs/enums/stop_time_point.h>
-#include <gtfs/record.h>
 #include <gtfs/time.h>
 #include <gtfs/types.h>
 
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace pfaedle::gtfs
 {
 struct stop;
 struct trip;
 class feed;
-struct stop_time: public record
-{
-    stop_time(pfaedle::gtfs::feed& feed):
-        record(feed)
-    {}
+class stop_time_store;
 
+// Fields of a single stop time, used to add it to a stop_time_store.
+struct stop_time_values
+{
     // Required:
-    Id trip_id;
-    Id stop_id;
+    std::string_view trip_id;
+    std::string_view stop_id;
     size_t stop_sequence = 0;
 
     // Conditionally required:
@@ -29,15 +34,208 @@ struct stop_time: public record
     time departure_time;
 
     // Optional:
-    Text stop_headsign;
+    std::string_view stop_headsign;
     stop_time_boarding pickup_type = stop_time_boarding::RegularlyScheduled;
     stop_time_boarding drop_off_type = stop_time_boarding::RegularlyScheduled;
 
     double shape_dist_traveled = 0.0;
     stop_time_point timepoint = stop_time_point::Exact;
+};
+
+// A stop time in a stop_time_store. Works like a reference, changes are written to the store.
+class stop_time
+{
+public:
+    stop_time(stop_time_store& store, uint32_t index);
+
+    // Required:
+    const Id& trip_id() const;
+    const Id& stop_id() const;
+    size_t stop_sequence() const;
+
+    // Conditionally required:
+    time arrival_time() const;
+    time departure_time() const;
+
+    // Optional:
+    const Text& stop_headsign() const;
+    stop_time_boarding pickup_type() const;
+    stop_time_boarding drop_off_type() const;
+    double shape_dist_traveled() const;
+    stop_time_point timepoint() const;
+
+    void set_arrival_time(const time& t);
+    void set_departure_time(const time& t);
+    void set_shape_dist_traveled(double dist);
+
+    // Position of the stop time in stop_times.txt.
+    uint32_t index() const;
 
+    // Resolved by feed::build(), nullopt before.
     std::optional<std::reference_wrapper<pfaedle::gtfs::stop>> stop() const;
     std::optional<std::reference_wrapper<pfaedle::gtfs::trip>> trip() const;
+
+    bool operator==(const stop_time& other) const;
+    bool operator!=(const stop_time& other) const;
+
+private:
+    stop_time_store* store;
+    uint32_t idx;
 };
-}
 
+// Stop times of a store, either all of them or the ones listed by an array of indices.
+class stop_time_range
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = stop_time;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = stop_time;
+
+        iterator(stop_time_store* store, const uint32_t* indices, size_t pos);
+
+        stop_time operator*() const;
+        stop_time operator[](difference_type n) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+        iterator& operator+=(difference_type n);
+        iterator& operator-=(difference_type n);
+        iterator operator+(difference_type n) const;
+        iterator operator-(difference_type n) const;
+        difference_type operator-(const iterator& other) const;
+
+        bool operator==(const iterator& other) const;
+        bool operator!=(const iterator& other) const;
+
+    private:
+        stop_time_store* store;
+        const uint32_t* indices;
+        size_t pos;
+    };
+
+    stop_time_range() = default;
+    stop_time_range(stop_time_store& store, const uint32_t* begin, const uint32_t* end);
+
+    iterator begin() const;
+    iterator end() const;
+
+    size_t size() const;
+    bool empty() const;
+
+    stop_time operator[](size_t i) const;
+    stop_time front() const;
+    stop_time back() const;
+
+private:
+    stop_time_store* store = nullptr;
+    const uint32_t* indices = nullptr;
+    size_t count = 0;
+};
+
+/**
+ * @brief all stop times of a feed, stored column by column
+ *
+ * Trip ids, stop ids and headsigns are interned, times are stored as seconds and distances as
+ * floats, 19 bytes per stop time and 4 more once a headsign is given. Stop times keep the order of
+ * stop_times.txt.
+ */
+class stop_time_store
+{
+public:
+    stop_time_store() = default;
+    explicit stop_time_store(pfaedle::gtfs::feed& feed);
+
+    stop_time_store(const stop_time_store&) = delete;
+    stop_time_store& operator=(const stop_time_store&) = delete;
+    stop_time_store(stop_time_store&&) = default;
+    stop_time_store& operator=(stop_time_store&&) = default;
+
+    using iterator = stop_time_range::iterator;
+
+    void push_back(const stop_time_values& values);
+
+    // Moves the stop times of other to the end of this store.
+    void append(stop_time_store&& other);
+
+    void reserve(size_t n);
+    size_t size() const;
+    bool empty() const;
+
+    // Stop times work like references, also for a const store.
+    iterator begin() const;
+    iterator end() const;
+    stop_time operator[](size_t i) const;
+
+    // Interned trips and stops, and the ones of each stop time.
+    size_t num_trips() const;
+    size_t num_stops() const;
+    std::optional<uint32_t> find_trip(const Id& id) const;
+    std::optional<uint32_t> find_stop(const Id& id) const;
+    uint32_t trip_of(size_t i) const;
+    uint32_t stop_of(size_t i) const;
+
+    // Bytes taken by the columns of the stop times, without the interned ids.
+    size_t column_bytes() const;
+
+    // Resolves the interned stops and trips to the ones of the feed.
+    void link();
+
+private:
+    friend class stop_time;
+
+    static constexpr int32_t NO_TIME = -1;
+
+    // Ids in a deque so that the views in the lookup tables stay valid.
+    struct id_table
+    {
+        std::deque<std::string> ids;
+        std::unordered_map<std::string_view, uint32_t> lookup;
+
+        uint32_t intern(std::string_view id);
+        std::optional<uint32_t> find(std::string_view id) const;
+    };
+
+    void set_times(size_t i, int32_t arrival, int32_t departure);
+    int32_t get_arrival(size_t i) const;
+
+    void add_trip_run(uint32_t start, uint32_t trip);
+    void push_stop_sequence(size_t value);
+    size_t get_stop_sequence(size_t i) const;
+
+    pfaedle::gtfs::feed* feed = nullptr;
+
+    id_table trip_ids;
+    id_table stop_ids;
+    // The headsign column is only filled once a headsign is given, the empty one is interned
+    // first.
+    id_table headsigns;
+
+    // Stop times of a trip are usually consecutive in the file, so the trip is kept once per run
+    // of them: run r starts at stop time trip_run_start[r] and ends where the next one starts.
+    std::vector<uint32_t> trip_run_start;
+    std::vector<uint32_t> trip_run_trip;
+    std::vector<uint32_t> stop_idx;
+    // 16 bit sequence numbers, all of them move to the wide column once one does not fit.
+    std::vector<uint16_t> stop_sequence;
+    std::vector<uint32_t> wide_stop_sequence;
+    // One slot per stop time, so that the times of different stop times can be set from several
+    // threads at once.
+    std::vector<int32_t> arrival;
+    std::vector<int32_t> departure;
+    std::vector<float> shape_dist_traveled;
+    // Pickup type, drop off type and timepoint packed into one byte.
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> headsign;
+
+    // By interned index, null if the feed has no such stop or trip.
+    std::vector<pfaedle::gtfs::stop*> stop_links;
+    std::vector<pfaedle::gtfs::trip*> trip_links;
+};
+}
@@ -2,6 +2,7 @@
 #include <gtfs/misc.h>
 #include <tuple>
 #include <string>
+#include <string_view>
 
 namespace pfaedle::gtfs
 {
@@ -11,7 +12,7 @@ class time
 {
 public:
     time() = default;
-    explicit time(const std::string & raw_time_str);
+    explicit time(std::string_view raw_time_str);
     time(size_t seconds);
     time(uint16_t hours, uint16_t minutes, uint16_t seconds);
 
@@ -19,7 +20,7 @@ public:
     bool is_provided() const;
     size_t get_total_seconds() const;
     std::tuple<uint16_t, uint16_t, uint16_t> get_hh_mm_ss() const;
-    std::string get_raw_time() const;
+    const std::string& get_raw_time() const;
     bool limit_hours_to_24max();
 
 private:
@@ -1,7 +1,9 @@
 #pragma once
 #include <gtfs/enums/trip_access.h>
 #include <gtfs/enums/trip_direction_id.h>
+#include <gtfs/id_map.h>
 #include <gtfs/record.h>
+#include <gtfs/stop_time.h>
 #include <gtfs/types.h>
 
 #include <functional>
@@ -10,7 +12,6 @@
 
 namespace pfaedle::gtfs
 {
-struct stop_time;
 struct route;
 struct shape;
 class feed;
@@ -37,8 +38,20 @@ struct trip: public record
     trip_access wheelchair_accessible = trip_access::NoInfo;
     trip_access bikes_allowed = trip_access::NoInfo;
 
+    // Resolved by feed::build(), nullopt before. After shape_id or the shapes of the feed are
+    // changed, feed::link_shapes() resolves the shape again. Shapes in feed::spilled_shapes
+    // are not resolved.
     std::optional<std::reference_wrapper<pfaedle::gtfs::route>> route() const;
     std::optional<std::reference_wrapper<pfaedle::gtfs::shape>> shape() const;
-    std::vector<std::reference_wrapper<stop_time>>& stop_times() const;
+    // Resolved by feed::build(), empty before. The stop times are sorted by stop_sequence.
+    stop_time_range stop_times() const;
+
+private:
+    friend class feed;
+
+    pfaedle::gtfs::route* route_link = nullptr;
+    // An index, shapes are replaced while the feed is in use.
+    uint32_t shape_index = id_map<pfaedle::gtfs::shape>::npos;
+    stop_time_range stop_time_link;
 };
 }
@@ -1,96 +1,365 @@
 #include "csv_parser.h"
+#include "zip_archive.h"
 #include <gtfs/misc.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
 namespace pfaedle::gtfs::access
 {
-csv_parser::csv_parser(const std::string & gtfs_directory) : gtfs_path(gtfs_directory) {}
+namespace
+{
+constexpr size_t npos = std::numeric_limits<size_t>::max();
 
-std::vector<std::string> csv_parser::split_record(const std::string & record, bool is_header)
+// Header ids start at 1, 0 marks a column that was not looked up yet.
+std::atomic<size_t> next_header_id{1};
+
+// Same as normalize(), but on the characters of the field itself.
+std::string_view normalize_in_place(char * begin, char * end, bool has_quotes, bool has_delimiters)
 {
-    size_t start_index = 0;
-    if (is_header)
+    if (has_delimiters)
     {
-        // ignore UTF-8 BOM prefix:
-        if (record.size() > 2 && record[0] == '\xef' && record[1] == '\xbb' && record[2] == '\xbf')
-            start_index = 3;
+        char * out = begin;
+        for (char * in = begin; in != end; ++in)
+            if (*in != '\t' && *in != '\r')
+                *out++ = *in;
+        end = out;
+    }
+
+    while (begin != end && *begin == ' ')
+        ++begin;
+    while (end != begin && *(end - 1) == ' ')
+        --end;
+
+    if (!has_quotes)
+        return {begin, static_cast<size_t>(end - begin)};
+
+    // See unquote_text(), the unquoted field is never longer than the quoted one.
+    char * in = begin;
+    char * out = begin;
+    if (end - begin > 1 && *begin == quote && *(end - 1) == quote)
+    {
+        ++in;
+        --end;
     }
 
-    std::vector<std::string> fields;
-    fields.reserve(20);
+    bool prev_is_quote = false;
+    bool prev_is_skipped = false;
+    for (; in != end; ++in)
+    {
+        if (*in != quote)
+        {
+            *out++ = *in;
+            prev_is_quote = false;
+            prev_is_skipped = false;
+            continue;
+        }
 
-    std::string token;
-    token.reserve(record.size());
+        if (prev_is_quote)
+        {
+            if (prev_is_skipped)
+                *out++ = *in;
 
+            prev_is_skipped = !prev_is_skipped;
+        }
+        else
+        {
+            prev_is_quote = true;
+            *out++ = *in;
+        }
+    }
+
+    return {begin, static_cast<size_t>(out - begin)};
+}
+}
+
+csv_column::csv_column(std::string name) : column_name(std::move(name)) {}
+
+const std::string & csv_column::name() const { return column_name; }
+
+size_t csv_row::column_index(const csv_column & column) const
+{
+    if (column.header_id != header_id)
+    {
+        column.index = npos;
+        for (size_t i = 0; i < field_sequence->size(); ++i)
+        {
+            if ((*field_sequence)[i] == column.column_name)
+            {
+                column.index = i;
+                break;
+            }
+        }
+        column.header_id = header_id;
+    }
+
+    return column.index;
+}
+
+bool csv_row::has(const csv_column & column) const
+{
+    return column_index(column) < fields.size();
+}
+
+std::string_view csv_row::get(const csv_column & column) const
+{
+    const size_t i = column_index(column);
+    if (i >= fields.size())
+        return {};
+
+    return fields[i];
+}
+
+std::string_view csv_row::at(const csv_column & column) const
+{
+    const size_t i = column_index(column);
+    if (i >= fields.size())
+        throw std::out_of_range(column.name());
+
+    return fields[i];
+}
+
+bool csv_row::empty() const { return fields.empty(); }
+
+csv_parser::csv_parser(const std::string & gtfs_directory) : gtfs_path(gtfs_directory) {}
+
+csv_parser::csv_parser(const zip_reader & archive) : archive(&archive) {}
+
+csv_parser::~csv_parser() { unmap(); }
+
+void csv_parser::unmap()
+{
+    if (data != nullptr)
+        munmap(data, size);
+
+    data = nullptr;
+    size = 0;
+    pos = 0;
+}
+
+void csv_parser::split_record(char * begin, char * end, std::vector<std::string_view> & fields)
+{
+    fields.clear();
+
+    char * token = begin;
     bool is_inside_quotes = false;
     bool quotes_in_token = false;
+    bool delimiters_in_token = false;
 
-    for (size_t i = start_index; i < record.size(); ++i)
+    for (char * c = begin; c != end; ++c)
     {
-        if (record[i] == quote)
+        if (*c == quote)
         {
             is_inside_quotes = !is_inside_quotes;
             quotes_in_token = true;
-            token += record[i];
             continue;
         }
 
-        if (record[i] == csv_separator)
+        if (*c == csv_separator)
         {
             if (is_inside_quotes)
-            {
-                token += record[i];
                 continue;
-            }
 
-            fields.emplace_back(normalize(token, quotes_in_token));
-            token.clear();
+            fields.emplace_back(normalize_in_place(token, c, quotes_in_token, delimiters_in_token));
+            token = c + 1;
             quotes_in_token = false;
+            delimiters_in_token = false;
             continue;
         }
 
         // Skip delimiters:
-        if (record[i] != '\t' && record[i] != '\r')
-            token += record[i];
+        if (*c == '\t' || *c == '\r')
+            delimiters_in_token = true;
     }
 
-    fields.emplace_back(normalize(token, quotes_in_token));
-    return fields;
+    fields.emplace_back(normalize_in_place(token, end, quotes_in_token, delimiters_in_token));
 }
 
-result csv_parser::read_header(const std::string & csv_filename)
+std::vector<std::string> csv_parser::split_record(const std::string & record, bool is_header)
 {
-    if (csv_stream.is_open())
-        csv_stream.close();
+    size_t start_index = 0;
+    if (is_header)
+    {
+        // ignore UTF-8 BOM prefix:
+        if (record.size() > 2 && record[0] == '\xef' && record[1] == '\xbb' && record[2] == '\xbf')
+            start_index = 3;
+    }
+
+    std::string buffer = record.substr(start_index);
+    std::vector<std::string_view> views;
+    split_record(buffer.data(), buffer.data() + buffer.size(), views);
+
+    return {views.begin(), views.end()};
+}
+
+result csv_parser::map_file(const std::string & csv_filename)
+{
+    if (archive != nullptr)
+        return archive->extract(csv_filename, data, size);
+
+    const std::string path = gtfs_path + csv_filename;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return {result_code::ERROR_FILE_ABSENT, "File " + csv_filename + " could not be opened"};
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return result_code::OK;
+    }
 
-    csv_stream.open(gtfs_path + csv_filename);
-    if (!csv_stream.is_open())
+    // Private and writable, fields are unquoted in place. Only the pages that are written to
+    // are copied.
+    void * mapped = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
         return {result_code::ERROR_FILE_ABSENT, "File " + csv_filename + " could not be opened"};
 
-    std::string header;
-    if (!getline(csv_stream, header) || header.empty())
+    data = static_cast<char *>(mapped);
+    size = st.st_size;
+    madvise(data, size, MADV_SEQUENTIAL);
+    return result_code::OK;
+}
+
+result csv_parser::open(const std::string & csv_filename)
+{
+    unmap();
+    return map_file(csv_filename);
+}
+
+std::string_view csv_parser::contents() const { return {data, size}; }
+
+const std::vector<std::string> & csv_parser::header() const { return field_sequence; }
+
+result csv_parser::read_header(const std::string & csv_filename)
+{
+    if (auto res = open(csv_filename); res != result_code::OK)
+        return res;
+
+    if (size == 0)
+        return {result_code::ERROR_INVALID_FIELD_FORMAT, "Empty header in file " + csv_filename};
+
+    // ignore UTF-8 BOM prefix:
+    if (size > 2 && data[0] == '\xef' && data[1] == '\xbb' && data[2] == '\xbf')
+        pos = 3;
+
+    char * begin = data + pos;
+    char * end = static_cast<char *>(std::memchr(begin, '\n', size - pos));
+    if (end == nullptr)
+        end = data + size;
+    pos = end - data + (end != data + size);
+
+    if (end == begin)
         return {result_code::ERROR_INVALID_FIELD_FORMAT, "Empty header in file " + csv_filename};
 
-    field_sequence = split_record(header, true);
+    std::vector<std::string_view> header;
+    split_record(begin, end, header);
+    field_sequence.assign(header.begin(), header.end());
+    header_id = next_header_id++;
+
     return result_code::OK;
 }
 
-result csv_parser::read_row(std::map<std::string, std::string> & obj)
+result csv_parser::read_row(csv_row & row)
 {
-    obj = {};
-    std::string row;
-    if (!getline(csv_stream, row))
+    chunk rest{pos, size};
+    const result res = read_row(row, rest);
+    pos = rest.begin;
+    return res;
+}
+
+result csv_parser::read_raw_row(std::vector<std::string_view> & fields)
+{
+    fields.clear();
+    if (pos >= size)
         return {result_code::END_OF_FILE, {}};
 
-    if (row == "\r")
+    const char * begin = data + pos;
+    const char * end = static_cast<const char *>(std::memchr(begin, '\n', size - pos));
+    if (end == nullptr)
+        end = data + size;
+    pos = end - data + 1;
+
+    if (end != begin && *(end - 1) == '\r')
+        --end;
+    if (end == begin)
         return result_code::OK;
 
-    const std::vector<std::string> fields_values = split_record(row);
+    bool is_inside_quotes = false;
+    const char * token = begin;
+    for (const char * c = begin; c != end; ++c)
+    {
+        if (*c == quote)
+            is_inside_quotes = !is_inside_quotes;
+        else if (*c == csv_separator && !is_inside_quotes)
+        {
+            fields.emplace_back(token, c - token);
+            token = c + 1;
+        }
+    }
+    fields.emplace_back(token, end - token);
+
+    return result_code::OK;
+}
+
+std::vector<csv_parser::chunk> csv_parser::split_rows(size_t count, size_t min_chunk_size) const
+{
+    const size_t remaining = size - std::min(pos, size);
+    count = std::max<size_t>(1, std::min(count, remaining / std::max<size_t>(1, min_chunk_size)));
+
+    std::vector<chunk> chunks;
+    size_t begin = pos;
+    for (size_t i = 1; i <= count && begin < size; ++i)
+    {
+        size_t end = size;
+        if (i < count)
+        {
+            end = std::max(begin, pos + remaining / count * i);
+            const void * nl = std::memchr(data + end, '\n', size - end);
+            end = nl == nullptr ? size : static_cast<const char *>(nl) - data + 1;
+        }
+
+        chunks.push_back({begin, end});
+        begin = end;
+    }
+
+    return chunks;
+}
+
+result csv_parser::read_row(csv_row & row, chunk & rows) const
+{
+    row.field_sequence = &field_sequence;
+    row.header_id = header_id;
+    row.fields.clear();
+
+    if (rows.begin >= rows.end)
+        return {result_code::END_OF_FILE, {}};
+
+    char * begin = data + rows.begin;
+    char * end = static_cast<char *>(std::memchr(begin, '\n', rows.end - rows.begin));
+    if (end == nullptr)
+        end = data + rows.end;
+    rows.begin = end - data + 1;
+
+    // Blank lines are skipped.
+    if (end == begin || (end - begin == 1 && *begin == '\r'))
+        return result_code::OK;
+
+    split_record(begin, end, row.fields);
 
     // Different count of fields in the row and in the header of csv.
     // Typical approach is to skip not required fields.
-    const size_t fields_count = std::min(field_sequence.size(), fields_values.size());
-
-    for (size_t i = 0; i < fields_count; ++i)
-        obj[field_sequence[i]] = fields_values[i];
+    if (row.fields.size() > field_sequence.size())
+        row.fields.resize(field_sequence.size());
 
     return result_code::OK;
 }
@@ -1,29 +1,120 @@
 #pragma once
 #include <gtfs/access/result.h>
 
-#include <fstream>
-#include <vector>
+#include <cstddef>
 #include <string>
-#include <map>
+#include <string_view>
+#include <vector>
 
 namespace pfaedle::gtfs::access
 {
+class csv_row;
+class zip_reader;
+
+// Named column of a csv file. Its index is looked up in the header of the file only once, on the
+// first row it is read from.
+class csv_column
+{
+public:
+    explicit csv_column(std::string name);
+
+    const std::string & name() const;
+
+private:
+    friend class csv_row;
+
+    std::string column_name;
+    mutable size_t header_id = 0;
+    mutable size_t index = 0;
+};
+
+// Fields of a single csv row. The views point into the file mapped by the parser and are valid
+// until the next row is read.
+class csv_row
+{
+public:
+    // True if the file has the column and the row has a value for it.
+    bool has(const csv_column & column) const;
+
+    // Field of the column, empty if the file has no such column.
+    std::string_view get(const csv_column & column) const;
+
+    // Field of the column, throws std::out_of_range if the file has no such column.
+    std::string_view at(const csv_column & column) const;
+
+    bool empty() const;
+
+private:
+    friend class csv_parser;
+
+    size_t column_index(const csv_column & column) const;
+
+    const std::vector<std::string> * field_sequence = nullptr;
+    size_t header_id = 0;
+    std::vector<std::string_view> fields;
+};
+
 class csv_parser
 {
 public:
+    // Byte range of whole rows in the file.
+    struct chunk
+    {
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
     csv_parser() = default;
     explicit csv_parser(const std::string & gtfs_directory);
+    // Files are inflated from the archive instead of mapped from the directory.
+    explicit csv_parser(const zip_reader & archive);
+    ~csv_parser();
+
+    csv_parser(const csv_parser &) = delete;
+    csv_parser & operator=(const csv_parser &) = delete;
 
     result read_header(const std::string & csv_filename);
-    result read_row(std::map<std::string, std::string> & obj);
+    result read_row(csv_row & row);
+
+    // Maps the file without reading its header, for files that are copied as they are.
+    result open(const std::string & csv_filename);
+    // All of the mapped file, as long as no row was read.
+    std::string_view contents() const;
+
+    // Field names of the header.
+    const std::vector<std::string> & header() const;
+
+    // Reads the next row like read_row(), but leaves the fields as they are in the file, with
+    // their quotes and spaces. A blank line has no fields.
+    result read_raw_row(std::vector<std::string_view> & fields);
+
+    // Splits the rows that were not read yet into at most count chunks of at least
+    // min_chunk_size bytes each.
+    std::vector<chunk> split_rows(size_t count, size_t min_chunk_size) const;
+
+    // Reads the next row of the chunk. The parser itself is not changed, different chunks can
+    // be read from several threads at once.
+    result read_row(csv_row & row, chunk & rows) const;
 
     static std::vector<std::string> split_record(const std::string & record,
                                                         bool is_header = false);
 
 private:
+    // Splits the record in place: quotes, tabs and carriage returns are removed by moving the
+    // remaining characters of a field to its front.
+    static void split_record(char * begin, char * end, std::vector<std::string_view> & fields);
+
+    result map_file(const std::string & csv_filename);
+    void unmap();
+
     std::vector<std::string> field_sequence;
+    size_t header_id = 0;
     std::string gtfs_path;
-    std::ifstream csv_stream;
+    const zip_reader * archive = nullptr;
+
+    char * data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
 };
 
 
@@ -0,0 +1,204 @@
+#include "csv_writer.h"
+#include <gtfs/misc.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <charconv>
+#include <cstring>
+
+namespace pfaedle::gtfs::access
+{
+namespace
+{
+// Longest number written by to_chars: 20 digits and a sign, or a double in fixed notation.
+constexpr size_t max_number_length = 350;
+}
+
+csv_writer::csv_writer(const std::string & filepath) :
+    filepath(filepath),
+    partial_path(filepath + ".part"),
+    buffer(new char[buffer_size])
+{
+    fd = open(partial_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+csv_writer::csv_writer(zip_writer & archive, const std::string & name) :
+    filepath(name),
+    archive(&archive),
+    member(std::make_unique<zip_writer::member>(name)),
+    buffer(new char[buffer_size])
+{
+}
+
+csv_writer::~csv_writer() { close(); }
+
+bool csv_writer::is_open() const { return fd >= 0 || member != nullptr; }
+
+void csv_writer::separate()
+{
+    if (row_started)
+        put(csv_separator);
+
+    row_started = true;
+}
+
+char * csv_writer::reserve(size_t n)
+{
+    if (used + n > buffer_size)
+        flush();
+
+    return buffer.get() + used;
+}
+
+void csv_writer::put(char c)
+{
+    if (used == buffer_size)
+        flush();
+
+    buffer[used++] = c;
+}
+
+void csv_writer::put(std::string_view text)
+{
+    while (!text.empty())
+    {
+        if (used == buffer_size)
+            flush();
+
+        const size_t n = std::min(text.size(), buffer_size - used);
+        std::memcpy(buffer.get() + used, text.data(), n);
+        used += n;
+        text.remove_prefix(n);
+    }
+}
+
+void csv_writer::flush()
+{
+    if (member != nullptr)
+    {
+        member->write(buffer.get(), used);
+        used = 0;
+        return;
+    }
+
+    size_t written = 0;
+    while (fd >= 0 && !failed && written < used)
+    {
+        const ssize_t res = ::write(fd, buffer.get() + written, used - written);
+        if (res < 0 && errno == EINTR)
+            continue;
+
+        if (res <= 0)
+            failed = true;
+        else
+            written += res;
+    }
+
+    used = 0;
+}
+
+csv_writer & csv_writer::field(std::string_view text)
+{
+    separate();
+    if (text.find_first_of("\",") == std::string_view::npos)
+    {
+        put(text);
+        return *this;
+    }
+
+    // Quotes are doubled, like quote_text() does.
+    put(quote);
+    for (size_t pos = text.find(quote); pos != std::string_view::npos; pos = text.find(quote))
+    {
+        put(text.substr(0, pos + 1));
+        put(quote);
+        text.remove_prefix(pos + 1);
+    }
+    put(text);
+    put(quote);
+    return *this;
+}
+
+csv_writer & csv_writer::field(const char * text) { return field(std::string_view(text)); }
+
+csv_writer & csv_writer::field(const std::string & text) { return field(std::string_view(text)); }
+
+csv_writer & csv_writer::field(double value, int precision)
+{
+    separate();
+    char * out = reserve(max_number_length);
+    out = std::to_chars(out, buffer.get() + buffer_size, value, std::chars_format::fixed, precision).ptr;
+    used = out - buffer.get();
+    return *this;
+}
+
+csv_writer & csv_writer::integer(long long value)
+{
+    separate();
+    char * out = reserve(max_number_length);
+    out = std::to_chars(out, buffer.get() + buffer_size, value).ptr;
+    used = out - buffer.get();
+    return *this;
+}
+
+csv_writer & csv_writer::unsigned_integer(unsigned long long value)
+{
+    separate();
+    char * out = reserve(max_number_length);
+    out = std::to_chars(out, buffer.get() + buffer_size, value).ptr;
+    used = out - buffer.get();
+    return *this;
+}
+
+csv_writer & csv_writer::empty_field()
+{
+    separate();
+    return *this;
+}
+
+csv_writer & csv_writer::raw_field(std::string_view text)
+{
+    separate();
+    put(text);
+    return *this;
+}
+
+void csv_writer::raw(std::string_view bytes) { put(bytes); }
+
+void csv_writer::end_row()
+{
+    put('\n');
+    row_started = false;
+}
+
+result csv_writer::close()
+{
+    if (member != nullptr)
+    {
+        flush();
+        const result res = archive->add(*member);
+        member.reset();
+        return res;
+    }
+
+    if (fd < 0)
+        return {result_code::ERROR_INVALID_GTFS_PATH, "Could not open path for writing " + filepath};
+
+    flush();
+    if (::close(fd) != 0)
+        failed = true;
+    fd = -1;
+
+    if (failed || std::rename(partial_path.c_str(), filepath.c_str()) != 0)
+    {
+        unlink(partial_path.c_str());
+        return {result_code::ERROR_INVALID_GTFS_PATH, "Could not write " + filepath};
+    }
+
+    return result_code::OK;
+}
+}
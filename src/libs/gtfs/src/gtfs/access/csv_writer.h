@@ -0,0 +1,86 @@
+#pragma once
+#include "zip_archive.h"
+#include <gtfs/access/result.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace pfaedle::gtfs::access
+{
+// Writes csv rows field by field into a buffer that is written to the file once it is full.
+// Numbers are formatted with std::to_chars, text is quoted only if it has to be. Files are
+// written next to their path and replace it once they are closed.
+class csv_writer
+{
+public:
+    static constexpr size_t buffer_size = 1 << 20;
+
+    explicit csv_writer(const std::string & filepath);
+    // Deflates the rows into a member of the archive, which is added once the writer is closed.
+    csv_writer(zip_writer & archive, const std::string & name);
+    ~csv_writer();
+
+    csv_writer(const csv_writer &) = delete;
+    csv_writer & operator=(const csv_writer &) = delete;
+
+    bool is_open() const;
+
+    csv_writer & field(std::string_view text);
+    csv_writer & field(const char * text);
+    csv_writer & field(const std::string & text);
+
+    // Fixed point, with 6 decimals by default like the coordinates of the input feeds.
+    csv_writer & field(double value, int precision = 6);
+
+    // Enums are written as their underlying integer.
+    template<typename T>
+    std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>, csv_writer &> field(T value)
+    {
+        if constexpr (std::is_enum_v<T>)
+            return integer(static_cast<long long>(value));
+        else if constexpr (std::is_signed_v<T>)
+            return integer(static_cast<long long>(value));
+        else
+            return unsigned_integer(static_cast<unsigned long long>(value));
+    }
+
+    csv_writer & empty_field();
+
+    // Field that is written as it is, quotes included, e.g. one of another csv file.
+    csv_writer & raw_field(std::string_view text);
+
+    // Bytes that are written as they are, e.g. a whole file that is copied.
+    void raw(std::string_view bytes);
+
+    void end_row();
+
+    // Writes the rest of the buffer, the result tells whether every write succeeded.
+    result close();
+
+private:
+    csv_writer & integer(long long value);
+    csv_writer & unsigned_integer(unsigned long long value);
+
+    // Separator before every field but the first of a row.
+    void separate();
+    // Room for n more characters in the buffer, they are added by moving used past them.
+    char * reserve(size_t n);
+    void put(char c);
+    void put(std::string_view text);
+    void flush();
+
+    std::string filepath;
+    std::string partial_path;
+    int fd = -1;
+    zip_writer * archive = nullptr;
+    std::unique_ptr<zip_writer::member> member;
+    bool failed = false;
+    bool row_started = false;
+
+    std::unique_ptr<char[]> buffer;
+    size_t used = 0;
+};
+}
@@ -1,11 +1,23 @@
 #include <gtfs/access/feed_reader.h>
 #include "csv_parser.h"
+#include "zip_archive.h"
 #include <string>
+#include <iterator>
+#include <string_view>
 #include <stdexcept>
-#include <map>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_max_threads() 1
+#endif
 
 namespace pfaedle::gtfs::access
 {
+// Chunks of large files per thread, more than one to balance chunks of different density.
+constexpr size_t CHUNKS_PER_THREAD = 4;
+constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
 
 class preparation_handler
 {
@@ -22,34 +34,105 @@ private:
     feed& feed_;
 };
 
-std::string get_value_or_default(const parsed_csv_row& container, const std::string& key,
-                                 const std::string& default_value = "")
+template<class T>
+void set_field(T& field, const csv_row& row, const csv_column& column, bool is_optional = true)
 {
-    const auto it = container.find(key);
-    if (it == container.end())
-        return default_value;
+    const std::string_view value = row.get(column);
+    if (!value.empty() || !is_optional)
+        field = static_cast<T>(parse_int(value));
+}
 
-    return it->second;
+bool set_fractional(double& field, const csv_row& row, const csv_column& column,
+                    bool is_optional = true)
+{
+    const std::string_view value = row.get(column);
+    if (!value.empty() || !is_optional)
+    {
+        field = parse_double(value);
+        return true;
+    }
+    return false;
 }
 
 template<class T>
-void set_field(T& field, const parsed_csv_row& container, const std::string& key, bool is_optional = true)
+void append(std::vector<T>& entities, std::vector<T>&& chunk)
 {
-    const std::string key_str = get_value_or_default(container, key);
-    if (!key_str.empty() || !is_optional)
-        field = static_cast<T>(std::stoi(key_str));
+    std::move(chunk.begin(), chunk.end(), std::back_inserter(entities));
+    std::vector<T>().swap(chunk);
 }
 
-bool set_fractional(double& field, const parsed_csv_row& container, const std::string& key,
-                    bool is_optional = true)
+void append(stop_time_store& entities, stop_time_store&& chunk)
+{
+    entities.append(std::move(chunk));
+}
+
+// Parser of the files in the directory, or in the archive if the feed is zipped.
+csv_parser make_parser(const std::string& directory, const zip_reader* archive)
+{
+    if (archive != nullptr)
+        return csv_parser(*archive);
+
+    return csv_parser(directory);
+}
+
+// Parses the rows of a large file in chunks on all threads. Every chunk is parsed into its own
+// container with its own columns, the containers are concatenated in file order.
+template<class Columns, class Container, class F>
+result parse_csv_chunked(const std::string& directory, const zip_reader* archive, const std::string& filename,
+                         Container& entities,
+                         const F& add_entity) noexcept
 {
-    const std::string key_str = get_value_or_default(container, key);
-    if (!key_str.empty() || !is_optional)
+    csv_parser parser = make_parser(directory, archive);
+    auto res_header = parser.read_header(filename);
+    if (res_header.code != result_code::OK)
+        return res_header;
+
+    const auto chunks = parser.split_rows(omp_get_max_threads() * CHUNKS_PER_THREAD, MIN_CHUNK_SIZE);
+    std::vector<Container> parsed(chunks.size());
+    std::vector<result> results(chunks.size(), result_code::OK);
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < chunks.size(); ++i)
     {
-        field = std::stod(key_str);
-        return true;
+        const Columns columns;
+        auto rows = chunks[i];
+        csv_row record;
+        result res_row;
+        while ((res_row = parser.read_row(record, rows)) != result_code::END_OF_FILE)
+        {
+            if (res_row != result_code::OK)
+            {
+                results[i] = res_row;
+                break;
+            }
+
+            if (record.empty())
+                continue;
+
+            result res = add_entity(record, columns, parsed[i]);
+            if (res != result_code::OK)
+            {
+                res.message += " while adding item from " + filename;
+                results[i] = res;
+                break;
+            }
+        }
     }
-    return false;
+
+    // The first error in the file:
+    for (const auto& res : results)
+        if (res != result_code::OK)
+            return res;
+
+    size_t count = entities.size();
+    for (const auto& chunk : parsed)
+        count += chunk.size();
+    entities.reserve(count);
+
+    for (auto& chunk : parsed)
+        append(entities, std::move(chunk));
+
+    return {result_code::OK, {"Parsed " + filename}};
 }
 
 // Throw if not valid WGS84 decimal degrees.
@@ -69,11 +152,13 @@ namespace pfaedle::gtfs::access
 
 feed_reader::feed_reader(feed& feed, const std::string& directory) :
     feed_(feed),
-    gtfs_directory_(add_trailing_slash(directory))
+    gtfs_directory_(is_zip_path(directory) ? directory : add_trailing_slash(directory))
 {
 
 }
 
+feed_reader::~feed_reader() = default;
+
 bool error_parsing_optional_file(const result & res)
 {
     return res != result_code::OK && res != result_code::ERROR_FILE_ABSENT;
@@ -81,73 +166,75 @@ bool error_parsing_optional_file(const result & res)
 
 result feed_reader::read(const read_config& config) noexcept
 {
-    preparation_handler handler(feed_);
-    // Read required files:
-    if (config.agencies)
-        if (auto res = read_agencies(); res != result_code::OK)
-            return res;
-
-    if (config.stops)
-        if (auto res = read_stops(); res != result_code::OK)
-            return res;
-
-    if (config.routes)
-        if (auto res = read_routes(); res != result_code::OK)
-            return res;
-
-    if (config.trips)
-        if (auto res = read_trips(); res != result_code::OK)
-            return res;
-
-    if (config.stop_times)
-        if (auto res = read_stop_times(); res != result_code::OK)
-            return res;
-
-    // Read conditionally required files:
-    if (config.calendar)
-        if (auto res = read_calendar(); error_parsing_optional_file(res))
-            return res;
-
-    if (config.calendar_dates)
-        if (auto res = read_calendar_dates(); error_parsing_optional_file(res))
+    if (is_zip_path(gtfs_directory_))
+    {
+        archive_ = std::make_unique<zip_reader>();
+        if (auto res = archive_->open(gtfs_directory_); res != result_code::OK)
             return res;
+    }
 
-    // Read optional files:
-    if (config.shapes)
-        if (auto res = read_shapes(); error_parsing_optional_file(res))
-            return res;
+    descriptive_columns_ = config.descriptive_columns;
+    preparation_handler handler(feed_);
 
-    if (config.transfers)
-        if (auto res = read_transfers(); error_parsing_optional_file(res))
-            return res;
+    struct file_reader
+    {
+        bool enabled;
+        bool required;
+        // Parsed in chunks on all threads, all other files are read concurrently afterwards.
+        bool chunked;
+        result (feed_reader::*read)();
+        result res;
+    };
 
-    if (config.frequencies)
-        if (auto res = read_frequencies(); error_parsing_optional_file(res))
-            return res;
+    // In the order their errors are reported:
+    std::vector<file_reader> files = {
+        // Read required files:
+        {config.agencies, true, false, &feed_reader::read_agencies, result_code::OK},
+        {config.stops, true, false, &feed_reader::read_stops, result_code::OK},
+        {config.routes, true, false, &feed_reader::read_routes, result_code::OK},
+        {config.trips, true, false, &feed_reader::read_trips, result_code::OK},
+        {config.stop_times, true, true, &feed_reader::read_stop_times, result_code::OK},
+
+        // Read conditionally required files:
+        {config.calendar, false, false, &feed_reader::read_calendar, result_code::OK},
+        {config.calendar_dates, false, false, &feed_reader::read_calendar_dates, result_code::OK},
+
+        // Read optional files:
+        {config.shapes, false, true, &feed_reader::read_shapes, result_code::OK},
+        {config.transfers, false, false, &feed_reader::read_transfers, result_code::OK},
+        {config.frequencies, false, false, &feed_reader::read_frequencies, result_code::OK},
+        {config.fare_attributes, false, false, &feed_reader::read_fare_attributes, result_code::OK},
+        {config.fare_rules, false, false, &feed_reader::read_fare_rules, result_code::OK},
+        {config.feed_info, false, false, &feed_reader::read_feed_info, result_code::OK},
+    };
 
-    if (config.fare_attributes)
-        if (auto res = read_fare_attributes(); error_parsing_optional_file(res))
-            return res;
+    for (auto& file : files)
+        if (file.enabled && file.chunked)
+            file.res = (this->*file.read)();
 
-    if (config.fare_rules)
-        if (auto res = read_fare_rules(); error_parsing_optional_file(res))
-            return res;
+    // Every file goes to its own container of the feed.
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < files.size(); ++i)
+        if (files[i].enabled && !files[i].chunked)
+            files[i].res = (this->*files[i].read)();
 
-    if (config.feed_info)
-        if (auto res = read_feed_info(); error_parsing_optional_file(res))
-            return res;
+    for (const auto& file : files)
+    {
+        if (file.required ? file.res != result_code::OK : error_parsing_optional_file(file.res))
+            return file.res;
+    }
 
     return result_code::OK;
 }
 
-result pfaedle::gtfs::access::feed_reader::parse_csv(const std::string& filename, const std::function<result(const parsed_csv_row&)>& add_entity) noexcept
+result pfaedle::gtfs::access::feed_reader::parse_csv(const std::string& filename, const std::function<result(const csv_row&)>& add_entity) noexcept
 {
-    csv_parser parser(gtfs_directory_);
+    csv_parser parser = make_parser(gtfs_directory_, archive_.get());
     auto res_header = parser.read_header(filename);
     if (res_header.code != result_code::OK)
         return res_header;
 
-    parsed_csv_row record;
+    csv_row record;
     result res_row;
     while ((res_row = parser.read_row(record)) != result_code::END_OF_FILE)
     {
@@ -169,19 +256,34 @@ result pfaedle::gtfs::access::feed_reader::parse_csv(const std::string& filename
 }
 result feed_reader::read_agencies()
 {
+    const struct
+    {
+        csv_column agency_id{"agency_id"};
+        csv_column agency_name{"agency_name"};
+        csv_column agency_url{"agency_url"};
+        csv_column agency_timezone{"agency_timezone"};
+        csv_column agency_lang{"agency_lang"};
+        csv_column agency_phone{"agency_phone"};
+        csv_column agency_fare_url{"agency_fare_url"};
+        csv_column agency_email{"agency_email"};
+    } columns{};
+
     int index = 0;
-    auto handler = [this, &index](const parsed_csv_row& row) -> result {
+    auto handler = [this, &columns, &index](const csv_row& row) -> result {
       agency agency(feed_);
 
       // Conditionally required id:
-      agency.agency_id = get_value_or_default(row, "agency_id", std::to_string(index));
+      if (row.has(columns.agency_id))
+          agency.agency_id = row.get(columns.agency_id);
+      else
+          agency.agency_id = std::to_string(index);
 
       // Required fields:
       try
       {
-          agency.agency_name = row.at("agency_name");
-          agency.agency_url = row.at("agency_url");
-          agency.agency_timezone = row.at("agency_timezone");
+          agency.agency_name = row.at(columns.agency_name);
+          agency.agency_url = row.at(columns.agency_url);
+          agency.agency_timezone = row.at(columns.agency_timezone);
       }
       catch (const std::out_of_range & ex)
       {
@@ -189,10 +291,10 @@ result feed_reader::read_agencies()
       }
 
       // Optional fields:
-      agency.agency_lang = get_value_or_default(row, "agency_lang");
-      agency.agency_phone = get_value_or_default(row, "agency_phone");
-      agency.agency_fare_url = get_value_or_default(row, "agency_fare_url");
-      agency.agency_email = get_value_or_default(row, "agency_email");
+      agency.agency_lang = row.get(columns.agency_lang);
+      agency.agency_phone = row.get(columns.agency_phone);
+      agency.agency_fare_url = row.get(columns.agency_fare_url);
+      agency.agency_email = row.get(columns.agency_email);
 
       feed_.agencies.insert(std::make_pair(agency.agency_id, std::move(agency)));
       return result{result_code::OK};
@@ -201,16 +303,34 @@ result feed_reader::read_agencies()
 }
 result feed_reader::read_stops()
 {
-    auto handler = [this](const parsed_csv_row& row) ->result {
+    const struct
+    {
+        csv_column stop_id{"stop_id"};
+        csv_column stop_name{"stop_name"};
+        csv_column parent_station{"parent_station"};
+        csv_column zone_id{"zone_id"};
+        csv_column stop_code{"stop_code"};
+        csv_column stop_desc{"stop_desc"};
+        csv_column stop_url{"stop_url"};
+        csv_column stop_timezone{"stop_timezone"};
+        csv_column wheelchair_boarding{"wheelchair_boarding"};
+        csv_column level_id{"level_id"};
+        csv_column platform_code{"platform_code"};
+        csv_column stop_lon{"stop_lon"};
+        csv_column stop_lat{"stop_lat"};
+        csv_column location_type{"location_type"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row) ->result {
       stop s(feed_);
 
       try
       {
-          s.stop_id = row.at("stop_id");
+          s.stop_id = row.at(columns.stop_id);
 
           // Optional:
-          bool const set_lon = set_fractional(s.stop_lon, row, "stop_lon");
-          bool const set_lat = set_fractional(s.stop_lat, row, "stop_lat");
+          bool const set_lon = set_fractional(s.stop_lon, row, columns.stop_lon);
+          bool const set_lat = set_fractional(s.stop_lat, row, columns.stop_lat);
 
           if (!set_lon || !set_lat)
               s.coordinates_present = false;
@@ -225,19 +345,19 @@ result feed_reader::read_stops()
       }
 
       // Conditionally required:
-      s.stop_name = get_value_or_default(row, "stop_name");
-      s.parent_station = get_value_or_default(row, "parent_station");
-      s.zone_id = get_value_or_default(row, "zone_id");
+      s.stop_name = row.get(columns.stop_name);
+      s.parent_station = row.get(columns.parent_station);
+      s.zone_id = row.get(columns.zone_id);
 
       // Optional:
-      s.stop_code = get_value_or_default(row, "stop_code");
-      s.stop_desc = get_value_or_default(row, "stop_desc");
-      s.stop_url = get_value_or_default(row, "stop_url");
-      set_field(s.location_type, row, "location_type");
-      s.stop_timezone = get_value_or_default(row, "stop_timezone");
-      s.wheelchair_boarding = get_value_or_default(row, "wheelchair_boarding");
-      s.level_id = get_value_or_default(row, "level_id");
-      s.platform_code = get_value_or_default(row, "platform_code");
+      s.stop_code = row.get(columns.stop_code);
+      s.stop_desc = row.get(columns.stop_desc);
+      s.stop_url = row.get(columns.stop_url);
+      set_field(s.location_type, row, columns.location_type);
+      s.stop_timezone = row.get(columns.stop_timezone);
+      s.wheelchair_boarding = row.get(columns.wheelchair_boarding);
+      s.level_id = row.get(columns.level_id);
+      s.platform_code = row.get(columns.platform_code);
 
 
       feed_.stops.insert(std::make_pair(s.stop_id, std::move(s)));
@@ -249,17 +369,31 @@ result feed_reader::read_stops()
 }
 result feed_reader::read_routes()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result {
+    const struct
+    {
+        csv_column route_id{"route_id"};
+        csv_column agency_id{"agency_id"};
+        csv_column route_short_name{"route_short_name"};
+        csv_column route_long_name{"route_long_name"};
+        csv_column route_color{"route_color"};
+        csv_column route_text_color{"route_text_color"};
+        csv_column route_desc{"route_desc"};
+        csv_column route_url{"route_url"};
+        csv_column route_type{"route_type"};
+        csv_column route_sort_order{"route_sort_order"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row) -> result {
       route r(feed_);
 
       try
       {
           // Required fields:
-          r.route_id = row.at("route_id");
-          set_field(r.route_type, row, "route_type", false);
+          r.route_id = row.at(columns.route_id);
+          set_field(r.route_type, row, columns.route_type, false);
 
           // Optional:
-          set_field(r.route_sort_order, row, "route_sort_order");
+          set_field(r.route_sort_order, row, columns.route_sort_order);
       }
       catch (const std::out_of_range & ex)
       {
@@ -271,10 +405,10 @@ result feed_reader::read_routes()
       }
 
       // Conditionally required:
-      r.agency_id = get_value_or_default(row, "agency_id");
+      r.agency_id = row.get(columns.agency_id);
 
-      r.route_short_name = get_value_or_default(row, "route_short_name");
-      r.route_long_name = get_value_or_default(row, "route_long_name");
+      r.route_short_name = row.get(columns.route_short_name);
+      r.route_long_name = row.get(columns.route_long_name);
 
       if (r.route_short_name.empty() && r.route_long_name.empty())
       {
@@ -282,10 +416,10 @@ result feed_reader::read_routes()
                   "'route_short_name' or 'route_long_name' must be specified"};
       }
 
-      r.route_color = get_value_or_default(row, "route_color");
-      r.route_text_color = get_value_or_default(row, "route_text_color");
-      r.route_desc = get_value_or_default(row, "route_desc");
-      r.route_url = get_value_or_default(row, "route_url");
+      r.route_color = row.get(columns.route_color);
+      r.route_text_color = row.get(columns.route_text_color);
+      r.route_desc = row.get(columns.route_desc);
+      r.route_url = row.get(columns.route_url);
 
       feed_.routes.insert(std::make_pair(r.route_id, std::move(r)));
 
@@ -295,19 +429,33 @@ result feed_reader::read_routes()
 }
 result feed_reader::read_trips()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result {
+    const struct
+    {
+        csv_column route_id{"route_id"};
+        csv_column service_id{"service_id"};
+        csv_column trip_id{"trip_id"};
+        csv_column shape_id{"shape_id"};
+        csv_column trip_headsign{"trip_headsign"};
+        csv_column trip_short_name{"trip_short_name"};
+        csv_column block_id{"block_id"};
+        csv_column direction_id{"direction_id"};
+        csv_column wheelchair_accessible{"wheelchair_accessible"};
+        csv_column bikes_allowed{"bikes_allowed"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row) -> result {
       trip t(feed_);
       try
       {
           // Required:
-          t.route_id = row.at("route_id");
-          t.service_id = row.at("service_id");
-          t.trip_id = row.at("trip_id");
+          t.route_id = row.at(columns.route_id);
+          t.service_id = row.at(columns.service_id);
+          t.trip_id = row.at(columns.trip_id);
 
           // Optional:
-          set_field(t.direction_id, row, "direction_id");
-          set_field(t.wheelchair_accessible, row, "wheelchair_accessible");
-          set_field(t.bikes_allowed, row, "bikes_allowed");
+          set_field(t.direction_id, row, columns.direction_id);
+          set_field(t.wheelchair_accessible, row, columns.wheelchair_accessible);
+          set_field(t.bikes_allowed, row, columns.bikes_allowed);
       }
       catch (const std::out_of_range & ex)
       {
@@ -319,10 +467,13 @@ result feed_reader::read_trips()
       }
 
       // Optional:
-      t.shape_id = get_value_or_default(row, "shape_id");
-      t.trip_headsign = get_value_or_default(row, "trip_headsign");
-      t.trip_short_name = get_value_or_default(row, "trip_short_name");
-      t.block_id = get_value_or_default(row, "block_id");
+      t.shape_id = row.get(columns.shape_id);
+      t.trip_short_name = row.get(columns.trip_short_name);
+      if (descriptive_columns_)
+      {
+          t.trip_headsign = row.get(columns.trip_headsign);
+          t.block_id = row.get(columns.block_id);
+      }
 
       feed_.trips.insert(std::make_pair(t.trip_id, std::move(t)));
 
@@ -332,29 +483,47 @@ result feed_reader::read_trips()
 }
 result feed_reader::read_stop_times()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result{
-      stop_time st(feed_);
+    struct stop_time_columns
+    {
+        csv_column trip_id{"trip_id"};
+        csv_column stop_id{"stop_id"};
+        csv_column stop_sequence{"stop_sequence"};
+        csv_column departure_time{"departure_time"};
+        csv_column arrival_time{"arrival_time"};
+        csv_column stop_headsign{"stop_headsign"};
+        csv_column pickup_type{"pickup_type"};
+        csv_column drop_off_type{"drop_off_type"};
+        csv_column shape_dist_traveled{"shape_dist_traveled"};
+        csv_column timepoint{"timepoint"};
+    };
+
+    const bool descriptive_columns = descriptive_columns_;
+    auto handler = [descriptive_columns](const csv_row& row, const stop_time_columns& columns,
+                                         stop_time_store& stop_times) -> result {
+      stop_time_values st;
 
       try
       {
           // Required:
-          st.trip_id = row.at("trip_id");
-          st.stop_id = row.at("stop_id");
-          st.stop_sequence = std::stoi(row.at("stop_sequence"));
+          st.trip_id = row.at(columns.trip_id);
+          st.stop_id = row.at(columns.stop_id);
+          st.stop_sequence = parse_int(row.at(columns.stop_sequence));
 
           // Conditionally required:
-          st.departure_time = time(row.at("departure_time"));
-          st.arrival_time = time(row.at("arrival_time"));
+          st.departure_time = time(row.at(columns.departure_time));
+          st.arrival_time = time(row.at(columns.arrival_time));
 
           // Optional:
-          set_field(st.pickup_type, row, "pickup_type");
-          set_field(st.drop_off_type, row, "drop_off_type");
-
-          set_fractional(st.shape_dist_traveled, row, "shape_dist_traveled");
+          set_fractional(st.shape_dist_traveled, row, columns.shape_dist_traveled);
           if (st.shape_dist_traveled < 0.0)
               throw std::invalid_argument("Invalid shape_dist_traveled");
 
-          set_field(st.timepoint, row, "timepoint");
+          if (descriptive_columns)
+          {
+              set_field(st.pickup_type, row, columns.pickup_type);
+              set_field(st.drop_off_type, row, columns.drop_off_type);
+              set_field(st.timepoint, row, columns.timepoint);
+          }
       }
       catch (const std::out_of_range & ex)
       {
@@ -370,33 +539,48 @@ result feed_reader::read_stop_times()
       }
 
       // Optional fields:
-      st.stop_headsign = get_value_or_default(row, "stop_headsign");
+      if (descriptive_columns)
+          st.stop_headsign = row.get(columns.stop_headsign);
 
-      feed_.stop_times.push_back(std::move(st));
+      stop_times.push_back(st);
 
       return result_code::OK;
     };
-    return parse_csv(file_stop_times, handler);
+    return parse_csv_chunked<stop_time_columns>(gtfs_directory_, archive_.get(), file_stop_times, feed_.stop_times, handler);
 }
 result feed_reader::read_calendar()
 {
-    auto handler = [this](const parsed_csv_row& row)->result {
+    const struct
+    {
+        csv_column service_id{"service_id"};
+        csv_column start_date{"start_date"};
+        csv_column end_date{"end_date"};
+        csv_column monday{"monday"};
+        csv_column tuesday{"tuesday"};
+        csv_column wednesday{"wednesday"};
+        csv_column thursday{"thursday"};
+        csv_column friday{"friday"};
+        csv_column saturday{"saturday"};
+        csv_column sunday{"sunday"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row)->result {
       pfaedle::gtfs::calendar_item calendar_item;
       try
       {
           // Required fields:
-          calendar_item.service_id = row.at("service_id");
+          calendar_item.service_id = row.at(columns.service_id);
 
-          set_field(calendar_item.monday, row, "monday", false);
-          set_field(calendar_item.tuesday, row, "tuesday", false);
-          set_field(calendar_item.wednesday, row, "wednesday", false);
-          set_field(calendar_item.thursday, row, "thursday", false);
-          set_field(calendar_item.friday, row, "friday", false);
-          set_field(calendar_item.saturday, row, "saturday", false);
-          set_field(calendar_item.sunday, row, "sunday", false);
+          set_field(calendar_item.monday, row, columns.monday, false);
+          set_field(calendar_item.tuesday, row, columns.tuesday, false);
+          set_field(calendar_item.wednesday, row, columns.wednesday, false);
+          set_field(calendar_item.thursday, row, columns.thursday, false);
+          set_field(calendar_item.friday, row, columns.friday, false);
+          set_field(calendar_item.saturday, row, columns.saturday, false);
+          set_field(calendar_item.sunday, row, columns.sunday, false);
 
-          calendar_item.start_date = date(row.at("start_date"));
-          calendar_item.end_date = date(row.at("end_date"));
+          calendar_item.start_date = date(row.at(columns.start_date));
+          calendar_item.end_date = date(row.at(columns.end_date));
       }
       catch (const std::out_of_range & ex)
       {
@@ -418,15 +602,22 @@ result feed_reader::read_calendar()
 }
 result feed_reader::read_calendar_dates()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result {
+    const struct
+    {
+        csv_column service_id{"service_id"};
+        csv_column date{"date"};
+        csv_column exception_type{"exception_type"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row) -> result {
       pfaedle::gtfs::calendar_date calendar_date;
       try
       {
           // Required fields:
-          calendar_date.service_id = row.at("service_id");
+          calendar_date.service_id = row.at(columns.service_id);
 
-          set_field(calendar_date.exception_type, row, "exception_type", false);
-          calendar_date.date = date(row.at("date"));
+          set_field(calendar_date.exception_type, row, columns.exception_type, false);
+          calendar_date.date = date(row.at(columns.date));
       }
       catch (const std::out_of_range & ex)
       {
@@ -448,12 +639,21 @@ result feed_reader::read_calendar_dates()
 }
 result feed_reader::read_fare_rules()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result {
+    const struct
+    {
+        csv_column fare_id{"fare_id"};
+        csv_column route_id{"route_id"};
+        csv_column origin_id{"origin_id"};
+        csv_column destination_id{"destination_id"};
+        csv_column contains_id{"contains_id"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row) -> result {
         pfaedle::gtfs::fare_rule fare_rule;
         try
         {
             // Required fields:
-            fare_rule.fare_id = row.at("fare_id");
+            fare_rule.fare_id = row.at(columns.fare_id);
         }
         catch (const std::out_of_range& ex)
         {
@@ -469,10 +669,10 @@ result feed_reader::read_fare_rules()
         }
 
         // Optional fields:
-        fare_rule.route_id = get_value_or_default(row, "route_id");
-        fare_rule.origin_id = get_value_or_default(row, "origin_id");
-        fare_rule.destination_id = get_value_or_default(row, "destination_id");
-        fare_rule.contains_id = get_value_or_default(row, "contains_id");
+        fare_rule.route_id = row.get(columns.route_id);
+        fare_rule.origin_id = row.get(columns.origin_id);
+        fare_rule.destination_id = row.get(columns.destination_id);
+        fare_rule.contains_id = row.get(columns.contains_id);
 
         feed_.fare_rules.emplace(fare_rule.fare_id, fare_rule);
 
@@ -482,21 +682,32 @@ result feed_reader::read_fare_rules()
 }
 result feed_reader::read_fare_attributes()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result {
+    const struct
+    {
+        csv_column fare_id{"fare_id"};
+        csv_column currency_type{"currency_type"};
+        csv_column agency_id{"agency_id"};
+        csv_column price{"price"};
+        csv_column payment_method{"payment_method"};
+        csv_column transfers{"transfers"};
+        csv_column transfer_duration{"transfer_duration"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row) -> result {
         fare_attributes_item item;
         try
         {
             // Required fields:
-            item.fare_id = row.at("fare_id");
-            set_fractional(item.price, row, "price", false);
+            item.fare_id = row.at(columns.fare_id);
+            set_fractional(item.price, row, columns.price, false);
 
-            item.currency_type = row.at("currency_type");
-            set_field(item.payment_method, row, "payment_method", false);
-            set_field(item.transfers, row, "transfers", false);
+            item.currency_type = row.at(columns.currency_type);
+            set_field(item.payment_method, row, columns.payment_method, false);
+            set_field(item.transfers, row, columns.transfers, false);
 
             // Conditionally optional:
-            item.agency_id = get_value_or_default(row, "agency_id");
-            set_field(item.transfer_duration, row, "transfer_duration");
+            item.agency_id = row.get(columns.agency_id);
+            set_field(item.transfer_duration, row, columns.transfer_duration);
         }
         catch (const std::out_of_range& ex)
         {
@@ -518,20 +729,37 @@ result feed_reader::read_fare_attributes()
 }
 result feed_reader::read_shapes()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result {
-      shape_point pt;
+    struct shape_columns
+    {
+        csv_column shape_id{"shape_id"};
+        csv_column shape_pt_sequence{"shape_pt_sequence"};
+        csv_column shape_pt_lon{"shape_pt_lon"};
+        csv_column shape_pt_lat{"shape_pt_lat"};
+        csv_column shape_dist_traveled{"shape_dist_traveled"};
+    };
+
+    // The id is stored once per shape, so it is only kept next to the point while reading.
+    struct shape_row
+    {
+        Id shape_id;
+        shape_point point;
+    };
+
+    auto handler = [](const csv_row& row, const shape_columns& columns, std::vector<shape_row>& rows) -> result {
+      shape_row parsed;
+      shape_point& pt = parsed.point;
       try
       {
           // Required:
-          pt.shape_id = row.at("shape_id");
-          pt.shape_pt_sequence = std::stoi(row.at("shape_pt_sequence"));
+          parsed.shape_id = row.at(columns.shape_id);
+          pt.shape_pt_sequence = parse_int(row.at(columns.shape_pt_sequence));
 
-          pt.shape_pt_lon = std::stod(row.at("shape_pt_lon"));
-          pt.shape_pt_lat = std::stod(row.at("shape_pt_lat"));
+          pt.shape_pt_lon = parse_double(row.at(columns.shape_pt_lon));
+          pt.shape_pt_lat = parse_double(row.at(columns.shape_pt_lat));
           check_coordinates(pt.shape_pt_lat, pt.shape_pt_lon);
 
           // Optional:
-          set_fractional(pt.shape_dist_traveled, row, "shape_dist_traveled");
+          set_fractional(pt.shape_dist_traveled, row, columns.shape_dist_traveled);
           if (pt.shape_dist_traveled < 0.0)
               throw std::invalid_argument("Invalid shape_dist_traveled");
       }
@@ -544,31 +772,54 @@ result feed_reader::read_shapes()
           return {result_code::ERROR_INVALID_FIELD_FORMAT, ex.what()};
       }
 
-      auto& shape = feed_.shapes[pt.shape_id];
-      if(shape.points.empty())
-      {
-          shape.shape_id = pt.shape_id;
-      }
-      shape.points.emplace_back(pt);
+      rows.push_back(std::move(parsed));
 
       return result_code::OK;
     };
-    return parse_csv(file_shapes, handler);
+
+    std::vector<shape_row> rows;
+    auto res = parse_csv_chunked<shape_columns>(gtfs_directory_, archive_.get(), file_shapes, rows, handler);
+    if (res != result_code::OK)
+        return res;
+
+    // Points of a shape are usually consecutive in the file.
+    shape* current = nullptr;
+    for (auto& row : rows)
+    {
+        if (current == nullptr || current->shape_id != row.shape_id)
+        {
+            current = &feed_.shapes[row.shape_id];
+            if (current->points.empty())
+                current->shape_id = std::move(row.shape_id);
+        }
+        current->points.push_back(row.point);
+    }
+
+    return res;
 }
 result feed_reader::read_frequencies()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result{
+    const struct
+    {
+        csv_column trip_id{"trip_id"};
+        csv_column start_time{"start_time"};
+        csv_column end_time{"end_time"};
+        csv_column headway_secs{"headway_secs"};
+        csv_column exact_times{"exact_times"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row) -> result{
       pfaedle::gtfs::frequency frequency(feed_);
       try
       {
           // Required fields:
-          frequency.trip_id = row.at("trip_id");
-          frequency.start_time = time(row.at("start_time"));
-          frequency.end_time = time(row.at("end_time"));
-          set_field(frequency.headway_secs, row, "headway_secs", false);
+          frequency.trip_id = row.at(columns.trip_id);
+          frequency.start_time = time(row.at(columns.start_time));
+          frequency.end_time = time(row.at(columns.end_time));
+          set_field(frequency.headway_secs, row, columns.headway_secs, false);
 
           // Optional:
-          set_field(frequency.exact_times, row, "exact_times");
+          set_field(frequency.exact_times, row, columns.exact_times);
       }
       catch (const std::out_of_range & ex)
       {
@@ -590,17 +841,25 @@ result feed_reader::read_frequencies()
 }
 result feed_reader::read_transfers()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result {
+    const struct
+    {
+        csv_column from_stop_id{"from_stop_id"};
+        csv_column to_stop_id{"to_stop_id"};
+        csv_column transfer_type{"transfer_type"};
+        csv_column min_transfer_time{"min_transfer_time"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row) -> result {
         pfaedle::gtfs::transfer transfer(feed_);
         try
         {
             // Required fields:
-            transfer.from_stop_id = row.at("from_stop_id");
-            transfer.to_stop_id = row.at("to_stop_id");
-            set_field(transfer.transfer_type, row, "transfer_type", false);
+            transfer.from_stop_id = row.at(columns.from_stop_id);
+            transfer.to_stop_id = row.at(columns.to_stop_id);
+            set_field(transfer.transfer_type, row, columns.transfer_type, false);
 
             // Optional:
-            set_field(transfer.min_transfer_time, row, "min_transfer_time");
+            set_field(transfer.min_transfer_time, row, columns.min_transfer_time);
         }
         catch (const std::out_of_range& ex)
         {
@@ -622,17 +881,29 @@ result feed_reader::read_transfers()
 }
 result feed_reader::read_feed_info()
 {
-    auto handler = [this](const parsed_csv_row& row) -> result {
+    const struct
+    {
+        csv_column feed_publisher_name{"feed_publisher_name"};
+        csv_column feed_publisher_url{"feed_publisher_url"};
+        csv_column feed_lang{"feed_lang"};
+        csv_column feed_start_date{"feed_start_date"};
+        csv_column feed_end_date{"feed_end_date"};
+        csv_column feed_version{"feed_version"};
+        csv_column feed_contact_email{"feed_contact_email"};
+        csv_column feed_contact_url{"feed_contact_url"};
+    } columns{};
+
+    auto handler = [this, &columns](const csv_row& row) -> result {
         try
         {
             // Required fields:
-            feed_.feed_info.feed_publisher_name = row.at("feed_publisher_name");
-            feed_.feed_info.feed_publisher_url = row.at("feed_publisher_url");
-            feed_.feed_info.feed_lang = row.at("feed_lang");
+            feed_.feed_info.feed_publisher_name = row.at(columns.feed_publisher_name);
+            feed_.feed_info.feed_publisher_url = row.at(columns.feed_publisher_url);
+            feed_.feed_info.feed_lang = row.at(columns.feed_lang);
 
             // Optional fields:
-            feed_.feed_info.feed_start_date = date(get_value_or_default(row, "feed_start_date"));
-            feed_.feed_info.feed_end_date = date(get_value_or_default(row, "feed_end_date"));
+            feed_.feed_info.feed_start_date = date(row.get(columns.feed_start_date));
+            feed_.feed_info.feed_end_date = date(row.get(columns.feed_end_date));
         }
         catch (const std::out_of_range& ex)
         {
@@ -648,9 +919,9 @@ result feed_reader::read_feed_info()
         }
 
         // Optional fields:
-        feed_.feed_info.feed_version = get_value_or_default(row, "feed_version");
-        feed_.feed_info.feed_contact_email = get_value_or_default(row, "feed_contact_email");
-        feed_.feed_info.feed_contact_url = get_value_or_default(row, "feed_contact_url");
+        feed_.feed_info.feed_version = row.get(columns.feed_version);
+        feed_.feed_info.feed_contact_email = row.get(columns.feed_contact_email);
+        feed_.feed_info.feed_contact_url = row.get(columns.feed_contact_url);
 
         return result_code::OK;
     };
@@ -1,143 +1,252 @@
 #include <gtfs/access/feed_writter.h>
+#include "csv_parser.h"
+#include "csv_writer.h"
+#include "zip_archive.h"
 #include <gtfs/feed.h>
 #include <gtfs/misc.h>
 
-#include <fstream>
-#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <initializer_list>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace pfaedle::gtfs
 {
-void write_agency_header(std::ofstream & out)
+using access::csv_writer;
+
+void write_header(csv_writer & out, std::initializer_list<std::string_view> fields)
 {
-    std::vector<std::string> fields = {"agency_id",       "agency_name", "agency_url",
-                                       "agency_timezone", "agency_lang", "agency_phone",
-                                       "agency_fare_url", "agency_email"};
-    write_joined(out, std::move(fields));
+    for (const auto field : fields)
+        out.field(field);
+    out.end_row();
 }
 
-void write_routes_header(std::ofstream & out)
+void write_agency_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {
+    write_header(out, {"agency_id",       "agency_name", "agency_url",
+                       "agency_timezone", "agency_lang", "agency_phone",
+                       "agency_fare_url", "agency_email"});
+}
+
+void write_routes_header(csv_writer & out)
+{
+    write_header(out, {
             "route_id",         "agency_id",        "route_short_name",  "route_long_name",
             "route_desc",       "route_type",       "route_url",         "route_color",
-            "route_text_color", "route_sort_order", "continuous_pickup", "continuous_drop_off"};
-    write_joined(out, std::move(fields));
+            "route_text_color", "route_sort_order", "continuous_pickup", "continuous_drop_off"});
 }
 
-void write_shapes_header(std::ofstream & out)
+void write_shapes_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"shape_id", "shape_pt_lat", "shape_pt_lon",
-                                       "shape_pt_sequence", "shape_dist_traveled"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"shape_id", "shape_pt_lat", "shape_pt_lon",
+                       "shape_pt_sequence", "shape_dist_traveled"});
 }
 
-void write_trips_header(std::ofstream & out)
+void write_trips_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {
+    write_header(out, {
             "route_id",     "service_id", "trip_id",  "trip_headsign",         "trip_short_name",
-            "direction_id", "block_id",   "shape_id", "wheelchair_accessible", "bikes_allowed"};
-    write_joined(out, std::move(fields));
+            "direction_id", "block_id",   "shape_id", "wheelchair_accessible", "bikes_allowed"});
 }
 
-void write_stops_header(std::ofstream & out)
+void write_stops_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"stop_id",        "stop_code",     "stop_name",
-                                       "stop_desc",      "stop_lat",      "stop_lon",
-                                       "zone_id",        "stop_url",      "location_type",
-                                       "parent_station", "stop_timezone", "wheelchair_boarding",
-                                       "level_id",       "platform_code"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"stop_id",        "stop_code",     "stop_name",
+                       "stop_desc",      "stop_lat",      "stop_lon",
+                       "zone_id",        "stop_url",      "location_type",
+                       "parent_station", "stop_timezone", "wheelchair_boarding",
+                       "level_id",       "platform_code"});
 }
 
-void write_stop_times_header(std::ofstream & out)
+void write_stop_times_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {
+    write_header(out, {
             "trip_id",           "arrival_time",        "departure_time",      "stop_id",
             "stop_sequence",     "stop_headsign",       "pickup_type",         "drop_off_type",
-            "continuous_pickup", "continuous_drop_off", "shape_dist_traveled", "timepoint"};
-    write_joined(out, std::move(fields));
+            "continuous_pickup", "continuous_drop_off", "shape_dist_traveled", "timepoint"});
 }
 
-void write_calendar_header(std::ofstream & out)
+void write_calendar_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"service_id", "monday",   "tuesday", "wednesday",  "thursday",
-                                       "friday",     "saturday", "sunday",  "start_date", "end_date"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"service_id", "monday",   "tuesday", "wednesday",  "thursday",
+                       "friday",     "saturday", "sunday",  "start_date", "end_date"});
 }
 
-void write_calendar_dates_header(std::ofstream & out)
+void write_calendar_dates_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"service_id", "date", "exception_type"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"service_id", "date", "exception_type"});
 }
 
-void write_transfers_header(std::ofstream & out)
+void write_transfers_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"from_stop_id", "to_stop_id", "transfer_type",
-                                       "min_transfer_time"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"from_stop_id", "to_stop_id", "transfer_type",
+                       "min_transfer_time"});
 }
 
-void write_frequencies_header(std::ofstream & out)
+void write_frequencies_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"trip_id", "start_time", "end_time", "headway_secs",
-                                       "exact_times"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"trip_id", "start_time", "end_time", "headway_secs",
+                       "exact_times"});
 }
 
-void write_fare_attributes_header(std::ofstream & out)
+void write_fare_attributes_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"fare_id",   "price",     "currency_type",    "payment_method",
-                                       "transfers", "agency_id", "transfer_duration"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"fare_id",   "price",     "currency_type",    "payment_method",
+                       "transfers", "agency_id", "transfer_duration"});
 }
 
-void write_fare_rules_header(std::ofstream & out)
+void write_fare_rules_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"fare_id", "route_id", "origin_id", "destination_id",
-                                       "contains_id"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"fare_id", "route_id", "origin_id", "destination_id",
+                       "contains_id"});
 }
 
-void write_pathways_header(std::ofstream & out)
+void write_pathways_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {
+    write_header(out, {
             "pathway_id",       "from_stop_id", "to_stop_id",     "pathway_mode",
             "is_bidirectional", "length",       "traversal_time", "stair_count",
-            "max_slope",        "min_width",    "signposted_as",  "reversed_signposted_as"};
-    write_joined(out, std::move(fields));
+            "max_slope",        "min_width",    "signposted_as",  "reversed_signposted_as"});
 }
 
-void write_levels_header(std::ofstream & out)
+void write_levels_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"level_id", "level_index", "level_name"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"level_id", "level_index", "level_name"});
 }
 
-void write_feed_info_header(std::ofstream & out)
+void write_feed_info_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {
+    write_header(out, {
             "feed_publisher_name", "feed_publisher_url", "feed_lang",
             "default_lang",        "feed_start_date",    "feed_end_date",
-            "feed_version",        "feed_contact_email", "feed_contact_url"};
-    write_joined(out, std::move(fields));
+            "feed_version",        "feed_contact_email", "feed_contact_url"});
 }
 
-void write_translations_header(std::ofstream & out)
+void write_translations_header(csv_writer & out)
 {
-    std::vector<std::string> fields = {"table_name", "field_name",    "language",   "translation",
-                                       "record_id",  "record_sub_id", "field_value"};
-    write_joined(out, std::move(fields));
+    write_header(out, {"table_name", "field_name",    "language",   "translation",
+                       "record_id",  "record_sub_id", "field_value"});
+}
+
+void write_attributions_header(csv_writer & out)
+{
+    write_header(out, {"attribution_id",    "agency_id",         "route_id",
+                       "trip_id",           "organization_name", "is_producer",
+                       "is_operator",       "is_authority",      "attribution_url",
+                       "attribution_email", "attribution_phone"});
+}
+
+namespace
+{
+// Regular files in the directory, sorted.
+std::vector<std::string> list_directory(const std::string& directory)
+{
+    std::vector<std::string> names;
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+        return names;
+
+    while (const dirent* entry = readdir(dir))
+    {
+        struct stat st;
+        const std::string name = entry->d_name;
+        if (stat((directory + name).c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            names.push_back(name);
+    }
+    closedir(dir);
+
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+bool same_file(const std::string& a, const std::string& b)
+{
+    struct stat st_a;
+    struct stat st_b;
+    return stat(a.c_str(), &st_a) == 0 && stat(b.c_str(), &st_b) == 0 && st_a.st_dev == st_b.st_dev &&
+           st_a.st_ino == st_b.st_ino;
+}
+
+// Value of a field as the reader has it, only fields with quotes or spaces are split again.
+std::string field_value(std::string_view raw)
+{
+    if (raw.find_first_of("\"\t\r ") == std::string_view::npos)
+        return std::string(raw);
+
+    return access::csv_parser::split_record(std::string(raw)).front();
 }
 
-void write_attributions_header(std::ofstream & out)
+size_t column_index(const std::vector<std::string>& header, const std::string& name)
 {
-    std::vector<std::string> fields = {"attribution_id",    "agency_id",         "route_id",
-                                       "trip_id",           "organization_name", "is_producer",
-                                       "is_operator",       "is_authority",      "attribution_url",
-                                       "attribution_email", "attribution_phone"};
-    write_joined(out, std::move(fields));
+    return std::find(header.begin(), header.end(), name) - header.begin();
+}
+
+// Indices of the columns that are taken from the feed, the ones the header has not are appended
+// after its last column in this order.
+std::vector<size_t> feed_columns(const std::vector<std::string>& header, const std::vector<std::string>& names)
+{
+    std::vector<size_t> columns;
+    size_t appended = header.size();
+    for (const auto& name : names)
+    {
+        const size_t i = column_index(header, name);
+        columns.push_back(i < header.size() ? i : appended++);
+    }
+    return columns;
+}
+
+// Header of a file that is passed through, with the columns that are taken from the feed added if
+// it has none.
+void write_header(csv_writer& out, const std::vector<std::string>& header, const std::vector<size_t>& columns,
+                  const std::vector<std::string>& names)
+{
+    for (const auto& field : header)
+        out.field(field);
+    for (size_t k = 0; k < columns.size(); ++k)
+    {
+        if (columns[k] >= header.size())
+            out.field(names[k]);
+    }
+    out.end_row();
+}
+
+// Row of a file that is passed through, the value of the k-th column taken from the feed is
+// written by write_value(k, value). Rows are cut or padded to the header, like the reader does.
+template<class F>
+void write_row(csv_writer& out, const std::vector<std::string_view>& fields, size_t header_size,
+               const std::vector<size_t>& columns, const F& write_value)
+{
+    size_t size = header_size;
+    for (const auto column : columns)
+        size = std::max(size, column + 1);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        const size_t k = std::find(columns.begin(), columns.end(), i) - columns.begin();
+        if (k < columns.size())
+            write_value(k, i < fields.size() ? fields[i] : std::string_view());
+        else if (i < fields.size())
+            out.raw_field(fields[i]);
+        else
+            out.empty_field();
+    }
+    out.end_row();
+}
+
+// A time of a row that is passed through, kept as it is unless the feed has another one.
+void write_time(csv_writer& out, std::string_view value, const time& t)
+{
+    if (time(field_value(value)) == t)
+        out.raw_field(value);
+    else if (!t.is_provided())
+        out.empty_field();
+    else
+        out.field(t.get_raw_time());
+}
 }
 
 namespace access
@@ -146,202 +255,385 @@ namespace access
 
 feed_writter::feed_writter(feed& feed, const std::string& directory) :
     feed_{feed},
-    gtfs_directory_{add_trailing_slash(directory)}
+    gtfs_directory_{is_zip_path(directory) ? directory : add_trailing_slash(directory)}
 {}
+feed_writter::~feed_writter() = default;
 result feed_writter::write(const write_config& config) noexcept
 {
-    // Read required files:
-    if (config.agencies)
-        if (auto res = write_agencies(); res != result_code::OK)
-            return res;
+    const bool passing = !config.pass_through.empty();
+    if (passing)
+    {
+        if (is_zip_path(config.pass_through))
+        {
+            source_archive_ = std::make_unique<zip_reader>();
+            if (auto res = source_archive_->open(config.pass_through); res != result_code::OK)
+            {
+                source_archive_.reset();
+                return res;
+            }
+        }
+        else
+        {
+            source_directory_ = add_trailing_slash(config.pass_through);
+        }
+    }
+
+    if (is_zip_path(gtfs_directory_))
+    {
+        archive_ = std::make_unique<zip_writer>(gtfs_directory_);
+        if (!archive_->is_open())
+            return archive_->close();
+    }
+
+    struct file_writer
+    {
+        bool enabled;
+        std::string file;
+        std::function<result()> write;
+        result res = result_code::OK;
+    };
 
-    if (config.stops)
-        if (auto res = write_stops(); res != result_code::OK)
-            return res;
+    auto from_feed = [this](result (feed_writter::*write)() const) -> std::function<result()> {
+        return [this, write] { return (this->*write)(); };
+    };
+    auto copied = [this](const std::string& file) -> std::function<result()> {
+        return [this, file] { return copy_file(file); };
+    };
+    // Files that are only copied if the feed is passed through.
+    auto copied_only = [&](const std::string& file) -> std::function<result()> {
+        return passing ? copied(file) : nullptr;
+    };
 
-    if (config.routes)
-        if (auto res = write_routes(); res != result_code::OK)
-            return res;
+    // In the order their errors are reported:
+    std::vector<file_writer> files = {
+        // Write required files:
+        {config.agencies, file_agency, passing ? copied(file_agency) : from_feed(&feed_writter::write_agencies)},
+        {config.stops, file_stops, passing ? copied(file_stops) : from_feed(&feed_writter::write_stops)},
+        {config.routes, file_routes, passing ? copied(file_routes) : from_feed(&feed_writter::write_routes)},
+        {config.trips, file_trips, from_feed(passing ? &feed_writter::pass_trips : &feed_writter::write_trips)},
+        {config.stop_times, file_stop_times,
+         from_feed(passing ? &feed_writter::pass_stop_times : &feed_writter::write_stop_times)},
+
+        // Write conditionally required files:
+        {config.calendar, file_calendar, passing ? copied(file_calendar) : from_feed(&feed_writter::write_calendar)},
+        {config.calendar_dates, file_calendar_dates,
+         passing ? copied(file_calendar_dates) : from_feed(&feed_writter::write_calendar_dates)},
+
+        // Write optional files:
+        {config.shapes, file_shapes, from_feed(&feed_writter::write_shapes)},
+        {config.transfers, file_transfers, passing ? copied(file_transfers) : from_feed(&feed_writter::write_transfers)},
+        {config.frequencies, file_frequencies,
+         passing ? copied(file_frequencies) : from_feed(&feed_writter::write_frequencies)},
+        {config.fare_attributes, file_fare_attributes,
+         passing ? copied(file_fare_attributes) : from_feed(&feed_writter::write_fare_attributes)},
+        {config.fare_rules, file_fare_rules, passing ? copied(file_fare_rules) : from_feed(&feed_writter::write_fare_rules)},
+        {config.pathways, file_pathways, copied_only(file_pathways)},
+        {config.levels, file_levels, copied_only(file_levels)},
+        {config.attributions, file_attributions, copied_only(file_attributions)},
+        {config.feed_info, file_feed_info, passing ? copied(file_feed_info) : from_feed(&feed_writter::write_feed_info)},
+        {config.translations, file_translations, copied_only(file_translations)},
+    };
 
-    if (config.trips)
-        if (auto res = write_trips(); res != result_code::OK)
-            return res;
+    // Files that are not part of the feed, e.g. of newer GTFS extensions, are copied as well.
+    if (passing)
+    {
+        const auto names = source_archive_ ? source_archive_->names() : list_directory(source_directory_);
+        for (const auto& name : names)
+        {
+            const std::string file = name.substr(name.rfind('/') + 1);
+            const bool known = std::any_of(files.begin(), files.end(),
+                                           [&file](const file_writer& f) { return f.file == file; });
+            if (!known && file.size() > 4 && file.compare(file.size() - 4, 4, ".txt") == 0)
+                files.push_back({true, file, copied(file)});
+        }
+    }
+
+    // Every file only reads its own container of the feed.
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < files.size(); ++i)
+        if (files[i].enabled && files[i].write)
+            files[i].res = files[i].write();
+
+    result res = result_code::OK;
+    for (const auto& file : files)
+    {
+        if (file.res != result_code::OK)
+        {
+            res = file.res;
+            break;
+        }
+    }
+
+    if (archive_)
+    {
+        // Closed after an error as well, the archive then lists the files written so far.
+        const result closed = archive_->close();
+        archive_.reset();
+        if (res == result_code::OK)
+            res = closed;
+    }
+
+    source_archive_.reset();
+    source_directory_.clear();
+    return res;
+}
 
-    if (config.stop_times)
-        if (auto res = write_stop_times(); res != result_code::OK)
-            return res;
+result feed_writter::write_csv(const std::string& file,
+                               const std::function<void(csv_writer&)>& write_header,
+                               const std::function<void(csv_writer&)>& write_entities) const
+{
+    // Every file is deflated by the thread that writes it.
+    csv_writer out = archive_ ? csv_writer(*archive_, file) : csv_writer(gtfs_directory_ + file);
+    if (!out.is_open())
+        return out.close();
 
-    // Read conditionally required files:
-    if (config.calendar)
-        if (auto res = write_calendar(); res != result_code::OK)
-            return res;
+    write_header(out);
+    write_entities(out);
+    return out.close();
+}
+csv_parser feed_writter::source_parser() const
+{
+    if (source_archive_)
+        return csv_parser(*source_archive_);
 
-    if (config.calendar_dates)
-        if (auto res = write_calendar_dates(); res != result_code::OK)
-            return res;
+    return csv_parser(source_directory_);
+}
 
-    // Read optional files:
-    if (config.shapes)
-        if (auto res = write_shapes(); res != result_code::OK)
-            return res;
+result feed_writter::copy_file(const std::string& file) const
+{
+    // The feed is written in place, the file is there already.
+    if (!archive_ && !source_archive_ && same_file(source_directory_ + file, gtfs_directory_ + file))
+        return result_code::OK;
 
-    if (config.transfers)
-        if (auto res = write_transfers(); res != result_code::OK)
-            return res;
+    csv_parser parser = source_parser();
+    if (auto res = parser.open(file); res != result_code::OK)
+        return res == result_code::ERROR_FILE_ABSENT ? result(result_code::OK) : res;
 
-    if (config.frequencies)
-        if (auto res = write_frequencies(); res != result_code::OK)
-            return res;
+    csv_writer out = archive_ ? csv_writer(*archive_, file) : csv_writer(gtfs_directory_ + file);
+    if (!out.is_open())
+        return out.close();
 
-    if (config.fare_attributes)
-        if (auto res = write_fare_attributes(); res != result_code::OK)
-            return res;
+    out.raw(parser.contents());
+    return out.close();
+}
 
-    if (config.fare_rules)
-        if (auto res = write_fare_rules(); res != result_code::OK)
-            return res;
+result feed_writter::pass_trips() const
+{
+    csv_parser parser = source_parser();
+    if (auto res = parser.read_header(file_trips); res != result_code::OK)
+        return res;
+
+    const auto& header = parser.header();
+    const size_t trip_id = column_index(header, "trip_id");
+    const std::vector<std::string> names{"shape_id"};
+    const auto columns = feed_columns(header, names);
+    if (trip_id == header.size())
+        return {result_code::ERROR_REQUIRED_FIELD_ABSENT, "trip_id while passing through " + file_trips};
+
+    auto container_writer = [&](csv_writer& out) {
+        std::vector<std::string_view> fields;
+        while (parser.read_raw_row(fields) == result_code::OK)
+        {
+            if (fields.size() <= trip_id)
+                continue;
 
-    if (config.feed_info)
-        if (auto res = write_feed_info(); res != result_code::OK)
-            return res;
+            // Trips that were erased from the feed are left out.
+            const trip* t = feed_.trips.get(field_value(fields[trip_id]));
+            if (t == nullptr)
+                continue;
 
-    return result_code::OK;
+            write_row(out, fields, header.size(), columns, [&out, t](size_t, std::string_view) {
+                out.field(t->shape_id);
+            });
+        }
+    };
+    return write_csv(file_trips,
+                     [&](csv_writer& out) { write_header(out, header, columns, names); },
+                     container_writer);
 }
 
-result feed_writter::write_csv(const std::string& path, const std::string& file,
-                               const std::function<void(std::ofstream&)>& write_header,
-                               const std::function<void(std::ofstream&)>& write_entities)
+result feed_writter::pass_stop_times() const
 {
-    const std::string filepath = add_trailing_slash(path) + file;
-    std::ofstream out(filepath);
+    csv_parser parser = source_parser();
+    if (auto res = parser.read_header(file_stop_times); res != result_code::OK)
+        return res;
+
+    const auto& header = parser.header();
+    // The times are filled in or interpolated by the shape builder as well.
+    const std::vector<std::string> names{"shape_dist_traveled", "arrival_time", "departure_time"};
+    const auto columns = feed_columns(header, names);
+
+    // The stop times of the feed are in the order of the file, one for every row that is not blank.
+    size_t count = 0;
+    auto container_writer = [&](csv_writer& out) {
+        std::vector<std::string_view> fields;
+        while (parser.read_raw_row(fields) == result_code::OK)
+        {
+            if (fields.empty())
+                continue;
 
-    if (!out.is_open())
-        return {result_code::ERROR_INVALID_GTFS_PATH, "Could not open path for writing " + filepath};
+            if (count == feed_.stop_times.size())
+            {
+                ++count;
+                break;
+            }
 
-    write_header(out);
-    write_entities(out);
-    return result_code::OK;
+            const stop_time st = feed_.stop_times[count++];
+            write_row(out, fields, header.size(), columns, [&out, &st](size_t k, std::string_view value) {
+                if (k == 1)
+                    write_time(out, value, st.arrival_time());
+                else if (k == 2)
+                    write_time(out, value, st.departure_time());
+                // Rows without a distance get none, unless the feed has one for them.
+                else if (value.empty() && st.shape_dist_traveled() == 0.0)
+                    out.empty_field();
+                else
+                    out.field(st.shape_dist_traveled());
+            });
+        }
+    };
+
+    auto res = write_csv(
+            file_stop_times,
+            [&](csv_writer& out) { write_header(out, header, columns, names); },
+            container_writer);
+    if (res == result_code::OK && count != feed_.stop_times.size())
+        return {result_code::ERROR_INVALID_GTFS_PATH, file_stop_times + " to pass through does not match the feed"};
+
+    return res;
 }
+
 result feed_writter::write_agencies() const
 {
-    auto container_writer = [this](std::ofstream& out) {
+    auto container_writer = [this](csv_writer& out) {
         for (const auto& agency_pair : feed_.agencies)
         {
             const auto& agency = agency_pair.second;
-            std::vector<std::string> fields{wrap(agency.agency_id), wrap(agency.agency_name),
-                                            wrap(agency.agency_url), agency.agency_timezone,
-                                            agency.agency_lang, wrap(agency.agency_phone),
-                                            agency.agency_fare_url, agency.agency_email};
-            write_joined(out, std::move(fields));
+            out.field(agency.agency_id).field(agency.agency_name).field(agency.agency_url)
+                    .field(agency.agency_timezone).field(agency.agency_lang).field(agency.agency_phone)
+                    .field(agency.agency_fare_url).field(agency.agency_email);
+            out.end_row();
         }
     };
-    return write_csv(gtfs_directory_, file_agency, write_agency_header, container_writer);
+    return write_csv(file_agency, write_agency_header, container_writer);
 }
 result feed_writter::write_routes() const
 {
-    auto container_writer = [this](std::ofstream& out) {
+    auto container_writer = [this](csv_writer& out) {
         for (const auto& route_pair : feed_.routes)
         {
             const auto& route = route_pair.second;
-            std::vector<std::string> fields{wrap(route.route_id),
-                                            wrap(route.agency_id),
-                                            wrap(route.route_short_name),
-                                            wrap(route.route_long_name),
-                                            wrap(route.route_desc),
-                                            wrap(route.route_type),
-                                            route.route_url,
-                                            route.route_color,
-                                            route.route_text_color,
-                                            wrap(route.route_sort_order),
-                                            "" /* continuous_pickup */,
-                                            "" /* continuous_drop_off */};
+            out.field(route.route_id)
+                    .field(route.agency_id)
+                    .field(route.route_short_name)
+                    .field(route.route_long_name)
+                    .field(route.route_desc)
+                    .field(route.route_type)
+                    .field(route.route_url)
+                    .field(route.route_color)
+                    .field(route.route_text_color)
+                    .field(route.route_sort_order)
+                    .empty_field() /* continuous_pickup */
+                    .empty_field() /* continuous_drop_off */;
             // TODO: handle new route fields.
-            write_joined(out, std::move(fields));
+            out.end_row();
         }
     };
-    return write_csv(gtfs_directory_, file_routes, write_routes_header, container_writer);
+    return write_csv(file_routes, write_routes_header, container_writer);
 }
 result feed_writter::write_shapes() const
 {
-    auto container_writer = [this](std::ofstream& out) {
+    bool spilled_read = true;
+    auto container_writer = [this, &spilled_read](csv_writer& out) {
         for (const auto& shape_pair : feed_.shapes)
         {
             const auto& shape = shape_pair.second;
             for (const auto& point : shape.points)
             {
-
-                std::vector<std::string> fields{wrap(point.shape_id), wrap(point.shape_pt_lat),
-                                                wrap(point.shape_pt_lon), wrap(point.shape_pt_sequence),
-                                                wrap(point.shape_dist_traveled)};
-                write_joined(out, std::move(fields));
+                out.field(shape.shape_id).field(point.shape_pt_lat).field(point.shape_pt_lon)
+                        .field(point.shape_pt_sequence).field(point.shape_dist_traveled);
+                out.end_row();
             }
         }
+
+        spilled_read = feed_.spilled_shapes.for_each([&out](const Id& id, const std::vector<shape_store::point>& points) {
+            for (size_t i = 0; i < points.size(); ++i)
+            {
+                out.field(id).field(points[i].latitude()).field(points[i].longitude())
+                        .field(i).field(static_cast<double>(points[i].dist));
+                out.end_row();
+            }
+        });
     };
-    return write_csv(gtfs_directory_, file_shapes, write_shapes_header, container_writer);
+
+    auto res = write_csv(file_shapes, write_shapes_header, container_writer);
+    if (res == result_code::OK && !spilled_read)
+        return {result_code::ERROR_INVALID_GTFS_PATH, "Could not read the shapes back from their temporary file"};
+
+    return res;
 }
 result feed_writter::write_trips() const
 {
-    auto container_writer = [this](std::ofstream& out) {
+    auto container_writer = [this](csv_writer& out) {
         for (const auto& trip_pair : feed_.trips)
         {
             const auto& trip = trip_pair.second;
-            std::vector<std::string> fields{
-                    wrap(trip.route_id), wrap(trip.service_id), wrap(trip.trip_id),
-                    wrap(trip.trip_headsign), wrap(trip.trip_short_name), wrap(trip.direction_id),
-                    wrap(trip.block_id), wrap(trip.shape_id), wrap(trip.wheelchair_accessible),
-                    wrap(trip.bikes_allowed)};
-            write_joined(out, std::move(fields));
+            out.field(trip.route_id).field(trip.service_id).field(trip.trip_id)
+                    .field(trip.trip_headsign).field(trip.trip_short_name).field(trip.direction_id)
+                    .field(trip.block_id).field(trip.shape_id).field(trip.wheelchair_accessible)
+                    .field(trip.bikes_allowed);
+            out.end_row();
         }
     };
-    return write_csv(gtfs_directory_, file_trips, write_trips_header, container_writer);
+    return write_csv(file_trips, write_trips_header, container_writer);
 }
 result feed_writter::write_stops() const
 {
-    auto container_writer = [this](std::ofstream& out) {
+    auto container_writer = [this](csv_writer& out) {
         for (const auto& stop_pair : feed_.stops)
         {
             const auto& stop = stop_pair.second;
-            std::vector<std::string> fields{
-                    wrap(stop.stop_id), wrap(stop.stop_code), wrap(stop.stop_name),
-                    wrap(stop.stop_desc), wrap(stop.stop_lat), wrap(stop.stop_lon),
-                    wrap(stop.zone_id), stop.stop_url, wrap(stop.location_type),
-                    wrap(stop.parent_station), stop.stop_timezone, wrap(stop.wheelchair_boarding),
-                    wrap(stop.level_id), wrap(stop.platform_code)};
-            write_joined(out, std::move(fields));
+            out.field(stop.stop_id).field(stop.stop_code).field(stop.stop_name)
+                    .field(stop.stop_desc).field(stop.stop_lat).field(stop.stop_lon)
+                    .field(stop.zone_id).field(stop.stop_url).field(stop.location_type)
+                    .field(stop.parent_station).field(stop.stop_timezone).field(stop.wheelchair_boarding)
+                    .field(stop.level_id).field(stop.platform_code);
+            out.end_row();
         }
     };
-    return write_csv(gtfs_directory_, file_stops, write_stops_header, container_writer);
+    return write_csv(file_stops, write_stops_header, container_writer);
 }
 result feed_writter::write_stop_times() const
 {
-    auto container_writer = [this](std::ofstream& out) {
-        for (const auto& stop_time : feed_.stop_times)
+    auto container_writer = [this](csv_writer& out) {
+        for (const auto stop_time : feed_.stop_times)
         {
-            std::vector<std::string> fields{wrap(stop_time.trip_id),
-                                            stop_time.arrival_time.get_raw_time(),
-                                            stop_time.departure_time.get_raw_time(),
-                                            wrap(stop_time.stop_id),
-                                            wrap(stop_time.stop_sequence),
-                                            wrap(stop_time.stop_headsign),
-                                            wrap(stop_time.pickup_type),
-                                            wrap(stop_time.drop_off_type),
-                                            "" /* continuous_pickup */,
-                                            "" /* continuous_drop_off */,
-                                            wrap(stop_time.shape_dist_traveled),
-                                            wrap(stop_time.timepoint)};
+            out.field(stop_time.trip_id())
+                    .field(stop_time.arrival_time().get_raw_time())
+                    .field(stop_time.departure_time().get_raw_time())
+                    .field(stop_time.stop_id())
+                    .field(stop_time.stop_sequence())
+                    .field(stop_time.stop_headsign())
+                    .field(stop_time.pickup_type())
+                    .field(stop_time.drop_off_type())
+                    .empty_field() /* continuous_pickup */
+                    .empty_field() /* continuous_drop_off */
+                    .field(stop_time.shape_dist_traveled())
+                    .field(stop_time.timepoint());
             // TODO: handle new stop_times fields.
-            write_joined(out, std::move(fields));
+            out.end_row();
         }
     };
-    return write_csv(gtfs_directory_, file_stop_times, write_stop_times_header, container_writer);
-}
-result feed_writter::write_calendar() const {}
-result feed_writter::write_calendar_dates() const {}
-result feed_writter::write_transfers() const {}
-result feed_writter::write_frequencies() const {}
-result feed_writter::write_fare_attributes() const {}
-result feed_writter::write_fare_rules() const {}
-result feed_writter::write_feed_info() const {}
+    return write_csv(file_stop_times, write_stop_times_header, container_writer);
+}
+// Not written yet.
+result feed_writter::write_calendar() const { return result_code::OK; }
+result feed_writter::write_calendar_dates() const { return result_code::OK; }
+result feed_writter::write_transfers() const { return result_code::OK; }
+result feed_writter::write_frequencies() const { return result_code::OK; }
+result feed_writter::write_fare_attributes() const { return result_code::OK; }
+result feed_writter::write_fare_rules() const { return result_code::OK; }
+result feed_writter::write_feed_info() const { return result_code::OK; }
 }
 
 }
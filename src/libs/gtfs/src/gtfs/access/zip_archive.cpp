@@ -0,0 +1,580 @@
+#include "zip_archive.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <limits>
+
+#ifdef ZLIB_FOUND
+#include <zlib.h>
+#else
+struct z_stream_s
+{
+};
+#endif
+
+namespace pfaedle::gtfs::access
+{
+namespace
+{
+constexpr uint32_t local_header_signature = 0x04034b50;
+constexpr uint32_t central_header_signature = 0x02014b50;
+constexpr uint32_t end_of_central_directory_signature = 0x06054b50;
+constexpr uint32_t zip64_end_of_central_directory_signature = 0x06064b50;
+constexpr uint32_t zip64_locator_signature = 0x07064b50;
+constexpr uint16_t zip64_extra_id = 0x0001;
+
+constexpr size_t local_header_size = 30;
+constexpr size_t central_header_size = 46;
+constexpr size_t end_of_central_directory_size = 22;
+constexpr size_t zip64_end_of_central_directory_size = 56;
+constexpr size_t zip64_locator_size = 20;
+
+constexpr uint16_t method_stored = 0;
+constexpr uint16_t method_deflated = 8;
+constexpr uint16_t version_deflate = 20;
+constexpr uint16_t version_zip64 = 45;
+
+constexpr uint32_t max_u32 = std::numeric_limits<uint32_t>::max();
+constexpr uint16_t max_u16 = std::numeric_limits<uint16_t>::max();
+
+constexpr size_t io_block_size = 1 << 20;
+
+uint16_t get_u16(const unsigned char * p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+
+uint32_t get_u32(const unsigned char * p)
+{
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+uint64_t get_u64(const unsigned char * p)
+{
+    return static_cast<uint64_t>(get_u32(p)) | static_cast<uint64_t>(get_u32(p + 4)) << 32;
+}
+
+void put_u16(std::vector<char> & out, uint16_t v)
+{
+    out.push_back(static_cast<char>(v & 0xFF));
+    out.push_back(static_cast<char>(v >> 8));
+}
+
+void put_u32(std::vector<char> & out, uint32_t v)
+{
+    put_u16(out, static_cast<uint16_t>(v & 0xFFFF));
+    put_u16(out, static_cast<uint16_t>(v >> 16));
+}
+
+void put_u64(std::vector<char> & out, uint64_t v)
+{
+    put_u32(out, static_cast<uint32_t>(v & max_u32));
+    put_u32(out, static_cast<uint32_t>(v >> 32));
+}
+
+bool read_at(int fd, void * buffer, size_t size, uint64_t offset)
+{
+    auto * out = static_cast<char *>(buffer);
+    while (size > 0)
+    {
+        const ssize_t res = pread(fd, out, size, static_cast<off_t>(offset));
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return false;
+
+        out += res;
+        size -= res;
+        offset += res;
+    }
+    return true;
+}
+
+bool write_all(int fd, const char * data, size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t res = ::write(fd, data, size);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return false;
+
+        data += res;
+        size -= res;
+    }
+    return true;
+}
+}
+
+zip_reader::~zip_reader()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+result zip_reader::open(const std::string & archive_path)
+{
+    path = archive_path;
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return {result_code::ERROR_INVALID_GTFS_PATH, "Archive " + path + " could not be opened"};
+
+    return read_central_directory();
+}
+
+result zip_reader::read_central_directory()
+{
+    const result invalid{result_code::ERROR_INVALID_GTFS_PATH, path + " is not a zip archive"};
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < end_of_central_directory_size)
+        return invalid;
+
+    // The end of central directory record is followed by a comment of at most 64 KiB.
+    const uint64_t file_size = st.st_size;
+    const uint64_t tail_size = std::min<uint64_t>(file_size, end_of_central_directory_size + max_u16);
+    std::vector<unsigned char> tail(tail_size);
+    if (!read_at(fd, tail.data(), tail.size(), file_size - tail_size))
+        return invalid;
+
+    size_t eocd = tail.size() - end_of_central_directory_size + 1;
+    do
+    {
+        --eocd;
+        if (get_u32(&tail[eocd]) == end_of_central_directory_signature)
+            break;
+    } while (eocd > 0);
+
+    if (get_u32(&tail[eocd]) != end_of_central_directory_signature)
+        return invalid;
+
+    uint64_t count = get_u16(&tail[eocd + 10]);
+    uint64_t directory_size = get_u32(&tail[eocd + 12]);
+    uint64_t directory_offset = get_u32(&tail[eocd + 16]);
+
+    const uint64_t eocd_offset = file_size - tail_size + eocd;
+    if (eocd_offset >= zip64_locator_size)
+    {
+        unsigned char locator[zip64_locator_size];
+        if (read_at(fd, locator, sizeof(locator), eocd_offset - zip64_locator_size) &&
+            get_u32(locator) == zip64_locator_signature)
+        {
+            unsigned char record[zip64_end_of_central_directory_size];
+            if (!read_at(fd, record, sizeof(record), get_u64(locator + 8)) ||
+                get_u32(record) != zip64_end_of_central_directory_signature)
+                return invalid;
+
+            count = get_u64(record + 32);
+            directory_size = get_u64(record + 40);
+            directory_offset = get_u64(record + 48);
+        }
+    }
+
+    if (directory_offset + directory_size > file_size)
+        return invalid;
+
+    std::vector<unsigned char> directory(directory_size);
+    if (!read_at(fd, directory.data(), directory.size(), directory_offset))
+        return invalid;
+
+    size_t pos = 0;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        if (pos + central_header_size > directory.size() ||
+            get_u32(&directory[pos]) != central_header_signature)
+            return invalid;
+
+        const unsigned char * header = &directory[pos];
+        member m;
+        m.method = get_u16(header + 10);
+        m.crc = get_u32(header + 16);
+        m.compressed_size = get_u32(header + 20);
+        m.size = get_u32(header + 24);
+        m.local_header_offset = get_u32(header + 42);
+
+        const size_t name_length = get_u16(header + 28);
+        const size_t extra_length = get_u16(header + 30);
+        const size_t comment_length = get_u16(header + 32);
+        if (pos + central_header_size + name_length + extra_length + comment_length > directory.size())
+            return invalid;
+
+        const std::string name(reinterpret_cast<const char *>(header + central_header_size), name_length);
+
+        // Values that do not fit into 32 bits are in the zip64 extra field, in this order.
+        const unsigned char * extra = header + central_header_size + name_length;
+        const unsigned char * extra_end = extra + extra_length;
+        while (extra + 4 <= extra_end)
+        {
+            const uint16_t id = get_u16(extra);
+            const uint16_t length = get_u16(extra + 2);
+            const unsigned char * value = extra + 4;
+            const unsigned char * value_end = std::min(value + length, extra_end);
+            if (id == zip64_extra_id)
+            {
+                for (uint64_t * field : {&m.size, &m.compressed_size, &m.local_header_offset})
+                {
+                    if (*field != max_u32 || value + 8 > value_end)
+                        continue;
+
+                    *field = get_u64(value);
+                    value += 8;
+                }
+            }
+            extra = value_end;
+        }
+
+        if (name.empty() || name.back() != '/')
+            members.emplace(name, m);
+
+        pos += central_header_size + name_length + extra_length + comment_length;
+    }
+
+    return result_code::OK;
+}
+
+const zip_reader::member * zip_reader::find(const std::string & name) const
+{
+    const auto it = members.find(name);
+    if (it != members.end())
+        return &it->second;
+
+    for (const auto & m : members)
+    {
+        const auto slash = m.first.rfind('/');
+        if (slash != std::string::npos && m.first.compare(slash + 1, std::string::npos, name) == 0)
+            return &m.second;
+    }
+
+    return nullptr;
+}
+
+std::vector<std::string> zip_reader::names() const
+{
+    std::vector<std::string> ret;
+    ret.reserve(members.size());
+    for (const auto & m : members)
+        ret.push_back(m.first);
+
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+result zip_reader::extract(const std::string & name, char *& data, size_t & size) const
+{
+    data = nullptr;
+    size = 0;
+
+    const member * m = find(name);
+    if (m == nullptr)
+        return {result_code::ERROR_FILE_ABSENT, "File " + name + " is not in " + path};
+
+    const result corrupt{result_code::ERROR_INVALID_FIELD_FORMAT, "File " + name + " in " + path + " is corrupt"};
+
+    unsigned char local_header[local_header_size];
+    if (!read_at(fd, local_header, sizeof(local_header), m->local_header_offset) ||
+        get_u32(local_header) != local_header_signature)
+        return corrupt;
+
+    uint64_t offset = m->local_header_offset + local_header_size + get_u16(local_header + 26) +
+                      get_u16(local_header + 28);
+
+    if (m->size == 0)
+        return result_code::OK;
+
+    void * mapped = mmap(nullptr, m->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED)
+        return {result_code::ERROR_FILE_ABSENT, "File " + name + " could not be extracted"};
+
+    auto * out = static_cast<char *>(mapped);
+    bool ok = false;
+
+    if (m->method == method_stored)
+    {
+        ok = m->compressed_size == m->size && read_at(fd, out, m->size, offset);
+#ifdef ZLIB_FOUND
+        ok = ok && crc32_z(0, reinterpret_cast<const Bytef *>(out), m->size) == m->crc;
+#endif
+    }
+    else if (m->method == method_deflated)
+    {
+#ifdef ZLIB_FOUND
+        z_stream stream{};
+        if (inflateInit2(&stream, -MAX_WBITS) == Z_OK)
+        {
+            std::vector<unsigned char> input(io_block_size);
+            uint64_t remaining = m->compressed_size;
+            uLong crc = 0;
+            int res = Z_OK;
+
+            // The output is the mapping itself, the input is read block by block.
+            stream.next_out = reinterpret_cast<Bytef *>(out);
+            while (res == Z_OK)
+            {
+                if (stream.avail_in == 0 && remaining > 0)
+                {
+                    const size_t n = std::min<uint64_t>(remaining, input.size());
+                    if (!read_at(fd, input.data(), n, offset))
+                        break;
+
+                    offset += n;
+                    remaining -= n;
+                    stream.next_in = input.data();
+                    stream.avail_in = static_cast<uInt>(n);
+                }
+
+                const size_t produced = reinterpret_cast<char *>(stream.next_out) - out;
+                stream.avail_out = static_cast<uInt>(std::min<uint64_t>(m->size - produced, max_u32));
+                Bytef * before = stream.next_out;
+                res = inflate(&stream, Z_NO_FLUSH);
+                crc = crc32_z(crc, before, stream.next_out - before);
+            }
+
+            ok = res == Z_STREAM_END && stream.total_out == m->size && crc == m->crc;
+            inflateEnd(&stream);
+        }
+#endif
+    }
+
+    if (!ok)
+    {
+        munmap(mapped, m->size);
+#ifndef ZLIB_FOUND
+        if (m->method == method_deflated)
+            return {result_code::ERROR_INVALID_GTFS_PATH, "Built without zlib, cannot inflate " + name};
+#endif
+        return corrupt;
+    }
+
+    data = out;
+    size = m->size;
+    return result_code::OK;
+}
+
+
+zip_writer::member::member(std::string member_name) :
+    name(std::move(member_name)),
+    stream(std::make_unique<z_stream_s>())
+{
+#ifdef ZLIB_FOUND
+    failed = deflateInit2(stream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                          Z_DEFAULT_STRATEGY) != Z_OK;
+#else
+    // Built without zlib, nothing can be deflated.
+    failed = true;
+#endif
+}
+
+zip_writer::member::~member()
+{
+#ifdef ZLIB_FOUND
+    deflateEnd(stream.get());
+#endif
+}
+
+void zip_writer::member::write(const char * data, size_t length)
+{
+    if (failed || length == 0)
+        return;
+
+#ifdef ZLIB_FOUND
+    crc = static_cast<uint32_t>(crc32_z(crc, reinterpret_cast<const Bytef *>(data), length));
+#endif
+    size += length;
+    failed = !deflate_buffer(data, length, false);
+}
+
+bool zip_writer::member::deflate_buffer(const char * data, size_t length, bool finish)
+{
+#ifdef ZLIB_FOUND
+    stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream->avail_in = static_cast<uInt>(length);
+
+    const int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+    int res = Z_OK;
+    do
+    {
+        const size_t used = compressed.size();
+        compressed.resize(used + io_block_size);
+        stream->next_out = reinterpret_cast<Bytef *>(compressed.data() + used);
+        stream->avail_out = io_block_size;
+        res = deflate(stream.get(), flush);
+        compressed.resize(compressed.size() - stream->avail_out);
+    } while (res == Z_OK && (stream->avail_in > 0 || stream->avail_out == 0));
+
+    return flush == Z_FINISH ? res == Z_STREAM_END : res == Z_OK || res == Z_BUF_ERROR;
+#else
+    return false;
+#endif
+}
+
+
+zip_writer::zip_writer(const std::string & archive_path) :
+    path(archive_path),
+    partial_path(archive_path + ".part")
+{
+    fd = ::open(partial_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    const std::time_t now = std::time(nullptr);
+    std::tm local{};
+    localtime_r(&now, &local);
+    dos_time = static_cast<uint16_t>(local.tm_hour << 11 | local.tm_min << 5 | local.tm_sec / 2);
+    dos_date = static_cast<uint16_t>(std::max(local.tm_year - 80, 0) << 9 | (local.tm_mon + 1) << 5 |
+                                     local.tm_mday);
+}
+
+zip_writer::~zip_writer()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        unlink(partial_path.c_str());
+    }
+}
+
+bool zip_writer::is_open() const { return fd >= 0; }
+
+bool zip_writer::write(const std::vector<char> & data)
+{
+    if (!failed && !write_all(fd, data.data(), data.size()))
+        failed = true;
+
+    offset += data.size();
+    return !failed;
+}
+
+result zip_writer::add(member & m)
+{
+    const result error{result_code::ERROR_INVALID_GTFS_PATH, "Could not write " + m.name + " to " + path};
+    if (m.failed || !m.deflate_buffer(nullptr, 0, true))
+        return error;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fd < 0 || failed)
+        return error;
+
+    entry e{m.name, m.crc, m.compressed.size(), m.size, offset};
+    const bool zip64 = e.size >= max_u32 || e.compressed_size >= max_u32;
+
+    std::vector<char> header;
+    put_u32(header, local_header_signature);
+    put_u16(header, zip64 ? version_zip64 : version_deflate);
+    put_u16(header, 0);  // flags
+    put_u16(header, method_deflated);
+    put_u16(header, dos_time);
+    put_u16(header, dos_date);
+    put_u32(header, e.crc);
+    put_u32(header, zip64 ? max_u32 : static_cast<uint32_t>(e.compressed_size));
+    put_u32(header, zip64 ? max_u32 : static_cast<uint32_t>(e.size));
+    put_u16(header, static_cast<uint16_t>(e.name.size()));
+    put_u16(header, zip64 ? 20 : 0);
+    header.insert(header.end(), e.name.begin(), e.name.end());
+    if (zip64)
+    {
+        put_u16(header, zip64_extra_id);
+        put_u16(header, 16);
+        put_u64(header, e.size);
+        put_u64(header, e.compressed_size);
+    }
+
+    if (!write(header) || !write(m.compressed))
+        return error;
+
+    std::vector<char>().swap(m.compressed);
+    entries.push_back(std::move(e));
+    return result_code::OK;
+}
+
+result zip_writer::close()
+{
+    const result error{result_code::ERROR_INVALID_GTFS_PATH, "Could not write " + path};
+    if (fd < 0)
+        return {result_code::ERROR_INVALID_GTFS_PATH, "Could not open path for writing " + path};
+
+    const uint64_t directory_offset = offset;
+    std::vector<char> directory;
+    for (const auto & e : entries)
+    {
+        std::vector<char> extra;
+        if (e.size >= max_u32)
+            put_u64(extra, e.size);
+        if (e.compressed_size >= max_u32)
+            put_u64(extra, e.compressed_size);
+        if (e.local_header_offset >= max_u32)
+            put_u64(extra, e.local_header_offset);
+
+        put_u32(directory, central_header_signature);
+        put_u16(directory, extra.empty() ? version_deflate : version_zip64);  // version made by
+        put_u16(directory, extra.empty() ? version_deflate : version_zip64);  // version needed
+        put_u16(directory, 0);  // flags
+        put_u16(directory, method_deflated);
+        put_u16(directory, dos_time);
+        put_u16(directory, dos_date);
+        put_u32(directory, e.crc);
+        put_u32(directory, static_cast<uint32_t>(std::min<uint64_t>(e.compressed_size, max_u32)));
+        put_u32(directory, static_cast<uint32_t>(std::min<uint64_t>(e.size, max_u32)));
+        put_u16(directory, static_cast<uint16_t>(e.name.size()));
+        put_u16(directory, static_cast<uint16_t>(extra.empty() ? 0 : extra.size() + 4));
+        put_u16(directory, 0);  // comment length
+        put_u16(directory, 0);  // disk number
+        put_u16(directory, 0);  // internal attributes
+        put_u32(directory, 0);  // external attributes
+        put_u32(directory, static_cast<uint32_t>(std::min<uint64_t>(e.local_header_offset, max_u32)));
+        directory.insert(directory.end(), e.name.begin(), e.name.end());
+        if (!extra.empty())
+        {
+            put_u16(directory, zip64_extra_id);
+            put_u16(directory, static_cast<uint16_t>(extra.size()));
+            directory.insert(directory.end(), extra.begin(), extra.end());
+        }
+    }
+
+    const uint64_t directory_size = directory.size();
+    const bool zip64 = entries.size() >= max_u16 || directory_offset >= max_u32 || directory_size >= max_u32;
+    if (zip64)
+    {
+        const uint64_t record_offset = directory_offset + directory_size;
+        put_u32(directory, zip64_end_of_central_directory_signature);
+        put_u64(directory, zip64_end_of_central_directory_size - 12);
+        put_u16(directory, version_zip64);
+        put_u16(directory, version_zip64);
+        put_u32(directory, 0);  // disk number
+        put_u32(directory, 0);  // disk with the central directory
+        put_u64(directory, entries.size());
+        put_u64(directory, entries.size());
+        put_u64(directory, directory_size);
+        put_u64(directory, directory_offset);
+
+        put_u32(directory, zip64_locator_signature);
+        put_u32(directory, 0);
+        put_u64(directory, record_offset);
+        put_u32(directory, 1);
+    }
+
+    put_u32(directory, end_of_central_directory_signature);
+    put_u16(directory, 0);
+    put_u16(directory, 0);
+    put_u16(directory, static_cast<uint16_t>(std::min<uint64_t>(entries.size(), max_u16)));
+    put_u16(directory, static_cast<uint16_t>(std::min<uint64_t>(entries.size(), max_u16)));
+    put_u32(directory, static_cast<uint32_t>(std::min<uint64_t>(directory_size, max_u32)));
+    put_u32(directory, static_cast<uint32_t>(std::min<uint64_t>(directory_offset, max_u32)));
+    put_u16(directory, 0);  // comment length
+
+    const bool written = write(directory);
+    const bool closed = ::close(fd) == 0;
+    fd = -1;
+
+    if (!written || !closed || std::rename(partial_path.c_str(), path.c_str()) != 0)
+    {
+        unlink(partial_path.c_str());
+        return error;
+    }
+
+    return result_code::OK;
+}
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <gtfs/access/result.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct z_stream_s;
+
+namespace pfaedle::gtfs::access
+{
+// Members of a zip file. Members are read with pread(), several threads can extract members of
+// the same archive at once. Stored and deflated members are supported, as well as zip64.
+class zip_reader
+{
+public:
+    zip_reader() = default;
+    ~zip_reader();
+
+    zip_reader(const zip_reader &) = delete;
+    zip_reader & operator=(const zip_reader &) = delete;
+
+    result open(const std::string & path);
+
+    // Inflates the member into a private anonymous mapping of its size, which the caller unmaps.
+    // Members are found by name, or by their file name if they are in a directory of the archive.
+    result extract(const std::string & name, char *& data, size_t & size) const;
+
+    // Names of all members, sorted.
+    std::vector<std::string> names() const;
+
+private:
+    struct member
+    {
+        uint16_t method = 0;
+        uint32_t crc = 0;
+        uint64_t compressed_size = 0;
+        uint64_t size = 0;
+        uint64_t local_header_offset = 0;
+    };
+
+    result read_central_directory();
+    const member * find(const std::string & name) const;
+
+    std::string path;
+    int fd = -1;
+    std::unordered_map<std::string, member> members;
+};
+
+// Writes a zip file. Members are deflated into memory by the thread that writes them and
+// appended to the archive once they are finished. The archive is written next to the path and
+// replaces it once it is closed, an archive that is read from the same path stays readable.
+class zip_writer
+{
+public:
+    class member
+    {
+    public:
+        explicit member(std::string name);
+        ~member();
+
+        member(const member &) = delete;
+        member & operator=(const member &) = delete;
+
+        void write(const char * data, size_t size);
+
+    private:
+        friend class zip_writer;
+
+        bool deflate_buffer(const char * data, size_t size, bool finish);
+
+        std::string name;
+        std::unique_ptr<z_stream_s> stream;
+        std::vector<char> compressed;
+        uint32_t crc = 0;
+        uint64_t size = 0;
+        bool failed = false;
+    };
+
+    explicit zip_writer(const std::string & path);
+    ~zip_writer();
+
+    zip_writer(const zip_writer &) = delete;
+    zip_writer & operator=(const zip_writer &) = delete;
+
+    bool is_open() const;
+
+    // Finishes the member and appends it to the archive.
+    result add(member & m);
+
+    // Writes the central directory.
+    result close();
+
+private:
+    struct entry
+    {
+        std::string name;
+        uint32_t crc = 0;
+        uint64_t compressed_size = 0;
+        uint64_t size = 0;
+        uint64_t local_header_offset = 0;
+    };
+
+    bool write(const std::vector<char> & data);
+
+    std::string path;
+    std::string partial_path;
+    int fd = -1;
+    bool failed = false;
+    uint64_t offset = 0;
+    uint16_t dos_time = 0;
+    uint16_t dos_date = 0;
+
+    std::mutex mutex;
+    std::vector<entry> entries;
+};
+}
@@ -40,17 +40,17 @@ date::date(uint16_t year, uint16_t month, uint16_t day) : yyyy(year), mm(month),
     date_is_provided = true;
 }
 
-date::date(const std::string & raw_date_str) : raw_date(raw_date_str)
+date::date(std::string_view raw_date_str) : raw_date(raw_date_str)
 {
-    if (raw_date.empty())
+    if (raw_date_str.empty())
         return;
 
-    if (raw_date.size() != 8)
-        throw invalid_field_format("date is not in YYYY:MM::DD format: " + raw_date_str);
+    if (raw_date_str.size() != 8)
+        throw invalid_field_format("date is not in YYYY:MM::DD format: " + raw_date);
 
-    yyyy = static_cast<uint16_t>(std::stoi(raw_date.substr(0, 4)));
-    mm = static_cast<uint16_t>(std::stoi(raw_date.substr(4, 2)));
-    dd = static_cast<uint16_t>(std::stoi(raw_date.substr(6, 2)));
+    yyyy = static_cast<uint16_t>(parse_int(raw_date_str.substr(0, 4)));
+    mm = static_cast<uint16_t>(parse_int(raw_date_str.substr(4, 2)));
+    dd = static_cast<uint16_t>(parse_int(raw_date_str.substr(6, 2)));
 
     check_valid();
 
@@ -1,4 +1,8 @@
 #include <gtfs/feed.h>
+
+#include <algorithm>
+#include <cstdint>
+
 namespace pfaedle::gtfs
 {
 
@@ -6,34 +10,61 @@ stop_time_provider::stop_time_provider(feed& feed) :
     feed_(feed)
 {
 }
-const std::vector<std::reference_wrapper<stop_time>>& stop_time_provider::get_for_stop(const Id& id) const
+stop_time_range stop_time_provider::index::get(stop_time_store& store, std::optional<uint32_t> i) const
 {
-    return stop_based_map.at(id);
-}
-std::vector<std::reference_wrapper<stop_time>>& stop_time_provider::get_for_stop(const Id& id)
-{
-    return stop_based_map.at(id);
+    if (!i || *i + 1 >= offsets.size())
+        return {};
+
+    return {store, stop_times.data() + offsets[*i], stop_times.data() + offsets[*i + 1]};
 }
-const std::vector<std::reference_wrapper<stop_time>>& stop_time_provider::get_for_trip(const Id& id) const
+stop_time_range stop_time_provider::get_for_stop(const Id& id) const
 {
-    return trip_based_map.at(id);
+    return stop_based_index.get(feed_.stop_times, feed_.stop_times.find_stop(id));
 }
-std::vector<std::reference_wrapper<stop_time>>& stop_time_provider::get_for_trip(const Id& id)
+stop_time_range stop_time_provider::get_for_trip(const Id& id) const
 {
-    return trip_based_map.at(id);
+    return trip_based_index.get(feed_.stop_times, feed_.stop_times.find_trip(id));
 }
 void stop_time_provider::prepare()
 {
-    for (auto& st : feed_.stop_times)
+    const auto& store = feed_.stop_times;
+
+    // Counting sort of the stop times by stop and by trip, keeps the file order within each.
+    auto build = [&store](index& idx, size_t count, uint32_t (stop_time_store::*key)(size_t) const) {
+        idx.offsets.assign(count + 1, 0);
+        for (size_t i = 0; i < store.size(); ++i)
+            ++idx.offsets[(store.*key)(i) + 1];
+        for (size_t i = 1; i < idx.offsets.size(); ++i)
+            idx.offsets[i] += idx.offsets[i - 1];
+
+        std::vector<uint32_t> next(idx.offsets.begin(), idx.offsets.end() - 1);
+        idx.stop_times.resize(store.size());
+        for (size_t i = 0; i < store.size(); ++i)
+            idx.stop_times[next[(store.*key)(i)]++] = static_cast<uint32_t>(i);
+    };
+
+    build(stop_based_index, store.num_stops(), &stop_time_store::stop_of);
+    build(trip_based_index, store.num_trips(), &stop_time_store::trip_of);
+
+    // Stop times of a trip are usually in order already.
+    const auto by_sequence = [&store](uint32_t a, uint32_t b) {
+        return store[a].stop_sequence() < store[b].stop_sequence();
+    };
+    const auto num_trips = static_cast<int64_t>(store.num_trips());
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int64_t t = 0; t < num_trips; ++t)
     {
-        trip_based_map[st.trip_id].push_back(std::ref(st));
-        stop_based_map[st.stop_id].push_back(std::ref(st));
+        const auto begin = trip_based_index.stop_times.begin() + trip_based_index.offsets[t];
+        const auto end = trip_based_index.stop_times.begin() + trip_based_index.offsets[t + 1];
+        if (!std::is_sorted(begin, end, by_sequence))
+            std::stable_sort(begin, end, by_sequence);
     }
 }
 
 
 
 feed::feed() :
+    stop_times(*this),
     stop_time_provider_(*this),
     routes_provider_(*this),
     trips_provider_(*this)
@@ -48,6 +79,32 @@ void feed::build()
     stop_time_provider_.prepare();
     routes_provider_.prepare();
     trips_provider_.prepare();
+
+    stop_times.link();
+
+    const auto num_trips = static_cast<int64_t>(trips.index_count());
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < num_trips; ++i)
+    {
+        trip* t = trips.get(static_cast<uint32_t>(i));
+        if (t == nullptr)
+            continue;
+
+        t->route_link = routes.get(t->route_id);
+        t->shape_index = shapes.index_of(t->shape_id).value_or(shape_map::npos);
+        t->stop_time_link = stop_time_provider_.get_for_trip(t->trip_id);
+    }
+}
+void feed::link_shapes()
+{
+    const auto num_trips = static_cast<int64_t>(trips.index_count());
+#pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < num_trips; ++i)
+    {
+        trip* t = trips.get(static_cast<uint32_t>(i));
+        if (t != nullptr)
+            t->shape_index = shapes.index_of(t->shape_id).value_or(shape_map::npos);
+    }
 }
 pfaedle::gtfs::routes_provider& feed::routes_provider() const
 {
@@ -65,18 +122,21 @@ routes_provider::routes_provider(feed& feed) :
 }
 void routes_provider::prepare()
 {
+    agency_based_routes.assign(feed_.agencies.index_count(), {});
     for (auto& r : feed_.routes)
     {
-        agency_based_map[r.second.agency_id].push_back(std::ref(r.second));
+        const auto agency = feed_.agencies.index_of(r.second.agency_id);
+        if (agency)
+            agency_based_routes[*agency].push_back(std::ref(r.second));
     }
 }
 std::vector<std::reference_wrapper<pfaedle::gtfs::route>>& routes_provider::get_for_agency(const Id& id)
 {
-    return agency_based_map.at(id);
+    return agency_based_routes.at(feed_.agencies.index_of(id).value_or(agency_map::npos));
 }
 const std::vector<std::reference_wrapper<pfaedle::gtfs::route>>& routes_provider::get_for_agency(const Id& id) const
 {
-    return agency_based_map.at(id);
+    return agency_based_routes.at(feed_.agencies.index_of(id).value_or(agency_map::npos));
 }
 
 trips_provider::trips_provider(feed& feed) :
@@ -85,17 +145,20 @@ trips_provider::trips_provider(feed& feed) :
 }
 void trips_provider::prepare()
 {
+    route_based_trips.assign(feed_.routes.index_count(), {});
     for (auto& t : feed_.trips)
     {
-        route_based_map[t.second.route_id].push_back(std::ref(t.second));
+        const auto route = feed_.routes.index_of(t.second.route_id);
+        if (route)
+            route_based_trips[*route].push_back(std::ref(t.second));
     }
 }
 std::vector<std::reference_wrapper<pfaedle::gtfs::trip>>& trips_provider::get_for_route(const Id& id)
 {
-    return route_based_map.at(id);
+    return route_based_trips.at(feed_.routes.index_of(id).value_or(route_map::npos));
 }
 const std::vector<std::reference_wrapper<pfaedle::gtfs::trip>>& trips_provider::get_for_route(const Id& id) const
 {
-    return route_based_map.at(id);
+    return route_based_trips.at(feed_.routes.index_of(id).value_or(route_map::npos));
 }
 }
@@ -1,8 +1,13 @@
 #include <gtfs/exceptions/invalid_field_format.h>
 #include <gtfs/misc.h>
 
+#include <sys/stat.h>
+
 #include <fstream>
 #include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
 #include <iomanip>
 #include <sstream>
 namespace pfaedle::gtfs
@@ -23,6 +28,19 @@ std::string add_trailing_slash(const std::string& path)
         extended_path += "/";
     return extended_path;
 }
+bool is_zip_path(const std::string& path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0)
+        return S_ISREG(st.st_mode);
+
+    constexpr std::string_view suffix = ".zip";
+    if (path.size() < suffix.size())
+        return false;
+
+    return std::equal(suffix.begin(), suffix.end(), path.end() - suffix.size(),
+                      [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); });
+}
 void write_joined(std::ofstream& out, std::vector<std::string>&& elements)
 {
     for (size_t i = 0; i < elements.size(); ++i)
@@ -113,6 +131,29 @@ std::string normalize(std::string& token, bool has_quotes)
         return unquote_text(res);
     return res;
 }
+template<class T>
+T parse_number(std::string_view text, const char* what)
+{
+    // std::from_chars does not accept a leading plus sign.
+    if (text.size() > 1 && text.front() == '+' && text[1] != '-')
+        text.remove_prefix(1);
+
+    T val{};
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), val);
+    if (ec == std::errc::invalid_argument)
+        throw std::invalid_argument(std::string(what) + ": " + std::string(text));
+    if (ec == std::errc::result_out_of_range)
+        throw std::out_of_range(std::string(what) + ": " + std::string(text));
+    return val;
+}
+int parse_int(std::string_view text)
+{
+    return parse_number<int>(text, "Invalid integer");
+}
+double parse_double(std::string_view text)
+{
+    return parse_number<double>(text, "Invalid number");
+}
 std::set<route_type> get_route_types_from_string(std::string name)
 {
     std::set<route_type> ret;
@@ -4,10 +4,11 @@ namespace pfaedle::gtfs
 {
 std::optional<std::reference_wrapper<agency>> route::agency() const
 {
-    if (agency_id.empty() || feed.agencies.count(agency_id))
+    auto* a = feed.agencies.get(agency_id);
+    if (a == nullptr)
         return std::nullopt;
 
-    return feed.agencies.at(agency_id);
+    return *a;
 }
 std::vector<std::reference_wrapper<trip>> route::trips() const
 {
@@ -0,0 +1,170 @@
+#include <gtfs/shape_store.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace pfaedle::gtfs
+{
+namespace
+{
+constexpr double fixed_point_scale = 1e7;
+
+int32_t to_fixed_point(double degrees)
+{
+    return static_cast<int32_t>(std::lround(degrees * fixed_point_scale));
+}
+}
+
+double shape_store::point::latitude() const
+{
+    return lat / fixed_point_scale;
+}
+
+double shape_store::point::longitude() const
+{
+    return lon / fixed_point_scale;
+}
+
+shape_store::shape_store(std::string directory) :
+    directory(std::move(directory))
+{
+}
+
+shape_store::~shape_store()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+bool shape_store::add(const shape& s)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lookup.count(s.shape_id))
+        return false;
+
+    entry& e = entries.emplace_back();
+    e.id = s.shape_id;
+    e.first_point = num_flushed + buffer.size();
+    e.num_points = static_cast<uint32_t>(s.points.size());
+    lookup.emplace(e.id, entries.size() - 1);
+
+    for (const auto& p : s.points)
+    {
+        if (buffer.size() == buffer_points)
+            flush();
+
+        buffer.push_back({to_fixed_point(p.shape_pt_lat), to_fixed_point(p.shape_pt_lon),
+                          static_cast<float>(p.shape_dist_traveled)});
+    }
+
+    return true;
+}
+
+void shape_store::flush()
+{
+    if (fd < 0)
+    {
+        if (directory.empty())
+        {
+            const char* tmpdir = getenv("TMPDIR");
+            directory = tmpdir != nullptr && *tmpdir != '\0' ? tmpdir : "/tmp";
+        }
+
+        std::string path = directory + "/.pfaedle-shapes-XXXXXX";
+        fd = mkstemp(&path[0]);
+        if (fd < 0)
+            throw std::runtime_error("Could not create a temporary file for shapes in " + directory);
+
+        // Removed once it is closed.
+        unlink(path.c_str());
+    }
+
+    const char* data = reinterpret_cast<const char*>(buffer.data());
+    size_t size = buffer.size() * sizeof(point);
+    while (size > 0)
+    {
+        const ssize_t res = write(fd, data, size);
+        if (res < 0 && errno == EINTR)
+            continue;
+
+        if (res <= 0)
+            throw std::runtime_error("Could not write shapes to a temporary file");
+
+        data += res;
+        size -= res;
+    }
+
+    num_flushed += buffer.size();
+    buffer.clear();
+}
+
+bool shape_store::read(const entry& e, std::vector<point>& points) const
+{
+    points.resize(e.num_points);
+
+    // The first points can be in the file, the rest in the buffer.
+    size_t in_file = 0;
+    if (e.first_point < num_flushed)
+        in_file = static_cast<size_t>(std::min<uint64_t>(e.num_points, num_flushed - e.first_point));
+
+    char* data = reinterpret_cast<char*>(points.data());
+    size_t size = in_file * sizeof(point);
+    auto offset = static_cast<off_t>(e.first_point * sizeof(point));
+    while (size > 0)
+    {
+        const ssize_t res = pread(fd, data, size, offset);
+        if (res < 0 && errno == EINTR)
+            continue;
+
+        if (res <= 0)
+            return false;
+
+        data += res;
+        size -= res;
+        offset += res;
+    }
+
+    if (in_file < e.num_points)
+    {
+        const size_t buffered = e.first_point + in_file - num_flushed;
+        std::copy(buffer.begin() + buffered, buffer.begin() + buffered + (e.num_points - in_file),
+                  points.begin() + in_file);
+    }
+    return true;
+}
+
+size_t shape_store::erase(std::string_view id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto it = lookup.find(id);
+    if (it == lookup.end())
+        return 0;
+
+    entries[it->second].erased = true;
+    lookup.erase(it);
+    return 1;
+}
+
+size_t shape_store::count(std::string_view id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookup.count(id);
+}
+
+size_t shape_store::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookup.size();
+}
+
+bool shape_store::empty() const
+{
+    return size() == 0;
+}
+}
@@ -7,20 +7,16 @@ stop::stop(pfaedle::gtfs::feed& feed) :
     record(feed)
 {
 }
-const std::vector<std::reference_wrapper<stop_time>>& stop::get_stop_times() const
-{
-    return feed.stop_time_provider().get_for_stop(stop_id);
-}
-
-std::vector<std::reference_wrapper<stop_time>>& stop::get_stop_times()
+stop_time_range stop::get_stop_times() const
 {
     return feed.stop_time_provider().get_for_stop(stop_id);
 }
 std::optional<std::reference_wrapper<stop>> stop::get_parent_station() const
 {
-    if (feed.stops.count(parent_station))
-        return feed.stops.at(parent_station);
+    auto* parent = feed.stops.get(parent_station);
+    if (parent == nullptr)
+        return std::nullopt;
 
-    return std::nullopt;
+    return *parent;
 }
 }
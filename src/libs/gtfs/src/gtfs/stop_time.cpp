@@ -1,20 +1,433 @@
 #include <gtfs/stop_time.h>
 #include <gtfs/feed.h>
 
+#include <algorithm>
+#include <limits>
+
 namespace pfaedle::gtfs
 {
+namespace
+{
+const Text empty_text;
+
+constexpr uint8_t pickup_shift = 0;
+constexpr uint8_t drop_off_shift = 2;
+constexpr uint8_t timepoint_shift = 4;
+
+int32_t to_seconds(const time& t)
+{
+    return t.is_provided() ? static_cast<int32_t>(t.get_total_seconds()) : -1;
+}
+
+time from_seconds(int32_t seconds)
+{
+    return seconds < 0 ? time() : time(static_cast<size_t>(seconds));
+}
+}
+
+stop_time::stop_time(stop_time_store& store, uint32_t index) :
+    store(&store),
+    idx(index)
+{
+}
+const Id& stop_time::trip_id() const
+{
+    return store->trip_ids.ids[store->trip_of(idx)];
+}
+const Id& stop_time::stop_id() const
+{
+    return store->stop_ids.ids[store->stop_idx[idx]];
+}
+size_t stop_time::stop_sequence() const
+{
+    return store->get_stop_sequence(idx);
+}
+time stop_time::arrival_time() const
+{
+    return from_seconds(store->get_arrival(idx));
+}
+time stop_time::departure_time() const
+{
+    return from_seconds(store->departure[idx]);
+}
+const Text& stop_time::stop_headsign() const
+{
+    if (store->headsigns.ids.empty())
+        return empty_text;
+
+    return store->headsigns.ids[store->headsign[idx]];
+}
+stop_time_boarding stop_time::pickup_type() const
+{
+    return static_cast<stop_time_boarding>((store->flags[idx] >> pickup_shift) & 3);
+}
+stop_time_boarding stop_time::drop_off_type() const
+{
+    return static_cast<stop_time_boarding>((store->flags[idx] >> drop_off_shift) & 3);
+}
+double stop_time::shape_dist_traveled() const
+{
+    return store->shape_dist_traveled[idx];
+}
+stop_time_point stop_time::timepoint() const
+{
+    return static_cast<stop_time_point>((store->flags[idx] >> timepoint_shift) & 1);
+}
+void stop_time::set_arrival_time(const time& t)
+{
+    store->set_times(idx, to_seconds(t), store->departure[idx]);
+}
+void stop_time::set_departure_time(const time& t)
+{
+    store->set_times(idx, store->get_arrival(idx), to_seconds(t));
+}
+void stop_time::set_shape_dist_traveled(double dist)
+{
+    store->shape_dist_traveled[idx] = static_cast<float>(dist);
+}
+uint32_t stop_time::index() const
+{
+    return idx;
+}
 std::optional<std::reference_wrapper<pfaedle::gtfs::stop>> stop_time::stop() const
 {
-    if(!feed.stops.count(stop_id))
+    const uint32_t s = store->stop_idx[idx];
+    if (s >= store->stop_links.size() || store->stop_links[s] == nullptr)
         return std::nullopt;
 
-    return feed.stops.at(stop_id);
+    return *store->stop_links[s];
 }
 std::optional<std::reference_wrapper<pfaedle::gtfs::trip>> stop_time::trip() const
 {
-    if(!feed.trips.count(trip_id))
+    const uint32_t t = store->trip_of(idx);
+    if (t >= store->trip_links.size() || store->trip_links[t] == nullptr)
+        return std::nullopt;
+
+    return *store->trip_links[t];
+}
+bool stop_time::operator==(const stop_time& other) const
+{
+    return store == other.store && idx == other.idx;
+}
+bool stop_time::operator!=(const stop_time& other) const
+{
+    return !(*this == other);
+}
+
+
+stop_time_range::iterator::iterator(stop_time_store* store, const uint32_t* indices, size_t pos) :
+    store(store),
+    indices(indices),
+    pos(pos)
+{
+}
+stop_time stop_time_range::iterator::operator*() const
+{
+    return {*store, indices ? indices[pos] : static_cast<uint32_t>(pos)};
+}
+stop_time stop_time_range::iterator::operator[](difference_type n) const
+{
+    return *(*this + n);
+}
+stop_time_range::iterator& stop_time_range::iterator::operator++()
+{
+    ++pos;
+    return *this;
+}
+stop_time_range::iterator stop_time_range::iterator::operator++(int)
+{
+    auto ret = *this;
+    ++pos;
+    return ret;
+}
+stop_time_range::iterator& stop_time_range::iterator::operator--()
+{
+    --pos;
+    return *this;
+}
+stop_time_range::iterator stop_time_range::iterator::operator--(int)
+{
+    auto ret = *this;
+    --pos;
+    return ret;
+}
+stop_time_range::iterator& stop_time_range::iterator::operator+=(difference_type n)
+{
+    pos += n;
+    return *this;
+}
+stop_time_range::iterator& stop_time_range::iterator::operator-=(difference_type n)
+{
+    pos -= n;
+    return *this;
+}
+stop_time_range::iterator stop_time_range::iterator::operator+(difference_type n) const
+{
+    return {store, indices, pos + n};
+}
+stop_time_range::iterator stop_time_range::iterator::operator-(difference_type n) const
+{
+    return {store, indices, pos - n};
+}
+stop_time_range::iterator::difference_type stop_time_range::iterator::operator-(const iterator& other) const
+{
+    return static_cast<difference_type>(pos) - static_cast<difference_type>(other.pos);
+}
+bool stop_time_range::iterator::operator==(const iterator& other) const
+{
+    return pos == other.pos && indices == other.indices && store == other.store;
+}
+bool stop_time_range::iterator::operator!=(const iterator& other) const
+{
+    return !(*this == other);
+}
+
+
+stop_time_range::stop_time_range(stop_time_store& store, const uint32_t* begin, const uint32_t* end) :
+    store(&store),
+    indices(begin),
+    count(end - begin)
+{
+}
+stop_time_range::iterator stop_time_range::begin() const
+{
+    return {store, indices, 0};
+}
+stop_time_range::iterator stop_time_range::end() const
+{
+    return {store, indices, count};
+}
+size_t stop_time_range::size() const
+{
+    return count;
+}
+bool stop_time_range::empty() const
+{
+    return count == 0;
+}
+stop_time stop_time_range::operator[](size_t i) const
+{
+    return begin()[i];
+}
+stop_time stop_time_range::front() const
+{
+    return (*this)[0];
+}
+stop_time stop_time_range::back() const
+{
+    return (*this)[count - 1];
+}
+
+
+uint32_t stop_time_store::id_table::intern(std::string_view id)
+{
+    const auto it = lookup.find(id);
+    if (it != lookup.end())
+        return it->second;
+
+    const auto index = static_cast<uint32_t>(ids.size());
+    ids.emplace_back(id);
+    lookup.emplace(ids.back(), index);
+    return index;
+}
+std::optional<uint32_t> stop_time_store::id_table::find(std::string_view id) const
+{
+    const auto it = lookup.find(id);
+    if (it == lookup.end())
         return std::nullopt;
 
-    return feed.trips.at(trip_id);
+    return it->second;
+}
+
+stop_time_store::stop_time_store(pfaedle::gtfs::feed& feed) :
+    feed(&feed)
+{
+}
+void stop_time_store::push_back(const stop_time_values& values)
+{
+    if (trip_run_trip.empty() || trip_ids.ids[trip_run_trip.back()] != values.trip_id)
+        add_trip_run(static_cast<uint32_t>(size()), trip_ids.intern(values.trip_id));
+
+    stop_idx.push_back(stop_ids.intern(values.stop_id));
+    push_stop_sequence(values.stop_sequence);
+    arrival.push_back(to_seconds(values.arrival_time));
+    departure.push_back(to_seconds(values.departure_time));
+    shape_dist_traveled.push_back(static_cast<float>(values.shape_dist_traveled));
+    flags.push_back(static_cast<uint8_t>(static_cast<uint8_t>(values.pickup_type) << pickup_shift |
+                                         static_cast<uint8_t>(values.drop_off_type) << drop_off_shift |
+                                         static_cast<uint8_t>(values.timepoint) << timepoint_shift));
+
+    if (!values.stop_headsign.empty() && headsigns.ids.empty())
+    {
+        headsigns.intern({});
+        headsign.resize(size() - 1, 0);
+    }
+    if (!headsigns.ids.empty())
+        headsign.push_back(headsigns.intern(values.stop_headsign));
+}
+void stop_time_store::append(stop_time_store&& other)
+{
+    std::vector<uint32_t> trips(other.trip_ids.ids.size());
+    for (size_t i = 0; i < trips.size(); ++i)
+        trips[i] = trip_ids.intern(other.trip_ids.ids[i]);
+
+    std::vector<uint32_t> stops(other.stop_ids.ids.size());
+    for (size_t i = 0; i < stops.size(); ++i)
+        stops[i] = stop_ids.intern(other.stop_ids.ids[i]);
+
+    const size_t offset = size();
+    reserve(offset + other.size());
+
+    for (size_t r = 0; r < other.trip_run_trip.size(); ++r)
+        add_trip_run(static_cast<uint32_t>(offset + other.trip_run_start[r]), trips[other.trip_run_trip[r]]);
+    for (auto s : other.stop_idx)
+        stop_idx.push_back(stops[s]);
+
+    if (other.wide_stop_sequence.empty() && wide_stop_sequence.empty())
+    {
+        stop_sequence.insert(stop_sequence.end(), other.stop_sequence.begin(), other.stop_sequence.end());
+    }
+    else
+    {
+        for (size_t i = 0; i < other.size(); ++i)
+            push_stop_sequence(other.get_stop_sequence(i));
+    }
+    arrival.insert(arrival.end(), other.arrival.begin(), other.arrival.end());
+    departure.insert(departure.end(), other.departure.begin(), other.departure.end());
+    shape_dist_traveled.insert(shape_dist_traveled.end(), other.shape_dist_traveled.begin(),
+                               other.shape_dist_traveled.end());
+    flags.insert(flags.end(), other.flags.begin(), other.flags.end());
+
+    if (!other.headsigns.ids.empty())
+    {
+        if (headsigns.ids.empty())
+        {
+            headsigns.intern({});
+            headsign.resize(offset, 0);
+        }
+
+        for (auto h : other.headsign)
+            headsign.push_back(headsigns.intern(other.headsigns.ids[h]));
+    }
+    else if (!headsigns.ids.empty())
+    {
+        headsign.resize(size(), 0);
+    }
+
+    other = stop_time_store();
+}
+void stop_time_store::reserve(size_t n)
+{
+    stop_idx.reserve(n);
+    if (wide_stop_sequence.empty())
+        stop_sequence.reserve(n);
+    else
+        wide_stop_sequence.reserve(n);
+    arrival.reserve(n);
+    departure.reserve(n);
+    shape_dist_traveled.reserve(n);
+    flags.reserve(n);
+}
+size_t stop_time_store::size() const
+{
+    return stop_idx.size();
+}
+bool stop_time_store::empty() const
+{
+    return stop_idx.empty();
+}
+stop_time_store::iterator stop_time_store::begin() const
+{
+    return {const_cast<stop_time_store*>(this), nullptr, 0};
+}
+stop_time_store::iterator stop_time_store::end() const
+{
+    return {const_cast<stop_time_store*>(this), nullptr, size()};
+}
+stop_time stop_time_store::operator[](size_t i) const
+{
+    return {*const_cast<stop_time_store*>(this), static_cast<uint32_t>(i)};
+}
+size_t stop_time_store::num_trips() const
+{
+    return trip_ids.ids.size();
+}
+size_t stop_time_store::num_stops() const
+{
+    return stop_ids.ids.size();
+}
+std::optional<uint32_t> stop_time_store::find_trip(const Id& id) const
+{
+    return trip_ids.find(id);
+}
+std::optional<uint32_t> stop_time_store::find_stop(const Id& id) const
+{
+    return stop_ids.find(id);
+}
+uint32_t stop_time_store::trip_of(size_t i) const
+{
+    const auto run = std::upper_bound(trip_run_start.begin(), trip_run_start.end(), i) - trip_run_start.begin() - 1;
+    return trip_run_trip[run];
+}
+uint32_t stop_time_store::stop_of(size_t i) const
+{
+    return stop_idx[i];
+}
+size_t stop_time_store::column_bytes() const
+{
+    const auto bytes = [](const auto& column) { return column.size() * sizeof(column[0]); };
+    return bytes(trip_run_start) + bytes(trip_run_trip) + bytes(stop_idx) + bytes(stop_sequence) +
+           bytes(wide_stop_sequence) + bytes(arrival) + bytes(departure) + bytes(shape_dist_traveled) +
+           bytes(flags) + bytes(headsign);
+}
+void stop_time_store::link()
+{
+    stop_links.assign(stop_ids.ids.size(), nullptr);
+    trip_links.assign(trip_ids.ids.size(), nullptr);
+    if (!feed)
+        return;
+
+    for (size_t i = 0; i < stop_links.size(); ++i)
+        stop_links[i] = feed->stops.get(stop_ids.ids[i]);
+    for (size_t i = 0; i < trip_links.size(); ++i)
+        trip_links[i] = feed->trips.get(trip_ids.ids[i]);
+}
+void stop_time_store::set_times(size_t i, int32_t arrival_seconds, int32_t departure_seconds)
+{
+    arrival[i] = arrival_seconds < 0 ? NO_TIME : arrival_seconds;
+    departure[i] = departure_seconds;
+}
+int32_t stop_time_store::get_arrival(size_t i) const
+{
+    return arrival[i];
+}
+void stop_time_store::add_trip_run(uint32_t start, uint32_t trip)
+{
+    // Runs of the same trip that meet, e.g. when chunks are appended, are merged.
+    if (!trip_run_trip.empty() && trip_run_trip.back() == trip)
+        return;
+
+    trip_run_start.push_back(start);
+    trip_run_trip.push_back(trip);
+}
+void stop_time_store::push_stop_sequence(size_t value)
+{
+    if (wide_stop_sequence.empty() && value <= std::numeric_limits<uint16_t>::max())
+    {
+        stop_sequence.push_back(static_cast<uint16_t>(value));
+        return;
+    }
+
+    if (wide_stop_sequence.empty())
+    {
+        wide_stop_sequence.reserve(std::max(stop_sequence.capacity(), stop_sequence.size() + 1));
+        wide_stop_sequence.assign(stop_sequence.begin(), stop_sequence.end());
+        stop_sequence = {};
+    }
+    wide_stop_sequence.push_back(static_cast<uint32_t>(value));
+}
+size_t stop_time_store::get_stop_sequence(size_t i) const
+{
+    return wide_stop_sequence.empty() ? stop_sequence[i] : wide_stop_sequence[i];
 }
 }
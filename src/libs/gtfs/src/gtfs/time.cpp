@@ -1,6 +1,8 @@
 #include <gtfs/exceptions/invalid_field_format.h>
 #include <gtfs/time.h>
 
+#include <charconv>
+
 namespace pfaedle::gtfs
 {
 
@@ -19,26 +21,35 @@ void time::set_total_seconds() { total_seconds = hh * 60 * 60 + mm * 60 + ss; }
 
 void time::set_raw_time()
 {
-    const std::string hh_str = append_leading_zero(std::to_string(hh), false);
-    const std::string mm_str = append_leading_zero(std::to_string(mm));
-    const std::string ss_str = append_leading_zero(std::to_string(ss));
+    // Hours have at least two digits, the writer formats every time of a feed this way.
+    char buffer[16];
+    char * out = buffer;
+    if (hh < 10)
+        *out++ = '0';
+    out = std::to_chars(out, buffer + sizeof(buffer), hh).ptr;
+    for (const uint16_t part : {mm, ss})
+    {
+        *out++ = ':';
+        *out++ = static_cast<char>('0' + part / 10);
+        *out++ = static_cast<char>('0' + part % 10);
+    }
 
-    raw_time = hh_str + ":" + mm_str + ":" + ss_str;
+    raw_time.assign(buffer, out);
 }
 
 // Time in the HH:MM:SS format (H:MM:SS is also accepted). Used as type for Time GTFS fields.
-time::time(const std::string & raw_time_str) : raw_time(raw_time_str)
+time::time(std::string_view raw_time_str) : raw_time(raw_time_str)
 {
     if (raw_time_str.empty())
         return;
 
-    const size_t len = raw_time.size();
-    if (!(len == 7 || len == 8) || (raw_time[len - 3] != ':' && raw_time[len - 6] != ':'))
-        throw invalid_field_format("time is not in [H]H:MM:SS format: " + raw_time_str);
+    const size_t len = raw_time_str.size();
+    if (!(len == 7 || len == 8) || (raw_time_str[len - 3] != ':' && raw_time_str[len - 6] != ':'))
+        throw invalid_field_format("time is not in [H]H:MM:SS format: " + raw_time);
 
-    hh = static_cast<uint16_t>(std::stoi(raw_time.substr(0, len - 6)));
-    mm = static_cast<uint16_t>(std::stoi(raw_time.substr(len - 5, 2)));
-    ss = static_cast<uint16_t>(std::stoi(raw_time.substr(len - 2)));
+    hh = static_cast<uint16_t>(parse_int(raw_time_str.substr(0, len - 6)));
+    mm = static_cast<uint16_t>(parse_int(raw_time_str.substr(len - 5, 2)));
+    ss = static_cast<uint16_t>(parse_int(raw_time_str.substr(len - 2)));
 
     if (mm > 60 || ss > 60)
         throw invalid_field_format("time minutes/seconds wrong value: " + std::to_string(mm) +
@@ -83,7 +94,7 @@ size_t time::get_total_seconds() const { return total_seconds; }
 
 std::tuple<uint16_t, uint16_t, uint16_t> time::get_hh_mm_ss() const { return {hh, mm, ss}; }
 
-std::string time::get_raw_time() const { return raw_time; }
+const std::string& time::get_raw_time() const { return raw_time; }
 time& time::add_seconds(size_t seconds)
 {
     auto h = seconds / 3600;
@@ -5,21 +5,21 @@ namespace pfaedle::gtfs
 {
 std::optional<std::reference_wrapper<pfaedle::gtfs::route>> trip::route() const
 {
-    if(!feed.routes.count(route_id))
+    if (route_link == nullptr)
         return std::nullopt;
 
-    return feed.routes.at(route_id);
+    return *route_link;
 }
 std::optional<std::reference_wrapper<pfaedle::gtfs::shape>> trip::shape() const
 {
-    if(!feed.shapes.count(shape_id))
+    auto* s = feed.shapes.get(shape_index);
+    if (s == nullptr)
         return std::nullopt;
 
-    return feed.shapes.at(shape_id);
+    return *s;
 }
-std::vector<std::reference_wrapper<stop_time>>& trip::stop_times() const
+stop_time_range trip::stop_times() const
 {
-    auto& provider = feed.stop_time_provider();
-    return provider.get_for_trip(trip_id);
+    return stop_time_link;
 }
 }
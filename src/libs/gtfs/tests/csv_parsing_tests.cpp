@@ -1,5 +1,10 @@
 #include "catch_amalgamated.hpp"
 #include "../src/gtfs/access/csv_parser.h"
+#include "../src/gtfs/access/csv_writer.h"
+#include "config.h"
+
+#include <filesystem>
+#include <string>
 
 using namespace pfaedle::gtfs::access;
 
@@ -87,3 +92,92 @@ TEST_CASE("Read quoted values with quotes at end")
     CHECK(res[0] == "");
     CHECK(res[1] == "Text and \"Name\"");
 }
+
+TEST_CASE("Rows of a file by column")
+{
+    csv_parser parser(TEST_FOLDER_PATH "/resources/sample_feed/");
+    REQUIRE(parser.read_header("stop_times.txt") == result_code::OK);
+
+    const csv_column trip_id("trip_id");
+    const csv_column stop_sequence("stop_sequence");
+    const csv_column timepoint("timepoint");
+
+    csv_row row;
+    REQUIRE(parser.read_row(row) == result_code::OK);
+    CHECK(row.at(trip_id) == "STBA");
+    CHECK(row.get(stop_sequence) == "1");
+    CHECK(!row.has(timepoint));
+    CHECK(row.get(timepoint).empty());
+    CHECK_THROWS_AS(row.at(timepoint), std::out_of_range);
+
+    size_t rows = 1;
+    while (parser.read_row(row) != result_code::END_OF_FILE)
+        ++rows;
+    CHECK(rows == 28);
+}
+
+TEST_CASE("Rows of a file split into chunks")
+{
+    csv_parser parser(TEST_FOLDER_PATH "/resources/sample_feed/");
+    REQUIRE(parser.read_header("stop_times.txt") == result_code::OK);
+
+    const auto chunks = parser.split_rows(4, 1);
+    REQUIRE(chunks.size() == 4);
+
+    const csv_column stop_sequence("stop_sequence");
+    std::vector<std::string> sequences;
+    for (auto rows : chunks)
+    {
+        csv_row row;
+        while (parser.read_row(row, rows) != result_code::END_OF_FILE)
+            sequences.emplace_back(row.at(stop_sequence));
+    }
+
+    REQUIRE(sequences.size() == 28);
+    CHECK(sequences.front() == "1");
+    CHECK(sequences.back() == "2");
+
+    csv_row row;
+    REQUIRE(parser.read_row(row) == result_code::OK);
+    CHECK(row.get(stop_sequence) == "1");
+}
+
+TEST_CASE("Written rows are read back")
+{
+    const std::string directory = std::filesystem::temp_directory_path().string() + "/";
+    const std::string text(csv_writer::buffer_size, 'x');
+    {
+        csv_writer out(directory + "written.txt");
+        REQUIRE(out.is_open());
+        out.field("id").field("name").field("lat").field("sequence");
+        out.end_row();
+        out.field("a").field("Big \"Bus\", Company").field(52.5).field(size_t{7});
+        out.end_row();
+        out.field(text).empty_field().field(-1.25, 2).field(-3);
+        out.end_row();
+        REQUIRE(out.close() == result_code::OK);
+    }
+
+    csv_parser parser(directory);
+    REQUIRE(parser.read_header("written.txt") == result_code::OK);
+    const csv_column id("id");
+    const csv_column name("name");
+    const csv_column lat("lat");
+    const csv_column sequence("sequence");
+
+    csv_row row;
+    REQUIRE(parser.read_row(row) == result_code::OK);
+    CHECK(row.at(id) == "a");
+    CHECK(row.at(name) == "Big \"Bus\", Company");
+    CHECK(row.at(lat) == "52.500000");
+    CHECK(row.at(sequence) == "7");
+
+    REQUIRE(parser.read_row(row) == result_code::OK);
+    CHECK(row.at(id) == text);
+    CHECK(row.at(name).empty());
+    CHECK(row.at(lat) == "-1.25");
+    CHECK(row.at(sequence) == "-3");
+
+    CHECK(parser.read_row(row) == result_code::END_OF_FILE);
+    std::filesystem::remove(directory + "written.txt");
+}
@@ -5,6 +5,11 @@
 #include <gtfs/feed.h>
 #include "config.h"
 
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
 
 using namespace pfaedle::gtfs;
 
@@ -118,6 +123,76 @@ TEST_CASE("Read GTFS feed")
     CHECK(!feed.feed_info.feed_publisher_name.empty());
 }
 
+TEST_CASE("Zipped GTFS feed")
+{
+    feed feed;
+    access::feed_reader reader(feed, TEST_FOLDER_PATH"/resources/sample_feed");
+    access::feed_reader::read_config config;
+    REQUIRE(reader.read(config) == access::result_code::OK);
+
+    const auto archive = std::filesystem::temp_directory_path() / "stei-gtfs-tests-feed.zip";
+    access::feed_writter writter(feed, archive.string());
+    REQUIRE(writter.write(access::feed_writter::write_config{}) == access::result_code::OK);
+
+    pfaedle::gtfs::feed feed_copy;
+    access::feed_reader reader_copy(feed_copy, archive.string());
+    REQUIRE(reader_copy.read(config) == access::result_code::OK);
+    std::filesystem::remove(archive);
+
+    CHECK(feed_copy.agencies.size() == feed.agencies.size());
+    CHECK(feed_copy.stops.size() == feed.stops.size());
+    CHECK(feed_copy.routes.size() == feed.routes.size());
+    CHECK(feed_copy.trips.size() == feed.trips.size());
+    CHECK(feed_copy.stop_times.size() == feed.stop_times.size());
+    CHECK(feed_copy.shapes.size() == feed.shapes.size());
+    CHECK(feed_copy.stops.at("FUR_CREEK_RES").stop_name == feed.stops.at("FUR_CREEK_RES").stop_name);
+}
+
+TEST_CASE("Pass-through GTFS feed")
+{
+    feed feed;
+    access::feed_reader reader(feed, TEST_FOLDER_PATH"/resources/sample_feed");
+    access::feed_reader::read_config config;
+    config.calendar = false;
+    config.descriptive_columns = false;
+    REQUIRE(reader.read(config) == access::result_code::OK);
+    CHECK(feed.trips.at("AB1").trip_headsign.empty());
+
+    feed.trips.at("AB1").shape_id = "new_shape";
+    feed.stop_times[0].set_shape_dist_traveled(12.5);
+    feed.stop_times[1].set_arrival_time(pfaedle::gtfs::time(6, 25, 0));
+    feed.stop_times[1].set_departure_time(pfaedle::gtfs::time(6, 26, 30));
+
+    const auto directory = std::filesystem::temp_directory_path() / "stei-gtfs-tests-pass-through";
+    std::filesystem::create_directories(directory);
+    access::feed_writter writter(feed, directory.string());
+    access::feed_writter::write_config write_config;
+    write_config.pass_through = TEST_FOLDER_PATH"/resources/sample_feed";
+    REQUIRE(writter.write(write_config) == access::result_code::OK);
+
+    pfaedle::gtfs::feed feed_copy;
+    access::feed_reader reader_copy(feed_copy, directory.string());
+    REQUIRE(reader_copy.read(access::feed_reader::read_config{}) == access::result_code::OK);
+    std::ifstream stop_times_file(directory / "stop_times.txt");
+    const std::string stop_times_text((std::istreambuf_iterator<char>(stop_times_file)), std::istreambuf_iterator<char>());
+    stop_times_file.close();
+    std::filesystem::remove_all(directory);
+
+    // Copied from the input, although they were not read:
+    CHECK(feed_copy.calendar.size() == 2);
+    CHECK(feed_copy.trips.at("AB1").trip_headsign == "to Bullfrog");
+
+    CHECK(feed_copy.trips.at("AB1").shape_id == "new_shape");
+    CHECK(feed_copy.trips.size() == feed.trips.size());
+    REQUIRE(feed_copy.stop_times.size() == feed.stop_times.size());
+    CHECK(feed_copy.stop_times[0].shape_dist_traveled() == 12.5);
+    CHECK(feed_copy.stop_times[1].stop_id() == feed.stop_times[1].stop_id());
+    CHECK(feed_copy.stop_times[1].arrival_time() == pfaedle::gtfs::time(6, 25, 0));
+    CHECK(feed_copy.stop_times[1].departure_time() == pfaedle::gtfs::time(6, 26, 30));
+    // Times that were not changed are copied as they are.
+    CHECK(stop_times_text.find("\nCITY1,6:00:00,6:00:00,") != std::string::npos);
+}
+
 TEST_CASE("Agency")
 {
     pfaedle::gtfs::feed feed;
@@ -0,0 +1,81 @@
+#include <gtfs/feed.h>
+#include <gtfs/id_map.h>
+
+#include "catch_amalgamated.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace pfaedle::gtfs;
+
+TEST_CASE("Entities are interned in insertion order")
+{
+    id_map<shape> shapes;
+    shapes["b"].shape_id = "b";
+    shapes["a"].shape_id = "a";
+    shapes.emplace("c");
+
+    REQUIRE(shapes.size() == 3);
+    CHECK(shapes.index_of("b") == 0u);
+    CHECK(shapes.index_of("a") == 1u);
+    CHECK(shapes.index_of("c") == 2u);
+    CHECK_FALSE(shapes.index_of("d").has_value());
+
+    std::vector<std::string> order;
+    for (const auto& shape_pair : shapes)
+        order.push_back(shape_pair.first);
+    CHECK(order == std::vector<std::string>{"b", "a", "c"});
+
+    shape* a = shapes.get("a");
+    REQUIRE(a != nullptr);
+    CHECK(a == shapes.get(1u));
+    CHECK(&shapes.at("a") == a);
+    CHECK(&shapes.find("a")->second == a);
+    CHECK(shapes.get("d") == nullptr);
+    CHECK(shapes.find("d") == shapes.end());
+    CHECK_THROWS_AS(shapes.at("d"), std::out_of_range);
+
+    CHECK_FALSE(shapes.emplace("a").second);
+    CHECK(shapes.size() == 3);
+}
+
+TEST_CASE("Erased entities keep the indices of the others")
+{
+    id_map<shape> shapes;
+    shapes["a"];
+    shapes["b"];
+    shape* b = shapes.get("b");
+
+    CHECK(shapes.erase("a") == 1);
+    CHECK(shapes.erase("a") == 0);
+    CHECK(shapes.size() == 1);
+    CHECK(shapes.count("a") == 0);
+    CHECK(shapes.get(0u) == nullptr);
+    CHECK(shapes.get("b") == b);
+    CHECK(shapes.begin()->first == "b");
+
+    shapes["a"];
+    CHECK(shapes.index_of("a") == 2u);
+    CHECK(shapes.index_count() == 3);
+    CHECK(shapes.get("b") == b);
+}
+
+TEST_CASE("Records are resolved by id")
+{
+    feed feed;
+    route r(feed);
+    r.route_id = "R";
+    feed.routes.insert(std::make_pair(r.route_id, std::move(r)));
+
+    trip t(feed);
+    t.trip_id = "T";
+    t.route_id = "R";
+    t.shape_id = "S";
+    feed.trips.insert(std::make_pair(t.trip_id, std::move(t)));
+    feed.build();
+
+    const auto& inserted = feed.trips.at("T");
+    REQUIRE(inserted.route().has_value());
+    CHECK(&inserted.route()->get() == feed.routes.get("R"));
+    CHECK_FALSE(inserted.shape().has_value());
+}
@@ -0,0 +1,71 @@
+#include "catch_amalgamated.hpp"
+
+#include <gtfs/shape_store.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace pfaedle::gtfs;
+
+namespace
+{
+shape make_shape(const std::string& id, size_t num_points)
+{
+    shape s;
+    s.shape_id = id;
+    for (size_t i = 0; i < num_points; ++i)
+        s.points.push_back({47.5 + i * 1e-6, 7.5 - i * 1e-6, i, i * 2.5});
+    return s;
+}
+}
+
+TEST_CASE("Shapes are read back in the order they were added")
+{
+    shape_store store;
+    REQUIRE(store.empty());
+
+    // The second shape spans the first flush of the buffer.
+    CHECK(store.add(make_shape("a", 10)));
+    CHECK(store.add(make_shape("b", shape_store::buffer_points + 5)));
+    CHECK(store.add(make_shape("c", 3)));
+    CHECK_FALSE(store.add(make_shape("a", 1)));
+
+    CHECK(store.size() == 3);
+    CHECK(store.count("b") == 1);
+    CHECK(store.count("d") == 0);
+
+    std::vector<std::string> ids;
+    std::vector<size_t> sizes;
+    bool points_match = true;
+    REQUIRE(store.for_each([&](const Id& id, const std::vector<shape_store::point>& points) {
+        ids.push_back(id);
+        sizes.push_back(points.size());
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            points_match = points_match && std::abs(points[i].latitude() - (47.5 + i * 1e-6)) < 1e-7 &&
+                           std::abs(points[i].longitude() - (7.5 - i * 1e-6)) < 1e-7 &&
+                           std::abs(points[i].dist - i * 2.5) <= 1e-6 * i * 2.5;
+        }
+    }));
+
+    CHECK(ids == std::vector<std::string>{"a", "b", "c"});
+    CHECK(sizes == std::vector<size_t>{10, shape_store::buffer_points + 5, 3});
+    CHECK(points_match);
+}
+
+TEST_CASE("Erased shapes are skipped")
+{
+    shape_store store;
+    store.add(make_shape("a", 2));
+    store.add(make_shape("b", 2));
+
+    CHECK(store.erase("a") == 1);
+    CHECK(store.erase("a") == 0);
+    CHECK(store.count("a") == 0);
+    CHECK(store.size() == 1);
+
+    std::vector<std::string> ids;
+    store.for_each([&ids](const Id& id, const std::vector<shape_store::point>&) { ids.push_back(id); });
+    CHECK(ids == std::vector<std::string>{"b"});
+}
@@ -0,0 +1,208 @@
+#include <gtfs/feed.h>
+#include <gtfs/stop_time.h>
+
+#include "catch_amalgamated.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace pfaedle::gtfs;
+
+namespace
+{
+stop_time_values make_stop_time(std::string_view trip_id, std::string_view stop_id, size_t stop_sequence,
+                                const std::string& arrival, const std::string& departure)
+{
+    stop_time_values values;
+    values.trip_id = trip_id;
+    values.stop_id = stop_id;
+    values.stop_sequence = stop_sequence;
+    values.arrival_time = pfaedle::gtfs::time(arrival);
+    values.departure_time = pfaedle::gtfs::time(departure);
+    return values;
+}
+}
+
+TEST_CASE("Stop times are stored by column")
+{
+    feed feed;
+    auto& store = feed.stop_times;
+
+    store.push_back(make_stop_time("T1", "A", 1, "", "08:00:00"));
+    auto values = make_stop_time("T1", "B", 2, "08:10:00", "08:12:00");
+    values.stop_headsign = "to C";
+    values.pickup_type = stop_time_boarding::Phone;
+    values.timepoint = stop_time_point::Approximate;
+    values.shape_dist_traveled = 1250.5;
+    store.push_back(values);
+    store.push_back(make_stop_time("T2", "A", 1, "25:00:00", "08:00:00"));
+
+    REQUIRE(store.size() == 3);
+    CHECK(store.num_trips() == 2);
+    CHECK(store.num_stops() == 2);
+
+    CHECK(store[0].trip_id() == "T1");
+    CHECK(store[0].stop_id() == "A");
+    CHECK(!store[0].arrival_time().is_provided());
+    CHECK(store[0].departure_time() == pfaedle::gtfs::time(8, 0, 0));
+    CHECK(store[0].stop_headsign().empty());
+
+    CHECK(store[1].stop_sequence() == 2);
+    CHECK(store[1].arrival_time() == pfaedle::gtfs::time(8, 10, 0));
+    CHECK(store[1].departure_time() == pfaedle::gtfs::time(8, 12, 0));
+    CHECK(store[1].stop_headsign() == "to C");
+    CHECK(store[1].pickup_type() == stop_time_boarding::Phone);
+    CHECK(store[1].drop_off_type() == stop_time_boarding::RegularlyScheduled);
+    CHECK(store[1].timepoint() == stop_time_point::Approximate);
+    CHECK(store[1].shape_dist_traveled() == Catch::Approx(1250.5));
+
+    // arrival after departure
+    CHECK(store[2].arrival_time() == pfaedle::gtfs::time(25, 0, 0));
+    CHECK(store[2].departure_time() == pfaedle::gtfs::time(8, 0, 0));
+
+    auto st = store[2];
+    st.set_departure_time(pfaedle::gtfs::time(26, 0, 0));
+    CHECK(store[2].arrival_time() == pfaedle::gtfs::time(25, 0, 0));
+    CHECK(store[2].departure_time() == pfaedle::gtfs::time(26, 0, 0));
+
+    feed.build();
+    const auto trip_stop_times = feed.stop_time_provider().get_for_trip("T1");
+    REQUIRE(trip_stop_times.size() == 2);
+    CHECK(trip_stop_times.front() == store[0]);
+    CHECK(trip_stop_times.back() == store[1]);
+    CHECK(feed.stop_time_provider().get_for_stop("A").size() == 2);
+    CHECK(feed.stop_time_provider().get_for_trip("T3").empty());
+}
+
+TEST_CASE("Stop time stores are appended")
+{
+    feed feed;
+    auto& store = feed.stop_times;
+    store.push_back(make_stop_time("T1", "A", 1, "08:00:00", "08:00:00"));
+
+    stop_time_store chunk;
+    auto values = make_stop_time("T2", "B", 1, "09:00:00", "08:00:00");
+    values.stop_headsign = "to A";
+    chunk.push_back(values);
+    chunk.push_back(make_stop_time("T1", "B", 2, "08:05:00", "08:05:00"));
+
+    store.append(std::move(chunk));
+
+    REQUIRE(store.size() == 3);
+    CHECK(store.num_trips() == 2);
+    CHECK(store[0].stop_headsign().empty());
+    CHECK(store[1].trip_id() == "T2");
+    CHECK(store[1].stop_headsign() == "to A");
+    CHECK(store[1].arrival_time() == pfaedle::gtfs::time(9, 0, 0));
+    CHECK(store[2].trip_id() == "T1");
+    CHECK(store[2].stop_id() == "B");
+    CHECK(store.trip_of(0) == store.trip_of(2));
+}
+
+TEST_CASE("Stop time columns take under 24 bytes per stop time")
+{
+    stop_time_store store;
+    for (size_t i = 0; i < 10000; ++i)
+    {
+        auto values = make_stop_time("T" + std::to_string(i / 20), "S" + std::to_string(i % 500), i % 20,
+                                     "08:00:00", "08:01:00");
+        values.stop_headsign = "to S" + std::to_string(i % 7);
+        values.shape_dist_traveled = 100.0 * (i % 20);
+        store.push_back(values);
+    }
+
+    REQUIRE(store.size() == 10000);
+    CHECK(store.column_bytes() < 24 * store.size());
+    CHECK(store[9999].trip_id() == "T499");
+    CHECK(store.trip_of(9999) == store.trip_of(9980));
+    CHECK(store.trip_of(9979) != store.trip_of(9980));
+}
+
+TEST_CASE("Stop sequences beyond 16 bits are kept")
+{
+    stop_time_store store;
+    store.push_back(make_stop_time("T1", "A", 1, "08:00:00", "08:00:00"));
+    store.push_back(make_stop_time("T1", "B", 70000, "08:10:00", "08:10:00"));
+
+    stop_time_store chunk;
+    chunk.push_back(make_stop_time("T1", "C", 70001, "08:20:00", "08:20:00"));
+    chunk.push_back(make_stop_time("T2", "A", 3, "09:00:00", "09:00:00"));
+    store.append(std::move(chunk));
+
+    REQUIRE(store.size() == 4);
+    CHECK(store[0].stop_sequence() == 1);
+    CHECK(store[1].stop_sequence() == 70000);
+    CHECK(store[2].stop_sequence() == 70001);
+    CHECK(store[3].stop_sequence() == 3);
+    CHECK(store[2].trip_id() == "T1");
+    CHECK(store[3].trip_id() == "T2");
+}
+
+TEST_CASE("Stop times are set from several threads")
+{
+    stop_time_store store;
+    constexpr size_t num_threads = 4;
+    constexpr size_t per_thread = 2000;
+    for (size_t i = 0; i < num_threads * per_thread; ++i)
+        store.push_back(make_stop_time("T" + std::to_string(i / 10), "A", i % 10, "08:00:00", "08:00:00"));
+
+    // Like interpolated times, the arrival is set after the old departure first.
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&store, t] {
+            for (size_t i = t * per_thread; i < (t + 1) * per_thread; ++i)
+            {
+                auto st = store[i];
+                st.set_arrival_time(pfaedle::gtfs::time(10 + t, 0, i % 60));
+                st.set_departure_time(pfaedle::gtfs::time(10 + t, 1, i % 60));
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    bool times_match = true;
+    for (size_t i = 0; i < store.size(); ++i)
+    {
+        const size_t t = i / per_thread;
+        times_match = times_match && store[i].arrival_time() == pfaedle::gtfs::time(10 + t, 0, i % 60) &&
+                      store[i].departure_time() == pfaedle::gtfs::time(10 + t, 1, i % 60);
+    }
+    CHECK(times_match);
+}
+
+TEST_CASE("Stop times are linked to their trip and stops")
+{
+    feed feed;
+    for (const char* id : {"A", "B"})
+    {
+        stop s(feed);
+        s.stop_id = id;
+        feed.stops.insert(std::make_pair(s.stop_id, std::move(s)));
+    }
+    trip t(feed);
+    t.trip_id = "T1";
+    feed.trips.insert(std::make_pair(t.trip_id, std::move(t)));
+
+    auto& store = feed.stop_times;
+    store.push_back(make_stop_time("T1", "B", 2, "08:10:00", "08:10:00"));
+    store.push_back(make_stop_time("T1", "C", 3, "08:20:00", "08:20:00"));
+    store.push_back(make_stop_time("T1", "A", 1, "08:00:00", "08:00:00"));
+
+    CHECK_FALSE(store[0].stop().has_value());
+    feed.build();
+
+    const auto trip_stop_times = feed.trips.at("T1").stop_times();
+    REQUIRE(trip_stop_times.size() == 3);
+    CHECK(trip_stop_times[0] == store[2]);
+    CHECK(trip_stop_times[1] == store[0]);
+    CHECK(trip_stop_times[2] == store[1]);
+
+    REQUIRE(trip_stop_times[0].stop().has_value());
+    CHECK(&trip_stop_times[0].stop()->get() == feed.stops.get("A"));
+    CHECK_FALSE(trip_stop_times[2].stop().has_value());
+    REQUIRE(store[1].trip().has_value());
+    CHECK(&store[1].trip()->get() == feed.trips.get("T1"));
+}
@@ -23,6 +23,9 @@ struct config
     std::string outputPath{"gtfs-out"};
     std::string writeOsm;
     std::string osmPath;
+    std::string graphCachePath;
+    std::string routeCachePath;
+    std::string spatialIndex{"grid"};
     std::string evalDfBins;
     std::vector<std::string> feedPaths;
     std::vector<std::string> configPaths;
@@ -32,11 +35,14 @@ struct config
     bool writeGraph{false};
     bool writeCombGraph{false};
     bool evaluate{false};
+    bool evalSingleFile{false};
     bool buildTransitGraph{false};
     bool useCaching{false};
+    bool useHierarchy{false};
     bool writeOverpass{false};
     bool inPlace{false};
     double gridSize{2000};
+    double routeCacheSize{1024};
     bool interpolate_times{false};
     bool import_osm_stops{false};
 
@@ -47,13 +53,19 @@ struct config
            << "output-path: " << outputPath << "\n"
            << "write-osm-path: " << writeOsm << "\n"
            << "read-osm-path: " << osmPath << "\n"
+           << "graph-cache-path: " << graphCachePath << "\n"
            << "debug-output-path: " << dbgOutputPath << "\n"
            << "drop-shapes: " << dropShapes << "\n"
            << "use-hmm: " << useHMM << "\n"
            << "write-graph: " << writeGraph << "\n"
            << "write-cgraph: " << writeCombGraph << "\n"
            << "grid-size: " << gridSize << "\n"
+           << "spatial-index: " << spatialIndex << "\n"
            << "use-cache: " << useCaching << "\n"
+           << "route-cache-path: " << routeCachePath << "\n"
+           << "route-cache-size: " << routeCacheSize << "\n"
+           << "use-hierarchy: " << useHierarchy << "\n"
+           << "eval-single-file: " << evalSingleFile << "\n"
            << "write-overpass: " << writeOverpass << "\n"
            << "interpolate-times: " << interpolate_times << "\n"
            << "import-osm-stops: " << import_osm_stops << "\n"
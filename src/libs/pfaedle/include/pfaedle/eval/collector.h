@@ -8,35 +8,58 @@
 #include "pfaedle/definitions.h"
 #include "pfaedle/eval/result.h"
 #include "util/geo/Geo.h"
+#include <gtfs/shape.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
 #include <map>
+#include <mutex>
 #include <ostream>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
 namespace pfaedle::gtfs
 {
 struct trip;
-struct shape;
 }
 namespace pfaedle::eval
 {
 
 /*
- * Collects routing results for evaluation
+ * Collects routing results for evaluation. The results are evaluated by
+ * worker threads of the collector while the matching goes on, the matching
+ * threads only hand them over through a bounded queue. Every worker keeps
+ * its own results, they are merged by finish()
  */
 class collector
 {
 public:
-    collector(const std::string& evalOutPath, const std::vector<double>& dfBins);
-
-    // Add a shape found by our tool newS for a trip t with newly calculated
-    // station dist values with the old shape oldS
-    double add(const gtfs::trip& t,
-               const gtfs::shape* oldS,
-               const gtfs::shape& newS,
-               const std::vector<double>& newDists);
+    // The shapes are evaluated by numThreads worker threads. If singleFile is
+    // set, the old and new geometries of all trips are written to
+    // evalOutPath/eval-trips.json instead of one file per trip
+    collector(const std::string& evalOutPath, const std::vector<double>& dfBins, bool singleFile,
+              size_t numThreads);
+    ~collector();
+
+    collector(const collector&) = delete;
+    collector& operator=(const collector&) = delete;
+
+    // Add a shape found by our tool newS for the trips ts with newly
+    // calculated station dist values, to be compared with their old shapes
+    // oldS. The stop times of the trips are read before this returns, they
+    // may be changed afterwards. Blocks while the queue is full
+    void add(const std::vector<gtfs::trip*>& ts,
+             const std::vector<const gtfs::shape*>& oldS,
+             const gtfs::shape& newS,
+             const std::vector<double>& newDists);
+
+    // Wait until all added shapes are evaluated and merge the results of the
+    // workers. Rethrows the first exception of a worker
+    void finish();
 
     // Return the set of all Result objects
     const std::set<result>& get_results() const;
@@ -57,20 +80,69 @@ public:
     static LINE get_web_merc_line(const gtfs::shape* s, double from, double to, std::vector<double>& dists);
 
 private:
+    // what is needed of a trip and its stop times
+    struct trip_stops
+    {
+        const gtfs::trip* trip;
+        const gtfs::shape* oldS;
+        // false if there is no old shape or a stop time without dist value
+        bool comparable;
+        double from;
+        double to;
+        // the position of every stop and its old dist value
+        std::vector<std::pair<POINT, double>> cuts;
+    };
+
+    struct job
+    {
+        gtfs::shape newS;
+        std::vector<double> newDists;
+        std::vector<trip_stops> trips;
+    };
+
+    // the results of one worker
+    struct buffer
+    {
+        std::vector<result> results;
+        std::vector<result> resultsAN;
+        std::vector<result> resultsAL;
+        size_t noOrigShp = 0;
+        double fdSum = 0;
+        size_t unmatchedSegSum = 0;
+        double unmatchedSegLengthSum = 0;
+        // features for the single trip file not written yet
+        std::string features;
+    };
+
+    void start();
+    void stop();
+    void work(buffer& b);
+    void evaluate(const job& j, buffer& b) const;
+    void write_features(buffer& b, bool force);
+
+    static void print_feature(std::ostream& os, const LINE& l, const std::string& tripId, const std::string& ver);
+
     static std::pair<size_t, double> get_da(const std::vector<LINE>& a,
                                            const std::vector<LINE>& b);
 
-    static std::vector<LINE> segmentize(const gtfs::trip& t, const LINE& shape,
+    static std::vector<LINE> segmentize(const LINE& shape,
                                         const std::vector<double>& dists,
-                                        const std::vector<double>* newTripDists);
+                                        const std::vector<std::pair<POINT, double>>& cuts);
 
     static std::vector<double> get_bins(double mind, double maxd, size_t steps);
 
+    // the band of q a point of p may be matched to in the frechet distance: the
+    // points of the stop segments before, at and after its own. pIdx and qIdx
+    // are the positions of the points of a and b in p and q
+    static util::geo::FrechetBand get_band(const std::vector<LINE>& a,
+                                           const std::vector<LINE>& b,
+                                           const std::vector<size_t>& pIdx,
+                                           const std::vector<size_t>& qIdx,
+                                           size_t pSize, size_t qSize);
+
     std::set<result> _results;
     std::set<result> _resultsAN;
     std::set<result> _resultsAL;
-    std::map<const gtfs::shape*, std::map<std::string, double>> _dCache;
-    std::map<const gtfs::shape*, std::map<std::string, std::pair<size_t, double>>> _dACache;
     size_t _noOrigShp;
 
     double _fdSum;
@@ -80,6 +152,26 @@ private:
     std::string _evalOutPath;
 
     std::vector<double> _dfBins;
+
+    bool _singleFile;
+    size_t _numThreads;
+
+    // guarded by _queueMutex
+    std::deque<job> _queue;
+    bool _closed;
+    std::exception_ptr _error;
+    std::mutex _queueMutex;
+    std::condition_variable _queueNotEmpty;
+    std::condition_variable _queueNotFull;
+    size_t _queueSize;
+
+    std::vector<std::thread> _workers;
+    std::vector<buffer> _buffers;
+
+    // guarded by _tripsMutex
+    std::ofstream _tripsOut;
+    bool _tripsEmpty;
+    std::mutex _tripsMutex;
 };
 
 }  // namespace pfaedle
@@ -0,0 +1,63 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_OSM_GRAPHCACHE_H_
+#define PFAEDLE_OSM_GRAPHCACHE_H_
+
+#include "pfaedle/osm/bounding_box.h"
+#include "pfaedle/osm/osm_read_options.h"
+#include "pfaedle/router/misc.h"
+#include "pfaedle/trgraph/graph.h"
+#include "pfaedle/trgraph/restrictor.h"
+
+#include <string>
+
+namespace pfaedle::osm
+{
+
+/*
+ * On-disk snapshots of transit graphs as they are read from an OSM file,
+ * before any GTFS station is snapped into them. A snapshot is keyed by the
+ * OSM file (path, size and modification time), the read options that shape
+ * the graph, the bounding box and the grid size, so a changed GTFS feed with
+ * the same extent can skip reading the OSM file entirely
+ */
+class graph_cache
+{
+public:
+    // Snapshots are stored in the directory at path, which is created if it
+    // does not exist yet
+    explicit graph_cache(const std::string& path);
+
+    // Return the key of the graph read from the OSM file at osmPath with the
+    // given options, or an empty string if the file cannot be accessed
+    std::string get_key(const std::string& osmPath,
+                        const osm_read_options& opts,
+                        const bounding_box& box,
+                        size_t gridSize,
+                        bool packedIndex) const;
+
+    // Read the snapshot stored under key into the empty graph g, restrictor
+    // res and orphanStations. Return false if there is no usable snapshot,
+    // the outputs are left empty in that case
+    bool load(const std::string& key,
+              trgraph::graph& g,
+              trgraph::restrictor& res,
+              router::node_set& orphanStations) const;
+
+    // Write a snapshot of g, res and orphanStations under key. Failures are
+    // logged, but are not fatal
+    void store(const std::string& key,
+               const trgraph::graph& g,
+               const trgraph::restrictor& res,
+               const router::node_set& orphanStations) const;
+
+private:
+    std::string _path;
+
+    std::string get_file_path(const std::string& key) const;
+};
+}  // namespace pfaedle::osm
+
+#endif  // PFAEDLE_OSM_GRAPHCACHE_H_
@@ -7,9 +7,11 @@
 
 #include <pfaedle/definitions.h>
 #include <pfaedle/osm/bounding_box.h>
+#include <pfaedle/osm/graph_cache.h>
 #include <pfaedle/osm/osm_filter.h>
 #include <pfaedle/osm/osm_id_set.h>
 #include <pfaedle/osm/osm_read_options.h>
+#include <pfaedle/osm/osm_reader.h>
 #include <pfaedle/router/router.h>
 #include <pfaedle/trgraph/graph.h>
 #include <pfaedle/trgraph/node_payload.h>
@@ -19,6 +21,7 @@
 #include <util/geo/Geo.h>
 #include <util/xml/XmlWriter.h>
 
+#include <functional>
 #include <map>
 #include <queue>
 #include <set>
@@ -28,12 +31,6 @@
 #include <vector>
 #include <optional>
 
-namespace pugi
-{
-class xml_document;
-class xml_node;
-}  // namespace pugi
-
 namespace pfaedle::gtfs
 {
 struct stop;
@@ -72,6 +69,54 @@ struct block_search_functor : public search_functor
     }
 };
 
+/*
+ * An edge snap_station() tries a station on, with the results of the depth
+ * searches from the position of the station projected onto it
+ */
+struct snap_candidate
+{
+    trgraph::edge* e;
+    POINT geom;
+    trgraph::node* eq;
+    // only searched for if there is no eq and the level of e may be snapped to
+    bool blocked;
+};
+
+/*
+ * What snap_station() reads from the graph for a station and a snap distance.
+ * Making a plan does not change the graph, and the plan stays valid as long as
+ * neither the station nor anything in region changes
+ */
+struct snap_plan
+{
+    // the station the plan was made for
+    POINT geom;
+    std::string name;
+    std::vector<std::string> altNames;
+
+    double maxD = 0;
+    bool orphSnap = false;
+    // in import mode, the OSM station whose info is taken over
+    const trgraph::node* best = nullptr;
+    std::vector<snap_candidate> candidates;
+    // where the candidates and stations were looked up
+    BOX lookup;
+    // the lookup and everything the depth searches may read
+    BOX region;
+};
+
+/*
+ * A call of snap_station() with either a payload that is kept between calls or
+ * a copy of the payload of an OSM station
+ */
+struct snap_call
+{
+    trgraph::node_payload* pl;
+    const trgraph::node* station;
+    double maxD;
+    bool surHeur;
+};
+
 inline bool operator<(const NodeCand& a, const NodeCand& b)
 {
     return a.fullTurns > b.fullTurns || a.dist > b.dist;
@@ -79,6 +124,18 @@ inline bool operator<(const NodeCand& a, const NodeCand& b)
 
 using node_candidate_priority_queue = std::priority_queue<NodeCand>;
 
+/*
+ * The graph to build for a single configuration when reading an OSM file for
+ * multiple configurations at once
+ */
+struct osm_read_job
+{
+    const osm_read_options& opts;
+    trgraph::graph& g;
+    router::feed_stops& fs;
+    trgraph::restrictor& res;
+};
+
 /*
  * Builds a physical transit network graph from OSM data
  */
@@ -88,16 +145,30 @@ public:
     osm_builder();
 
     // Read the OSM file at path, and write a graph to g. Only elements
-    // inside the bounding box will be read
+    // inside the bounding box will be read. Edges and nodes are looked up in
+    // grids of gridSize cells, or in packed R-trees if packedIndex is set
     void read(const std::string& path,
               const osm_read_options& opts,
               trgraph::graph& g,
               const bounding_box& box,
               size_t gridSize,
+              bool packedIndex,
               router::feed_stops& fs,
               trgraph::restrictor& res,
               bool import_osm_stations);
 
+    // Read the OSM file at path once and build the graph of every job from
+    // it. Only elements inside the bounding box will be read. The graphs are
+    // post-processed in parallel. If cache is given, jobs with a snapshot in
+    // the cache are not read from the OSM file, the others are stored there
+    static void read(const std::string& path,
+                     const std::vector<osm_read_job>& jobs,
+                     const bounding_box& box,
+                     size_t gridSize,
+                     bool packedIndex,
+                     bool import_osm_stations,
+                     const graph_cache* cache);
+
     // Based on the list of options, output an overpass XML query for getting
     // the data needed for routing
     void overpass_query_write(std::ostream& out,
@@ -113,81 +184,119 @@ public:
                       const bounding_box& box);
 
 private:
-    int filter_nodes(pugi::xml_document& xml,
-                     osm_id_set& nodes,
+    // per-job state of the read passes
+    struct read_state
+    {
+        explicit read_state(const osm_read_job& job);
+
+        const osm_read_job& job;
+        osm_filter filter;
+        std::vector<attribute_key_set> attr_keys;
+
+        osm_id_set noHupNodes;
+        node_id_map nodes;
+        node_id_multimap multNodes;
+        relation_list rels;
+        relation_map nodeRels;
+        relation_map wayRels;
+        restrictions rawRests;
+        station_attribute_groups attrGroups;
+
+        router::node_set orphanStations;
+        edge_tracks eTracks;
+    };
+
+    // Apply the edge tracks, fix gaps and write the edge geometries of a
+    // freshly read graph. Everything up to here only depends on the OSM data
+    static void prepare_graph(trgraph::graph& g,
+                              const bounding_box& bbox,
+                              size_t gridSize,
+                              bool packedIndex,
+                              const edge_tracks& eTracks);
+
+    // Run all remaining steps on a prepared graph, from snapping the GTFS
+    // stations to writing the self edges
+    static void build_graph(const osm_read_job& job,
+                            const bounding_box& bbox,
+                            size_t gridSize,
+                            bool packedIndex,
+                            const router::node_set& orphanStations,
+                            bool import_osm_stations);
+
+    void filter_node(const osm_raw_element& nd,
                      osm_id_set& noHupNodes,
-                     const osm_filter& filter,
-                     const bounding_box& bbox) const;
+                     const osm_filter& filter) const;
 
-    void read_relations(pugi::xml_document& xml,
-                        relation_list& rels,
-                        relation_map& nodeRels,
-                        relation_map& wayRels,
-                        const osm_filter& filter,
-                        const attribute_key_set& keepAttrs,
-                        restrictions& rests) const;
+    void read_relation(const osm_raw_element& el,
+                       relation_list& rels,
+                       relation_map& nodeRels,
+                       relation_map& wayRels,
+                       const osm_filter& filter,
+                       const attribute_key_set& keepAttrs,
+                       restrictions& rests) const;
 
     void read_restrictions(const osm_relation& rel,
                            restrictions& rests,
                            const osm_filter& filter) const;
 
-    void read_nodes(pugi::xml_document& xml,
-                    trgraph::graph& g,
-                    const relation_list& rels,
-                    const relation_map& nodeRels,
-                    const osm_filter& filter,
-                    const osm_id_set& bBoxNodes,
-                    node_id_map& nodes,
-                    node_id_multimap& multNodes,
-                    router::node_set& orphanStations,
-                    const attribute_key_set& keepAttrs,
-                    const flat_relations& fl,
-                    const osm_read_options& opts) const;
-
-    void read_write_nodes(pugi::xml_document& i,
-                          pugi::xml_node& o,
-                          const relation_map& nRels,
-                          const osm_filter& filter,
-                          const osm_id_set& bBoxNds,
-                          node_id_map& nds,
-                          const attribute_key_set& keepAttrs,
-                          const flat_relations& f) const;
-
-    void read_write_ways(pugi::xml_document& i,
-                         pugi::xml_node& o,
-                         osmid_list& ways,
-                         const attribute_key_set& keepAttrs) const;
-
-    void read_write_relations(pugi::xml_document& i,
-                              pugi::xml_node& o,
-                              osmid_list& ways,
-                              node_id_map& nodes,
-                              const osm_filter& filter,
-                              const attribute_key_set& keepAttrs);
-
-    void read_edges(pugi::xml_document& xml,
-                    trgraph::graph& g, const relation_list& rels,
-                    const relation_map& wayRels,
-                    const osm_filter& filter,
-                    const osm_id_set& bBoxNodes,
-                    node_id_map& nodes,
-                    node_id_multimap& multNodes,
-                    const osm_id_set& noHupNodes,
-                    const attribute_key_set& keepAttrs,
-                    const restrictions& rest,
-                    trgraph::restrictor& restor,
-                    const flat_relations& flatRels,
-                    edge_tracks& etracks,
-                    const osm_read_options& opts);
-
-    void read_ways(pugi::xml_document& xml,
-                    const relation_map& wayRels,
-                    const osm_filter& filter,
-                    const osm_id_set& bBoxNodes,
-                    const attribute_key_set& keepAttrs,
-                    osmid_list& ret,
-                    node_id_map& nodes,
-                    const flat_relations& flatRels);
+    void read_node(const osm_raw_element& el,
+                   trgraph::graph& g,
+                   const relation_list& rels,
+                   const relation_map& nodeRels,
+                   const osm_filter& filter,
+                   const osm_id_set& bBoxNodes,
+                   node_id_map& nodes,
+                   node_id_multimap& multNodes,
+                   router::node_set& orphanStations,
+                   station_attribute_groups& attrGroups,
+                   const attribute_key_set& keepAttrs,
+                   const flat_relations& fl,
+                   const osm_read_options& opts) const;
+
+    void read_write_node(const osm_raw_element& el,
+                         util::xml::XmlWriter& o,
+                         const relation_map& nRels,
+                         const osm_filter& filter,
+                         const osm_id_set& bBoxNds,
+                         node_id_map& nds,
+                         const attribute_key_set& keepAttrs,
+                         const flat_relations& f) const;
+
+    void read_write_way(const osm_raw_element& el,
+                        util::xml::XmlWriter& o,
+                        const osmid_list& ways,
+                        const attribute_key_set& keepAttrs) const;
+
+    void read_write_relation(const osm_raw_element& el,
+                             util::xml::XmlWriter& o,
+                             const osmid_list& ways,
+                             const node_id_map& nodes,
+                             const osm_filter& filter,
+                             const attribute_key_set& keepAttrs) const;
+
+    void read_edge(const osm_raw_element& el,
+                   trgraph::graph& g, const relation_list& rels,
+                   const relation_map& wayRels,
+                   const osm_filter& filter,
+                   const osm_id_set& bBoxNodes,
+                   node_id_map& nodes,
+                   node_id_multimap& multNodes,
+                   const osm_id_set& noHupNodes,
+                   const attribute_key_set& keepAttrs,
+                   const restrictions& rest,
+                   trgraph::restrictor& restor,
+                   const flat_relations& flatRels,
+                   edge_tracks& etracks,
+                   const osm_read_options& opts);
+
+    void read_way(const osm_raw_element& el,
+                  const relation_map& wayRels,
+                  const osm_filter& filter,
+                  const osm_id_set& bBoxNodes,
+                  const attribute_key_set& keepAttrs,
+                  osmid_list& ret,
+                  node_id_map& nodes,
+                  const flat_relations& flatRels) const;
 
     bool keep_way(const osm_way& w, const relation_map& wayRels, const osm_filter& filter,
                   const osm_id_set& bBoxNodes, const flat_relations& fl) const;
@@ -207,6 +316,7 @@ private:
                            trgraph::graph& g,
                            const bounding_box& bbox,
                            size_t gridSize,
+                           bool packedIndex,
                            router::feed_stops& fs,
                               trgraph::restrictor& res,
                            const router::node_set& orphanStations,
@@ -226,6 +336,39 @@ private:
                                          double maxD,
                                          bool import_osm_stations);
 
+    static snap_plan plan_snap(const trgraph::node_payload& s,
+                               trgraph::edge_grid& eg,
+                               trgraph::node_grid& sng,
+                               const osm_read_options& opts,
+                               bool surHeur,
+                               bool orphSnap,
+                               double maxD,
+                               bool import_osm_stations);
+
+    // Applies the plan to the graph, with the same result as snap_station() if
+    // changed holds the bounding boxes of everything that changed since the plan
+    // was made outside of its lookup. The boxes of the changes are added to it
+    static router::node_set commit_snap(trgraph::graph& g,
+                                        trgraph::node_payload& s,
+                                        const snap_plan& plan,
+                                        trgraph::edge_grid& eg,
+                                        trgraph::node_grid& sng,
+                                        const osm_read_options& opts,
+                                        trgraph::restrictor& restor,
+                                        std::vector<BOX>* changed);
+
+    // Makes the calls to snap_station() in order, but plans them in parallel
+    // batches. snapped(i, pl, nodes) is called after call i
+    static void snap_in_batches(trgraph::graph& g,
+                                const std::vector<snap_call>& calls,
+                                trgraph::edge_grid& eg,
+                                trgraph::node_grid& sng,
+                                const osm_read_options& opts,
+                                trgraph::restrictor& restor,
+                                bool import_osm_stations,
+                                const std::function<void(size_t, trgraph::node_payload&,
+                                                         const router::node_set&)>& snapped);
+
     // Checks if from the edge e, a station similar to si can be reach with less
     // than maxD distance and less or equal to "maxFullTurns" full turns. If
     // such a station exists, it is returned. If not, 0 is returned.
@@ -0,0 +1,46 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_OSM_OSMPBFREADER_H_
+#define PFAEDLE_OSM_OSMPBFREADER_H_
+
+#include "pfaedle/osm/osm_reader.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace pfaedle::osm
+{
+
+/*
+ * Streams entities from an OSM PBF file. Blocks are read sequentially in
+ * batches, decompressed and decoded in parallel and then handed out in file
+ * order, so only one batch of blocks is held in memory at any time
+ */
+class osm_pbf_reader : public osm_reader
+{
+public:
+    explicit osm_pbf_reader(const std::string& path);
+
+    bool read(osm_raw_element& e) override;
+    void rewind() override;
+
+private:
+    std::string _path;
+    std::ifstream _file;
+
+    std::vector<std::vector<osm_raw_element>> _blocks;
+    size_t _curBlock;
+    size_t _curElem;
+
+    // read the next file block of type OSMData into blob, return false at EOF
+    bool read_data_blob(std::string& blob);
+
+    // read and decode the next batch of blocks, return false at EOF
+    bool read_batch();
+};
+}  // namespace pfaedle::osm
+
+#endif  // PFAEDLE_OSM_OSMPBFREADER_H_
@@ -0,0 +1,85 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_OSM_OSMREADER_H_
+#define PFAEDLE_OSM_OSMREADER_H_
+
+#include "pfaedle/osm/osm.h"
+#include "util/xml/XmlReader.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace pfaedle::osm
+{
+
+enum class osm_element_type
+{
+    NODE,
+    WAY,
+    RELATION
+};
+
+struct osm_raw_member
+{
+    osm_element_type type;
+    osmid ref;
+    std::string role;
+};
+
+/*
+ * A single OSM entity exactly as it appears in the input, with all of its
+ * tags. Only the fields matching type are set.
+ */
+struct osm_raw_element
+{
+    osm_element_type type;
+    osmid id;
+    double lat;
+    double lng;
+    std::vector<attribute> tags;
+    osmid_list nodes;
+    std::vector<osm_raw_member> members;
+};
+
+/*
+ * Sequential source of OSM entities. Every pass of the osm_builder rewinds
+ * the reader and streams the input once, so the memory needed for reading
+ * does not depend on the size of the input
+ */
+class osm_reader
+{
+public:
+    virtual ~osm_reader() = default;
+
+    // Open the OSM file at path, files ending in .pbf are read as OSM PBF,
+    // everything else as OSM XML
+    static std::unique_ptr<osm_reader> from_file(const std::string& path);
+
+    // Read the next entity into e, return false at the end of the input
+    virtual bool read(osm_raw_element& e) = 0;
+
+    // Start again at the beginning of the input
+    virtual void rewind() = 0;
+};
+
+/*
+ * Streams entities from an OSM XML file
+ */
+class osm_xml_reader : public osm_reader
+{
+public:
+    explicit osm_xml_reader(const std::string& path);
+
+    bool read(osm_raw_element& e) override;
+    void rewind() override;
+
+private:
+    util::xml::XmlReader _xml;
+    bool _more;
+};
+}  // namespace pfaedle::osm
+
+#endif  // PFAEDLE_OSM_OSMREADER_H_
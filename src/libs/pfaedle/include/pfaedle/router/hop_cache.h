@@ -0,0 +1,130 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_ROUTER_HOPCACHE_H_
+#define PFAEDLE_ROUTER_HOPCACHE_H_
+
+#include "pfaedle/router/misc.h"
+#include "pfaedle/router/routing_attributes.h"
+#include "pfaedle/trgraph/csr_graph.h"
+#include "pfaedle/trgraph/restrictor.h"
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pfaedle::router
+{
+
+/*
+ * Hop results of a router, shared by all threads. Hops are keyed by the id
+ * of their routing attributes and the csr graph ids of their first and last
+ * edge. The cache is split into shards with a lock each, every shard evicts
+ * its least recently used hops once it grows beyond its share of the memory
+ * limit
+ */
+class hop_cache
+{
+public:
+    // A cache using about maxBytes of memory at most
+    explicit hop_cache(size_t maxBytes);
+
+    // Return the id of rAttrs, ids are assigned on first use. This locks, so
+    // resolve it once per route and not per hop
+    uint32_t get_attr_id(const routing_attributes& rAttrs);
+
+    // Look up the hop from -> to under the attributes with id attr. On a
+    // hit, write its cost to c and its edges to edges and return true
+    bool get(uint32_t attr, trgraph::csr_graph::id from, trgraph::csr_graph::id to,
+             edge_cost& c, std::vector<trgraph::csr_graph::id>& edges);
+
+    // Store the hop from -> to under the attributes with id attr
+    void put(uint32_t attr, trgraph::csr_graph::id from, trgraph::csr_graph::id to,
+             const edge_cost& c, const std::vector<trgraph::csr_graph::id>& edges);
+
+    // Return the number of cached hops
+    size_t size() const;
+
+    // Return the key of hop results on the graph g, or an empty string if
+    // the ids of g are not stable across runs
+    static std::string get_key(const trgraph::csr_graph& g,
+                               const trgraph::restrictor& res,
+                               const routing_options& rOpts);
+
+    // Add the hops stored under key in the directory at path. Return false
+    // if there are none, or if they cannot be read
+    bool load(const std::string& path, const std::string& key, size_t numEdges);
+
+    // Write all hops under key to the directory at path, which is created if
+    // it does not exist yet. Failures are logged, but are not fatal
+    void store(const std::string& path, const std::string& key) const;
+
+private:
+    struct hop_key
+    {
+        uint32_t attr;
+        trgraph::csr_graph::id from;
+        trgraph::csr_graph::id to;
+
+        bool operator==(const hop_key& o) const
+        {
+            return attr == o.attr && from == o.from && to == o.to;
+        }
+    };
+
+    struct hop_key_hash
+    {
+        size_t operator()(const hop_key& k) const
+        {
+            uint64_t h = (static_cast<uint64_t>(k.from) << 32) | k.to;
+            h ^= static_cast<uint64_t>(k.attr) * 0x9E3779B97F4A7C15ULL;
+            h ^= h >> 31;
+            h *= 0xBF58476D1CE4E5B9ULL;
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+    };
+
+    // the edges of a hop are a range in the arena of its shard
+    struct hop
+    {
+        hop_key key;
+        double cost;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct shard
+    {
+        std::mutex mutex;
+        std::list<hop> lru;
+        std::unordered_map<hop_key, std::list<hop>::iterator, hop_key_hash> index;
+        std::vector<trgraph::csr_graph::id> arena;
+        size_t garbage = 0;
+        size_t bytes = 0;
+    };
+
+    static const size_t NUM_SHARDS = 64;
+
+    std::vector<std::unique_ptr<shard>> _shards;
+    size_t _maxShardBytes;
+
+    mutable std::mutex _attrMutex;
+    std::map<routing_attributes, uint32_t> _attrIds;
+    std::vector<routing_attributes> _attrs;
+
+    shard& get_shard(const hop_key& k) const;
+
+    // expect the mutex of s to be held
+    static void evict(shard& s);
+    static void compact(shard& s);
+    static size_t hop_bytes(size_t length);
+};
+}  // namespace pfaedle::router
+
+#endif  // PFAEDLE_ROUTER_HOPCACHE_H_
@@ -7,16 +7,20 @@
 
 #include "pfaedle/definitions.h"
 #include "pfaedle/router/graph.h"
+#include "pfaedle/router/hop_cache.h"
 #include "pfaedle/router/misc.h"
 #include "pfaedle/router/routing_attributes.h"
+#include "pfaedle/trgraph/csr_graph.h"
 #include "pfaedle/trgraph/graph.h"
 #include "pfaedle/trgraph/restrictor.h"
 #include "util/geo/Geo.h"
+#include "util/graph/CsrHierarchy.h"
 #include "util/graph/Dijkstra.h"
 #include "util/graph/EDijkstra.h"
 
 #include <limits>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <string>
@@ -28,10 +32,6 @@ namespace pfaedle::router
 {
 using CombNodeMap = std::unordered_map<const trgraph::edge*, router::node*>;
 using HId = std::pair<size_t, size_t>;
-using Cache = std::map<
-            routing_attributes,
-            std::unordered_map<const trgraph::edge*,std::unordered_map<const trgraph::edge*, std::pair<edge_cost, edge_list>>>
-        >;
 
 struct HopBand
 {
@@ -43,15 +43,17 @@ struct HopBand
 
 struct CostFunc : public util::graph::EDijkstra::CostFunc<trgraph::node_payload, trgraph::edge_payload, edge_cost>
 {
-    CostFunc(const routing_attributes& rAttrs, const routing_options& rOpts,
-             const trgraph::restrictor& res, const trgraph::station_group* tgGrp,
-             double max) :
+    CostFunc(const trgraph::csr_graph& g, const routing_attributes& rAttrs,
+             const routing_options& rOpts, const trgraph::restrictor& res,
+             const trgraph::station_group* tgGrp, double max) :
+        _g(g),
         _rAttrs(rAttrs),
         _rOpts(rOpts),
         _res(res),
         _tgGrp(tgGrp),
         _inf(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, max, nullptr) {}
 
+    const trgraph::csr_graph& _g;
     const routing_attributes& _rAttrs;
     const routing_options& _rOpts;
     const trgraph::restrictor& _res;
@@ -60,9 +62,15 @@ struct CostFunc : public util::graph::EDijkstra::CostFunc<trgraph::node_payload,
 
     edge_cost operator()(const trgraph::edge* from, const trgraph::node* n,
                         const trgraph::edge* to) const override;
+
+    // Same as above, but on the ids of the csr graph
+    edge_cost operator()(trgraph::csr_graph::id from, trgraph::csr_graph::id n,
+                        trgraph::csr_graph::id to) const;
+
     edge_cost inf() const override { return _inf; }
 
     double transitLineCmp(const trgraph::edge_payload& e) const;
+    double transitLineCmp(const trgraph::line_span& lines) const;
 };
 
 struct NCostFunc : public util::graph::Dijkstra::CostFunc<trgraph::node_payload, trgraph::edge_payload, edge_cost>
@@ -89,15 +97,19 @@ struct NCostFunc : public util::graph::Dijkstra::CostFunc<trgraph::node_payload,
 
 struct DistHeur : public util::graph::EDijkstra::HeurFunc<trgraph::node_payload, trgraph::edge_payload, edge_cost>
 {
-    DistHeur(uint8_t minLvl, const routing_options& rOpts,
-             const std::set<trgraph::edge*>& tos);
+    DistHeur(const trgraph::csr_graph& g, uint8_t minLvl,
+             const routing_options& rOpts, const std::set<trgraph::edge*>& tos);
 
+    const trgraph::csr_graph& _g;
     const routing_options& _rOpts;
     uint8_t _lvl;
     POINT _center;
     double _maxCentD;
     edge_cost operator()(const trgraph::edge* a,
                         const std::set<trgraph::edge*>& b) const override;
+
+    // Same as above, but on the ids of the csr graph
+    edge_cost operator()(trgraph::csr_graph::id a) const;
 };
 
 struct NDistHeur : public util::graph::Dijkstra::HeurFunc<trgraph::node_payload, trgraph::edge_payload, edge_cost>
@@ -130,9 +142,10 @@ struct CombCostFunc : public util::graph::EDijkstra::CostFunc<router::node_paylo
 class router
 {
 public:
-    // Init this router with caches for numThreads threads
-    explicit router(size_t numThreads, bool caching);
-    ~router();
+    // Init this router on the frozen graph g for numThreads threads. If
+    // caching is enabled, the threads share a hop cache of cacheBytes bytes
+    router(const trgraph::csr_graph& g, size_t numThreads, bool caching,
+           size_t cacheBytes);
 
     // Find the most likely path through the graph for a node candidate route.
     edge_list_hops route(const node_candidate_route& route, const routing_attributes& rAttrs,
@@ -163,37 +176,63 @@ public:
                               const routing_options& rOpts,
                               const trgraph::restrictor& rest) const;
 
-    // Return the number of thread caches this router was initialized with
-    size_t getCacheNumber() const;
+    // Return the number of threads this router was initialized for
+    size_t getNumThreads() const;
+
+    // Add the hops stored under key in the directory at path to the cache
+    bool load_cache(const std::string& path, const std::string& key);
+
+    // Write the cached hops under key to the directory at path
+    void store_cache(const std::string& path, const std::string& key) const;
+
+    // Contract the graph for hop searches under rOpts and rest. Hops of
+    // trips without line information are then searched on the hierarchy
+    void build_hierarchy(const routing_options& rOpts, const trgraph::restrictor& rest);
 
 private:
-    mutable std::vector<Cache*> _cache;
+    const trgraph::csr_graph& _g;
+    size_t _numThreads;
     bool _caching;
+    mutable hop_cache _cache;
+
+    std::unique_ptr<util::graph::CsrHierarchy> _hierarchy;
+    routing_options _hierarchyOpts;
+    const trgraph::restrictor* _hierarchyRes;
 
     HopBand getHopBand(const edge_candidate_group& a, const edge_candidate_group& b,
-                       const routing_attributes& rAttrs, const routing_options& rOpts,
+                       const routing_attributes& rAttrs, uint32_t attr,
+                       const routing_options& rOpts,
                        const trgraph::restrictor& rest) const;
 
-    void hops(trgraph::edge* from, const std::set<trgraph::edge*>& froms,
-              const std::set<trgraph::edge*> to, const trgraph::station_group* tgGrp,
-              const std::unordered_map<trgraph::edge*, edge_list*>& edgesRet,
-              std::unordered_map<trgraph::edge*, edge_cost>* rCosts,
-              const routing_attributes& rAttrs, const routing_options& rOpts,
+    // Compute the hops from every edge in froms to all edges in tos. The
+    // results of the i-th edge in froms go to edgesRet[i] and rCosts[i]. Cached
+    // hops are looked up under attr, the cache id of rAttrs
+    void hops(const std::set<trgraph::edge*>& froms,
+              const std::set<trgraph::edge*>& tos, const trgraph::station_group* tgGrp,
+              const std::vector<std::unordered_map<trgraph::edge*, edge_list*>>& edgesRet,
+              std::vector<std::unordered_map<trgraph::edge*, edge_cost>>* rCosts,
+              const routing_attributes& rAttrs, uint32_t attr,
+              const routing_options& rOpts,
               const trgraph::restrictor& rest, HopBand hopB) const;
 
     std::set<trgraph::edge*> getCachedHops(
             trgraph::edge* from, const std::set<trgraph::edge*>& to,
             const std::unordered_map<trgraph::edge*, edge_list*>& edgesRet,
             std::unordered_map<trgraph::edge*, edge_cost>* rCosts,
-            const routing_attributes& rAttrs) const;
+            uint32_t attr) const;
 
     void cache(trgraph::edge* from, trgraph::edge* to, const edge_cost& c,
-               edge_list* edges, const routing_attributes& rAttrs) const;
+               edge_list* edges, uint32_t attr) const;
 
     void nestedCache(const edge_list* el, const std::set<trgraph::edge*>& froms,
-                     const CostFunc& cost, const routing_attributes& rAttrs) const;
+                     const CostFunc& cost, uint32_t attr) const;
 
     bool compConned(const edge_candidate_group& a, const edge_candidate_group& b) const;
+
+    bool useHierarchy(const std::vector<trgraph::csr_graph::id>& froms,
+                      const std::vector<std::vector<trgraph::csr_graph::id>>& tos,
+                      const routing_attributes& rAttrs, const routing_options& rOpts,
+                      const trgraph::restrictor& rest) const;
 };
 }  // namespace pfaedle
 
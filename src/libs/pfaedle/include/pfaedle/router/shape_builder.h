@@ -12,13 +12,14 @@
 #include <pfaedle/netgraph/graph.h>
 #include <pfaedle/router/misc.h>
 #include <pfaedle/router/router.h>
+#include <pfaedle/trgraph/csr_graph.h>
 #include <pfaedle/trgraph/graph.h>
 #include <pfaedle/trgraph/restrictor.h>
 
 #include <gtfs/trip.h>
 #include <util/geo/Geo.h>
 
-#include <mutex>
+#include <atomic>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -61,7 +62,8 @@ public:
                   trgraph::graph& graph,
                   feed_stops& stops,
                   trgraph::restrictor& restr,
-                  const config::config& cfg);
+                  const config::config& cfg,
+                  size_t numThreads);
 
     void get_shape(pfaedle::netgraph::graph& ng);
 
@@ -123,20 +125,21 @@ private:
     eval::collector& _ecoll;
     const config::config& _cfg;
     trgraph::graph& _g;
+    trgraph::csr_graph _csr;
     router _crouter;
 
     feed_stops& _stops;
 
     node_candidate_group _emptyNCG;
 
-    size_t _curShpCnt;
+    std::atomic<size_t> _curShpCnt;
     size_t _numThreads;
 
-    std::mutex _shpMutex;
-
     trip_routing_attributes _rAttrs;
 
     trgraph::restrictor& _restr;
+
+    std::string _routeCacheKey;
 };
 }  // namespace pfaedle::router
 
@@ -0,0 +1,107 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef PFAEDLE_TRGRAPH_CSRGRAPH_H_
+#define PFAEDLE_TRGRAPH_CSRGRAPH_H_
+
+#include "pfaedle/definitions.h"
+#include "pfaedle/trgraph/graph.h"
+#include "util/graph/CsrGraph.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace pfaedle::trgraph
+{
+
+/*
+ * The transit lines of a single edge in a csr_graph
+ */
+struct line_span
+{
+    const transit_edge_line* const* first;
+    const transit_edge_line* const* last;
+
+    const transit_edge_line* const* begin() const { return first; }
+    const transit_edge_line* const* end() const { return last; }
+    bool empty() const { return first == last; }
+};
+
+/*
+ * A frozen, read-only copy of a transit graph in compressed sparse row
+ * layout. Everything the router needs per node and per edge is held in
+ * contiguous arrays indexed by id. The graph it was built from must outlive
+ * it and must not be changed anymore.
+ *
+ * Nodes are numbered by their position and edges by their target, so the
+ * same graph built twice gets the same ids, unless it has indistinguishable
+ * nodes or edges
+ */
+class csr_graph
+{
+public:
+    using id = util::graph::CsrGraph::Id;
+
+    static constexpr id NONE = util::graph::CsrGraph::NONE;
+
+    explicit csr_graph(const graph& g);
+
+    const util::graph::CsrGraph& get_topology() const { return _topo; }
+
+    // Return a hash over everything in this graph which has an influence on
+    // routing costs
+    uint64_t get_fingerprint() const { return _fingerprint; }
+
+    // True if building this graph again from the same input is guaranteed
+    // to result in the same ids
+    bool has_stable_ids() const { return _stableIds; }
+
+    // Return the id of edge e
+    id get_id(const edge* e) const { return _ids.at(e); }
+
+    edge* get_edge(id e) const { return _edges[e]; }
+    node* get_node(id n) const { return _nodes[n]; }
+
+    const POINT& get_geom(id n) const { return _geoms[n]; }
+    const station_info* get_si(id n) const { return _sis[n]; }
+    const component* get_component(id n) const { return _comps[n]; }
+
+    double get_length(id e) const { return _lengths[e]; }
+    uint8_t level(id e) const { return _levels[e]; }
+    uint8_t oneWay(id e) const { return _oneWays[e]; }
+    bool is_restricted(id e) const { return _restricted[e]; }
+    const POINT& frontHop(id e) const { return _frontHops[e]; }
+    const POINT& backHop(id e) const { return _backHops[e]; }
+
+    line_span get_lines(id e) const
+    {
+        return line_span{_lines.data() + _lineOffsets[e],
+                         _lines.data() + _lineOffsets[e + 1]};
+    }
+
+private:
+    util::graph::CsrGraph _topo;
+    uint64_t _fingerprint;
+    bool _stableIds;
+
+    std::vector<node*> _nodes;
+    std::vector<POINT> _geoms;
+    std::vector<const station_info*> _sis;
+    std::vector<const component*> _comps;
+
+    std::vector<edge*> _edges;
+    std::unordered_map<const edge*, id> _ids;
+    std::vector<float> _lengths;
+    std::vector<uint8_t> _levels;
+    std::vector<uint8_t> _oneWays;
+    std::vector<uint8_t> _restricted;
+    std::vector<POINT> _frontHops;
+    std::vector<POINT> _backHops;
+    std::vector<uint32_t> _lineOffsets;
+    std::vector<const transit_edge_line*> _lines;
+};
+}  // namespace pfaedle::trgraph
+
+#endif  // PFAEDLE_TRGRAPH_CSRGRAPH_H_
@@ -5,6 +5,7 @@
 #include "pfaedle/trgraph/node_payload.h"
 #include <util/graph/Edge.h>
 #include <util/geo/Grid.h>
+#include <util/geo/PackedRTree.h>
 
 #include <queue>
 namespace pfaedle::trgraph
@@ -19,7 +20,8 @@ public:
     using edge_candidate = std::pair<double, edge*>;
     using edge_candidate_priority_queue = std::priority_queue<edge_candidate>;
 
-    static trgraph::edge_grid build_edge_grid(graph& g, size_t size, const BOX& webMercBox);
+    // if packed, the edges are kept in a packed R-tree instead of grid cells of the given size
+    static trgraph::edge_grid build_edge_grid(graph& g, size_t size, const BOX& webMercBox, bool packed = false);
     // initialization of a point grid with cell width w and cell height h
     // that covers the area of bounding box bbox
     edge_grid(double w, double h, const util::geo::Box<PFAEDLE_PRECISION>& bbox);
@@ -36,7 +38,15 @@ public:
     // the empty grid
     edge_grid(bool buildValIdx);
 
+    void add(const LINE& l, edge* e);
+    void remove(edge* e);
+    void get(const BOX& box, std::vector<edge*>* s) const;
+
     edge_candidate_priority_queue get_edge_candidates(const POINT& s, double d);
+
+private:
+    bool _packed = false;
+    util::geo::PackedRTree<edge*, PFAEDLE_PRECISION> _tree;
 };
 
 }
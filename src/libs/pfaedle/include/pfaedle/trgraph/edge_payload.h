@@ -10,6 +10,7 @@
 #include "util/geo/Geo.h"
 #include "util/geo/GeoGraph.h"
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
@@ -132,8 +133,12 @@ private:
 
     std::vector<const transit_edge_line*> _lines;
 
+    // expects _refMutex to be held
     static void unRefTLine(const transit_edge_line* l);
 
+    // graphs of different configurations are built in parallel, the
+    // reference counts below are guarded by _refMutex
+    static std::mutex _refMutex;
     static std::map<LINE*, size_t> _flines;
     static std::map<const transit_edge_line*, size_t> _tlines;
 };
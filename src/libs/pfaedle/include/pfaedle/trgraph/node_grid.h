@@ -5,6 +5,7 @@
 #include <pfaedle/trgraph/node_payload.h>
 #include <util/graph/Node.h>
 #include <util/geo/Grid.h>
+#include <util/geo/PackedRTree.h>
 
 namespace pfaedle::trgraph
 {
@@ -16,7 +17,9 @@ using node = util::graph::Node<node_payload, edge_payload>;
 class node_grid : public util::geo::Grid<node*, util::geo::Point, PFAEDLE_PRECISION>
 {
 public:
-    static trgraph::node_grid build_node_grid(graph& g, size_t size, const BOX& webMercBox, bool which);
+    // if packed, the nodes are kept in a packed R-tree instead of grid cells of the given size
+    static trgraph::node_grid build_node_grid(graph& g, size_t size, const BOX& webMercBox, bool which,
+                                              bool packed = false);
 
     // initialization of a point grid with cell width w and cell height h
     // that covers the area of bounding box bbox
@@ -34,11 +37,23 @@ public:
     // the empty grid
     node_grid(bool buildValIdx);
 
+    void add(const POINT& p, node* n);
+    void remove(node* n);
+    void get(const BOX& box, std::vector<node*>* s) const;
+
     node* get_matching_node(const node_payload& s, double d);
 
     node* get_distance_matching_node(const trgraph::node_payload& s, double d);
 
     std::set<node*> get_matching_nodes(const node_payload& s, double d);
+
+private:
+    // the nearest node with a station for which matches is true, closer than d meters
+    template<typename F>
+    node* get_nearest_station(const node_payload& s, double d, const F& matches) const;
+
+    bool _packed = false;
+    util::geo::PackedRTree<node*, PFAEDLE_PRECISION> _tree;
 };
 
 
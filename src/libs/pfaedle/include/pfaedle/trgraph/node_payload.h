@@ -10,6 +10,7 @@
 #include "util/geo/Geo.h"
 #include "util/geo/GeoGraph.h"
 #include <map>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -76,6 +77,7 @@ private:
 #endif
 
     static station_info _blockerSI;
+    static std::mutex _compsMutex;
     static std::unordered_map<const component*, size_t> _comps;
 };
 }  // namespace pfaedle::trgraph
@@ -11,6 +11,7 @@
 #include <utility>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
 
 namespace pfaedle::trgraph
 {
@@ -36,21 +37,24 @@ public:
     // assignment op
     normalizer& operator=(normalizer other);
 
-    // Normalize sn, not thread safe
+    // Normalize sn, thread safe. Cache hits only take a shared lock, so
+    // concurrent lookups of already normalized strings do not serialize
     std::string norm(const std::string& sn) const;
-    // Normalize sn, thread safe
+    // Normalize sn, thread safe (kept for compatibility, same as norm())
     std::string normTS(const std::string& sn) const;
 
-    // Normalize sn based on the rules of this normalizer, uses the thread safe
-    // version of norm() internally
+    // Normalize sn based on the rules of this normalizer
     std::string operator()(std::string sn) const;
     bool operator==(const normalizer& b) const;
 
+    // Return the replacement rules as they were given
+    const ReplRules& get_rules() const;
+
 private:
     ReplRulesComp _rules;
     ReplRules _rulesOrig;
     mutable std::unordered_map<std::string, std::string> _cache;
-    mutable std::mutex _mutex;
+    mutable std::shared_mutex _mutex;
 
     void build_rules(const ReplRules& rules);
 };
@@ -40,6 +40,12 @@ public:
              osmid to,
              const trgraph::node* via,
              bool pos);
+    // Add a rule whose target edge is already known, to may be nullptr for
+    // rules that could not be resolved
+    void add_rule(const trgraph::edge* from,
+                  const trgraph::edge* to,
+                  const trgraph::node* via,
+                  bool pos);
     bool may(const trgraph::edge* from,
              const trgraph::edge* to,
              const trgraph::node* via) const;
@@ -53,6 +59,10 @@ public:
     void duplicate_edge(const trgraph::edge* old,
                         const trgraph::edge* newE);
 
+    // Return the positive and negative rules, keyed by their via node
+    const Rules& get_pos_rules() const;
+    const Rules& get_neg_rules() const;
+
 private:
     using dangling_path = std::pair<const trgraph::node*, size_t>;
     using node_id_pair = std::pair<const trgraph::node*, osmid>;
@@ -5,6 +5,7 @@
 #ifndef PFAEDLE_TRGRAPH_STATINFO_H_
 #define PFAEDLE_TRGRAPH_STATINFO_H_
 
+#include <mutex>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -77,7 +78,9 @@ private:
     std::string _id;
 #endif
 
+    static std::mutex _groupsMutex;
     static std::unordered_map<const station_group*, size_t> _groups;
+    // expects _groupsMutex to be held
     static void unRefGroup(station_group* g);
 };
 }  // namespace pfaedle::trgraph
@@ -50,7 +50,7 @@ void config_reader::help(const char* bin)
               << std::setw(35) << " "
               << "  parameter (see usage)\n"
               << std::setw(35) << "  -x [ --osm-file ] arg"
-              << "OSM xml input file\n"
+              << "OSM input file, xml or pbf (*.pbf)\n"
               << std::setw(35) << "  -m [ --mots ] arg (=all)"
               << "MOTs to calculate shapes for, comma sep.,\n"
               << std::setw(35) << " "
@@ -64,7 +64,9 @@ void config_reader::help(const char* bin)
               << "  funicular, coach} or as GTFS mot codes\n"
               << "\nOutput:\n"
               << std::setw(35) << "  -o [ --output ] arg (=gtfs-out)"
-              << "GTFS output path\n"
+              << "GTFS output path, a .zip path writes\n"
+              << std::setw(35) << " "
+              << "  a zipped feed\n"
               << std::setw(35) << "  -X [ --osm-out ] arg"
               << "if specified, a filtered OSM file will be\n"
               << std::setw(35) << " "
@@ -102,6 +104,12 @@ void config_reader::help(const char* bin)
               << "bins to use for d_f histogram, comma sep.\n"
               << std::setw(35) << " "
               << "  (e.g. 10,20,30,40)\n"
+              << std::setw(35) << "  --eval-single-file"
+              << "write the old and new shapes of all trips\n"
+              << std::setw(35) << " "
+              << "  to <eval-path>/eval-trips.json instead of\n"
+              << std::setw(35) << " "
+              << "  one file per trip\n"
               << "\nMisc:\n"
               << std::setw(35) << "  -T [ --trip-id ] arg"
               << "Do routing only for trip <arg>, write result \n"
@@ -111,10 +119,34 @@ void config_reader::help(const char* bin)
               << "Output overpass query for matching OSM data\n"
               << std::setw(35) << "  --grid-size arg (=2000)"
               << "Grid cell size\n"
+              << std::setw(35) << "  --spatial-index arg (=grid)"
+              << "index for snapping stations and fixing\n"
+              << std::setw(35) << " "
+              << "  gaps, 'grid' or 'rtree' (packed R-tree)\n"
               << std::setw(35) << "  --use-route-cache"
               << "(experimental) cache intermediate routing\n"
               << std::setw(35) << " "
-              << "  results\n";
+              << "  results\n"
+              << std::setw(35) << "  --route-cache-size arg (=1024)"
+              << "memory limit of the route cache in MB\n"
+              << std::setw(35) << "  --route-cache-path arg"
+              << "directory to keep the route cache in between\n"
+              << std::setw(35) << " "
+              << "  runs on the same graph, implies\n"
+              << std::setw(35) << " "
+              << "  --use-route-cache\n"
+              << std::setw(35) << "  --use-hierarchy"
+              << "contract the graph before matching, speeds\n"
+              << std::setw(35) << " "
+              << "  up routing for trips without line\n"
+              << std::setw(35) << " "
+              << "  information\n"
+              << std::setw(35) << "  --graph-cache arg"
+              << "directory for snapshots of the graphs read\n"
+              << std::setw(35) << " "
+              << "  from the OSM file, reused as long as the\n"
+              << std::setw(35) << " "
+              << "  OSM file, config and feed extent match\n";
 }
 config_reader::config_reader(config& cfg) :
     config_{cfg}
@@ -158,6 +190,12 @@ void config_reader::read(int argc, char** argv)
                            {"use-route-cache", no_argument, nullptr, 8},
                            {"interpolate-times", no_argument, nullptr, 10},
                            {"import-osm-stops", no_argument, nullptr, 11},
+                           {"graph-cache", required_argument, nullptr, 12},
+                           {"route-cache-path", required_argument, nullptr, 13},
+                           {"route-cache-size", required_argument, nullptr, 14},
+                           {"use-hierarchy", no_argument, nullptr, 15},
+                           {"spatial-index", required_argument, nullptr, 16},
+                           {"eval-single-file", no_argument, nullptr, 17},
                            {nullptr, 0, nullptr, 0}};
 
     char c = 0;
@@ -195,6 +233,30 @@ void config_reader::read(int argc, char** argv)
             case 11:
                 config_.import_osm_stops = true;
                 break;
+            case 12:
+                config_.graphCachePath = optarg;
+                break;
+            case 13:
+                config_.routeCachePath = optarg;
+                config_.useCaching = true;
+                break;
+            case 14:
+                config_.routeCacheSize = atof(optarg);
+                break;
+            case 15:
+                config_.useHierarchy = true;
+                break;
+            case 16:
+                config_.spatialIndex = optarg;
+                if (config_.spatialIndex != "grid" && config_.spatialIndex != "rtree")
+                {
+                    std::cerr << "--spatial-index must be 'grid' or 'rtree'" << std::endl;
+                    exit(1);
+                }
+                break;
+            case 17:
+                config_.evalSingleFile = true;
+                break;
             case 'o':
                 config_.outputPath = optarg;
                 break;
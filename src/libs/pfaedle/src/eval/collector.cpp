@@ -7,6 +7,7 @@
 #include "pfaedle/eval/result.h"
 #include "util/geo/Geo.h"
 #include "util/geo/output/GeoJsonOutput.h"
+#include "util/json/Writer.h"
 
 #include <gtfs/trip.h>
 #include <gtfs/shape.h>
@@ -14,9 +15,11 @@
 #include <gtfs/stop_time.h>
 
 #include <logging/logger.h>
+#include <algorithm>
 #include <cmath>
 #include <csignal>
 #include <set>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <fstream>
@@ -25,206 +28,406 @@
 namespace pfaedle::eval
 {
 
-collector::collector(const std::string& evalOutPath, const std::vector<double>& dfBins) :
+collector::collector(const std::string& evalOutPath, const std::vector<double>& dfBins, bool singleFile,
+                     size_t numThreads) :
     _noOrigShp(0),
     _fdSum(0),
     _unmatchedSegSum(0),
     _unmatchedSegLengthSum(0),
     _evalOutPath(evalOutPath),
-    _dfBins(dfBins)
+    _dfBins(dfBins),
+    _singleFile(singleFile),
+    _numThreads(std::max<size_t>(1, numThreads)),
+    _closed(false),
+    _queueSize(0),
+    _tripsEmpty(true)
 {}
 
-double collector::add(const gtfs::trip& t,
-                      const gtfs::shape* oldS,
-                      const gtfs::shape& newS,
-                      const std::vector<double>& newTripDists)
+collector::~collector()
+{
+    stop();
+}
+
+void collector::start()
+{
+    // a few shapes per worker, the matching threads only wait if the workers
+    // fall behind
+    _queueSize = 4 * _numThreads;
+    _closed = false;
+    _buffers.resize(_numThreads);
+
+    if (_singleFile)
+    {
+        _tripsOut.open(_evalOutPath + "/eval-trips.json");
+        _tripsOut << "{\"type\": \"FeatureCollection\", \"features\": [\n";
+    }
+
+    for (auto& b : _buffers)
+        _workers.emplace_back(&collector::work, this, std::ref(b));
+}
+
+void collector::stop()
 {
-    if (!oldS)
     {
-        _noOrigShp++;
-        return 0;
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        _closed = true;
     }
+    _queueNotEmpty.notify_all();
+
+    for (auto& w : _workers)
+        w.join();
+    _workers.clear();
+}
 
-    for (auto st : t.stop_times())
+void collector::add(const std::vector<gtfs::trip*>& ts,
+                    const std::vector<const gtfs::shape*>& oldS,
+                    const gtfs::shape& newS,
+                    const std::vector<double>& newDists)
+{
+    assert(ts.size() == oldS.size());
+
+    job j{newS, newDists, {}};
+    j.trips.reserve(ts.size());
+
+    for (size_t i = 0; i < ts.size(); i++)
     {
-        if (st.get().shape_dist_traveled < 0)
+        trip_stops& tst = j.trips.emplace_back();
+        tst.trip = ts[i];
+        tst.oldS = oldS[i];
+        tst.comparable = oldS[i] != nullptr;
+        if (!tst.comparable)
+            continue;
+
+        const auto stop_times = ts[i]->stop_times();
+        tst.from = stop_times.front().shape_dist_traveled();
+        tst.to = stop_times.back().shape_dist_traveled();
+
+        for (auto st : stop_times)
         {
             // we cannot safely compare trips without shape dist travelled
             // info
-            _noOrigShp++;
-            return 0;
+            if (st.shape_dist_traveled() < 0)
+                tst.comparable = false;
+
+            if (!st.stop().has_value())
+                continue;
+            const gtfs::stop& stop = st.stop().value();
+            tst.cuts.emplace_back(util::geo::latLngToWebMerc(stop.stop_lat, stop.stop_lon),
+                                  st.shape_dist_traveled());
         }
     }
 
-    double fd = 0;
-    size_t unmatched_segments = 0;
-    double unmatched_segments_length = NAN;
+    std::unique_lock<std::mutex> lock(_queueMutex);
+    if (_workers.empty())
+        start();
 
-    std::vector<double> old_dists;
-    LINE old_line = get_web_merc_line(
-            oldS, t.stop_times().begin()->get().shape_dist_traveled,
-            (--t.stop_times().end())->get().shape_dist_traveled, old_dists);
+    _queueNotFull.wait(lock, [this] { return _queue.size() < _queueSize; });
+    _queue.push_back(std::move(j));
+    lock.unlock();
+    _queueNotEmpty.notify_one();
+}
 
-    std::vector<double> new_dists;
-    LINE new_line = get_web_merc_line(&newS, -1, -1, new_dists);
+void collector::work(buffer& b)
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(_queueMutex);
+        _queueNotEmpty.wait(lock, [this] { return _closed || !_queue.empty(); });
+        if (_queue.empty())
+            break;
 
-    std::ofstream fstr(_evalOutPath + "/trip-" + t.trip_id + ".json");
-    util::geo::output::GeoJsonOutput gjout(fstr);
+        job j = std::move(_queue.front());
+        _queue.pop_front();
+        lock.unlock();
+        _queueNotFull.notify_one();
 
-    auto old_segs = segmentize(t, old_line, old_dists, nullptr);
-    auto new_segs = segmentize(t, new_line, new_dists, &newTripDists);
+        try
+        {
+            evaluate(j, b);
+            if (_singleFile)
+                write_features(b, false);
+        }
+        catch (...)
+        {
+            // keep taking jobs, the matching threads must not wait for a
+            // full queue forever
+            lock.lock();
+            if (!_error)
+                _error = std::current_exception();
+        }
+    }
+
+    if (_singleFile)
+        write_features(b, true);
+}
 
-    // cut both result at the beginning and end to clear evaluation from
-    // loops at the end
-    POLYLINE old_start = old_segs[0];
-    POLYLINE new_start = new_segs[0];
-    auto old_start_new = old_start.getSegment(old_start.projectOn(new_segs[0][0]).totalPos, 1);
-    auto new_start_new = new_start.getSegment(new_start.projectOn(old_segs[0][0]).totalPos, 1);
+void collector::finish()
+{
+    stop();
 
-    if (fabs(old_start_new.getLength() - old_start.getLength()) / old_start.getLength() < 0.5 &&
-        fabs(new_start_new.getLength() - new_start.getLength()) / new_start.getLength() < 0.5)
+    for (auto& b : _buffers)
     {
-        old_segs[0] = old_start_new.getLine();
-        new_segs[0] = new_start_new.getLine();
+        _results.insert(b.results.begin(), b.results.end());
+        _resultsAN.insert(b.resultsAN.begin(), b.resultsAN.end());
+        _resultsAL.insert(b.resultsAL.begin(), b.resultsAL.end());
+        _noOrigShp += b.noOrigShp;
+        _fdSum += b.fdSum;
+        _unmatchedSegSum += b.unmatchedSegSum;
+        _unmatchedSegLengthSum += b.unmatchedSegLengthSum;
     }
+    _buffers.clear();
 
-    POLYLINE old_end = old_segs[old_segs.size() - 1];
-    POLYLINE new_end = new_segs[old_segs.size() - 1];
-    auto old_end_new = old_end.getSegment(0, old_end.projectOn(new_segs.back().back()).totalPos);
-    auto new_end_new = new_end.getSegment(0, new_end.projectOn(old_segs.back().back()).totalPos);
-
-    if (fabs(old_end_new.getLength() - old_end.getLength()) / old_end.getLength() < 0.5 &&
-        fabs(new_end_new.getLength() - new_end.getLength()) / new_end.getLength() < 0.5)
+    if (_tripsOut.is_open())
     {
-        old_segs[old_segs.size() - 1] = old_end_new.getLine();
-        new_segs[new_segs.size() - 1] = new_end_new.getLine();
+        _tripsOut << "\n]}\n";
+        _tripsOut.close();
     }
 
-    // check for suspicious (most likely erroneous) lines in the
-    // ground truth data which have a long straight-line segment
+    if (_error)
+        std::rethrow_exception(std::exchange(_error, nullptr));
+}
+
+void collector::evaluate(const job& j, buffer& b) const
+{
+    // the new shape is the same for all trips, trips with the same old shape
+    // have the same distances
+    std::map<const gtfs::shape*, std::pair<double, std::pair<size_t, double>>> cache;
 
-    for (const auto& old_line_segs : old_segs)
+    for (const auto& tst : j.trips)
     {
-        for (size_t i = 1; i < old_line_segs.size(); i++)
+        if (!tst.comparable)
+        {
+            b.noOrigShp++;
+            continue;
+        }
+
+        const gtfs::trip& t = *tst.trip;
+
+        std::vector<double> old_dists;
+        LINE old_line = get_web_merc_line(tst.oldS, tst.from, tst.to, old_dists);
+
+        std::vector<double> new_dists;
+        LINE new_line = get_web_merc_line(&j.newS, -1, -1, new_dists);
+
+        auto new_cuts = tst.cuts;
+        for (size_t i = 0; i < new_cuts.size(); i++)
+            new_cuts[i].second = j.newDists[i];
+
+        auto old_segs = segmentize(old_line, old_dists, tst.cuts);
+        auto new_segs = segmentize(new_line, new_dists, new_cuts);
+
+        // cut both result at the beginning and end to clear evaluation from
+        // loops at the end
+        POLYLINE old_start = old_segs[0];
+        POLYLINE new_start = new_segs[0];
+        auto old_start_new = old_start.getSegment(old_start.projectOn(new_segs[0][0]).totalPos, 1);
+        auto new_start_new = new_start.getSegment(new_start.projectOn(old_segs[0][0]).totalPos, 1);
+
+        if (fabs(old_start_new.getLength() - old_start.getLength()) / old_start.getLength() < 0.5 &&
+            fabs(new_start_new.getLength() - new_start.getLength()) / new_start.getLength() < 0.5)
+        {
+            old_segs[0] = old_start_new.getLine();
+            new_segs[0] = new_start_new.getLine();
+        }
+
+        POLYLINE old_end = old_segs[old_segs.size() - 1];
+        POLYLINE new_end = new_segs[old_segs.size() - 1];
+        auto old_end_new = old_end.getSegment(0, old_end.projectOn(new_segs.back().back()).totalPos);
+        auto new_end_new = new_end.getSegment(0, new_end.projectOn(old_segs.back().back()).totalPos);
+
+        if (fabs(old_end_new.getLength() - old_end.getLength()) / old_end.getLength() < 0.5 &&
+            fabs(new_end_new.getLength() - new_end.getLength()) / new_end.getLength() < 0.5)
         {
-            if (util::geo::webMercMeterDist(old_line_segs[i - 1], old_line_segs[i]) > 500)
+            old_segs[old_segs.size() - 1] = old_end_new.getLine();
+            new_segs[new_segs.size() - 1] = new_end_new.getLine();
+        }
+
+        // check for suspicious (most likely erroneous) lines in the
+        // ground truth data which have a long straight-line segment
+
+        for (const auto& old_line_segs : old_segs)
+        {
+            for (size_t i = 1; i < old_line_segs.size(); i++)
             {
-                // return 0;
+                if (util::geo::webMercMeterDist(old_line_segs[i - 1], old_line_segs[i]) > 500)
+                {
+                    // continue;
+                }
             }
         }
-    }
 
-    // new lines build from cleaned-up shapes
-    LINE old_l_cut;
-    LINE new_l_cut;
+        // new lines build from cleaned-up shapes
+        LINE old_l_cut;
+        LINE new_l_cut;
 
-    for (const auto& old_line_seg : old_segs)
-    {
-        gjout.printLatLng(old_line_seg, util::json::Dict{{"ver", "old"}});
-        old_l_cut.insert(old_l_cut.end(), old_line_seg.begin(), old_line_seg.end());
-    }
+        for (const auto& old_line_seg : old_segs)
+            old_l_cut.insert(old_l_cut.end(), old_line_seg.begin(), old_line_seg.end());
 
-    for (const auto& new_line_seg : new_segs)
-    {
-        gjout.printLatLng(new_line_seg, util::json::Dict{{"ver", "new"}});
-        new_l_cut.insert(new_l_cut.end(), new_line_seg.begin(), new_line_seg.end());
-    }
+        for (const auto& new_line_seg : new_segs)
+            new_l_cut.insert(new_l_cut.end(), new_line_seg.begin(), new_line_seg.end());
+
+        if (_singleFile)
+        {
+            std::ostringstream os;
+            for (const auto& old_line_seg : old_segs)
+                print_feature(os, old_line_seg, t.trip_id, "old");
+            for (const auto& new_line_seg : new_segs)
+                print_feature(os, new_line_seg, t.trip_id, "new");
+            b.features += os.str();
+        }
+        else
+        {
+            std::ofstream fstr(_evalOutPath + "/trip-" + t.trip_id + ".json");
+            util::geo::output::GeoJsonOutput gjout(fstr);
+
+            for (const auto& old_line_seg : old_segs)
+                gjout.printLatLng(old_line_seg, util::json::Dict{{"ver", "old"}});
+            for (const auto& new_line_seg : new_segs)
+                gjout.printLatLng(new_line_seg, util::json::Dict{{"ver", "new"}});
 
-    gjout.flush();
-    fstr.close();
+            gjout.flush();
+            fstr.close();
+        }
 
-    double fac = cos(2 * atan(exp((old_segs.front().front().getY() +
-                                   old_segs.back().back().getY()) /
-                                  6378137.0)) -
-                     1.5707965);
+        double fac = cos(2 * atan(exp((old_segs.front().front().getY() +
+                                       old_segs.back().back().getY()) /
+                                      6378137.0)) -
+                         1.5707965);
 
-    if (_dCache.count(oldS) && _dCache.find(oldS)->second.count(newS.shape_id))
-    {
-        fd = _dCache[oldS][newS.shape_id];
+        auto cached = cache.find(tst.oldS);
+        if (cached == cache.end())
+        {
+            std::vector<size_t> p_idx;
+            std::vector<size_t> q_idx;
+            LINE p = util::geo::densify(old_l_cut, 5 / fac, &p_idx);
+            LINE q = util::geo::densify(new_l_cut, 5 / fac, &q_idx);
+            double fd = util::geo::accFrechetDist(p, q, get_band(old_segs, new_segs, p_idx, q_idx, p.size(), q.size())) * fac;
+
+            cached = cache.emplace(tst.oldS, std::make_pair(fd, get_da(old_segs, new_segs))).first;
+        }
+
+        const double fd = cached->second.first;
+        const size_t unmatched_segments = cached->second.second.first;
+        const double unmatched_segments_length = cached->second.second.second;
+
+        double total_length = 0;
+        for (const auto& l : old_segs)
+            total_length += util::geo::len(l) * fac;
+
+        // filter out shapes with a length of under 5 meters - they are most likely
+        // artifacts
+        if (total_length < 5)
+        {
+            b.noOrigShp++;
+            continue;
+        }
+
+        b.fdSum += fd / total_length;
+        b.unmatchedSegSum += unmatched_segments;
+        b.unmatchedSegLengthSum += unmatched_segments_length;
+        b.results.emplace_back(t, fd / total_length);
+        b.resultsAN.emplace_back(t, static_cast<double>(unmatched_segments) / static_cast<double>(old_segs.size()));
+        b.resultsAL.emplace_back(t, unmatched_segments_length / total_length);
+
+        LOG(DEBUG) << "This result (" << t.trip_id
+                   << "): A_N/N = " << unmatched_segments << "/" << old_segs.size()
+                   << " = "
+                   << static_cast<double>(unmatched_segments) /
+                              static_cast<double>(old_segs.size())
+                   << " A_L/L = " << unmatched_segments_length << "/" << total_length << " = "
+                   << unmatched_segments_length / total_length << " d_f = " << fd;
     }
-    else
+}
+
+void collector::write_features(buffer& b, bool force)
+{
+    // the features of many trips are written at once
+    if (b.features.empty() || (!force && b.features.size() < (1 << 20)))
+        return;
+
+    std::lock_guard<std::mutex> lock(_tripsMutex);
+    if (!_tripsEmpty)
+        _tripsOut << ",\n";
+    // drop the separator after the last feature
+    _tripsOut.write(b.features.data(), b.features.size() - 2);
+    _tripsEmpty = false;
+    b.features.clear();
+}
+
+void collector::print_feature(std::ostream& os, const LINE& l, const std::string& tripId, const std::string& ver)
+{
+    if (l.empty()) return;
+
+    util::json::Writer w(os, 10, false);
+    w.obj();
+    w.keyVal("type", "Feature");
+    w.key("geometry");
+    w.obj();
+    w.keyVal("type", "LineString");
+    w.key("coordinates");
+    w.arr();
+    for (const auto& p : l)
     {
-        fd = util::geo::accFrechetDistC(old_l_cut, new_l_cut, 5 / fac) * fac;
-        _dCache[oldS][newS.shape_id] = fd;
+        auto ll = util::geo::webMercToLatLng<double>(p.getX(), p.getY());
+        w.arr();
+        w.val(ll.getX());
+        w.val(ll.getY());
+        w.close();
     }
+    w.close();
+    w.close();
+    w.key("properties");
+    w.val(util::json::Dict{{"ver", ver}, {"trip", tripId}});
+    w.closeAll();
+    os << ",\n";
+}
 
-    if (_dACache.count(oldS) && _dACache.find(oldS)->second.count(newS.shape_id))
+util::geo::FrechetBand collector::get_band(const std::vector<LINE>& a,
+                                           const std::vector<LINE>& b,
+                                           const std::vector<size_t>& pIdx,
+                                           const std::vector<size_t>& qIdx,
+                                           size_t pSize, size_t qSize)
+{
+    // without matching segments, the whole lines are compared
+    if (a.size() != b.size() || a.empty()) return {};
+    for (size_t k = 0; k < a.size(); k++)
     {
-        unmatched_segments = _dACache[oldS][newS.shape_id].first;
-        unmatched_segments_length = _dACache[oldS][newS.shape_id].second;
+        if (a[k].empty() || b[k].empty()) return {};
     }
-    else
+
+    // first and last point of every segment in q
+    std::vector<std::pair<size_t, size_t>> q_segs;
+    size_t off = 0;
+    for (const auto& l : b)
     {
-        auto dA = get_da(old_segs, new_segs);
-        _dACache[oldS][newS.shape_id] = dA;
-        unmatched_segments = dA.first;
-        unmatched_segments_length = dA.second;
+        q_segs.emplace_back(qIdx[off], qIdx[off + l.size() - 1]);
+        off += l.size();
     }
+    assert(q_segs.back().second == qSize - 1);
 
-    double total_length = 0;
-    for (const auto& l : old_segs)
-        total_length += util::geo::len(l) * fac;
-
-    // filter out shapes with a length of under 5 meters - they are most likely
-    // artifacts
-    if (total_length < 5)
+    util::geo::FrechetBand band;
+    band.reserve(pSize);
+    off = 0;
+    for (size_t k = 0; k < a.size(); k++)
     {
-        _noOrigShp++;
-        return 0;
+        off += a[k].size();
+        size_t end = k + 1 < a.size() ? pIdx[off] : pSize;
+        band.resize(end, {q_segs[k ? k - 1 : 0].first, q_segs[std::min(k + 1, a.size() - 1)].second});
     }
 
-    _fdSum += fd / total_length;
-    _unmatchedSegSum += unmatched_segments;
-    _unmatchedSegLengthSum += unmatched_segments_length;
-    _results.insert(result(t, fd / total_length));
-    _resultsAN.insert(result(t, static_cast<double>(unmatched_segments) / static_cast<double>(old_segs.size())));
-    _resultsAL.insert(result(t, unmatched_segments_length / total_length));
-
-    LOG(DEBUG) << "This result (" << t.trip_id
-               << "): A_N/N = " << unmatched_segments << "/" << old_segs.size()
-               << " = "
-               << static_cast<double>(unmatched_segments) /
-                          static_cast<double>(old_segs.size())
-               << " A_L/L = " << unmatched_segments_length << "/" << total_length << " = "
-               << unmatched_segments_length / total_length << " d_f = " << fd;
-
-    return fd;
+    return band;
 }
 
 std::vector<LINE> collector::segmentize(
-        const pfaedle::gtfs::trip& t,
         const LINE& shape,
         const std::vector<double>& dists,
-        const std::vector<double>* new_trip_dists)
+        const std::vector<std::pair<POINT, double>>& cuts)
 {
     std::vector<LINE> ret;
 
-    if (t.stop_times().size() < 2) return ret;
+    if (cuts.size() < 2) return ret;
 
     POLYLINE pl(shape);
-    std::vector<std::pair<POINT, double>> cuts;
-
-    size_t i = 0;
-    for (auto st : t.stop_times())
-    {
-        if(!st.get().stop().has_value())
-            continue;
-        gtfs::stop& stop = st.get().stop().value();
-
-        if (new_trip_dists)
-        {
-            cuts.emplace_back(
-                    util::geo::latLngToWebMerc(stop.stop_lat, stop.stop_lon),
-                    (*new_trip_dists)[i]);
-        }
-        else
-        {
-            cuts.emplace_back(
-                    util::geo::latLngToWebMerc(stop.stop_lat, stop.stop_lon),
-                    st.get().shape_dist_traveled);
-        }
-        i++;
-    }
 
     // get first half of geometry, and search for start point there!
     size_t before = std::upper_bound(dists.begin(), dists.end(), cuts[1].second) - dists.begin();
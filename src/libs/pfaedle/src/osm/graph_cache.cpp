@@ -0,0 +1,643 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include "pfaedle/osm/graph_cache.h"
+#include "pfaedle/trgraph/station_group.h"
+#include "util/Misc.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <logging/logger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using pfaedle::osm::graph_cache;
+
+namespace
+{
+
+// increase this whenever the snapshot layout or the graph building steps
+// before the snapshot change
+const uint32_t CACHE_VERSION = 1;
+const char CACHE_MAGIC[8] = {'P', 'F', 'G', 'R', 'A', 'P', 'H', '\0'};
+
+// marks a missing node, group, edge or line reference
+const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+// node flags
+const uint8_t BLOCKER = 1;
+const uint8_t STATION = 2;
+
+/*
+ * 64 bit FNV-1a hash over everything that determines a snapshot
+ */
+class key_hasher : public util::Fnv1a
+{
+public:
+    using util::Fnv1a::add;
+
+    void add(const pfaedle::osm::multi_attribute_map& m)
+    {
+        // the iteration order of the unordered map is not stable
+        std::vector<std::string> keys;
+        keys.reserve(m.size());
+        for (const auto& kv : m) keys.push_back(kv.first);
+        std::sort(keys.begin(), keys.end());
+
+        add(static_cast<uint64_t>(keys.size()));
+        for (const auto& key : keys)
+        {
+            add(key);
+            const auto& vals = m.find(key)->second;
+            add(static_cast<uint64_t>(vals.size()));
+            for (const auto& val : vals)
+            {
+                add(val.first);
+                add(val.second);
+            }
+        }
+    }
+
+    void add(const pfaedle::osm::attribute_list& l)
+    {
+        add(static_cast<uint64_t>(l.size()));
+        for (const auto& s : l) add(s);
+    }
+
+    void add(const pfaedle::osm::deep_attribute_rule& r)
+    {
+        add(r.attr);
+        add(r.relRule.kv.first);
+        add(r.relRule.kv.second);
+        add(static_cast<uint64_t>(r.relRule.flags.size()));
+        for (const auto& f : r.relRule.flags) add(f);
+    }
+
+    void add(const pfaedle::osm::deep_attribute_list& l)
+    {
+        add(static_cast<uint64_t>(l.size()));
+        for (const auto& r : l) add(r);
+    }
+
+    void add(const pfaedle::trgraph::normalizer& n)
+    {
+        add(static_cast<uint64_t>(n.get_rules().size()));
+        for (const auto& rule : n.get_rules())
+        {
+            add(rule.first);
+            add(rule.second);
+        }
+    }
+
+};
+
+/*
+ * Writes the fixed size values of a snapshot in host byte order
+ */
+class cache_writer
+{
+public:
+    explicit cache_writer(std::ostream& out) :
+        _out(out) {}
+
+    template <typename T>
+    void put(T v)
+    {
+        _out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    void put(const std::string& s)
+    {
+        put(static_cast<uint32_t>(s.size()));
+        _out.write(s.data(), s.size());
+    }
+
+private:
+    std::ostream& _out;
+};
+
+/*
+ * Reads the values of a memory mapped snapshot, throws if the snapshot ends
+ * prematurely
+ */
+class cache_reader
+{
+public:
+    cache_reader(const char* data, size_t size) :
+        _cur(data), _end(data + size) {}
+
+    template <typename T>
+    T get()
+    {
+        T v;
+        memcpy(&v, take(sizeof(T)), sizeof(T));
+        return v;
+    }
+
+    std::string get_string()
+    {
+        auto n = get<uint32_t>();
+        return std::string(take(n), n);
+    }
+
+    // read the number of the following items, each at least minSize bytes
+    // long. Throws if they cannot fit into the rest of the snapshot
+    uint32_t get_count(size_t minSize)
+    {
+        auto n = get<uint32_t>();
+        if (n > remaining() / minSize) throw std::runtime_error("invalid count");
+        return n;
+    }
+
+    // read a reference into a table of size n
+    uint32_t get_ref(size_t n)
+    {
+        auto ref = get<uint32_t>();
+        if (ref != NONE && ref >= n) throw std::runtime_error("invalid reference");
+        return ref;
+    }
+
+    bool at_end() const { return _cur == _end; }
+
+    size_t remaining() const { return _end - _cur; }
+
+private:
+    const char* _cur;
+    const char* _end;
+
+    const char* take(size_t n)
+    {
+        if (static_cast<size_t>(_end - _cur) < n) throw std::runtime_error("unexpected end of file");
+        const char* ret = _cur;
+        _cur += n;
+        return ret;
+    }
+};
+
+void write_rules(cache_writer& w,
+                 const pfaedle::trgraph::Rules& rules,
+                 const std::unordered_map<const pfaedle::trgraph::node*, uint32_t>& nids,
+                 const std::unordered_map<const pfaedle::trgraph::edge*, uint32_t>& eids)
+{
+    auto edge_ref = [&](const pfaedle::trgraph::edge* e) {
+        auto i = eids.find(e);
+        return i == eids.end() ? NONE : i->second;
+    };
+
+    // rules at nodes outside the graph are dropped
+    uint32_t count = 0;
+    for (const auto& r : rules)
+        if (nids.count(r.first)) count++;
+
+    w.put(count);
+    for (const auto& r : rules)
+    {
+        if (!nids.count(r.first)) continue;
+        w.put(nids.find(r.first)->second);
+        w.put(static_cast<uint32_t>(r.second.size()));
+        for (const auto& p : r.second)
+        {
+            w.put(edge_ref(p.first));
+            w.put(edge_ref(p.second));
+        }
+    }
+}
+
+void read_rules(cache_reader& r,
+                pfaedle::trgraph::restrictor& res,
+                const std::vector<pfaedle::trgraph::node*>& nodes,
+                const std::vector<pfaedle::trgraph::edge*>& edges,
+                bool pos)
+{
+    auto count = r.get_count(2 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        auto via = r.get_ref(nodes.size());
+        if (via == NONE) throw std::runtime_error("invalid reference");
+        auto n = r.get_count(2 * sizeof(uint32_t));
+        for (uint32_t j = 0; j < n; j++)
+        {
+            auto from = r.get_ref(edges.size());
+            auto to = r.get_ref(edges.size());
+            res.add_rule(from == NONE ? nullptr : edges[from],
+                         to == NONE ? nullptr : edges[to],
+                         nodes[via], pos);
+        }
+    }
+}
+}  // namespace
+
+// _____________________________________________________________________________
+graph_cache::graph_cache(const std::string& path) :
+    _path(path)
+{
+    mkdir(_path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+}
+
+// _____________________________________________________________________________
+std::string graph_cache::get_file_path(const std::string& key) const
+{
+    return _path + "/trgraph-" + key + ".bin";
+}
+
+// _____________________________________________________________________________
+std::string graph_cache::get_key(const std::string& osmPath,
+                                 const osm_read_options& opts,
+                                 const bounding_box& box,
+                                 size_t gridSize,
+                                 bool packedIndex) const
+{
+    struct stat st;
+    if (stat(osmPath.c_str(), &st) != 0) return "";
+
+    key_hasher h;
+    h.add(static_cast<uint64_t>(CACHE_VERSION));
+
+    // the OSM file is identified by its location, size and modification time,
+    // hashing its content would take about as long as a read pass
+    char* real = realpath(osmPath.c_str(), nullptr);
+    h.add(std::string(real ? real : osmPath));
+    free(real);
+    h.add(static_cast<uint64_t>(st.st_size));
+    h.add(static_cast<uint64_t>(st.st_mtim.tv_sec));
+    h.add(static_cast<uint64_t>(st.st_mtim.tv_nsec));
+
+    // only the options used before the stations are snapped
+    h.add(opts.noHupFilter);
+    h.add(opts.keepFilter);
+    for (const auto& f : opts.levelFilters) h.add(f);
+    h.add(opts.dropFilter);
+    h.add(opts.oneWayFilter);
+    h.add(opts.oneWayFilterRev);
+    h.add(opts.twoWayFilter);
+    h.add(opts.stationFilter);
+    h.add(opts.stationBlockerFilter);
+    h.add(static_cast<uint64_t>(opts.statGroupNAttrRules.size()));
+    for (const auto& r : opts.statGroupNAttrRules)
+    {
+        h.add(r.attr);
+        h.add(r.maxDist);
+    }
+    h.add(opts.statNormzer);
+    h.add(opts.lineNormzer);
+    h.add(opts.trackNormzer);
+    h.add(opts.idNormzer);
+    h.add(opts.relLinerules.sNameRule);
+    h.add(opts.relLinerules.fromNameRule);
+    h.add(opts.relLinerules.toNameRule);
+    h.add(opts.statAttrRules.nameRule);
+    h.add(opts.statAttrRules.platformRule);
+    h.add(opts.statAttrRules.idRule);
+    h.add(opts.edgePlatformRules);
+    h.add(opts.restrPosRestr);
+    h.add(opts.restrNegRestr);
+    h.add(opts.noRestrFilter);
+
+    for (const auto& b : box.get_leafs())
+    {
+        h.add(b.getLowerLeft().getX());
+        h.add(b.getLowerLeft().getY());
+        h.add(b.getUpperRight().getX());
+        h.add(b.getUpperRight().getY());
+    }
+    h.add(static_cast<uint64_t>(gridSize));
+    h.add(static_cast<uint64_t>(packedIndex));
+
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << h.get();
+    return ss.str();
+}
+
+// _____________________________________________________________________________
+void graph_cache::store(const std::string& key,
+                        const trgraph::graph& g,
+                        const trgraph::restrictor& res,
+                        const router::node_set& orphanStations) const
+{
+    const std::string path = get_file_path(key);
+
+    // write to a temporary file first, the snapshot becomes visible at once
+    std::string tmp = path + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if (fd < 0)
+    {
+        LOG(WARN) << "Could not write graph cache file " << path;
+        return;
+    }
+    fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    close(fd);
+
+    std::ofstream out(tmp, std::ios::binary);
+    cache_writer w(out);
+
+    std::unordered_map<const trgraph::node*, uint32_t> nids;
+    std::unordered_map<const trgraph::edge*, uint32_t> eids;
+    std::unordered_map<const trgraph::station_group*, uint32_t> gids;
+    std::unordered_map<const trgraph::transit_edge_line*, uint32_t> lids;
+    std::vector<const trgraph::station_group*> groups;
+    std::vector<const trgraph::transit_edge_line*> lines;
+
+    for (const auto* n : g.getNds())
+    {
+        nids[n] = nids.size();
+        const auto* si = n->pl().get_si();
+        if (si && si->get_group() && !gids.count(si->get_group()))
+        {
+            gids[si->get_group()] = groups.size();
+            groups.push_back(si->get_group());
+        }
+        for (const auto* e : n->getAdjListOut())
+        {
+            eids[e] = eids.size();
+            for (const auto* l : e->pl().get_lines())
+            {
+                if (lids.count(l)) continue;
+                lids[l] = lines.size();
+                lines.push_back(l);
+            }
+        }
+    }
+
+    out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    w.put(CACHE_VERSION);
+    w.put(key);
+
+    w.put(static_cast<uint32_t>(lines.size()));
+    for (const auto* l : lines)
+    {
+        w.put(l->fromStr);
+        w.put(l->toStr);
+        w.put(l->shortName);
+    }
+
+    w.put(static_cast<uint32_t>(groups.size()));
+
+    w.put(static_cast<uint32_t>(nids.size()));
+    for (const auto* n : g.getNds())
+    {
+        w.put(n->pl().get_geom()->getX());
+        w.put(n->pl().get_geom()->getY());
+
+        const auto* si = n->pl().get_si();
+        w.put(static_cast<uint8_t>(n->pl().is_blocker() ? BLOCKER : si ? STATION : 0));
+        if (!si) continue;
+
+        w.put(si->get_name());
+        w.put(si->get_track());
+        w.put(static_cast<uint8_t>(si->is_from_osm()));
+        w.put(static_cast<uint32_t>(si->get_alternative_names().size()));
+        for (const auto& name : si->get_alternative_names()) w.put(name);
+        w.put(si->get_group() ? gids[si->get_group()] : NONE);
+    }
+
+    // group members which are not stations of their own
+    for (const auto* grp : groups)
+    {
+        std::vector<uint32_t> members;
+        for (const auto* n : grp->get_nodes())
+        {
+            if (!nids.count(n)) continue;
+            const auto* si = n->pl().get_si();
+            if (si && si->get_group() == grp) continue;
+            members.push_back(nids[n]);
+        }
+        w.put(static_cast<uint32_t>(members.size()));
+        for (auto m : members) w.put(m);
+    }
+
+    w.put(static_cast<uint32_t>(eids.size()));
+    for (const auto* n : g.getNds())
+    {
+        for (const auto* e : n->getAdjListOut())
+        {
+            const auto& pl = e->pl();
+            w.put(nids[e->getFrom()]);
+            w.put(nids[e->getTo()]);
+            w.put(pl.get_length());
+            w.put(pl.get_max_speed());
+            w.put(pl.oneWay());
+            w.put(static_cast<uint8_t>(pl.is_restricted()));
+            w.put(static_cast<uint8_t>(pl.is_reversed()));
+            w.put(pl.level());
+
+            w.put(static_cast<uint32_t>(pl.get_geom()->size()));
+            for (const auto& p : *pl.get_geom())
+            {
+                w.put(p.getX());
+                w.put(p.getY());
+            }
+
+            w.put(static_cast<uint32_t>(pl.get_lines().size()));
+            for (const auto* l : pl.get_lines()) w.put(lids[l]);
+        }
+    }
+
+    write_rules(w, res.get_pos_rules(), nids, eids);
+    write_rules(w, res.get_neg_rules(), nids, eids);
+
+    uint32_t orphans = 0;
+    for (const auto* n : orphanStations)
+        if (nids.count(n)) orphans++;
+    w.put(orphans);
+    for (const auto* n : orphanStations)
+        if (nids.count(n)) w.put(nids[n]);
+
+    out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    out.close();
+
+    if (!out || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        LOG(WARN) << "Could not write graph cache file " << path;
+        unlink(tmp.c_str());
+        return;
+    }
+
+    LOG(DEBUG) << "Wrote graph cache file " << path;
+}
+
+// _____________________________________________________________________________
+bool graph_cache::load(const std::string& key,
+                       trgraph::graph& g,
+                       trgraph::restrictor& res,
+                       router::node_set& orphanStations) const
+{
+    const std::string path = get_file_path(key);
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    try
+    {
+        cache_reader r(static_cast<const char*>(data), size);
+
+        char magic[sizeof(CACHE_MAGIC)];
+        for (char& c : magic) c = r.get<char>();
+        if (memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+            r.get<uint32_t>() != CACHE_VERSION || r.get_string() != key)
+        {
+            throw std::runtime_error("not a snapshot for this key");
+        }
+
+        // lines and groups are owned here until the first edge or station
+        // referencing them takes them over, the payloads free them once the
+        // last reference is gone
+        std::vector<std::unique_ptr<trgraph::transit_edge_line>> ownedLines(
+            r.get_count(3 * sizeof(uint32_t)));
+        std::vector<trgraph::transit_edge_line*> lines;
+        lines.reserve(ownedLines.size());
+        for (auto& l : ownedLines)
+        {
+            l = std::make_unique<trgraph::transit_edge_line>();
+            l->fromStr = r.get_string();
+            l->toStr = r.get_string();
+            l->shortName = r.get_string();
+            lines.push_back(l.get());
+        }
+
+        // every group is followed by its member count
+        std::vector<std::unique_ptr<trgraph::station_group>> ownedGroups(
+            r.get_count(sizeof(uint32_t)));
+        std::vector<trgraph::station_group*> groups;
+        groups.reserve(ownedGroups.size());
+        for (auto& grp : ownedGroups)
+        {
+            grp = std::make_unique<trgraph::station_group>();
+            groups.push_back(grp.get());
+        }
+
+        std::vector<trgraph::node*> nodes(r.get_count(2 * sizeof(double) + sizeof(uint8_t)));
+        for (auto& n : nodes)
+        {
+            auto x = r.get<double>();
+            auto y = r.get<double>();
+            n = g.addNd(trgraph::node_payload(POINT(x, y)));
+
+            auto flags = r.get<uint8_t>();
+            if (flags == BLOCKER) n->pl().set_blocker();
+            if (flags != STATION) continue;
+
+            auto name = r.get_string();
+            auto track = r.get_string();
+            bool fromOsm = r.get<uint8_t>();
+            trgraph::station_info si(name, track, fromOsm);
+            auto numAlt = r.get_count(sizeof(uint32_t));
+            for (uint32_t i = 0; i < numAlt; i++) si.add_alternative_name(r.get_string());
+
+            auto grp = r.get_ref(groups.size());
+            if (grp != NONE)
+            {
+                ownedGroups[grp].release();
+                si.set_group(groups[grp]);
+                groups[grp]->add_node(n);
+            }
+            n->pl().set_si(si);
+        }
+
+        for (auto* grp : groups)
+        {
+            auto numMembers = r.get_count(sizeof(uint32_t));
+            for (uint32_t i = 0; i < numMembers; i++)
+            {
+                auto m = r.get_ref(nodes.size());
+                if (m == NONE) throw std::runtime_error("invalid reference");
+                grp->add_node(nodes[m]);
+            }
+        }
+
+        std::vector<trgraph::edge*> edges(
+            r.get_count(4 * sizeof(uint32_t) + 2 * sizeof(double) + 4 * sizeof(uint8_t)));
+        for (auto& e : edges)
+        {
+            auto from = r.get_ref(nodes.size());
+            auto to = r.get_ref(nodes.size());
+            if (from == NONE || to == NONE) throw std::runtime_error("invalid reference");
+
+            e = g.addEdg(nodes[from], nodes[to], trgraph::edge_payload());
+            auto& pl = e->pl();
+            pl.set_length(r.get<double>());
+            pl.set_max_speed(r.get<double>());
+            pl.setOneWay(r.get<uint8_t>());
+            if (r.get<uint8_t>()) pl.set_restricted();
+            if (r.get<uint8_t>()) pl.set_reversed();
+            pl.set_level(r.get<uint8_t>());
+
+            auto numPoints = r.get_count(2 * sizeof(double));
+            pl.get_geom()->reserve(numPoints);
+            for (uint32_t i = 0; i < numPoints; i++)
+            {
+                auto x = r.get<double>();
+                auto y = r.get<double>();
+                pl.add_point(POINT(x, y));
+            }
+
+            auto numLines = r.get_count(sizeof(uint32_t));
+            for (uint32_t i = 0; i < numLines; i++)
+            {
+                auto l = r.get_ref(lines.size());
+                if (l == NONE) throw std::runtime_error("invalid reference");
+                ownedLines[l].release();
+                pl.add_line(lines[l]);
+            }
+        }
+
+        read_rules(r, res, nodes, edges, true);
+        read_rules(r, res, nodes, edges, false);
+
+        auto numOrphans = r.get_count(sizeof(uint32_t));
+        for (uint32_t i = 0; i < numOrphans; i++)
+        {
+            auto n = r.get_ref(nodes.size());
+            if (n == NONE) throw std::runtime_error("invalid reference");
+            orphanStations.insert(nodes[n]);
+        }
+
+        for (char& c : magic) c = r.get<char>();
+        if (memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || !r.at_end())
+            throw std::runtime_error("trailing data");
+    }
+    catch (const std::runtime_error& e)
+    {
+        LOG(WARN) << "Ignoring graph cache file " << path << ": " << e.what();
+        munmap(data, size);
+
+        // lines and groups already taken over are freed together with the
+        // edges and nodes referencing them
+        while (!g.getNds().empty()) g.delNd(g.getNds().begin());
+        res = trgraph::restrictor();
+        orphanStations.clear();
+        return false;
+    }
+
+    munmap(data, size);
+    LOG(DEBUG) << "Read graph cache file " << path;
+    return true;
+}
@@ -2,27 +2,38 @@
 // Chair of Algorithms and Data Structures.
 // Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
 
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_max_threads() 1
+#endif
+
 #include "pfaedle/osm/osm_builder.h"
 #include "pfaedle/definitions.h"
 #include "pfaedle/osm/bounding_box.h"
 #include "pfaedle/osm/osm.h"
 #include "pfaedle/osm/osm_filter.h"
+#include "pfaedle/osm/osm_reader.h"
 #include "pfaedle/trgraph/restrictor.h"
 #include "pfaedle/trgraph/station_group.h"
 #include "util/Misc.h"
+#include "util/geo/PackedRTree.h"
 #include "util/String.h"
 
 #include <logging/logger.h>
-#include <pugixml.hpp>
 #include <algorithm>
+#include <exception>
 #include <iostream>
 #include <limits>
 #include <map>
+#include <memory>
 #include <stack>
 #include <string>
 #include <utility>
 #include <vector>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 
 using util::geo::webMercMeterDist;
 using util::geo::Point;
@@ -98,6 +109,65 @@ inline double string_to_kmh(std::string str)
     return value;
 }
 
+/**
+ * Copies the tags of e whose keys are in keepAttrs to attrs
+ */
+inline void keep_attributes(const osm_raw_element& e,
+                            const attribute_key_set& keepAttrs,
+                            attribute_map& attrs)
+{
+    for (const auto& tag : e.tags)
+    {
+        if (keepAttrs.count(tag.first))
+            attrs[tag.first] = tag.second;
+    }
+}
+
+/**
+ * Splits the node and way members of e into rel
+ */
+inline void read_members(const osm_raw_element& e, osm_relation& rel)
+{
+    for (const auto& member : e.members)
+    {
+        if (member.type == osm_element_type::NODE)
+        {
+            rel.nodes.emplace_back(member.ref);
+            rel.nodeRoles.emplace_back(member.role);
+        }
+        if (member.type == osm_element_type::WAY)
+        {
+            rel.ways.emplace_back(member.ref);
+            rel.wayRoles.emplace_back(member.role);
+        }
+    }
+}
+
+/**
+ * Streams the input from its beginning and calls f on every element of the
+ * given type
+ */
+template <typename F>
+inline void for_each_element(osm_reader& reader, osm_element_type type, F f)
+{
+    reader.rewind();
+    osm_raw_element el;
+    while (reader.read(el))
+    {
+        if (el.type == type) f(static_cast<const osm_raw_element&>(el));
+    }
+}
+
+/**
+ * @return the coordinate with the 7 decimal places used by OSM
+ */
+inline std::string coord_to_string(double c)
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(7) << c;
+    return ss.str();
+}
+
 bool eq_search_functor::operator()(const trgraph::node* cand, const trgraph::station_info* si) const
 {
     if (orphanSnap && cand->pl().get_si() &&
@@ -118,35 +188,74 @@ void osm_builder::read(const std::string& path,
                        trgraph::graph& g,
                        const bounding_box& bbox,
                        size_t gridSize,
+                       bool packedIndex,
                        router::feed_stops& fs,
                        trgraph::restrictor& res,
                        bool import_osm_stations)
 {
-    if (!bbox.size())
+    read(path, {{opts, g, fs, res}}, bbox, gridSize, packedIndex, import_osm_stations, nullptr);
+}
+
+
+osm_builder::read_state::read_state(const osm_read_job& job) :
+    job(job),
+    filter(job.opts),
+    attr_keys(job.opts.get_kept_attribute_keys())
+{
+}
+
+
+void osm_builder::read(const std::string& path,
+                       const std::vector<osm_read_job>& jobs,
+                       const bounding_box& bbox,
+                       size_t gridSize,
+                       bool packedIndex,
+                       bool import_osm_stations,
+                       const graph_cache* cache)
+{
+    if (!bbox.size() || jobs.empty())
         return;
 
-    LOG(INFO) << "Reading OSM file " << path << " ... ";
+    std::vector<router::node_set> orphan_stations(jobs.size());
+    std::vector<edge_tracks> e_tracks(jobs.size());
 
-    router::node_set orphan_stations;
-    edge_tracks e_tracks;
+    std::vector<std::string> cache_keys(jobs.size());
+    std::vector<char> cached(jobs.size(), false);
+
+    if (cache)
     {
-        osm_id_set bboxNodes, noHupNodes;
+#pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            cache_keys[i] = cache->get_key(path, jobs[i].opts, bbox, gridSize, packedIndex);
+            if (!cache_keys[i].empty())
+                cached[i] = cache->load(cache_keys[i], jobs[i].g, jobs[i].res, orphan_stations[i]);
+        }
+    }
 
-        node_id_map nodes;
-        node_id_multimap mult_nodes;
-        relation_list intm_rels;
-        relation_map node_rels, wayRels;
+    std::vector<std::unique_ptr<read_state>> states;
+    std::vector<size_t> state_jobs;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        if (cached[i]) continue;
+        states.push_back(std::make_unique<read_state>(jobs[i]));
+        state_jobs.push_back(i);
+    }
 
-        restrictions raw_rests;
+    if (states.size() < jobs.size())
+        LOG(INFO) << "Read " << jobs.size() - states.size() << " graph(s) from the graph cache";
 
-        std::vector<attribute_key_set> attr_keys = opts.get_kept_attribute_keys();
+    if (!states.empty())
+    {
+        LOG(INFO) << "Reading OSM file " << path << " for " << states.size() << " configuration(s) ... ";
+
+        // one builder per job, they hold the transit lines of their graph
+        std::vector<osm_builder> builders(states.size());
 
-        osm_filter filter(opts);
+        // the bounding box nodes do not depend on the configuration
+        osm_id_set bboxNodes;
 
-        pugi::xml_document doc;
-        pugi::xml_parse_result result = doc.load_file(path.c_str());
-        if (!result)
-            return;
+        auto reader = osm_reader::from_file(path);
 
         // we do four passes of the file here to be as memory creedy as possible:
         // - the first pass collects all node IDs which are
@@ -161,41 +270,122 @@ void osm_builder::read(const std::string& path,
         //    * collected as node ids in pass 1
         //    * match the filter criteria
         //    * have been used in a way in pass 3
+        // every element is parsed once per pass and then handed to the filters
+        // of all jobs
 
         LOG(TRACE) << "Reading bounding box nodes...";
-        filter_nodes(doc, bboxNodes, noHupNodes, filter, bbox);
+        for_each_element(*reader, osm_element_type::NODE, [&](const osm_raw_element& nd) {
+            if (!nd.id || !bbox.contains(Point(nd.lng, nd.lat))) return;
+            bboxNodes.add(nd.id);
+            for (size_t i = 0; i < states.size(); i++)
+            {
+                builders[i].filter_node(nd, states[i]->noHupNodes, states[i]->filter);
+            }
+        });
 
         LOG(TRACE) << "Reading relations...";
-        read_relations(doc, intm_rels, node_rels, wayRels, filter, attr_keys[2], raw_rests);
+        for_each_element(*reader, osm_element_type::RELATION, [&](const osm_raw_element& rel) {
+            for (size_t i = 0; i < states.size(); i++)
+            {
+                auto& st = *states[i];
+                builders[i].read_relation(rel, st.rels, st.nodeRels, st.wayRels, st.filter,
+                                          st.attr_keys[2], st.rawRests);
+            }
+        });
 
         LOG(TRACE) << "Reading edges...";
-        read_edges(doc, g, intm_rels, wayRels, filter, bboxNodes, nodes, mult_nodes,
-                   noHupNodes, attr_keys[1], raw_rests, res, intm_rels.flat, e_tracks,
-                   opts);
+        for_each_element(*reader, osm_element_type::WAY, [&](const osm_raw_element& way) {
+            for (size_t i = 0; i < states.size(); i++)
+            {
+                auto& st = *states[i];
+                builders[i].read_edge(way, st.job.g, st.rels, st.wayRels, st.filter, bboxNodes,
+                                      st.nodes, st.multNodes, st.noHupNodes, st.attr_keys[1],
+                                      st.rawRests, st.job.res, st.rels.flat, st.eTracks,
+                                      st.job.opts);
+            }
+        });
 
         LOG(TRACE) << "Reading kept nodes...";
-        read_nodes(doc, g, intm_rels, node_rels, filter, bboxNodes, nodes,
-                   mult_nodes, orphan_stations, attr_keys[0], intm_rels.flat, opts);
+        for_each_element(*reader, osm_element_type::NODE, [&](const osm_raw_element& nd) {
+            for (size_t i = 0; i < states.size(); i++)
+            {
+                auto& st = *states[i];
+                builders[i].read_node(nd, st.job.g, st.rels, st.nodeRels, st.filter, bboxNodes,
+                                      st.nodes, st.multNodes, st.orphanStations, st.attrGroups,
+                                      st.attr_keys[0], st.rels.flat, st.job.opts);
+            }
+        });
+
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            orphan_stations[state_jobs[i]].swap(states[i]->orphanStations);
+            e_tracks[state_jobs[i]].swap(states[i]->eTracks);
+        }
+        states.clear();
+
+        LOG(TRACE) << "OSM ID set lookups: " << osm::osm_id_set::LOOKUPS
+                   << ", file lookups: " << osm::osm_id_set::FLOOKUPS;
+    }
+
+    std::exception_ptr error;
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        try
+        {
+            if (!cached[i])
+            {
+                prepare_graph(jobs[i].g, bbox, gridSize, packedIndex, e_tracks[i]);
+                if (!cache_keys[i].empty())
+                    cache->store(cache_keys[i], jobs[i].g, jobs[i].res, orphan_stations[i]);
+            }
+            build_graph(jobs[i], bbox, gridSize, packedIndex, orphan_stations[i], import_osm_stations);
+        }
+        catch (...)
+        {
+#pragma omp critical(build_graph_error)
+            error = std::current_exception();
+        }
     }
 
-    LOG(TRACE) << "OSM ID set lookups: " << osm::osm_id_set::LOOKUPS
-               << ", file lookups: " << osm::osm_id_set::FLOOKUPS;
+    if (error) std::rethrow_exception(error);
+}
 
+
+void osm_builder::prepare_graph(trgraph::graph& g,
+                                const bounding_box& bbox,
+                                size_t gridSize,
+                                bool packedIndex,
+                                const edge_tracks& eTracks)
+{
     LOG(TRACE) << "Applying edge track numbers...";
-    write_edge_tracks(e_tracks);
-    e_tracks.clear();
+    write_edge_tracks(eTracks);
 
     {
         LOG(TRACE) << "Fixing gaps...";
-        trgraph::node_grid ng = trgraph::node_grid::build_node_grid(g, gridSize, bbox.get_full_web_merc_box(), false);
+        trgraph::node_grid ng =
+                trgraph::node_grid::build_node_grid(g, gridSize, bbox.get_full_web_merc_box(), false, packedIndex);
         g.fix_gaps(ng);
     }
 
     LOG(TRACE) << "Writing edge geoms...";
     g.write_geometries();
+}
+
+
+void osm_builder::build_graph(const osm_read_job& job,
+                              const bounding_box& bbox,
+                              size_t gridSize,
+                              bool packedIndex,
+                              const router::node_set& orphanStations,
+                              bool import_osm_stations)
+{
+    trgraph::graph& g = job.g;
+    const osm_read_options& opts = job.opts;
 
     LOG(TRACE) << "Snapping stations...";
-    snap_stations(opts, g, bbox, gridSize, fs, res, orphan_stations, import_osm_stations);
+    snap_stations(opts, g, bbox, gridSize, packedIndex, job.fs, job.res, orphanStations, import_osm_stations);
 
     LOG(TRACE) << "Deleting orphan nodes...";
     g.delete_orphan_nodes();
@@ -221,7 +411,7 @@ void osm_builder::read(const std::string& path,
     g.simplify_geometries();
 
     LOG(TRACE) << "Writing other-direction edges...";
-    g.writeODirEdgs(res);
+    g.writeODirEdgs(job.res);
 
     LOG(TRACE) << "Write dummy node self-edges...";
     g.writeSelfEdgs();
@@ -347,17 +537,20 @@ void osm_builder::filter_write(const std::string& in,
     // always empty
     node_id_multimap multNodes;
 
-    pugi::xml_document input_doc;
-    input_doc.load_file(in.c_str());
-
-    pugi::xml_document outout_doc;
-    auto osm_child = outout_doc.append_child("osm");
-    auto bounds_child = osm_child.append_child("bounds");
-    bounds_child.append_attribute("minlat").set_value(box.get_full_box().getLowerLeft().getY());
-    bounds_child.append_attribute("minlon").set_value(box.get_full_box().getLowerLeft().getX());
-    bounds_child.append_attribute("maxlat").set_value(box.get_full_box().getUpperRight().getY());
-    bounds_child.append_attribute("maxlon").set_value(box.get_full_box().getUpperRight().getX());
+    auto reader = osm_reader::from_file(in);
 
+    std::ofstream outstr;
+    outstr.open(out);
+    outstr << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+
+    util::xml::XmlWriter wr(outstr, true, 4);
+    wr.openTag("osm");
+    wr.openTag("bounds",
+               {{"minlat", coord_to_string(box.get_full_box().getLowerLeft().getY())},
+                {"minlon", coord_to_string(box.get_full_box().getLowerLeft().getX())},
+                {"maxlat", coord_to_string(box.get_full_box().getUpperRight().getY())},
+                {"maxlon", coord_to_string(box.get_full_box().getUpperRight().getX())}});
+    wr.closeTag();
 
     osm_filter filter;
     std::vector<attribute_key_set> attr_keys(3);
@@ -372,189 +565,147 @@ void osm_builder::filter_write(const std::string& in,
         filter = filter.merge(osm_filter(o.keepFilter, o.dropFilter));
     }
 
-    filter_nodes(input_doc, bboxNodes, noHupNodes, filter, box);
+    for_each_element(*reader, osm_element_type::NODE, [&](const osm_raw_element& nd) {
+        if (!nd.id || !box.contains(Point(nd.lng, nd.lat))) return;
+        bboxNodes.add(nd.id);
+        filter_node(nd, noHupNodes, filter);
+    });
 
-    read_relations(input_doc, rels, nodeRels, wayRels, filter, attr_keys[2], rests);
-    read_ways(input_doc, wayRels, filter, bboxNodes, attr_keys[1], ways, nodes, rels.flat);
-
-    read_write_nodes(input_doc, osm_child, nodeRels, filter, bboxNodes, nodes, attr_keys[0], rels.flat);
-    read_write_ways(input_doc, osm_child, ways, attr_keys[1]);
+    for_each_element(*reader, osm_element_type::RELATION, [&](const osm_raw_element& rel) {
+        read_relation(rel, rels, nodeRels, wayRels, filter, attr_keys[2], rests);
+    });
+    for_each_element(*reader, osm_element_type::WAY, [&](const osm_raw_element& way) {
+        read_way(way, wayRels, filter, bboxNodes, attr_keys[1], ways, nodes, rels.flat);
+    });
 
     std::sort(ways.begin(), ways.end());
-    read_write_relations(input_doc, osm_child, ways, nodes, filter, attr_keys[2]);
 
-    std::ofstream outstr;
-    outstr.open(out);
-    outout_doc.save(outstr);
+    for_each_element(*reader, osm_element_type::NODE, [&](const osm_raw_element& nd) {
+        read_write_node(nd, wr, nodeRels, filter, bboxNodes, nodes, attr_keys[0], rels.flat);
+    });
+    for_each_element(*reader, osm_element_type::WAY, [&](const osm_raw_element& way) {
+        read_write_way(way, wr, ways, attr_keys[1]);
+    });
+    for_each_element(*reader, osm_element_type::RELATION, [&](const osm_raw_element& rel) {
+        read_write_relation(rel, wr, ways, nodes, filter, attr_keys[2]);
+    });
+
+    wr.closeTags();
 }
 
 
-void osm_builder::read_write_relations(pugi::xml_document& i,
-                                       pugi::xml_node& o,
-                                       osmid_list& ways,
-                                       node_id_map& nodes,
-                                       const osm_filter& filter,
-                                       const attribute_key_set& keepAttrs)
+void osm_builder::read_write_relation(const osm_raw_element& el,
+                                      util::xml::XmlWriter& o,
+                                      const osmid_list& ways,
+                                      const node_id_map& nodes,
+                                      const osm_filter& filter,
+                                      const attribute_key_set& keepAttrs) const
 {
-    for (const auto& xmlrel : i.child("osm").children("relation"))
+    osm_relation rel;
+    uint64_t keep_flags = 0;
+    uint64_t drop_flags = 0;
+
+    rel.id = el.id;
+    // processing attributes
     {
-        osm_relation rel;
-        uint64_t keep_flags = 0;
-        uint64_t drop_flags = 0;
+        keep_attributes(el, keepAttrs, rel.attrs);
 
-        rel.id = xmlrel.attribute("id").as_ullong();
-        // processing attributes
+        if (rel.id && !rel.attrs.empty() &&
+            (keep_flags = filter.keep(rel.attrs, osm_filter::REL)) &&
+            !(drop_flags = filter.drop(rel.attrs, osm_filter::REL)))
         {
-            for (const auto& tag : xmlrel.children("tag"))
-            {
-                const auto& key = tag.attribute("k").as_string();
-                const auto& value = tag.attribute("v").as_string();
-                if (keepAttrs.count(key))
-                {
-                    rel.attrs[key] = value;
-                }
-            }
-
-            if (rel.id && !rel.attrs.empty() &&
-                (keep_flags = filter.keep(rel.attrs, osm_filter::REL)) &&
-                !(drop_flags = filter.drop(rel.attrs, osm_filter::REL)))
-            {
-                rel.keepFlags = keep_flags;
-                rel.dropFlags = drop_flags;
-            }
+            rel.keepFlags = keep_flags;
+            rel.dropFlags = drop_flags;
         }
+    }
+
+    // processing members
+    read_members(el, rel);
+
+    osmid_list realNodes;
+    osmid_list realWays;
+    std::vector<const char*> realNodeRoles;
+    std::vector<const char*> realWayRoles;
 
-        // processing members
-        for (const auto& member : xmlrel.children("member"))
+    for (size_t j = 0; j < rel.ways.size(); j++)
+    {
+        osmid wid = rel.ways[j];
+        const auto& i = std::lower_bound(ways.begin(), ways.end(), wid);
+        if (i != ways.end() && *i == wid)
         {
-            const auto& type = member.attribute("type").as_string();
-            if (strcmp(type, "node") == 0)
-            {
-                osmid id = member.attribute("ref").as_ullong();
-                rel.nodes.emplace_back(id);
-                rel.nodeRoles.emplace_back(member.attribute("role").as_string());
-            }
-            if (strcmp(type, "way") == 0)
-            {
-                osmid id = member.attribute("ref").as_ullong();
-                rel.ways.emplace_back(id);
-                rel.wayRoles.emplace_back(member.attribute("role").as_string());
-            }
+            realWays.push_back(wid);
+            realWayRoles.push_back(rel.wayRoles[j].c_str());
         }
+    }
 
+    for (size_t j = 0; j < rel.nodes.size(); j++)
+    {
+        osmid nid = rel.nodes[j];
+        if (nodes.count(nid))
+        {
+            realNodes.push_back(nid);
+            realNodeRoles.push_back(rel.nodeRoles[j].c_str());
+        }
+    }
 
-        osmid_list realNodes;
-        osmid_list realWays;
-        std::vector<const char*> realNodeRoles;
-        std::vector<const char*> realWayRoles;
+    if (!realNodes.empty() || !realWays.empty())
+    {
+        o.openTag("relation", "id", std::to_string(rel.id));
 
-        for (size_t j = 0; j < rel.ways.size(); j++)
+        for (size_t j = 0; j < realNodes.size(); j++)
         {
-            osmid wid = rel.ways[j];
-            const auto& i = std::lower_bound(ways.begin(), ways.end(), wid);
-            if (i != ways.end() && *i == wid)
-            {
-                realWays.push_back(wid);
-                realWayRoles.push_back(rel.wayRoles[j].c_str());
-            }
+            std::map<std::string, std::string> attrs{{"type", "node"},
+                                                     {"ref", std::to_string(realNodes[j])}};
+            if (strlen(realNodeRoles[j]))
+                attrs["role"] = realNodeRoles[j];
+            o.openTag("member", attrs);
+            o.closeTag();
         }
 
-        for (size_t j = 0; j < rel.nodes.size(); j++)
+        for (size_t j = 0; j < realWays.size(); j++)
         {
-            osmid nid = rel.nodes[j];
-            if (nodes.count(nid))
-            {
-                realNodes.push_back(nid);
-                realNodeRoles.push_back(rel.nodeRoles[j].c_str());
-            }
+            std::map<std::string, std::string> attrs{{"type", "way"},
+                                                     {"ref", std::to_string(realWays[j])}};
+            if (strlen(realWayRoles[j]))
+                attrs["role"] = realWayRoles[j];
+            o.openTag("member", attrs);
+            o.closeTag();
         }
 
-        if (!realNodes.empty() || !realWays.empty())
+        for (const auto& kv : rel.attrs)
         {
-            auto relation_child = o.append_child("relation");
-            relation_child.append_attribute("id").set_value(rel.id);
-
-
-            for (size_t j = 0; j < realNodes.size(); j++)
-            {
-                auto member_child = relation_child.append_child("member");
-                member_child.append_attribute("type").set_value("node");
-                member_child.append_attribute("ref").set_value(realNodes[j]);
-                if (strlen(realNodeRoles[j]))
-                    member_child.append_attribute("role").set_value(realNodeRoles[j]);
-            }
-
-            for (size_t j = 0; j < realWays.size(); j++)
-            {
-                auto member_child = relation_child.append_child("member");
-                member_child.append_attribute("type").set_value("way");
-                member_child.append_attribute("ref").set_value(realWays[j]);
-                if (strlen(realWayRoles[j]))
-                    member_child.append_attribute("role").set_value(realWayRoles[j]);
-            }
-
-            for (const auto& kv : rel.attrs)
-            {
-                auto tag_child = relation_child.append_child("tag");
-                tag_child.append_attribute("k").set_value(kv.first.c_str());
-                tag_child.append_attribute("v").set_value(kv.second.c_str());
-                //                        {"v", pfxml::file::decode(kv.second)}};
-            }
+            o.openTag("tag", {{"k", kv.first}, {"v", kv.second}});
+            o.closeTag();
         }
+        o.closeTag();
     }
 }
 
 
-void osm_builder::read_write_ways(pugi::xml_document& i,
-                                  pugi::xml_node& o,
-                                  osmid_list& ways,
-                                  const attribute_key_set& keepAttrs) const
+void osm_builder::read_write_way(const osm_raw_element& el,
+                                 util::xml::XmlWriter& o,
+                                 const osmid_list& ways,
+                                 const attribute_key_set& keepAttrs) const
 {
-    node_id_multimap empty;
-    for (const auto& wayxml : i.child("osm").children())
-    {
-        bool usable = false;
-        osm_way w;
-        w.id = wayxml.attribute("id").as_ullong();
-        for (auto wid : ways)
-        {
-            if (w.id == wid)
-            {
-                usable = true;
-                break;
-            }
-        }
+    // ways is sorted
+    if (!std::binary_search(ways.begin(), ways.end(), el.id)) return;
 
-        if (usable)
-        {
-            for (const auto& node : wayxml.children("nd"))
-            {
-                osmid nid = node.attribute("ref").as_ullong();
-                w.nodes.push_back(nid);
-            }
-            for (const auto& tag : wayxml.children("tag"))
-            {
-                const auto& key = tag.attribute("k").as_string();
-                const auto& val = tag.attribute("v").as_string();
-                if (keepAttrs.count(key))
-                    w.attrs[key] = val;
-            }
+    osm_way w;
+    w.id = el.id;
+    keep_attributes(el, keepAttrs, w.attrs);
 
-            auto way_child = o.append_child("way");
-            way_child.append_attribute("id").set_value(w.id);
-            for (osmid nid : w.nodes)
-            {
-                auto nd_child = way_child.append_child("nd");
-                nd_child.append_attribute("ref").set_value(nid);
-            }
-            for (const auto& kv : w.attrs)
-            {
-                auto tag_child = way_child.append_child("tag");
-                tag_child.append_attribute("k").set_value(kv.first.c_str());
-                tag_child.append_attribute("v").set_value(kv.second.c_str());
-            }
-        }
+    o.openTag("way", "id", std::to_string(w.id));
+    for (osmid nid : el.nodes)
+    {
+        o.openTag("nd", "ref", std::to_string(nid));
+        o.closeTag();
     }
+    for (const auto& kv : w.attrs)
+    {
+        o.openTag("tag", {{"k", kv.first}, {"v", kv.second}});
+        o.closeTag();
+    }
+    o.closeTag();
 }
 
 
@@ -581,40 +732,17 @@ trgraph::node_payload osm_builder::payload_from_gtfs(const gtfs::stop* s, const
 }
 
 
-int osm_builder::filter_nodes(pugi::xml_document& xml,
-                              osm_id_set& nodes,
-                              osm_id_set& nohupNodes,
-                              const osm_filter& filter,
-                              const bounding_box& bbox) const
+void osm_builder::filter_node(const osm_raw_element& nd,
+                              osm_id_set& noHupNodes,
+                              const osm_filter& filter) const
 {
-
-    for (const auto& node : xml.child("osm").children("node"))
+    for (const auto& tag : nd.tags)
     {
-        osmid cur_id = 0;
-
-        double y = node.attribute("lat").as_double();
-        double x = node.attribute("lon").as_double();
-
-        if (bbox.contains(Point(x, y)))
+        if (filter.nohup(tag.first.c_str(), tag.second.c_str()))
         {
-            cur_id = util::atoul(node.attribute("id").value());
-            nodes.add(cur_id);
-        }
-
-        if (cur_id == 0)
-            continue;
-
-        for (const auto& tag : node.children("tag"))
-        {
-            if (filter.nohup(tag.attribute("k").as_string(),
-                             tag.attribute("v").as_string()))
-            {
-                nohupNodes.add(cur_id);
-            }
+            noHupNodes.add(nd.id);
         }
     }
-
-    return 0;
 }
 
 
@@ -655,133 +783,105 @@ bool osm_builder::keep_way(const osm_way& w, const relation_map& wayRels,
 }
 
 
-void osm_builder::read_ways(pugi::xml_document& xml,
-                            const relation_map& wayRels,
-                            const osm_filter& filter,
-                            const osm_id_set& bBoxNodes,
-                            const attribute_key_set& keepAttrs,
-                            osmid_list& ret,
-                            node_id_map& nodes,
-                            const flat_relations& flatRels)
+void osm_builder::read_way(const osm_raw_element& el,
+                           const relation_map& wayRels,
+                           const osm_filter& filter,
+                           const osm_id_set& bBoxNodes,
+                           const attribute_key_set& keepAttrs,
+                           osmid_list& ret,
+                           node_id_map& nodes,
+                           const flat_relations& flatRels) const
 {
-    for (const auto& wayxml : xml.child("osm").children("way"))
-    {
-        osm_way w;
-        w.id = wayxml.attribute("id").as_ullong();
-        for (const auto& node : wayxml.children("nd"))
-        {
-            osmid nid = node.attribute("ref").as_ullong();
-            w.nodes.push_back(nid);
-        }
-        for (const auto& tag : wayxml.children("tag"))
-        {
-            const auto& key = tag.attribute("k").as_string();
-            const auto& val = tag.attribute("v").as_string();
-            if (keepAttrs.count(key))
-                w.attrs[key] = val;
-        }
+    osm_way w;
+    w.id = el.id;
+    w.nodes = el.nodes;
+    keep_attributes(el, keepAttrs, w.attrs);
 
-        if (keep_way(w, wayRels, filter, bBoxNodes, flatRels))
+    if (keep_way(w, wayRels, filter, bBoxNodes, flatRels))
+    {
+        ret.push_back(w.id);
+        for (auto n : w.nodes)
         {
-            ret.push_back(w.id);
-            for (auto n : w.nodes)
-            {
-                nodes[n] = nullptr;
-            }
+            nodes[n] = nullptr;
         }
     }
 }
 
 
-void osm_builder::read_edges(pugi::xml_document& xml,
-                             trgraph::graph& g,
-                             const relation_list& rels,
-                             const relation_map& wayRels,
-                             const osm_filter& filter,
-                             const osm_id_set& bBoxNodes,
-                             node_id_map& nodes,
-                             node_id_multimap& multNodes,
-                             const osm_id_set& noHupNodes,
-                             const attribute_key_set& keepAttrs,
-                             const restrictions& rest,
-                             trgraph::restrictor& restor,
-                             const flat_relations& flatRels,
-                             edge_tracks& etracks,
-                             const osm_read_options& opts)
+void osm_builder::read_edge(const osm_raw_element& el,
+                            trgraph::graph& g,
+                            const relation_list& rels,
+                            const relation_map& wayRels,
+                            const osm_filter& filter,
+                            const osm_id_set& bBoxNodes,
+                            node_id_map& nodes,
+                            node_id_multimap& multNodes,
+                            const osm_id_set& noHupNodes,
+                            const attribute_key_set& keepAttrs,
+                            const restrictions& rest,
+                            trgraph::restrictor& restor,
+                            const flat_relations& flatRels,
+                            edge_tracks& etracks,
+                            const osm_read_options& opts)
 {
-    for (const auto& xmlway : xml.child("osm").children("way"))
+    osm_way w;
+    w.id = el.id;
+    w.nodes = el.nodes;
+    keep_attributes(el, keepAttrs, w.attrs);
+
+    if (keep_way(w, wayRels, filter, bBoxNodes, flatRels))
     {
-        osm_way w;
-        w.id = xmlway.attribute("id").as_ullong();
-        for (const auto& nd : xmlway.children("nd"))
+        trgraph::node* last = nullptr;
+        std::vector<trgraph::transit_edge_line*> lines;
+        if (wayRels.count(w.id))
         {
-            osmid node_id = nd.attribute("ref").as_ullong();
-            w.nodes.emplace_back(node_id);
+            lines = get_lines(wayRels.find(w.id)->second, rels, opts);
         }
-
-        for (const auto& tag : xmlway.children("tag"))
+        std::string track =
+                getAttrByFirstMatch(opts.edgePlatformRules,
+                                    w.id,
+                                    w.attrs,
+                                    wayRels,
+                                    rels,
+                                    opts.trackNormzer);
+
+        osmid lastnid = 0;
+        for (osmid nid : w.nodes)
         {
-            const auto& key = tag.attribute("k").as_string();
-            const auto& val = tag.attribute("v").as_string();
-            if (keepAttrs.count(key))
+            trgraph::node* n = nullptr;
+            if (noHupNodes.has(nid))
             {
-                w.attrs[key] = val;
+                n = g.addNd();
+                multNodes[nid].insert(n);
             }
-        }
-        if (keep_way(w, wayRels, filter, bBoxNodes, flatRels))
-        {
-            trgraph::node* last = nullptr;
-            std::vector<trgraph::transit_edge_line*> lines;
-            if (wayRels.count(w.id))
+            else if (!nodes.count(nid))
             {
-                lines = get_lines(wayRels.find(w.id)->second, rels, opts);
+                if (!bBoxNodes.has(nid)) continue;
+                n = g.addNd();
+                nodes[nid] = n;
             }
-            std::string track =
-                    getAttrByFirstMatch(opts.edgePlatformRules,
-                                        w.id,
-                                        w.attrs,
-                                        wayRels,
-                                        rels,
-                                        opts.trackNormzer);
-
-            osmid lastnid = 0;
-            for (osmid nid : w.nodes)
+            else
             {
-                trgraph::node* n = nullptr;
-                if (noHupNodes.has(nid))
-                {
-                    n = g.addNd();
-                    multNodes[nid].insert(n);
-                }
-                else if (!nodes.count(nid))
-                {
-                    if (!bBoxNodes.has(nid)) continue;
-                    n = g.addNd();
-                    nodes[nid] = n;
-                }
-                else
-                {
-                    n = nodes[nid];
-                }
-                if (last)
-                {
-                    auto e = g.addEdg(last, n, trgraph::edge_payload());
-                    if (!e) continue;
+                n = nodes[nid];
+            }
+            if (last)
+            {
+                auto e = g.addEdg(last, n, trgraph::edge_payload());
+                if (!e) continue;
 
-                    process_restrictions(nid, w.id, rest, e, n, restor);
-                    process_restrictions(lastnid, w.id, rest, e, last, restor);
+                process_restrictions(nid, w.id, rest, e, n, restor);
+                process_restrictions(lastnid, w.id, rest, e, last, restor);
 
-                    e->pl().add_lines(lines);
-                    e->pl().set_level(filter.level(w.attrs));
-                    e->pl().set_max_speed(string_to_kmh(w.attrs["maxspeed"]));
-                    if (!track.empty()) etracks[e] = track;
+                e->pl().add_lines(lines);
+                e->pl().set_level(filter.level(w.attrs));
+                e->pl().set_max_speed(string_to_kmh(w.attrs["maxspeed"]));
+                if (!track.empty()) etracks[e] = track;
 
-                    if (filter.oneway(w.attrs)) e->pl().setOneWay(1);
-                    if (filter.onewayrev(w.attrs)) e->pl().setOneWay(2);
-                }
-                lastnid = nid;
-                last = n;
+                if (filter.oneway(w.attrs)) e->pl().setOneWay(1);
+                if (filter.onewayrev(w.attrs)) e->pl().setOneWay(2);
             }
+            lastnid = nid;
+            last = n;
         }
     }
 }
@@ -850,141 +950,118 @@ bool osm_builder::keep_node(const osm_node& n,
 }
 
 
-void osm_builder::read_write_nodes(pugi::xml_document& i,
-                                   pugi::xml_node& o,
-                                   const relation_map& nRels,
-                                   const osm_filter& filter,
-                                   const osm_id_set& bBoxNds,
-                                   node_id_map& nds,
-                                   const attribute_key_set& keepAttrs,
-                                   const flat_relations& f) const
+void osm_builder::read_write_node(const osm_raw_element& el,
+                                  util::xml::XmlWriter& o,
+                                  const relation_map& nRels,
+                                  const osm_filter& filter,
+                                  const osm_id_set& bBoxNds,
+                                  node_id_map& nds,
+                                  const attribute_key_set& keepAttrs,
+                                  const flat_relations& f) const
 {
     node_id_multimap empt;
-    for (const auto& xmlnode : i.child("osm").children("node"))
-    {
-        osm_node nd;
-        nd.lat = xmlnode.attribute("lat").as_double();
-        nd.lng = xmlnode.attribute("lon").as_double();
-        nd.id = xmlnode.attribute("id").as_ullong();
 
-        for (const auto& tag : xmlnode.children("tag"))
-        {
-            const auto& key = tag.attribute("k").as_string();
-            const auto& val = tag.attribute("v").as_string();
+    osm_node nd;
+    nd.lat = el.lat;
+    nd.lng = el.lng;
+    nd.id = el.id;
+    keep_attributes(el, keepAttrs, nd.attrs);
 
-            if (keepAttrs.count(key))
-                nd.attrs[key] = val;
-        }
-
-        if (keep_node(nd, nds, empt, nRels, bBoxNds, filter, f))
+    if (keep_node(nd, nds, empt, nRels, bBoxNds, filter, f))
+    {
+        nds[nd.id] = nullptr;
+        o.openTag("node", {{"id", std::to_string(nd.id)},
+                           {"lat", coord_to_string(nd.lat)},
+                           {"lon", coord_to_string(nd.lng)}});
+        for (const auto& kv : nd.attrs)
         {
-            nds[nd.id] = nullptr;
-            pugi::xml_node node = o.append_child("node");
-            node.append_attribute("id").set_value(nd.id);
-            node.append_attribute("lat").set_value(nd.lat);
-            node.append_attribute("lon").set_value(nd.lng);
-            for (const auto& kv : nd.attrs)
-            {
-                pugi::xml_node tag = node.append_child("tag");
-                tag.append_attribute("k").set_value(kv.first.c_str());
-                tag.append_attribute("v").set_value(kv.second.c_str());
-            }
+            o.openTag("tag", {{"k", kv.first}, {"v", kv.second}});
+            o.closeTag();
         }
+        o.closeTag();
     }
 }
 
 
-void osm_builder::read_nodes(pugi::xml_document& xml,
-                             trgraph::graph& g,
-                             const relation_list& rels,
-                             const relation_map& nodeRels,
-                             const osm_filter& filter,
-                             const osm_id_set& bBoxNodes,
-                             node_id_map& nodes,
-                             node_id_multimap& multNodes,
-                             router::node_set& orphanStations,
-                             const attribute_key_set& keepAttrs,
-                             const flat_relations& fl,
-                             const osm_read_options& opts) const
+void osm_builder::read_node(const osm_raw_element& el,
+                            trgraph::graph& g,
+                            const relation_list& rels,
+                            const relation_map& nodeRels,
+                            const osm_filter& filter,
+                            const osm_id_set& bBoxNodes,
+                            node_id_map& nodes,
+                            node_id_multimap& multNodes,
+                            router::node_set& orphanStations,
+                            station_attribute_groups& attrGroups,
+                            const attribute_key_set& keepAttrs,
+                            const flat_relations& fl,
+                            const osm_read_options& opts) const
 {
-    station_attribute_groups attr_groups;
+    osm_node nd;
+    nd.lat = el.lat;
+    nd.lng = el.lng;
+    nd.id = el.id;
+    keep_attributes(el, keepAttrs, nd.attrs);
 
-    for (const auto& xmlnode : xml.child("osm").children("node"))
+    if (keep_node(nd, nodes, multNodes, nodeRels, bBoxNodes, filter, fl))
     {
-        osm_node nd;
-        nd.lat = xmlnode.attribute("lat").as_double();
-        nd.lng = xmlnode.attribute("lon").as_double();
-        nd.id = xmlnode.attribute("id").as_ullong();
-
-        for (const auto& tag : xmlnode.children("tag"))
+        trgraph::node* n = nullptr;
+        auto pos = util::geo::latLngToWebMerc(nd.lat, nd.lng);
+        if (nodes.count(nd.id))
         {
-            const auto& key = tag.attribute("k").as_string();
-            const auto& val = tag.attribute("v").as_string();
-
-            if (keepAttrs.count(key))
-                nd.attrs[key] = val;
+            n = nodes[nd.id];
+            n->pl().set_geom(pos);
+            if (filter.station(nd.attrs))
+            {
+                auto si = get_station_info(n, nd.id, pos, nd.attrs, &attrGroups, nodeRels,
+                                           rels, opts);
+                if (si.has_value())
+                {
+                    n->pl().set_si(si.value());
+                }
+            }
+            else if (filter.blocker(nd.attrs))
+            {
+                n->pl().set_blocker();
+            }
         }
-
-        if (keep_node(nd, nodes, multNodes, nodeRels, bBoxNodes, filter, fl))
+        else if (multNodes.count(nd.id))
         {
-            trgraph::node* n = nullptr;
-            auto pos = util::geo::latLngToWebMerc(nd.lat, nd.lng);
-            if (nodes.count(nd.id))
+            for (auto* node : multNodes[nd.id])
             {
-                n = nodes[nd.id];
-                n->pl().set_geom(pos);
+                node->pl().set_geom(pos);
                 if (filter.station(nd.attrs))
                 {
-                    auto si = get_station_info(n, nd.id, pos, nd.attrs, &attr_groups, nodeRels,
+                    auto si = get_station_info(node, nd.id, pos, nd.attrs, &attrGroups, nodeRels,
                                                rels, opts);
                     if (si.has_value())
                     {
-                        n->pl().set_si(si.value());
+                        node->pl().set_si(si.value());
                     }
                 }
                 else if (filter.blocker(nd.attrs))
                 {
-                    n->pl().set_blocker();
+                    node->pl().set_blocker();
                 }
             }
-            else if (multNodes.count(nd.id))
+        }
+        else
+        {
+            // these are nodes without any connected edges
+            if (filter.station(nd.attrs))
             {
-                for (auto* node : multNodes[nd.id])
+                auto tmp = g.addNd(trgraph::node_payload(pos));
+                auto si = get_station_info(tmp, nd.id, pos, nd.attrs, &attrGroups, nodeRels, rels, opts);
+
+                if (si.has_value())
                 {
-                    node->pl().set_geom(pos);
-                    if (filter.station(nd.attrs))
-                    {
-                        auto si = get_station_info(node, nd.id, pos, nd.attrs, &attr_groups, nodeRels,
-                                                   rels, opts);
-                        if (si.has_value())
-                        {
-                            node->pl().set_si(si.value());
-                        }
-                    }
-                    else if (filter.blocker(nd.attrs))
-                    {
-                        node->pl().set_blocker();
-                    }
+                    tmp->pl().set_si(si.value());
                 }
-            }
-            else
-            {
-                // these are nodes without any connected edges
-                if (filter.station(nd.attrs))
-                {
-                    auto tmp = g.addNd(trgraph::node_payload(pos));
-                    auto si = get_station_info(tmp, nd.id, pos, nd.attrs, &attr_groups, nodeRels, rels, opts);
-
-                    if (si.has_value())
-                    {
-                        tmp->pl().set_si(si.value());
-                    }
 
-                    if (tmp->pl().get_si())
-                    {
-                        tmp->pl().get_si()->set_is_from_osm(false);
-                        orphanStations.insert(tmp);
-                    }
+                if (tmp->pl().get_si())
+                {
+                    tmp->pl().get_si()->set_is_from_osm(false);
+                    orphanStations.insert(tmp);
                 }
             }
         }
@@ -992,78 +1069,52 @@ void osm_builder::read_nodes(pugi::xml_document& xml,
 }
 
 
-void osm_builder::read_relations(pugi::xml_document& xml,
-                                 relation_list& rels,
-                                 relation_map& nodeRels,
-                                 relation_map& wayRels,
-                                 const osm_filter& filter,
-                                 const attribute_key_set& keepAttrs,
-                                 restrictions& rests) const
+void osm_builder::read_relation(const osm_raw_element& el,
+                                relation_list& rels,
+                                relation_map& nodeRels,
+                                relation_map& wayRels,
+                                const osm_filter& filter,
+                                const attribute_key_set& keepAttrs,
+                                restrictions& rests) const
 {
-    for (const auto& xmlrel : xml.child("osm").children("relation"))
+    osm_relation rel;
+    uint64_t keep_flags = 0;
+    uint64_t drop_flags = 0;
+
+    rel.id = el.id;
+    // processing attributes
     {
-        osm_relation rel;
-        uint64_t keep_flags = 0;
-        uint64_t drop_flags = 0;
+        keep_attributes(el, keepAttrs, rel.attrs);
 
-        rel.id = xmlrel.attribute("id").as_ullong();
-        // processing attributes
+        if (rel.id && !rel.attrs.empty() &&
+            (keep_flags = filter.keep(rel.attrs, osm_filter::REL)) &&
+            !(drop_flags = filter.drop(rel.attrs, osm_filter::REL)))
         {
-            for (const auto& tag : xmlrel.children("tag"))
-            {
-                const auto& key = tag.attribute("k").as_string();
-                const auto& value = tag.attribute("v").as_string();
-                if (keepAttrs.count(key))
-                {
-                    rel.attrs[key] = value;
-                }
-            }
-
-            if (rel.id && !rel.attrs.empty() &&
-                (keep_flags = filter.keep(rel.attrs, osm_filter::REL)) &&
-                !(drop_flags = filter.drop(rel.attrs, osm_filter::REL)))
-            {
-                rel.keepFlags = keep_flags;
-                rel.dropFlags = drop_flags;
-            }
-
-            rels.rels.emplace_back(rel.attrs);
+            rel.keepFlags = keep_flags;
+            rel.dropFlags = drop_flags;
         }
 
-        // processing members
-        for (const auto& member : xmlrel.children("member"))
-        {
-            const auto& type = member.attribute("type").as_string();
-            if (strcmp(type, "node") == 0)
-            {
-                osmid id = member.attribute("ref").as_ullong();
-                rel.nodes.emplace_back(id);
-                rel.nodeRoles.emplace_back(member.attribute("role").as_string());
-            }
-            if (strcmp(type, "way") == 0)
-            {
-                osmid id = member.attribute("ref").as_ullong();
-                rel.ways.emplace_back(id);
-                rel.wayRoles.emplace_back(member.attribute("role").as_string());
-            }
-        }
+        rels.rels.emplace_back(rel.attrs);
+    }
 
-        if (rel.keepFlags & osm::REL_NO_DOWN)
-        {
-            rels.flat.insert(rels.rels.size() - 1);
-        }
-        for (osmid id : rel.nodes)
-        {
-            nodeRels[id].push_back(rels.rels.size() - 1);
-        }
-        for (osmid id : rel.ways)
-        {
-            wayRels[id].push_back(rels.rels.size() - 1);
-        }
+    // processing members
+    read_members(el, rel);
 
-        // TODO(patrick): this is not needed for the filtering - remove it here!
-        read_restrictions(rel, rests, filter);
+    if (rel.keepFlags & osm::REL_NO_DOWN)
+    {
+        rels.flat.insert(rels.rels.size() - 1);
+    }
+    for (osmid id : rel.nodes)
+    {
+        nodeRels[id].push_back(rels.rels.size() - 1);
+    }
+    for (osmid id : rel.ways)
+    {
+        wayRels[id].push_back(rels.rels.size() - 1);
     }
+
+    // TODO(patrick): this is not needed for the filtering - remove it here!
+    read_restrictions(rel, rests, filter);
 }
 
 
@@ -1360,80 +1411,197 @@ trgraph::node* osm_builder::eqStatReach(const trgraph::edge* e, const trgraph::s
 }
 
 
-std::set<trgraph::node*> osm_builder::snap_station(trgraph::graph& g,
-                                                   trgraph::node_payload& s,
-                                          trgraph::edge_grid& eg,
-                                          trgraph::node_grid& sng,
-                                          const osm_read_options& opts,
-                                          trgraph::restrictor& restor,
-                                          bool surHeur,
-                                          bool orphSnap,
-                                          double maxD,
-                                          bool import_osm_stations)
+// the box around p with everything within d meters of it, with some slack for
+// the distance approximations
+inline BOX snap_region(const POINT& p, double d)
+{
+    return util::geo::pad(util::geo::getBoundingBox(p), 1.1 * d / util::geo::webMercDistFactor(p) + 1);
+}
+
+
+// what the depth searches for a snap candidate may read
+inline BOX candidate_region(const trgraph::edge* e, const POINT& geom, double maxD, const osm_read_options& opts)
+{
+    BOX ret = snap_region(geom, std::max(2 * maxD, opts.maxBlockDistance));
+    ret = util::geo::extendBox(*e->getFrom()->pl().get_geom(), ret);
+    return util::geo::extendBox(*e->getTo()->pl().get_geom(), ret);
+}
+
+
+inline bool intersects_any(const std::vector<BOX>& boxes, const BOX& box)
+{
+    return std::any_of(boxes.begin(), boxes.end(), [&box](const BOX& b) { return util::geo::intersects(b, box); });
+}
+
+
+// true if the plan was made for the station as it is now
+inline bool planned_for(const snap_plan& plan, const trgraph::node_payload& s)
+{
+    return *s.get_geom() == plan.geom && s.get_si()->get_name() == plan.name &&
+           s.get_si()->get_alternative_names() == plan.altNames;
+}
+
+
+// true if committing the plan changes the station it was made for
+inline bool changes_station(const snap_plan& plan, const osm_read_options& opts)
+{
+    if (plan.best && (plan.best->pl().get_si()->get_name() != plan.name ||
+                      plan.best->pl().get_si()->get_alternative_names() != plan.altNames))
+        return true;
+
+    // the station is moved onto the first edge it is not placed on an end of
+    return std::any_of(plan.candidates.begin(), plan.candidates.end(), [&opts](const snap_candidate& c) {
+        if (c.eq || c.blocked || c.e->pl().level() > opts.maxSnapLevel)
+            return false;
+        for (const auto* n : {c.e->getFrom(), c.e->getTo()})
+        {
+            if (!n->pl().get_si() && webMercMeterDist(c.geom, *n->pl().get_geom()) < 2)
+                return false;
+        }
+        return true;
+    });
+}
+
+
+router::node_set osm_builder::snap_station(trgraph::graph& g,
+                                           trgraph::node_payload& s,
+                                           trgraph::edge_grid& eg,
+                                           trgraph::node_grid& sng,
+                                           const osm_read_options& opts,
+                                           trgraph::restrictor& restor,
+                                           bool surHeur,
+                                           bool orphSnap,
+                                           double maxD,
+                                           bool import_osm_stations)
+{
+    std::vector<BOX> changed;
+    return commit_snap(g, s, plan_snap(s, eg, sng, opts, surHeur, orphSnap, maxD, import_osm_stations),
+                       eg, sng, opts, restor, &changed);
+}
+
+
+snap_plan osm_builder::plan_snap(const trgraph::node_payload& s,
+                                 trgraph::edge_grid& eg,
+                                 trgraph::node_grid& sng,
+                                 const osm_read_options& opts,
+                                 bool surHeur,
+                                 bool orphSnap,
+                                 double maxD,
+                                 bool import_osm_stations)
 {
     assert(s.get_si());
-    std::set<trgraph::node*> ret;
+    snap_plan plan;
+    plan.geom = *s.get_geom();
+    plan.name = s.get_si()->get_name();
+    plan.altNames = s.get_si()->get_alternative_names();
+    plan.maxD = maxD;
+    plan.orphSnap = orphSnap;
 
-    edge_candidate_priority_queue pq;
+    // the station info the station will have when it is snapped
+    const trgraph::station_info* si = s.get_si();
 
     if (import_osm_stations)
     {
         // importing data from osm -> mainly used to correct stations and positions
-        const auto* best = sng.get_distance_matching_node(s, opts.maxSnapFallbackHeurDistance);
-        if (best)
-        {
-            pq = eg.get_edge_candidates(*best->pl().get_geom(), maxD);
-            s.set_si(trgraph::station_info(*best->pl().get_si()));
-        }
-        else
-        {
-            pq = eg.get_edge_candidates(*s.get_geom(), maxD);
-        }
-    }
-    else
-    {
-        // fallback to normal operating mode
-        pq = eg.get_edge_candidates(*s.get_geom(), maxD);
+        plan.lookup = snap_region(plan.geom, opts.maxSnapFallbackHeurDistance);
+        plan.best = sng.get_distance_matching_node(s, opts.maxSnapFallbackHeurDistance);
+        if (plan.best)
+            si = plan.best->pl().get_si();
     }
 
+    // fallback to normal operating mode without a best station
+    const POINT& center = plan.best ? *plan.best->pl().get_geom() : plan.geom;
+    edge_candidate_priority_queue pq = eg.get_edge_candidates(center, maxD);
+    plan.lookup = util::geo::extendBox(snap_region(center, maxD), plan.lookup);
+
     if (pq.empty() && surHeur)
     {
         // no station found in the first round, try again with the nearest
         // surrounding station with matching name
-        const trgraph::node* best = sng.get_matching_node(s, opts.maxSnapFallbackHeurDistance);
+        plan.lookup = util::geo::extendBox(snap_region(plan.geom, opts.maxSnapFallbackHeurDistance), plan.lookup);
+        const trgraph::node* best = plan.best
+                ? sng.get_matching_node(trgraph::node_payload(plan.geom, *si), opts.maxSnapFallbackHeurDistance)
+                : sng.get_matching_node(s, opts.maxSnapFallbackHeurDistance);
         if (best)
         {
             pq = eg.get_edge_candidates(*best->pl().get_geom(), maxD);
+            plan.lookup = util::geo::extendBox(snap_region(*best->pl().get_geom(), maxD), plan.lookup);
         }
         else
         {
             // if still no luck, get edge cands in fallback snap distance
-            pq = eg.get_edge_candidates(*s.get_geom(), opts.maxSnapFallbackHeurDistance);
+            pq = eg.get_edge_candidates(plan.geom, opts.maxSnapFallbackHeurDistance);
         }
     }
 
-    while (!pq.empty())
+    std::vector<trgraph::edge*> edges;
+    for (; !pq.empty(); pq.pop())
+        edges.push_back(pq.top().second);
+    plan.candidates.resize(edges.size());
+
+    // only runs in parallel if the plan is not made in parallel to others
+#pragma omp parallel for schedule(dynamic) if (edges.size() > 1)
+    for (size_t i = 0; i < edges.size(); i++)
     {
-        auto* e = pq.top().second;
-        pq.pop();
-        auto geom = util::geo::projectOn(*e->getFrom()->pl().get_geom(),
-                                         *s.get_geom(),
-                                         *e->getTo()->pl().get_geom());
+        auto* e = edges[i];
+        auto& c = plan.candidates[i];
+        c.e = e;
+        c.geom = util::geo::projectOn(*e->getFrom()->pl().get_geom(), plan.geom, *e->getTo()->pl().get_geom());
+        c.eq = eqStatReach(e, si, c.geom, 2 * maxD, 0, opts.maxAngleSnapReach, orphSnap);
+        if (!c.eq && e->pl().level() <= opts.maxSnapLevel)
+            c.blocked = is_blocked(e, si, c.geom, opts.maxBlockDistance, 0, opts.maxAngleSnapReach);
+    }
 
-        trgraph::node* eq = nullptr;
-        if (!(eq = eqStatReach(e, s.get_si(), geom, 2 * maxD, 0, opts.maxAngleSnapReach, orphSnap)))
+    plan.region = plan.lookup;
+    for (const auto& c : plan.candidates)
+        plan.region = util::geo::extendBox(candidate_region(c.e, c.geom, maxD, opts), plan.region);
+
+    return plan;
+}
+
+
+router::node_set osm_builder::commit_snap(trgraph::graph& g,
+                                          trgraph::node_payload& s,
+                                          const snap_plan& plan,
+                                          trgraph::edge_grid& eg,
+                                          trgraph::node_grid& sng,
+                                          const osm_read_options& opts,
+                                          trgraph::restrictor& restor,
+                                          std::vector<BOX>* changed)
+{
+    assert(s.get_si());
+    router::node_set ret;
+
+    if (plan.best)
+        s.set_si(trgraph::station_info(*plan.best->pl().get_si()));
+
+    // once the station was placed on an edge, the remaining candidates are
+    // projected from its new position
+    bool moved = false;
+
+    for (const auto& c : plan.candidates)
+    {
+        auto* e = c.e;
+        auto geom = c.geom;
+        trgraph::node* eq = c.eq;
+        bool blocked = c.blocked;
+
+        if (moved || intersects_any(*changed, candidate_region(e, geom, plan.maxD, opts)))
+        {
+            geom = util::geo::projectOn(*e->getFrom()->pl().get_geom(),
+                                        *s.get_geom(),
+                                        *e->getTo()->pl().get_geom());
+            eq = eqStatReach(e, s.get_si(), geom, 2 * plan.maxD, 0, opts.maxAngleSnapReach, plan.orphSnap);
+            blocked = !eq && e->pl().level() <= opts.maxSnapLevel &&
+                      is_blocked(e, s.get_si(), geom, opts.maxBlockDistance, 0, opts.maxAngleSnapReach);
+        }
+
+        if (!eq)
         {
             if (e->pl().level() > opts.maxSnapLevel)
                 continue;
-            if (is_blocked(e,
-                           s.get_si(),
-                           geom,
-                           opts.maxBlockDistance,
-                           0,
-                           opts.maxAngleSnapReach))
-            {
+            if (blocked)
                 continue;
-            }
 
             // if the projected position is near (< 2 meters) the end point of this
             // way and the endpoint is not already a station, place the station there.
@@ -1444,6 +1612,7 @@ std::set<trgraph::node*> osm_builder::snap_station(trgraph::graph& g,
                 if (s.get_si()->get_group())
                     s.get_si()->get_group()->add_node(e->getFrom());
 
+                changed->push_back(util::geo::getBoundingBox(*e->getFrom()->pl().get_geom()));
                 ret.insert(e->getFrom());
             }
             else if (!e->getTo()->pl().get_si() && webMercMeterDist(geom, *e->getTo()->pl().get_geom()) < 2)
@@ -1453,10 +1622,16 @@ std::set<trgraph::node*> osm_builder::snap_station(trgraph::graph& g,
                 if (s.get_si()->get_group())
                     s.get_si()->get_group()->add_node(e->getTo());
 
+                changed->push_back(util::geo::getBoundingBox(*e->getTo()->pl().get_geom()));
                 ret.insert(e->getTo());
             }
             else
             {
+                BOX split = util::geo::getBoundingBox(*e->pl().get_geom());
+                split = util::geo::extendBox(*e->getFrom()->pl().get_geom(), split);
+                changed->push_back(util::geo::extendBox(*e->getTo()->pl().get_geom(), split));
+                moved = true;
+
                 s.set_geom(geom);
                 trgraph::node* n = g.addNd(s);
 
@@ -1506,6 +1681,108 @@ std::set<trgraph::node*> osm_builder::snap_station(trgraph::graph& g,
 }
 
 
+void osm_builder::snap_in_batches(trgraph::graph& g,
+                                  const std::vector<snap_call>& calls,
+                                  trgraph::edge_grid& eg,
+                                  trgraph::node_grid& sng,
+                                  const osm_read_options& opts,
+                                  trgraph::restrictor& restor,
+                                  bool import_osm_stations,
+                                  const std::function<void(size_t, trgraph::node_payload&,
+                                                           const router::node_set&)>& snapped)
+{
+    // the plans of a batch are made against the graph as it was before the
+    // batch. A plan that read something a snap before it in the batch changed
+    // is made again, so the result is the same as with snaps one after another.
+    // Small batches keep those conflicts rare
+    const size_t batch_size = 64 * static_cast<size_t>(omp_get_max_threads());
+
+    std::vector<snap_plan> plans;
+    std::vector<char> ahead;
+    std::vector<size_t> next;
+    // what the snaps of the current batch changed so far
+    std::vector<BOX> changes;
+    std::vector<size_t> hits;
+    std::vector<BOX> changed;
+    size_t in_order = 0;
+
+    for (size_t start = 0; start < calls.size(); start += batch_size)
+    {
+        size_t end = std::min(start + batch_size, calls.size());
+        plans.resize(end - start);
+        ahead.assign(end - start, false);
+
+        // a call on the payload of the call before it is only planned ahead if
+        // the plan before does not change the station, it would be stale otherwise
+        next.clear();
+        for (size_t i = start; i < end; i++)
+        {
+            if (i == start || !calls[i].pl || calls[i].pl != calls[i - 1].pl)
+                next.push_back(i);
+        }
+
+        while (!next.empty())
+        {
+#pragma omp parallel for schedule(dynamic)
+            for (size_t j = 0; j < next.size(); j++)
+            {
+                const auto& c = calls[next[j]];
+                plans[next[j] - start] = plan_snap(c.pl ? *c.pl : c.station->pl(), eg, sng, opts, c.surHeur, false,
+                                                   c.maxD, import_osm_stations);
+            }
+
+            size_t num = 0;
+            for (size_t i : next)
+            {
+                ahead[i - start] = true;
+                if (i + 1 < end && calls[i + 1].pl && calls[i + 1].pl == calls[i].pl &&
+                    !changes_station(plans[i - start], opts))
+                    next[num++] = i + 1;
+            }
+            next.resize(num);
+        }
+
+        util::geo::PackedRTree<size_t, PFAEDLE_PRECISION> touched;
+        touched.build();
+        changes.clear();
+
+        for (size_t i = start; i < end; i++)
+        {
+            const auto& c = calls[i];
+            trgraph::node_payload copy = c.station ? c.station->pl() : trgraph::node_payload();
+            if (c.station)
+                copy.get_si()->set_is_from_osm(false);
+            trgraph::node_payload& pl = c.pl ? *c.pl : copy;
+
+            snap_plan& plan = plans[i - start];
+            changed.clear();
+            touched.get(plan.region, &hits);
+            for (size_t h : hits)
+                changed.push_back(changes[h]);
+
+            if (!ahead[i - start] || !planned_for(plan, pl) || intersects_any(changed, plan.lookup))
+            {
+                plan = plan_snap(pl, eg, sng, opts, c.surHeur, false, c.maxD, import_osm_stations);
+                changed.clear();
+                in_order++;
+            }
+
+            size_t before = changed.size();
+            const auto& r = commit_snap(g, pl, plan, eg, sng, opts, restor, &changed);
+            for (size_t j = before; j < changed.size(); j++)
+            {
+                touched.add(changed[j], changes.size());
+                changes.push_back(changed[j]);
+            }
+
+            snapped(i, pl, r);
+        }
+    }
+
+    LOG(TRACE) << in_order << " of " << calls.size() << " station snaps were planned one after another";
+}
+
+
 trgraph::station_group* osm_builder::group_stats(const router::node_set& s)
 {
     if (s.empty())
@@ -1650,63 +1927,87 @@ void osm_builder::snap_stations(const osm_read_options& opts,
                                 trgraph::graph& g,
                                 const bounding_box& bbox,
                                 size_t gridSize,
+                                bool packedIndex,
                                 router::feed_stops& fs,
                                 trgraph::restrictor& res,
                                 const router::node_set& orphanStations,
                                 const bool import_osm_stations)
 {
-    trgraph::node_grid sng = trgraph::node_grid::build_node_grid(g, gridSize, bbox.get_full_web_merc_box(), true);
-    trgraph::edge_grid eg = trgraph::edge_grid::build_edge_grid(g, gridSize, bbox.get_full_web_merc_box());
+    const BOX box = bbox.get_full_web_merc_box();
+    trgraph::node_grid sng = trgraph::node_grid::build_node_grid(g, gridSize, box, true, packedIndex);
+    trgraph::edge_grid eg = trgraph::edge_grid::build_edge_grid(g, gridSize, box, packedIndex);
 
-    LOG(DEBUG) << "Grid size of " << sng.getXWidth() << "x" << sng.getYHeight();
+    if (packedIndex)
+        LOG(DEBUG) << "Using packed R-trees";
+    else
+        LOG(DEBUG) << "Grid size of " << sng.getXWidth() << "x" << sng.getYHeight();
 
+    std::vector<snap_call> calls;
     for (double d : opts.maxSnapDistances)
     {
-        for (auto s : orphanStations)
-        {
-            POINT geom = *s->pl().get_geom();
-            trgraph::node_payload pl = s->pl();
-            pl.get_si()->set_is_from_osm(false);
-            const auto& r = snap_station(g, pl, eg, sng, opts, res, false, false, d, import_osm_stations);
-            group_stats(r);
-            for (auto n : r)
-            {
-                // if the snapped station is very near to the original OSM
-                // station, set is-from-osm to true
-                if (webMercMeterDist(geom, *n->pl().get_geom()) < opts.maxOsmStationDistance)
-                {
-                    if (n->pl().get_si()) n->pl().get_si()->set_is_from_osm(true);
-                }
-            }
-        }
+        for (auto* s : orphanStations)
+            calls.push_back({nullptr, s, d, false});
     }
 
-    std::vector<const gtfs::stop*> not_snapped;
+    snap_in_batches(g, calls, eg, sng, opts, res, import_osm_stations,
+                    [&](size_t i, trgraph::node_payload&, const router::node_set& r) {
+                        const POINT& geom = *calls[i].station->pl().get_geom();
+                        group_stats(r);
+                        for (auto n : r)
+                        {
+                            // if the snapped station is very near to the original OSM
+                            // station, set is-from-osm to true
+                            if (webMercMeterDist(geom, *n->pl().get_geom()) < opts.maxOsmStationDistance)
+                            {
+                                if (n->pl().get_si()) n->pl().get_si()->set_is_from_osm(true);
+                            }
+                        }
+                    });
+
+    // every stop is tried with all snap distances before the next one
+    std::vector<const gtfs::stop*> stops;
+    std::vector<trgraph::node_payload> pls;
+    stops.reserve(fs.size());
+    pls.reserve(fs.size());
+    for (const auto& s : fs)
+    {
+        stops.push_back(s.first);
+        pls.emplace_back(payload_from_gtfs(s.first, opts));
+    }
 
-    for (auto& s : fs)
+    const size_t num_distances = opts.maxSnapDistances.size();
+    calls.clear();
+    for (auto& pl : pls)
     {
-        bool snapped = false;
-        auto pl = payload_from_gtfs(s.first, opts);
-        for (size_t i = 0; i < opts.maxSnapDistances.size(); i++)
-        {
-            double d = opts.maxSnapDistances[i];
+        for (size_t i = 0; i < num_distances; i++)
+            calls.push_back({&pl, nullptr, opts.maxSnapDistances[i], i == num_distances - 1});
+    }
 
-            trgraph::station_group* group = group_stats(
-                    snap_station(g, pl, eg, sng, opts, res,
-                                 i == opts.maxSnapDistances.size() - 1, false, d, import_osm_stations));
+    std::vector<char> snapped(stops.size(), false);
+    snap_in_batches(g, calls, eg, sng, opts, res, import_osm_stations,
+                    [&](size_t i, trgraph::node_payload&, const router::node_set& r) {
+                        trgraph::station_group* group = group_stats(r);
 
-            if (group)
-            {
-                group->add_stop(s.first);
-                fs[s.first] = *group->get_nodes().begin();
-                snapped = true;
-            }
-        }
-        if (!snapped)
+                        if (group)
+                        {
+                            const gtfs::stop* s = stops[i / num_distances];
+                            group->add_stop(s);
+                            fs[s] = *group->get_nodes().begin();
+                            snapped[i / num_distances] = true;
+                        }
+                    });
+
+    std::vector<const gtfs::stop*> not_snapped;
+
+    for (size_t j = 0; j < stops.size(); j++)
+    {
+        if (!snapped[j])
         {
+            const gtfs::stop* s = stops[j];
+            const auto& pl = pls[j];
             LOG(TRACE) << "Could not snap station "
                        << "(" << pl.get_si()->get_name() << ")"
-                       << " (" << s.first->stop_lon << "," << s.first->stop_lon
+                       << " (" << s->stop_lon << "," << s->stop_lon
                        << ") in normal run, trying again later in orphan mode.";
             if (!bbox.contains(*pl.get_geom()))
             {
@@ -1714,7 +2015,7 @@ void osm_builder::snap_stations(const osm_read_options& opts,
                            << "' does not lie within the bounds for this graph and "
                               "may be a stray station";
             }
-            not_snapped.push_back(s.first);
+            not_snapped.push_back(s);
         }
     }
 
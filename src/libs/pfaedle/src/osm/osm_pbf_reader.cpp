@@ -0,0 +1,544 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include "pfaedle/osm/osm_pbf_reader.h"
+
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifdef ZLIB_FOUND
+#include <zlib.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_max_threads() 1
+#endif
+
+using pfaedle::osm::osm_element_type;
+using pfaedle::osm::osm_pbf_reader;
+using pfaedle::osm::osm_raw_element;
+
+namespace
+{
+// limits from the OSM PBF specification
+const size_t MAX_BLOB_HEADER_SIZE = 64 * 1024;
+const size_t MAX_BLOB_SIZE = 32 * 1024 * 1024;
+
+// number of blocks decoded at once per thread
+const size_t BLOCKS_PER_THREAD = 2;
+
+/*
+ * Minimal protocol buffer message cursor, only the wire types used by the
+ * OSM PBF format are supported
+ */
+class pbf_message
+{
+public:
+    explicit pbf_message(std::string_view data) :
+        _cur(reinterpret_cast<const uint8_t*>(data.data())),
+        _end(reinterpret_cast<const uint8_t*>(data.data()) + data.size()) {}
+
+    bool empty() const { return _cur >= _end; }
+
+    // advance to the next field, return false at the end of the message
+    bool next()
+    {
+        if (empty()) return false;
+        uint64_t key = varint();
+        _field = key >> 3;
+        _wire = key & 7;
+        return true;
+    }
+
+    uint32_t field() const { return _field; }
+
+    uint64_t varint()
+    {
+        uint64_t ret = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (empty()) throw std::runtime_error("Truncated varint");
+            uint8_t b = *_cur++;
+            ret |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return ret;
+        }
+        throw std::runtime_error("Malformed varint");
+    }
+
+    int64_t svarint()
+    {
+        uint64_t v = varint();
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    }
+
+    std::string_view bytes()
+    {
+        uint64_t len = varint();
+        if (len > static_cast<uint64_t>(_end - _cur)) throw std::runtime_error("Truncated field");
+        std::string_view ret(reinterpret_cast<const char*>(_cur), len);
+        _cur += len;
+        return ret;
+    }
+
+    void skip()
+    {
+        size_t n = 0;
+        switch (_wire)
+        {
+            case 0:
+                varint();
+                return;
+            case 1:
+                n = 8;
+                break;
+            case 2:
+                bytes();
+                return;
+            case 5:
+                n = 4;
+                break;
+            default:
+                throw std::runtime_error("Unsupported wire type");
+        }
+        if (n > static_cast<size_t>(_end - _cur)) throw std::runtime_error("Truncated field");
+        _cur += n;
+    }
+
+private:
+    const uint8_t* _cur;
+    const uint8_t* _end;
+    uint32_t _field = 0;
+    uint32_t _wire = 0;
+};
+
+std::vector<uint64_t> packed(std::string_view data)
+{
+    std::vector<uint64_t> ret;
+    pbf_message m(data);
+    while (!m.empty()) ret.push_back(m.varint());
+    return ret;
+}
+
+std::vector<int64_t> packed_signed(std::string_view data)
+{
+    std::vector<int64_t> ret;
+    pbf_message m(data);
+    while (!m.empty()) ret.push_back(m.svarint());
+    return ret;
+}
+
+// undo the delta coding of packed ids and coordinates in place
+void undelta(std::vector<int64_t>& vals)
+{
+    for (size_t i = 1; i < vals.size(); i++) vals[i] += vals[i - 1];
+}
+
+/*
+ * Decoding state shared by all primitive groups of a block
+ */
+struct block_context
+{
+    std::vector<std::string_view> strings;
+    int64_t granularity = 100;
+    int64_t lat_offset = 0;
+    int64_t lon_offset = 0;
+
+    double lat(int64_t v) const { return 1e-9 * static_cast<double>(lat_offset + granularity * v); }
+    double lng(int64_t v) const { return 1e-9 * static_cast<double>(lon_offset + granularity * v); }
+
+    const std::string_view& str(uint64_t i) const
+    {
+        if (i >= strings.size()) throw std::runtime_error("String table index out of range");
+        return strings[i];
+    }
+};
+
+void add_tags(const block_context& ctx, const std::vector<uint64_t>& keys,
+              const std::vector<uint64_t>& vals, osm_raw_element& e)
+{
+    if (keys.size() != vals.size()) throw std::runtime_error("Key/value count mismatch");
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        e.tags.emplace_back(std::string(ctx.str(keys[i])), std::string(ctx.str(vals[i])));
+    }
+}
+
+osm_raw_element new_element(osm_element_type type)
+{
+    osm_raw_element e;
+    e.type = type;
+    e.id = 0;
+    e.lat = 0;
+    e.lng = 0;
+    return e;
+}
+
+void decode_node(const block_context& ctx, std::string_view data, std::vector<osm_raw_element>& ret)
+{
+    osm_raw_element e = new_element(osm_element_type::NODE);
+    std::vector<uint64_t> keys, vals;
+
+    pbf_message m(data);
+    while (m.next())
+    {
+        switch (m.field())
+        {
+            case 1: e.id = m.svarint(); break;
+            case 2: keys = packed(m.bytes()); break;
+            case 3: vals = packed(m.bytes()); break;
+            case 8: e.lat = ctx.lat(m.svarint()); break;
+            case 9: e.lng = ctx.lng(m.svarint()); break;
+            default: m.skip();
+        }
+    }
+
+    add_tags(ctx, keys, vals, e);
+    ret.push_back(std::move(e));
+}
+
+void decode_dense_nodes(const block_context& ctx, std::string_view data, std::vector<osm_raw_element>& ret)
+{
+    std::vector<int64_t> ids, lats, lons;
+    std::vector<uint64_t> keys_vals;
+
+    pbf_message m(data);
+    while (m.next())
+    {
+        switch (m.field())
+        {
+            case 1: ids = packed_signed(m.bytes()); break;
+            case 8: lats = packed_signed(m.bytes()); break;
+            case 9: lons = packed_signed(m.bytes()); break;
+            case 10: keys_vals = packed(m.bytes()); break;
+            default: m.skip();
+        }
+    }
+
+    if (lats.size() != ids.size() || lons.size() != ids.size())
+        throw std::runtime_error("Dense node coordinate count mismatch");
+
+    undelta(ids);
+    undelta(lats);
+    undelta(lons);
+
+    // keys_vals holds (key, val)* 0 for every node, or is empty if no node
+    // in this group has tags
+    size_t kv = 0;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        osm_raw_element e = new_element(osm_element_type::NODE);
+        e.id = ids[i];
+        e.lat = ctx.lat(lats[i]);
+        e.lng = ctx.lng(lons[i]);
+
+        while (kv < keys_vals.size() && keys_vals[kv] != 0)
+        {
+            if (kv + 1 >= keys_vals.size()) throw std::runtime_error("Dense node tags truncated");
+            e.tags.emplace_back(std::string(ctx.str(keys_vals[kv])),
+                                std::string(ctx.str(keys_vals[kv + 1])));
+            kv += 2;
+        }
+        kv++;
+
+        ret.push_back(std::move(e));
+    }
+}
+
+void decode_way(const block_context& ctx, std::string_view data, std::vector<osm_raw_element>& ret)
+{
+    osm_raw_element e = new_element(osm_element_type::WAY);
+    std::vector<uint64_t> keys, vals;
+    std::vector<int64_t> refs;
+
+    pbf_message m(data);
+    while (m.next())
+    {
+        switch (m.field())
+        {
+            case 1: e.id = m.varint(); break;
+            case 2: keys = packed(m.bytes()); break;
+            case 3: vals = packed(m.bytes()); break;
+            case 8: refs = packed_signed(m.bytes()); break;
+            default: m.skip();
+        }
+    }
+
+    undelta(refs);
+    e.nodes.assign(refs.begin(), refs.end());
+    add_tags(ctx, keys, vals, e);
+    ret.push_back(std::move(e));
+}
+
+void decode_relation(const block_context& ctx, std::string_view data, std::vector<osm_raw_element>& ret)
+{
+    osm_raw_element e = new_element(osm_element_type::RELATION);
+    std::vector<uint64_t> keys, vals, roles, types;
+    std::vector<int64_t> memids;
+
+    pbf_message m(data);
+    while (m.next())
+    {
+        switch (m.field())
+        {
+            case 1: e.id = m.varint(); break;
+            case 2: keys = packed(m.bytes()); break;
+            case 3: vals = packed(m.bytes()); break;
+            case 8: roles = packed(m.bytes()); break;
+            case 9: memids = packed_signed(m.bytes()); break;
+            case 10: types = packed(m.bytes()); break;
+            default: m.skip();
+        }
+    }
+
+    if (roles.size() != memids.size() || types.size() != memids.size())
+        throw std::runtime_error("Relation member count mismatch");
+
+    undelta(memids);
+    for (size_t i = 0; i < memids.size(); i++)
+    {
+        osm_element_type type;
+        if (types[i] == 0)
+            type = osm_element_type::NODE;
+        else if (types[i] == 1)
+            type = osm_element_type::WAY;
+        else
+            type = osm_element_type::RELATION;
+        e.members.push_back({type, static_cast<pfaedle::osm::osmid>(memids[i]), std::string(ctx.str(roles[i]))});
+    }
+
+    add_tags(ctx, keys, vals, e);
+    ret.push_back(std::move(e));
+}
+
+// unpack the Blob message in blob, return the raw block data
+std::string inflate_blob(const std::string& blob)
+{
+    std::string_view raw;
+    std::string_view zlib;
+    uint64_t raw_size = 0;
+
+    pbf_message m(blob);
+    while (m.next())
+    {
+        switch (m.field())
+        {
+            case 1: raw = m.bytes(); break;
+            case 2: raw_size = m.varint(); break;
+            case 3: zlib = m.bytes(); break;
+            case 4:
+            case 5:
+            case 6:
+            case 7: throw std::runtime_error("Unsupported PBF block compression, only zlib is supported");
+            default: m.skip();
+        }
+    }
+
+    if (!zlib.data()) return std::string(raw);
+
+#ifdef ZLIB_FOUND
+    if (raw_size > MAX_BLOB_SIZE) throw std::runtime_error("PBF block too large");
+    std::string ret(raw_size, '\0');
+    uLongf len = raw_size;
+    if (uncompress(reinterpret_cast<Bytef*>(&ret[0]), &len,
+                   reinterpret_cast<const Bytef*>(zlib.data()), zlib.size()) != Z_OK ||
+        len != raw_size)
+    {
+        throw std::runtime_error("Could not decompress PBF block");
+    }
+    return ret;
+#else
+    throw std::runtime_error("pfaedle was built without zlib, cannot read compressed PBF blocks");
+#endif
+}
+
+// decode the PrimitiveBlock in data into ret, in file order
+void decode_block(const std::string& data, std::vector<osm_raw_element>& ret)
+{
+    block_context ctx;
+    std::vector<std::string_view> groups;
+
+    pbf_message m(data);
+    while (m.next())
+    {
+        switch (m.field())
+        {
+            case 1:
+            {
+                pbf_message st(m.bytes());
+                while (st.next())
+                {
+                    if (st.field() == 1)
+                        ctx.strings.push_back(st.bytes());
+                    else
+                        st.skip();
+                }
+                break;
+            }
+            case 2: groups.push_back(m.bytes()); break;
+            case 17: ctx.granularity = m.varint(); break;
+            case 19: ctx.lat_offset = m.varint(); break;
+            case 20: ctx.lon_offset = m.varint(); break;
+            default: m.skip();
+        }
+    }
+
+    // groups can only be decoded once the granularity and offsets are known
+    for (const auto& group : groups)
+    {
+        pbf_message g(group);
+        while (g.next())
+        {
+            switch (g.field())
+            {
+                case 1: decode_node(ctx, g.bytes(), ret); break;
+                case 2: decode_dense_nodes(ctx, g.bytes(), ret); break;
+                case 3: decode_way(ctx, g.bytes(), ret); break;
+                case 4: decode_relation(ctx, g.bytes(), ret); break;
+                default: g.skip();
+            }
+        }
+    }
+}
+
+void check_header(const std::string& data)
+{
+    pbf_message m(data);
+    while (m.next())
+    {
+        if (m.field() == 4)
+        {
+            std::string feature(m.bytes());
+            if (feature != "OsmSchema-V0.6" && feature != "DenseNodes")
+                throw std::runtime_error("Unsupported PBF feature " + feature);
+        }
+        else
+        {
+            m.skip();
+        }
+    }
+}
+}  // namespace
+
+// _____________________________________________________________________________
+osm_pbf_reader::osm_pbf_reader(const std::string& path) :
+    _path(path),
+    _file(path, std::ios::binary),
+    _curBlock(0),
+    _curElem(0)
+{
+    if (!_file.good()) throw std::runtime_error("Could not open " + path);
+}
+
+// _____________________________________________________________________________
+void osm_pbf_reader::rewind()
+{
+    _file.clear();
+    _file.seekg(0);
+    _blocks.clear();
+    _curBlock = 0;
+    _curElem = 0;
+}
+
+// _____________________________________________________________________________
+bool osm_pbf_reader::read_data_blob(std::string& blob)
+{
+    while (true)
+    {
+        unsigned char len[4];
+        if (!_file.read(reinterpret_cast<char*>(len), 4)) return false;
+
+        size_t header_size = (static_cast<size_t>(len[0]) << 24) | (len[1] << 16) | (len[2] << 8) | len[3];
+        if (header_size > MAX_BLOB_HEADER_SIZE) throw std::runtime_error("Invalid PBF blob header in " + _path);
+
+        std::string header(header_size, '\0');
+        if (!_file.read(&header[0], header_size)) throw std::runtime_error("Truncated PBF file " + _path);
+
+        std::string type;
+        size_t size = 0;
+        pbf_message m(header);
+        while (m.next())
+        {
+            if (m.field() == 1)
+                type = m.bytes();
+            else if (m.field() == 3)
+                size = m.varint();
+            else
+                m.skip();
+        }
+
+        if (size > MAX_BLOB_SIZE) throw std::runtime_error("Invalid PBF blob size in " + _path);
+
+        blob.resize(size);
+        if (!_file.read(&blob[0], size)) throw std::runtime_error("Truncated PBF file " + _path);
+
+        if (type == "OSMData") return true;
+        if (type == "OSMHeader") check_header(inflate_blob(blob));
+        // unknown blob types are skipped
+    }
+}
+
+// _____________________________________________________________________________
+bool osm_pbf_reader::read_batch()
+{
+    std::vector<std::string> blobs;
+    std::string blob;
+    while (blobs.size() < static_cast<size_t>(omp_get_max_threads()) * BLOCKS_PER_THREAD && read_data_blob(blob))
+    {
+        blobs.push_back(std::move(blob));
+    }
+
+    _blocks.clear();
+    _blocks.resize(blobs.size());
+    _curBlock = 0;
+    _curElem = 0;
+
+    if (blobs.empty()) return false;
+
+    std::exception_ptr error;
+
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < blobs.size(); i++)
+    {
+        try
+        {
+            decode_block(inflate_blob(blobs[i]), _blocks[i]);
+        }
+        catch (...)
+        {
+#pragma omp critical(pbf_error)
+            error = std::current_exception();
+        }
+    }
+
+    if (error) std::rethrow_exception(error);
+
+    return true;
+}
+
+// _____________________________________________________________________________
+bool osm_pbf_reader::read(osm_raw_element& e)
+{
+    while (true)
+    {
+        while (_curBlock < _blocks.size())
+        {
+            if (_curElem < _blocks[_curBlock].size())
+            {
+                std::swap(e, _blocks[_curBlock][_curElem++]);
+                return true;
+            }
+            _curBlock++;
+            _curElem = 0;
+        }
+
+        if (!read_batch()) return false;
+    }
+}
@@ -0,0 +1,114 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include "pfaedle/osm/osm_reader.h"
+#include "pfaedle/osm/osm_pbf_reader.h"
+#include "util/Misc.h"
+#include "util/String.h"
+
+#include <cstring>
+#include <string>
+
+using pfaedle::osm::osm_raw_element;
+using pfaedle::osm::osm_reader;
+using pfaedle::osm::osm_xml_reader;
+
+namespace
+{
+const char* attr_or_empty(const util::xml::XmlTag& tag, const char* key)
+{
+    const char* val = tag.attr(key);
+    return val ? val : "";
+}
+
+bool element_type(const char* name, pfaedle::osm::osm_element_type& type)
+{
+    if (strcmp(name, "node") == 0)
+        type = pfaedle::osm::osm_element_type::NODE;
+    else if (strcmp(name, "way") == 0)
+        type = pfaedle::osm::osm_element_type::WAY;
+    else if (strcmp(name, "relation") == 0)
+        type = pfaedle::osm::osm_element_type::RELATION;
+    else
+        return false;
+    return true;
+}
+}  // namespace
+
+// _____________________________________________________________________________
+std::unique_ptr<osm_reader> osm_reader::from_file(const std::string& path)
+{
+    if (util::ends_with(path, ".pbf"))
+        return std::make_unique<osm_pbf_reader>(path);
+    return std::make_unique<osm_xml_reader>(path);
+}
+
+// _____________________________________________________________________________
+osm_xml_reader::osm_xml_reader(const std::string& path) :
+    _xml(path)
+{
+    _more = _xml.next();
+}
+
+// _____________________________________________________________________________
+void osm_xml_reader::rewind()
+{
+    _xml.reset();
+    _more = _xml.next();
+}
+
+// _____________________________________________________________________________
+bool osm_xml_reader::read(osm_raw_element& e)
+{
+    while (_more)
+    {
+        const auto& xmltag = _xml.get();
+        if (_xml.level() != 2 || !element_type(xmltag.name, e.type))
+        {
+            _more = _xml.next();
+            continue;
+        }
+
+        e.id = util::atoul(attr_or_empty(xmltag, "id"));
+        e.lat = 0;
+        e.lng = 0;
+        if (e.type == osm_element_type::NODE)
+        {
+            e.lat = util::atof(attr_or_empty(xmltag, "lat"));
+            e.lng = util::atof(attr_or_empty(xmltag, "lon"));
+        }
+
+        e.tags.clear();
+        e.nodes.clear();
+        e.members.clear();
+
+        // the children of this element, this leaves the reader positioned at
+        // the element following it
+        while ((_more = _xml.next()) && _xml.level() > 2)
+        {
+            if (_xml.level() != 3) continue;
+            const auto& child = _xml.get();
+
+            if (strcmp(child.name, "tag") == 0)
+            {
+                e.tags.emplace_back(attr_or_empty(child, "k"), attr_or_empty(child, "v"));
+            }
+            else if (strcmp(child.name, "nd") == 0)
+            {
+                e.nodes.push_back(util::atoul(attr_or_empty(child, "ref")));
+            }
+            else if (strcmp(child.name, "member") == 0)
+            {
+                osm_element_type type;
+                if (!element_type(attr_or_empty(child, "type"), type)) continue;
+                e.members.push_back({type, util::atoul(attr_or_empty(child, "ref")),
+                                     attr_or_empty(child, "role")});
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,376 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include "pfaedle/router/hop_cache.h"
+#include "util/Misc.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <logging/logger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using pfaedle::router::hop_cache;
+
+namespace
+{
+
+// increase this whenever the file layout or the routing costs change
+const uint32_t HOPS_VERSION = 1;
+const char HOPS_MAGIC[8] = {'P', 'F', 'H', 'O', 'P', 'S', '\0', '\0'};
+
+template <typename T>
+void write_value(std::ostream& out, T v)
+{
+    out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+void write_value(std::ostream& out, const std::string& s)
+{
+    write_value(out, static_cast<uint32_t>(s.size()));
+    out.write(s.data(), s.size());
+}
+
+template <typename T>
+T read_value(std::istream& in)
+{
+    T v;
+    if (!in.read(reinterpret_cast<char*>(&v), sizeof(T)))
+        throw std::runtime_error("unexpected end of file");
+    return v;
+}
+
+std::string read_string(std::istream& in)
+{
+    auto n = read_value<uint32_t>(in);
+    std::string s(n, '\0');
+    if (n && !in.read(&s[0], n)) throw std::runtime_error("unexpected end of file");
+    return s;
+}
+
+std::string get_file_path(const std::string& path, const std::string& key)
+{
+    return path + "/hops-" + key + ".bin";
+}
+
+void add_rules(util::Fnv1a& h, const pfaedle::trgraph::Rules& rules,
+               const pfaedle::trgraph::csr_graph& g)
+{
+    auto edge_ref = [&](const pfaedle::trgraph::edge* e) -> uint64_t {
+        return e ? g.get_id(e) : pfaedle::trgraph::csr_graph::NONE;
+    };
+
+    // the rules are unordered, the hashes of single rules are combined
+    // independently of their order
+    uint64_t sum = 0;
+    for (const auto& r : rules)
+    {
+        for (const auto& p : r.second)
+        {
+            util::Fnv1a rh;
+            rh.add(r.first->pl().get_geom()->getX());
+            rh.add(r.first->pl().get_geom()->getY());
+            rh.add(edge_ref(p.first));
+            rh.add(edge_ref(p.second));
+            sum += rh.get();
+        }
+    }
+    h.add(sum);
+}
+}  // namespace
+
+// _____________________________________________________________________________
+hop_cache::hop_cache(size_t maxBytes) :
+    _maxShardBytes(std::max<size_t>(maxBytes / NUM_SHARDS, 1))
+{
+    for (size_t i = 0; i < NUM_SHARDS; i++)
+    {
+        _shards.push_back(std::make_unique<shard>());
+    }
+}
+
+// _____________________________________________________________________________
+uint32_t hop_cache::get_attr_id(const routing_attributes& rAttrs)
+{
+    std::lock_guard<std::mutex> lock(_attrMutex);
+    auto i = _attrIds.find(rAttrs);
+    if (i != _attrIds.end()) return i->second;
+
+    auto id = static_cast<uint32_t>(_attrs.size());
+    _attrIds[rAttrs] = id;
+    _attrs.push_back(rAttrs);
+    return id;
+}
+
+// _____________________________________________________________________________
+hop_cache::shard& hop_cache::get_shard(const hop_key& k) const
+{
+    return *_shards[hop_key_hash()(k) % NUM_SHARDS];
+}
+
+// _____________________________________________________________________________
+size_t hop_cache::hop_bytes(size_t length)
+{
+    // the hop in the list, its index entry and its edges in the arena
+    return sizeof(hop) + 2 * sizeof(void*) + sizeof(hop_key) + 3 * sizeof(void*) +
+           length * sizeof(trgraph::csr_graph::id);
+}
+
+// _____________________________________________________________________________
+bool hop_cache::get(uint32_t attr, trgraph::csr_graph::id from, trgraph::csr_graph::id to,
+                    edge_cost& c, std::vector<trgraph::csr_graph::id>& edges)
+{
+    const hop_key k{attr, from, to};
+    shard& s = get_shard(k);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    auto i = s.index.find(k);
+    if (i == s.index.end()) return false;
+
+    // mark as most recently used
+    s.lru.splice(s.lru.begin(), s.lru, i->second);
+
+    const hop& h = *i->second;
+    c = edge_cost(h.cost);
+    edges.assign(s.arena.begin() + h.offset, s.arena.begin() + h.offset + h.length);
+    return true;
+}
+
+// _____________________________________________________________________________
+void hop_cache::put(uint32_t attr, trgraph::csr_graph::id from, trgraph::csr_graph::id to,
+                    const edge_cost& c, const std::vector<trgraph::csr_graph::id>& edges)
+{
+    const hop_key k{attr, from, to};
+    const size_t bytes = hop_bytes(edges.size());
+    shard& s = get_shard(k);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    // hops too large for the shard are not cached at all
+    if (bytes > _maxShardBytes) return;
+
+    auto i = s.index.find(k);
+    if (i != s.index.end())
+    {
+        s.garbage += i->second->length;
+        s.bytes -= hop_bytes(i->second->length);
+        s.lru.erase(i->second);
+        s.index.erase(i);
+    }
+
+    while (!s.lru.empty() && s.bytes + bytes > _maxShardBytes) evict(s);
+
+    if (s.garbage > s.arena.size() / 2) compact(s);
+
+    s.lru.push_front(hop{k, c.getValue(), static_cast<uint32_t>(s.arena.size()),
+                         static_cast<uint32_t>(edges.size())});
+    s.arena.insert(s.arena.end(), edges.begin(), edges.end());
+    s.index[k] = s.lru.begin();
+    s.bytes += bytes;
+}
+
+// _____________________________________________________________________________
+void hop_cache::evict(shard& s)
+{
+    const hop& h = s.lru.back();
+    s.garbage += h.length;
+    s.bytes -= hop_bytes(h.length);
+    s.index.erase(h.key);
+    s.lru.pop_back();
+}
+
+// _____________________________________________________________________________
+void hop_cache::compact(shard& s)
+{
+    std::vector<trgraph::csr_graph::id> arena;
+    arena.reserve(s.arena.size() - s.garbage);
+    for (auto& h : s.lru)
+    {
+        auto offset = static_cast<uint32_t>(arena.size());
+        arena.insert(arena.end(), s.arena.begin() + h.offset,
+                     s.arena.begin() + h.offset + h.length);
+        h.offset = offset;
+    }
+    s.arena.swap(arena);
+    s.garbage = 0;
+}
+
+// _____________________________________________________________________________
+size_t hop_cache::size() const
+{
+    size_t ret = 0;
+    for (const auto& s : _shards)
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        ret += s->lru.size();
+    }
+    return ret;
+}
+
+// _____________________________________________________________________________
+std::string hop_cache::get_key(const trgraph::csr_graph& g,
+                               const trgraph::restrictor& res,
+                               const routing_options& rOpts)
+{
+    if (!g.has_stable_ids()) return "";
+
+    util::Fnv1a h;
+    h.add(static_cast<uint64_t>(HOPS_VERSION));
+    h.add(g.get_fingerprint());
+    add_rules(h, res.get_pos_rules(), g);
+    add_rules(h, res.get_neg_rules(), g);
+
+    h.add(rOpts.fullTurnPunishFac);
+    h.add(rOpts.fullTurnAngle);
+    h.add(rOpts.passThruStationsPunish);
+    h.add(rOpts.oneWayPunishFac);
+    h.add(rOpts.oneWayEdgePunish);
+    h.add(rOpts.lineUnmatchedPunishFact);
+    h.add(rOpts.noLinesPunishFact);
+    h.add(rOpts.platformUnmatchedPen);
+    h.add(rOpts.stationDistPenFactor);
+    h.add(rOpts.nonOsmPen);
+    for (double p : rOpts.levelPunish) h.add(p);
+    h.add(static_cast<uint64_t>(rOpts.popReachEdge));
+    h.add(static_cast<uint64_t>(rOpts.noSelfHops));
+
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << h.get();
+    return ss.str();
+}
+
+// _____________________________________________________________________________
+bool hop_cache::load(const std::string& path, const std::string& key, size_t numEdges)
+{
+    const std::string file = get_file_path(path, key);
+    std::ifstream in(file, std::ios::binary);
+    if (!in.good()) return false;
+
+    try
+    {
+        char magic[sizeof(HOPS_MAGIC)];
+        if (!in.read(magic, sizeof(magic)) || memcmp(magic, HOPS_MAGIC, sizeof(magic)) != 0 ||
+            read_value<uint32_t>(in) != HOPS_VERSION || read_string(in) != key)
+            throw std::runtime_error("not a hop cache file for this graph");
+
+        std::vector<uint32_t> attrIds(read_value<uint32_t>(in));
+        for (auto& id : attrIds)
+        {
+            routing_attributes a;
+            a.from = read_string(in);
+            a.to = read_string(in);
+            a.short_name = read_string(in);
+            id = get_attr_id(a);
+        }
+
+        auto check = [&](uint32_t e) {
+            if (e >= numEdges) throw std::runtime_error("invalid edge reference");
+            return e;
+        };
+
+        // hops are stored from least to most recently used, putting them in
+        // that order restores their recency
+        auto count = read_value<uint64_t>(in);
+        std::vector<trgraph::csr_graph::id> edges;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            auto attr = read_value<uint32_t>(in);
+            if (attr >= attrIds.size()) throw std::runtime_error("invalid attribute reference");
+            auto from = check(read_value<uint32_t>(in));
+            auto to = check(read_value<uint32_t>(in));
+            auto cost = read_value<double>(in);
+            edges.resize(read_value<uint32_t>(in));
+            for (auto& e : edges) e = check(read_value<uint32_t>(in));
+            put(attrIds[attr], from, to, edge_cost(cost), edges);
+        }
+
+        char end[sizeof(HOPS_MAGIC)];
+        if (!in.read(end, sizeof(end)) || memcmp(end, HOPS_MAGIC, sizeof(end)) != 0)
+            throw std::runtime_error("unexpected end of file");
+    }
+    catch (const std::runtime_error& e)
+    {
+        LOG(WARN) << "Ignoring hop cache file " << file << ": " << e.what();
+        return false;
+    }
+
+    return true;
+}
+
+// _____________________________________________________________________________
+void hop_cache::store(const std::string& path, const std::string& key) const
+{
+    mkdir(path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    const std::string file = get_file_path(path, key);
+
+    // write to a temporary file first, the hops become visible at once
+    std::string tmp = file + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if (fd < 0)
+    {
+        LOG(WARN) << "Could not write hop cache file " << file;
+        return;
+    }
+    fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    close(fd);
+
+    std::ofstream out(tmp, std::ios::binary);
+    out.write(HOPS_MAGIC, sizeof(HOPS_MAGIC));
+    write_value(out, HOPS_VERSION);
+    write_value(out, key);
+
+    {
+        std::lock_guard<std::mutex> lock(_attrMutex);
+        write_value(out, static_cast<uint32_t>(_attrs.size()));
+        for (const auto& a : _attrs)
+        {
+            write_value(out, a.from);
+            write_value(out, a.to);
+            write_value(out, a.short_name);
+        }
+    }
+
+    std::vector<std::unique_lock<std::mutex>> locks;
+    uint64_t count = 0;
+    for (const auto& s : _shards)
+    {
+        locks.emplace_back(s->mutex);
+        count += s->lru.size();
+    }
+
+    write_value(out, count);
+    for (const auto& s : _shards)
+    {
+        for (auto h = s->lru.rbegin(); h != s->lru.rend(); h++)
+        {
+            write_value(out, h->key.attr);
+            write_value(out, h->key.from);
+            write_value(out, h->key.to);
+            write_value(out, h->cost);
+            write_value(out, h->length);
+            out.write(reinterpret_cast<const char*>(s->arena.data() + h->offset),
+                      h->length * sizeof(trgraph::csr_graph::id));
+        }
+    }
+    locks.clear();
+
+    out.write(HOPS_MAGIC, sizeof(HOPS_MAGIC));
+    out.close();
+
+    if (!out.good() || rename(tmp.c_str(), file.c_str()) != 0)
+    {
+        LOG(WARN) << "Could not write hop cache file " << file;
+        unlink(tmp.c_str());
+        return;
+    }
+
+    LOG(INFO) << "Stored " << count << " hops in " << file;
+}
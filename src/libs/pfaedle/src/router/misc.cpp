@@ -29,7 +29,7 @@ pfaedle::router::feed_stops write_mot_stops(const gtfs::feed& feed, const route_
 
         if(t.second.route().has_value() && mots.count(t.second.route().value().get().route_type))
         {
-            for (const gtfs::stop_time& st : t.second.stop_times())
+            for (const gtfs::stop_time st : t.second.stop_times())
             {
                 if(!st.stop().has_value())
                     continue;
@@ -28,6 +28,25 @@ using util::graph::EDijkstra;
 
 namespace pfaedle::router
 {
+namespace
+{
+edge_cost travel_cost(double length, uint8_t level, uint32_t fullTurns,
+                      int32_t stationSkip, int oneway, double transitLinePen,
+                      bool noLines, const routing_options* rOpts)
+{
+    return edge_cost(level == 0 ? length : 0,
+                     level == 1 ? length : 0,
+                     level == 2 ? length : 0,
+                     level == 3 ? length : 0,
+                     level == 4 ? length : 0,
+                     level == 5 ? length : 0,
+                     level == 6 ? length : 0,
+                     level == 7 ? length : 0, fullTurns,
+                     stationSkip, length * oneway, oneway,
+                     length * transitLinePen,
+                     noLines ? length : 0, 0, rOpts);
+}
+}  // namespace
 
 edge_cost NCostFunc::operator()(const trgraph::node* from,
                                const trgraph::edge* e,
@@ -86,26 +105,67 @@ edge_cost CostFunc::operator()(const trgraph::edge* from, const trgraph::node* n
     bool noLines = (_rAttrs.short_name.empty() && _rAttrs.to.empty() &&
                     _rAttrs.from.empty() && from->pl().get_lines().empty());
 
-    return edge_cost(from->pl().level() == 0 ? from->pl().get_length() : 0,
-                     from->pl().level() == 1 ? from->pl().get_length() : 0,
-                     from->pl().level() == 2 ? from->pl().get_length() : 0,
-                     from->pl().level() == 3 ? from->pl().get_length() : 0,
-                     from->pl().level() == 4 ? from->pl().get_length() : 0,
-                     from->pl().level() == 5 ? from->pl().get_length() : 0,
-                     from->pl().level() == 6 ? from->pl().get_length() : 0,
-                     from->pl().level() == 7 ? from->pl().get_length() : 0, fullTurns,
-                    stationSkip, from->pl().get_length() * oneway, oneway,
-                     from->pl().get_length() * transitLinePen,
-                    noLines ? from->pl().get_length() : 0, 0, &_rOpts);
+    return travel_cost(from->pl().get_length(), from->pl().level(), fullTurns,
+                       stationSkip, oneway, transitLinePen, noLines, &_rOpts);
+}
+
+edge_cost CostFunc::operator()(trgraph::csr_graph::id from, trgraph::csr_graph::id n,
+                              trgraph::csr_graph::id to) const
+{
+    if (from == trgraph::csr_graph::NONE) return edge_cost();
+
+    const auto& topo = _g.get_topology();
+    uint32_t fullTurns = 0;
+    int oneway = _g.oneWay(from) == 2;
+    int32_t stationSkip = 0;
+
+    if (n != trgraph::csr_graph::NONE)
+    {
+        if (topo.getFrom(from) == topo.getTo(to) && topo.getTo(from) == topo.getFrom(to))
+        {
+            // trivial full turn
+            fullTurns = 1;
+        }
+        else if (topo.getDeg(n) > 2)
+        {
+            // otherwise, only intersection angles will be punished
+            fullTurns = angSmaller(_g.backHop(from), _g.get_geom(n),
+                                   _g.frontHop(to), _rOpts.fullTurnAngle);
+        }
+
+        if (_g.is_restricted(from) &&
+            !_res.may(_g.get_edge(from), _g.get_edge(to), _g.get_node(n)))
+            oneway = 1;
+
+        // for debugging
+        _g.get_node(n)->pl().set_visited();
+
+        const trgraph::station_info* si = _g.get_si(n);
+        if (_tgGrp && si && si->get_group() != _tgGrp) stationSkip = 1;
+    }
+
+    const trgraph::line_span lines = _g.get_lines(from);
+    double transitLinePen = transitLineCmp(lines);
+    bool noLines = (_rAttrs.short_name.empty() && _rAttrs.to.empty() &&
+                    _rAttrs.from.empty() && lines.empty());
+
+    return travel_cost(_g.get_length(from), _g.level(from), fullTurns,
+                       stationSkip, oneway, transitLinePen, noLines, &_rOpts);
 }
 
 double CostFunc::transitLineCmp(const trgraph::edge_payload& e) const
+{
+    const auto& lines = e.get_lines();
+    return transitLineCmp(trgraph::line_span{lines.data(), lines.data() + lines.size()});
+}
+
+double CostFunc::transitLineCmp(const trgraph::line_span& lines) const
 {
     if (_rAttrs.short_name.empty() && _rAttrs.to.empty() &&
         _rAttrs.from.empty())
         return 0;
     double best = 1;
-    for (const auto* l : e.get_lines())
+    for (const auto* l : lines)
     {
         double cur = _rAttrs.simi(l);
 
@@ -141,8 +201,10 @@ NDistHeur::NDistHeur(const routing_options& rOpts,
     }
 }
 
-DistHeur::DistHeur(uint8_t minLvl, const routing_options& rOpts,
+DistHeur::DistHeur(const trgraph::csr_graph& g, uint8_t minLvl,
+                   const routing_options& rOpts,
                    const std::set<trgraph::edge*>& tos) :
+    _g(g),
     _rOpts(rOpts),
     _lvl(minLvl), _maxCentD(0)
 {
@@ -177,6 +239,15 @@ edge_cost DistHeur::operator()(const trgraph::edge* a,
     return edge_cost(cur - _maxCentD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr);
 }
 
+edge_cost DistHeur::operator()(trgraph::csr_graph::id a) const
+{
+    const auto& topo = _g.get_topology();
+    double cur = util::geo::webMercMeterDist(_g.get_geom(topo.getFrom(a)), _center) *
+                 _rOpts.levelPunish[_lvl];
+
+    return edge_cost(cur - _maxCentD, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr);
+}
+
 edge_cost NDistHeur::operator()(const trgraph::node* a,
                                const std::set<trgraph::node*>& b) const
 {
@@ -194,22 +265,14 @@ double CombCostFunc::operator()(const edge* from, const node* n,
     return to->pl().get_cost().getValue();
 }
 
-router::router(size_t numThreads, bool caching) :
-    _cache(numThreads),
-    _caching(caching)
-{
-    for (size_t i = 0; i < numThreads; i++)
-    {
-        _cache[i] = new Cache();
-    }
-}
-
-router::~router()
+router::router(const trgraph::csr_graph& g, size_t numThreads, bool caching,
+               size_t cacheBytes) :
+    _g(g),
+    _numThreads(numThreads),
+    _caching(caching),
+    _cache(caching ? cacheBytes : 0),
+    _hierarchyRes(nullptr)
 {
-    for (auto & i : _cache)
-    {
-        delete i;
-    }
 }
 
 bool router::compConned(const edge_candidate_group& a, const edge_candidate_group& b) const
@@ -227,7 +290,8 @@ bool router::compConned(const edge_candidate_group& a, const edge_candidate_grou
 }
 
 HopBand router::getHopBand(const edge_candidate_group& a, const edge_candidate_group& b,
-                           const routing_attributes& rAttrs, const routing_options& rOpts,
+                           const routing_attributes& rAttrs, uint32_t attr,
+                           const routing_options& rOpts,
                            const trgraph::restrictor& rest) const
 {
     assert(a.size());
@@ -251,7 +315,7 @@ HopBand router::getHopBand(const edge_candidate_group& a, const edge_candidate_g
     if (b.begin()->e->getFrom()->pl().get_si())
         tgGrpTo = b.begin()->e->getFrom()->pl().get_si()->get_group();
 
-    CostFunc costF(rAttrs, rOpts, rest, tgGrpTo, pend * 50);
+    CostFunc costF(_g, rAttrs, rOpts, rest, tgGrpTo, pend * 50);
 
     std::set<trgraph::edge*> from, to;
 
@@ -263,10 +327,18 @@ HopBand router::getHopBand(const edge_candidate_group& a, const edge_candidate_g
 
     edge_list el;
     edge_cost ret = costF.inf();
-    DistHeur distH(0, rOpts, to);
+    DistHeur distH(_g, 0, rOpts, to);
 
     if (compConned(a, b))
-        ret = EDijkstra::shortestPath(from, to, costF, distH, &el);
+    {
+        std::vector<trgraph::csr_graph::id> fromIds, toIds;
+        for (auto e : from) fromIds.push_back(_g.get_id(e));
+        for (auto e : to) toIds.push_back(_g.get_id(e));
+
+        EDijkstra::CsrEList elIds;
+        ret = EDijkstra::shortestPath(_g.get_topology(), fromIds, toIds, costF, distH, &elIds);
+        for (auto e : elIds) el.push_back(_g.get_edge(e));
+    }
 
     if (el.size() < 2 && costF.inf() <= ret)
     {
@@ -276,7 +348,7 @@ HopBand router::getHopBand(const edge_candidate_group& a, const edge_candidate_g
     }
 
     // cache the found path, will save a few dijkstra iterations
-    nestedCache(&el, from, costF, rAttrs);
+    nestedCache(&el, from, costF, attr);
 
     auto na = el.back()->getFrom();
     auto nb = el.front()->getFrom();
@@ -432,13 +504,16 @@ edge_list_hops router::route(const edge_candidate_route& route,
                                     i.pen, nullptr));
     }
 
+    // the hops of the whole route are cached under the same attributes
+    const uint32_t attr = _caching ? _cache.get_attr_id(rAttrs) : 0;
+
     size_t iters = EDijkstra::ITERS;
     double itPerSecTot = 0;
     size_t n = 0;
     for (size_t i = 0; i < route.size() - 1; i++)
     {
         nextNodes.clear();
-        HopBand hopBand = getHopBand(route[i], route[i + 1], rAttrs, rOpts, rest);
+        HopBand hopBand = getHopBand(route[i], route[i + 1], rAttrs, attr, rOpts, rest);
 
         const trgraph::station_group* tgGrp = nullptr;
         if (route[i + 1].begin()->e->getFrom()->pl().get_si())
@@ -447,22 +522,26 @@ edge_list_hops router::route(const edge_candidate_route& route,
         std::set<trgraph::edge*> froms;
         for (const auto& fr : route[i]) froms.insert(fr.e);
 
+        edge_set tos;
+        for (const auto& to : route[i + 1]) tos.insert(to.e);
+
+        // the combination graph edges of every source edge, the hops from
+        // all of them are computed at once below
+        std::vector<std::map<trgraph::edge*, edge*>> edges(froms.size());
+        std::vector<std::map<trgraph::edge*, double>> pens(froms.size());
+        std::vector<std::unordered_map<trgraph::edge*, edge_list*>> edgeLists(froms.size());
+        std::vector<std::unordered_map<trgraph::edge*, edge_cost>> costs(froms.size());
+
+        assert(route[i + 1].size());
+
+        size_t k = 0;
         for (auto eFr : froms)
         {
             node* cNodeFr = nodes.find(eFr)->second;
 
-            edge_set tos;
-            std::map<trgraph::edge*, edge*> edges;
-            std::map<trgraph::edge*, double> pens;
-            std::unordered_map<trgraph::edge*, edge_list*> edgeLists;
-            std::unordered_map<trgraph::edge*, edge_cost> costs;
-
-            assert(route[i + 1].size());
-
             for (const auto& to : route[i + 1])
             {
                 auto eTo = to.e;
-                tos.insert(eTo);
 
                 if (!nextNodes.count(eTo))
                     nextNodes[eTo] = cgraph.addNd(to.e->getFrom());
@@ -470,38 +549,43 @@ edge_list_hops router::route(const edge_candidate_route& route,
                 if (i == route.size() - 2)
                     cgraph.addEdg(nextNodes[eTo], sink);
 
-                edges[eTo] = cgraph.addEdg(cNodeFr, nextNodes[eTo]);
-                pens[eTo] = to.pen;
+                edges[k][eTo] = cgraph.addEdg(cNodeFr, nextNodes[eTo]);
+                pens[k][eTo] = to.pen;
 
-                edgeLists[eTo] = edges[eTo]->pl().get_edges();
-                edges[eTo]->pl().set_start_node(eFr->getFrom());
+                edgeLists[k][eTo] = edges[k][eTo]->pl().get_edges();
+                edges[k][eTo]->pl().set_start_node(eFr->getFrom());
 
                 // for debugging
-                edges[eTo]->pl().set_start_edge(eFr);
-                edges[eTo]->pl().set_end_node(to.e->getFrom());
+                edges[k][eTo]->pl().set_start_edge(eFr);
+                edges[k][eTo]->pl().set_end_node(to.e->getFrom());
 
                 // for debugging
-                edges[eTo]->pl().set_end_edge(eTo);
+                edges[k][eTo]->pl().set_end_edge(eTo);
             }
+            k++;
+        }
 
-            size_t iters = EDijkstra::ITERS;
-            auto t1 = TIME();
+        size_t hopIters = EDijkstra::ITERS;
+        auto t1 = TIME();
 
-            assert(tos.size());
-            assert(froms.size());
+        assert(tos.size());
+        assert(froms.size());
 
-            hops(eFr, froms, tos, tgGrp, edgeLists, &costs, rAttrs, rOpts, rest, hopBand);
-            double itPerSec = (static_cast<double>(EDijkstra::ITERS - iters)) / TOOK(t1, TIME());
-            n++;
-            itPerSecTot += itPerSec;
+        hops(froms, tos, tgGrp, edgeLists, &costs, rAttrs, attr, rOpts, rest, hopBand);
+        double itPerSec = (static_cast<double>(EDijkstra::ITERS - hopIters)) / TOOK(t1, TIME());
+        n++;
+        itPerSecTot += itPerSec;
 
-            LOG(TRACE) << "from " << eFr << ": 1-" << tos.size() << " ("
-                        << route[i + 1].size() << " nodes) hop took "
-                        << EDijkstra::ITERS - iters << " iterations, "
-                        << TOOK(t1, TIME()) << "ms (tput: " << itPerSec << " its/ms)";
-            for (auto& kv : edges)
+        LOG(TRACE) << froms.size() << "-" << tos.size() << " ("
+                    << route[i + 1].size() << " nodes) hop took "
+                    << EDijkstra::ITERS - hopIters << " iterations, "
+                    << TOOK(t1, TIME()) << "ms (tput: " << itPerSec << " its/ms)";
+
+        for (k = 0; k < froms.size(); k++)
+        {
+            for (auto& kv : edges[k])
             {
-                kv.second->pl().set_cost(edge_cost(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, pens[kv.first], nullptr) + costs[kv.first]);
+                kv.second->pl().set_cost(edge_cost(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, pens[k][kv.first], nullptr) + costs[k][kv.first]);
 
                 if (rOpts.popReachEdge && !kv.second->pl().get_edges()->empty())
                 {
@@ -577,48 +661,95 @@ edge_list_hops router::route(const node_candidate_route& route,
     return router::route(r, rAttrs, rOpts, rest, cgraph);
 }
 
-void router::hops(trgraph::edge* from, const std::set<trgraph::edge*>& froms,
-                  const std::set<trgraph::edge*> tos,
+void router::hops(const std::set<trgraph::edge*>& froms,
+                  const std::set<trgraph::edge*>& tos,
                   const trgraph::station_group* tgGrp,
-                  const std::unordered_map<trgraph::edge*, edge_list*>& edgesRet,
-                  std::unordered_map<trgraph::edge*, edge_cost>* rCosts,
-                  const routing_attributes& rAttrs, const routing_options& rOpts,
+                  const std::vector<std::unordered_map<trgraph::edge*, edge_list*>>& edgesRet,
+                  std::vector<std::unordered_map<trgraph::edge*, edge_cost>>* rCosts,
+                  const routing_attributes& rAttrs, uint32_t attr,
+                  const routing_options& rOpts,
                   const trgraph::restrictor& rest, HopBand hopB) const
 {
-    std::set<trgraph::edge*> rem;
+    CostFunc cost(_g, rAttrs, rOpts, rest, tgGrp, hopB.maxD);
 
-    CostFunc cost(rAttrs, rOpts, rest, tgGrp, hopB.maxD);
+    // the sources which have uncached targets left, with their index in
+    // froms, their remaining targets and their heuristic
+    std::vector<size_t> srcs;
+    std::vector<trgraph::csr_graph::id> srcIds;
+    std::vector<std::vector<trgraph::csr_graph::id>> remIds;
+    std::vector<DistHeur> dists;
 
-    const auto& cached = getCachedHops(from, tos, edgesRet, rCosts, rAttrs);
-
-    for (auto e : cached)
+    size_t k = 0;
+    for (auto from : froms)
     {
-        // shortcut: if the nodes lie in two different connected components,
-        // the distance between them is trivially infinite
-        if ((rOpts.noSelfHops && (e == from || e->getFrom() == from->getFrom())) ||
-            from->getFrom()->pl().get_component() != e->getTo()->pl().get_component() ||
-            e->pl().oneWay() == 2 || from->pl().oneWay() == 2)
+        std::set<trgraph::edge*> rem;
+
+        const auto& cached = getCachedHops(from, tos, edgesRet[k], &(*rCosts)[k], attr);
+
+        for (auto e : cached)
         {
-            (*rCosts)[e] = cost.inf();
+            // shortcut: if the nodes lie in two different connected components,
+            // the distance between them is trivially infinite
+            if ((rOpts.noSelfHops && (e == from || e->getFrom() == from->getFrom())) ||
+                from->getFrom()->pl().get_component() != e->getTo()->pl().get_component() ||
+                e->pl().oneWay() == 2 || from->pl().oneWay() == 2)
+            {
+                (*rCosts)[k][e] = cost.inf();
+            }
+            else
+            {
+                rem.insert(e);
+            }
         }
-        else
+
+        LOG(TRACE) << "From cache: " << tos.size() - rem.size()
+                    << ", have to cal: " << rem.size();
+
+        if (!rem.empty())
         {
-            rem.insert(e);
+            srcs.push_back(k);
+            srcIds.push_back(_g.get_id(from));
+            remIds.emplace_back();
+            for (auto e : rem) remIds.back().push_back(_g.get_id(e));
+            dists.emplace_back(_g, from->getFrom()->pl().get_component()->minEdgeLvl, rOpts, rem);
         }
+
+        k++;
     }
 
-    LOG(TRACE) << "From cache: " << tos.size() - rem.size()
-                << ", have to cal: " << rem.size();
+    if (srcs.empty()) return;
 
-    if (!rem.empty())
+    std::vector<std::unordered_map<trgraph::csr_graph::id, EDijkstra::CsrEList>> elIds(srcs.size());
+    std::vector<std::unordered_map<trgraph::csr_graph::id, EDijkstra::CsrEList*>> elIdsRet(srcs.size());
+    for (size_t j = 0; j < srcs.size(); j++)
     {
-        DistHeur dist(from->getFrom()->pl().get_component()->minEdgeLvl, rOpts, rem);
-        const auto& ret = EDijkstra::shortestPath(from, rem, cost, dist, edgesRet);
-        for (const auto& kv : ret)
+        for (auto eId : remIds[j]) elIdsRet[j][eId] = &elIds[j][eId];
+    }
+
+    std::vector<std::unordered_map<trgraph::csr_graph::id, edge_cost>> ret;
+    if (useHierarchy(srcIds, remIds, rAttrs, rOpts, rest))
+    {
+        for (size_t j = 0; j < srcs.size(); j++)
         {
-            nestedCache(edgesRet.at(kv.first), froms, cost, rAttrs);
+            ret.push_back(_hierarchy->shortestPath(srcIds[j], remIds[j], cost, dists[j], elIdsRet[j]));
+        }
+    }
+    else
+    {
+        ret = EDijkstra::shortestPath(_g.get_topology(), srcIds, remIds, cost, dists, elIdsRet);
+    }
 
-            (*rCosts)[kv.first] = kv.second;
+    for (size_t j = 0; j < srcs.size(); j++)
+    {
+        for (const auto& kv : ret[j])
+        {
+            auto* e = _g.get_edge(kv.first);
+            edge_list* el = edgesRet[srcs[j]].at(e);
+            for (auto eId : elIds[j][kv.first]) el->push_back(_g.get_edge(eId));
+
+            nestedCache(el, froms, cost, attr);
+
+            (*rCosts)[srcs[j]][e] = kv.second;
         }
     }
 }
@@ -626,7 +757,7 @@ void router::hops(trgraph::edge* from, const std::set<trgraph::edge*>& froms,
 void router::nestedCache(const edge_list* el,
                          const std::set<trgraph::edge*>& froms,
                          const CostFunc& cost,
-                         const routing_attributes& rAttrs) const
+                         uint32_t attr) const
 {
     if (!_caching) return;
     if (el->empty()) return;
@@ -648,7 +779,7 @@ void router::nestedCache(const edge_list* el,
         if (froms.count(*i))
         {
             edge_cost startC = cost(nullptr, nullptr, *i) + curCost;
-            cache(*i, el->front(), startC, &curEdges, rAttrs);
+            cache(*i, el->front(), startC, &curEdges, attr);
             j++;
         }
     }
@@ -658,16 +789,23 @@ std::set<pfaedle::trgraph::edge*> router::getCachedHops(
         trgraph::edge* from, const std::set<trgraph::edge*>& tos,
         const std::unordered_map<trgraph::edge*, edge_list*>& edgesRet,
         std::unordered_map<trgraph::edge*, edge_cost>* rCosts,
-        const routing_attributes& rAttrs) const
+        uint32_t attr) const
 {
+    if (!_caching) return tos;
+
     std::set<trgraph::edge*> ret;
+    const auto fromId = _g.get_id(from);
+    std::vector<trgraph::csr_graph::id> ids;
+
     for (auto to : tos)
     {
-        if (_caching && (*_cache[omp_get_thread_num()])[rAttrs][from].count(to))
+        edge_cost c;
+        if (_cache.get(attr, fromId, _g.get_id(to), c, ids))
         {
-            const auto& cv = (*_cache[omp_get_thread_num()])[rAttrs][from][to];
-            (*rCosts)[to] = cv.first;
-            *edgesRet.at(to) = cv.second;
+            (*rCosts)[to] = c;
+            edge_list* el = edgesRet.at(to);
+            el->clear();
+            for (auto id : ids) el->push_back(_g.get_edge(id));
         }
         else
         {
@@ -679,14 +817,91 @@ std::set<pfaedle::trgraph::edge*> router::getCachedHops(
 }
 
 void router::cache(trgraph::edge* from, trgraph::edge* to, const edge_cost& c,
-                   edge_list* edges, const routing_attributes& rAttrs) const
+                   edge_list* edges, uint32_t attr) const
 {
     if (!_caching) return;
     if (from == to) return;
-    (*_cache[omp_get_thread_num()])[rAttrs][from][to] =
-            std::pair<edge_cost, edge_list>(c, *edges);
+
+    std::vector<trgraph::csr_graph::id> ids;
+    ids.reserve(edges->size());
+    for (auto e : *edges) ids.push_back(_g.get_id(e));
+    _cache.put(attr, _g.get_id(from), _g.get_id(to), c, ids);
+}
+
+size_t router::getNumThreads() const { return _numThreads; }
+
+void router::build_hierarchy(const routing_options& rOpts, const trgraph::restrictor& rest)
+{
+    const auto& topo = _g.get_topology();
+
+    // the candidate edges of stops start at station nodes. Turns at station
+    // nodes are the only ones whose costs depend on the hop, so all edges
+    // touching them stay in the core
+    std::vector<bool> core(topo.getNumEdgs());
+    for (trgraph::csr_graph::id e = 0; e < topo.getNumEdgs(); e++)
+    {
+        core[e] = _g.get_si(topo.getFrom(e)) || _g.get_si(topo.getTo(e));
+    }
+
+    // without line information, turn costs are fixed except for passing
+    // through stations not in the target group. That is assumed to happen at
+    // every station here, hops are never cheaper than that
+    routing_attributes noLines;
+    CostFunc cost(_g, noLines, rOpts, rest, nullptr, std::numeric_limits<double>::infinity());
+    auto weight = [&](trgraph::csr_graph::id from, trgraph::csr_graph::id n,
+                      trgraph::csr_graph::id to) {
+        double w = cost(from, n, to).getValue();
+        if (_g.get_si(n)) w += std::max(0.0, rOpts.passThruStationsPunish);
+        return w;
+    };
+
+    auto t1 = TIME();
+    _hierarchy = std::make_unique<util::graph::CsrHierarchy>(topo, core, weight);
+    _hierarchyOpts = rOpts;
+    _hierarchyRes = &rest;
+
+    LOG(INFO) << "Contracted graph in " << TOOK(t1, TIME()) << " ms, "
+              << _hierarchy->getNumCoreEdgs() << " of " << topo.getNumEdgs()
+              << " edges left in the core, " << _hierarchy->getNumShortcuts()
+              << " shortcuts";
+}
+
+bool router::useHierarchy(const std::vector<trgraph::csr_graph::id>& froms,
+                          const std::vector<std::vector<trgraph::csr_graph::id>>& tos,
+                          const routing_attributes& rAttrs, const routing_options& rOpts,
+                          const trgraph::restrictor& rest) const
+{
+    if (!_hierarchy || &rest != _hierarchyRes || !(rOpts == _hierarchyOpts)) return false;
+
+    // the similarity to the lines of an edge is not part of the hierarchy
+    if (!rAttrs.short_name.empty() || !rAttrs.to.empty() || !rAttrs.from.empty())
+        return false;
+
+    for (auto e : froms)
+    {
+        if (!_hierarchy->isCore(e)) return false;
+    }
+    for (const auto& t : tos)
+    {
+        for (auto e : t)
+        {
+            if (!_hierarchy->isCore(e)) return false;
+        }
+    }
+
+    return true;
+}
+
+bool router::load_cache(const std::string& path, const std::string& key)
+{
+    if (!_caching || key.empty()) return false;
+    return _cache.load(path, key, _g.get_topology().getNumEdgs());
 }
 
-size_t router::getCacheNumber() const { return _cache.size(); }
+void router::store_cache(const std::string& path, const std::string& key) const
+{
+    if (!_caching || key.empty()) return;
+    _cache.store(path, key);
+}
 
 }
@@ -22,10 +22,10 @@
 #include <util/graph/EDijkstra.h>
 
 #include <logging/logger.h>
+#include <atomic>
+#include <cmath>
 #include <map>
-#include <mutex>
 #include <random>
-#include <thread>
 #include <fstream>
 #include <utility>
 #include <stdexcept>
@@ -45,6 +45,65 @@ using util::graph::EDijkstra;
 
 namespace pfaedle::router
 {
+namespace
+{
+// Shapes matched before are in the spilled shapes of the feed, trips do not resolve those.
+bool has_shape(const pfaedle::gtfs::feed& feed, const pfaedle::gtfs::trip& t)
+{
+    if (t.shape().has_value())
+        return !t.shape()->get().empty();
+
+    return !t.shape_id.empty() && feed.spilled_shapes.count(t.shape_id) > 0;
+}
+
+constexpr double EARTH_RADIUS = 6378137.0;
+constexpr double RAD_TO_DEG = 180.0 / M_PI;
+// Web mercator meters per degree of longitude.
+constexpr double METERS_PER_DEGREE = 111319.4907932735677;
+
+// Web mercator points of a shape, one array per coordinate so the kernels below vectorize.
+struct shape_geometry
+{
+    std::vector<double> x;
+    std::vector<double> y;
+    // Speed in km/h the point is reached with.
+    std::vector<double> speed;
+    // One past the last point of every hop.
+    std::vector<size_t> hop_ends;
+
+    void add(const POINT& p, double s)
+    {
+        x.push_back(p.getX());
+        y.push_back(p.getY());
+        speed.push_back(s);
+    }
+};
+
+// Latitudes in radians, as webMercToLatLng() computes them.
+void web_merc_latitudes(const double* y, double* lat, size_t n)
+{
+#pragma omp simd
+    for (size_t i = 0; i < n; i++)
+        lat[i] = 2.0 * std::atan(std::exp(y[i] / EARTH_RADIUS)) - M_PI_2;
+}
+
+// Meters from the previous point, as webMercMeterDist() computes them, 0 for the first one.
+void web_merc_steps(const double* x, const double* y, const double* lat, double* step, size_t n)
+{
+    if (n == 0)
+        return;
+
+    step[0] = 0;
+#pragma omp simd
+    for (size_t i = 1; i < n; i++)
+    {
+        const double dx = x[i] - x[i - 1];
+        const double dy = y[i] - y[i - 1];
+        step[i] = std::sqrt(dx * dx + dy * dy) * std::cos((lat[i - 1] + lat[i]) / 2.0);
+    }
+}
+}
+
 shape_builder::shape_builder(pfaedle::gtfs::feed& feed,
                              pfaedle::gtfs::feed& evalFeed,
                              route_type_set mots,
@@ -53,7 +112,8 @@ shape_builder::shape_builder(pfaedle::gtfs::feed& feed,
                            trgraph::graph& graph,
                            feed_stops& stops,
                              trgraph::restrictor& restr,
-                           const config::config& cfg) :
+                           const config::config& cfg,
+                             size_t numThreads) :
     _feed(feed),
     _evalFeed(evalFeed),
     _mots(std::move(mots)),
@@ -61,12 +121,25 @@ shape_builder::shape_builder(pfaedle::gtfs::feed& feed,
     _ecoll(collector),
     _cfg(cfg),
     _g(graph),
-    _crouter(std::thread::hardware_concurrency(), cfg.useCaching),
+    _csr(graph),
+    _crouter(_csr, numThreads, cfg.useCaching,
+             static_cast<size_t>(cfg.routeCacheSize * 1024 * 1024)),
     _stops(stops),
     _curShpCnt(0),
-    _numThreads{_crouter.getCacheNumber()},
+    _numThreads{_crouter.getNumThreads()},
     _restr(restr)
 {
+    if (_cfg.useHierarchy)
+        _crouter.build_hierarchy(_motCfg.routingOpts, _restr);
+
+    if (!_cfg.routeCachePath.empty())
+    {
+        _routeCacheKey = hop_cache::get_key(_csr, _restr, _motCfg.routingOpts);
+        if (_routeCacheKey.empty())
+            LOG(INFO) << "Graph ids are not stable, route cache is not persisted";
+        else if (_crouter.load_cache(_cfg.routeCachePath, _routeCacheKey))
+            LOG(INFO) << "Loaded route cache " << _routeCacheKey;
+    }
 }
 
 const node_candidate_group& shape_builder::get_node_candidates(const pfaedle::gtfs::stop& s) const
@@ -208,11 +281,8 @@ void shape_builder::get_shape(pfaedle::netgraph::graph& ng)
     for (auto& trip_pair : _feed.trips)
     {
         auto& t = trip_pair.second;
-        if(!t.shape().has_value())
-            continue;
-        gtfs::shape& shape = t.shape()->get();
-        if (!shape.points.empty())
-            shpUsage[shape.shape_id]++;
+        if (has_shape(_feed, t))
+            shpUsage[t.shape_id]++;
     }
 
     // to avoid unfair load balance on threads
@@ -221,27 +291,35 @@ void shape_builder::get_shape(pfaedle::netgraph::graph& ng)
 
     std::shuffle(clusters.begin(), clusters.end(), g);
 
-    size_t iters = EDijkstra::ITERS;
     size_t totiters = EDijkstra::ITERS;
     size_t oiters = EDijkstra::ITERS;
-    size_t j = 0;
+    std::atomic<size_t> j{0};
 
     auto t1 = TIME();
     auto t2 = TIME();
     double tot_avg_dist = 0;
     size_t tot_num_trips = 0;
 
-//#pragma omp parallel for num_threads(_numThreads)
+    // _feed.shapes is only read while matching. New shapes are spilled to
+    // disk right away, the ids of replaced shapes are collected per thread and
+    // erased afterwards, so the workers never have to synchronize on the
+    // shape map.
+    std::vector<std::vector<std::string>> thread_replaced(_numThreads);
+    std::exception_ptr error;
+
+    // the clusters are shuffled above, a dynamic schedule hands them out to
+    // whichever thread becomes idle first
+#pragma omp parallel for num_threads(_numThreads) schedule(dynamic) reduction(+:tot_avg_dist, tot_num_trips)
     for (size_t i = 0; i < clusters.size(); i++)
     {
-        j++;
+        const size_t cur_j = ++j;
 
-        if (j % 10 == 0)
+        if (cur_j % 10 == 0)
         {
-//#pragma omp critical
+#pragma omp critical(progress)
             {
-                LOG(INFO) << "@ " << j << " / " << clusters.size() << " ("
-                          << (static_cast<int>((j * 1.0) / clusters.size() * 100))
+                LOG(INFO) << "@ " << cur_j << " / " << clusters.size() << " ("
+                          << (static_cast<int>((cur_j * 1.0) / clusters.size() * 100))
                           << "%, " << (EDijkstra::ITERS - oiters) << " iters, "
                           << "matching " << (10.0 / (TOOK(t1, TIME()) / 1000))
                           << " trips/sec)";
@@ -251,68 +329,83 @@ void shape_builder::get_shape(pfaedle::netgraph::graph& ng)
             }
         }
 
-        // explicitly call const version of shape here for thread safety
-        const pfaedle::router::shape cshp =
-                const_cast<const shape_builder&>(*this).get_shape(*clusters[i][0]);
-        tot_avg_dist += cshp.avgHopDist;
-
-        if (_cfg.buildTransitGraph)
+        try
         {
-//#pragma omp critical
+            // explicitly call const version of shape here for thread safety
+            const pfaedle::router::shape cshp =
+                    const_cast<const shape_builder&>(*this).get_shape(*clusters[i][0]);
+            tot_avg_dist += cshp.avgHopDist;
+
+            if (_cfg.buildTransitGraph)
             {
-                write_transit_graph(cshp, gtfsGraph, clusters[i]);
+#pragma omp critical(transit_graph)
+                {
+                    write_transit_graph(cshp, gtfsGraph, clusters[i]);
+                }
             }
-        }
 
-        std::vector<double> distances;
-        std::vector<double> times;
-        std::vector<double> costs;
-        const pfaedle::gtfs::shape& shp = get_gtfs_shape(cshp, *clusters[i][0], distances, times, costs);
+            std::vector<double> distances;
+            std::vector<double> times;
+            std::vector<double> costs;
+            pfaedle::gtfs::shape shp = get_gtfs_shape(cshp, *clusters[i][0], distances, times, costs);
 
-        LOG(TRACE) << "Took " << EDijkstra::ITERS - iters << " iterations.";
-        iters = EDijkstra::ITERS;
+            tot_num_trips += clusters[i].size();
 
-        tot_num_trips += clusters[i].size();
-
-        for (auto t : clusters[i])
-        {
             if (_cfg.evaluate)
             {
-                std::lock_guard<std::mutex> guard(_shpMutex);
-                if(_evalFeed.shapes.count(t->shape_id))
-                {
-                    _ecoll.add(*t,
-                               &_evalFeed.shapes.at(t->shape_id),
-                               shp,
-                               distances);
-                }
-                else
-                {
-                    _ecoll.add(*t,
-                               nullptr,
-                               shp,
-                               distances);
-                }
+                std::vector<const pfaedle::gtfs::shape*> old_shapes;
+                for (auto t : clusters[i])
+                    old_shapes.push_back(_evalFeed.shapes.get(t->shape_id));
+
+                // before set_shape() changes the dist values of the trips
+                _ecoll.add(clusters[i], old_shapes, shp, distances);
             }
 
-            if(t->shape().has_value())
+            for (auto t : clusters[i])
             {
-                gtfs::shape& shape = t->shape().value();
-                if (!shape.empty() && shpUsage[shape.shape_id] > 0)
+                if (has_shape(_feed, *t))
                 {
-                    shpUsage[t->shape_id]--;
-                    if (shpUsage[t->shape_id] == 0)
-                    {
-                        std::lock_guard<std::mutex> guard(_shpMutex);
-                        _feed.shapes.erase(t->shape_id);
-                    }
+                    thread_replaced[omp_get_thread_num()].push_back(t->shape_id);
                 }
+                set_shape(*t, shp, distances, costs);
             }
-            set_shape(*t, shp, distances, costs);
 
+            _feed.spilled_shapes.add(shp);
+        }
+        catch (...)
+        {
+            // exceptions must not leave the parallel region, keep the first
+            // one and rethrow it once all threads are done
+#pragma omp critical(error)
+            {
+                if (!error)
+                    error = std::current_exception();
+            }
         }
     }
 
+    if (error)
+        std::rethrow_exception(error);
+
+    for (const auto& replaced : thread_replaced)
+    {
+        for (const auto& shape_id : replaced)
+        {
+            auto usage = shpUsage.find(shape_id);
+            if (usage == shpUsage.end() || usage->second == 0)
+                continue;
+
+            if (--usage->second == 0)
+            {
+                _feed.shapes.erase(shape_id);
+                _feed.spilled_shapes.erase(shape_id);
+            }
+        }
+    }
+
+    // the trips that were matched now refer to spilled shapes
+    _feed.link_shapes();
+
     LOG(INFO) << "Matched " << tot_num_trips << " trips in " << clusters.size()
               << " clusters.";
     LOG(DEBUG) << "Took " << (EDijkstra::ITERS - totiters)
@@ -327,6 +420,9 @@ void shape_builder::get_shape(pfaedle::netgraph::graph& ng)
                << (tot_avg_dist / static_cast<double>(clusters.size()))
                << " meters";
 
+    if (!_routeCacheKey.empty())
+        _crouter.store_cache(_cfg.routeCachePath, _routeCacheKey);
+
     if (_cfg.buildTransitGraph)
     {
         LOG(INFO) << "Building transit network graph...";
@@ -336,24 +432,24 @@ void shape_builder::get_shape(pfaedle::netgraph::graph& ng)
 
 void shape_builder::set_shape(pfaedle::gtfs::trip& t, const pfaedle::gtfs::shape& s, const std::vector<double>& dists, const std::vector<double>& costs)
 {
-    const auto& stop_times = t.stop_times();
+    const auto stop_times = t.stop_times();
     assert(dists.size() == stop_times.size() && costs.size() == stop_times.size());
 
     double total_cost = 0.f;
     for (auto& n : costs) total_cost += n;
     static constexpr size_t dwell_time_seconds = 10;
 
-    const gtfs::stop_time& st_begin = *stop_times.begin();
-    const gtfs::stop_time& st_end = *(stop_times.end() - 1);
-    const size_t time_span = st_end.departure_time.get_total_seconds() - st_begin.departure_time.get_total_seconds();
+    const gtfs::stop_time st_begin = stop_times.front();
+    const gtfs::stop_time st_end = stop_times.back();
+    const size_t time_span = st_end.departure_time().get_total_seconds() - st_begin.departure_time().get_total_seconds();
 
     // set distances
     size_t i = 0;
-    size_t previous_time = st_begin.departure_time.get_total_seconds();
-    for (gtfs::stop_time& st : stop_times)
+    size_t previous_time = st_begin.departure_time().get_total_seconds();
+    for (gtfs::stop_time st : stop_times)
     {
-        if (&st != &st_begin && &st != &st_end &&
-                (!st.arrival_time.is_provided() || !st.departure_time.is_provided() || _cfg.interpolate_times))
+        if (st != st_begin && st != st_end &&
+                (!st.arrival_time().is_provided() || !st.departure_time().is_provided() || _cfg.interpolate_times))
         {
             previous_time = (time_span * costs[i] / total_cost) + previous_time;
             gtfs::time time(previous_time);
@@ -361,19 +457,18 @@ void shape_builder::set_shape(pfaedle::gtfs::trip& t, const pfaedle::gtfs::shape
             LOG(INFO) << "Reaching stop " << st.stop()->get().stop_name
                       << " \n\t - has a calculated cost of " << costs[i]
                       << " \n\t - has a calculated time of " << time.get_raw_time()
-                      << " \n\t - and a provided time of " << st.departure_time.get_raw_time();
+                      << " \n\t - and a provided time of " << st.departure_time().get_raw_time();
             LOG(INFO) << "Reaching stop " << st.stop()->get().stop_name << " has a distance of " << dists[i];
 #endif
-            st.arrival_time = time;
-            st.departure_time = time.add_seconds(dwell_time_seconds);
+            st.set_arrival_time(time);
+            st.set_departure_time(time.add_seconds(dwell_time_seconds));
         }
 
-        st.shape_dist_traveled = dists[i];
+        st.set_shape_dist_traveled(dists[i]);
         i++;
     }
 
-    std::lock_guard guard(_shpMutex);
-    _feed.shapes.emplace(s.shape_id, s);
+    // the shape itself is spilled by get_shape(), see there
     t.shape_id = s.shape_id;
 }
 
@@ -389,137 +484,82 @@ pfaedle::gtfs::shape shape_builder::get_gtfs_shape(
 
     assert(shp.hops.size() == t.stop_times().size() - 1);
 
-    size_t seq = 0;
-
-    double time = 0;
-    double lastTime = 0;
+    // Gather the points in the order they are travelled, a hop without edges goes straight from
+    // its start to its end node.
+    shape_geometry geom;
     double last_speed = 50.f;
-
-    double dist = -1;
-    double lastDist = -1;
-
-    hopDists.push_back(0);
-    costs.push_back(0);
-    POINT last(0, 0);
     for (const auto& hop : shp.hops)
     {
         const trgraph::node* node = hop.start;
         if (hop.edges.empty())
         {
-            POINT ll = webMercToLatLng(
-                    hop.start->pl().get_geom()->getX(),
-                    hop.start->pl().get_geom()->getY());
+            geom.add(*hop.start->pl().get_geom(), last_speed);
+            geom.add(*hop.end->pl().get_geom(), last_speed);
+        }
+
+        for (auto it = hop.edges.rbegin(); it != hop.edges.rend(); it++)
+        {
+            const auto* edge = *it;
+
+            // time = 3.6f * distance(m) / speed (km/h)
+            last_speed = edge->pl().get_max_speed() - 10.0f;
 
-            if (dist > -0.5)
+            const auto& line = *edge->pl().get_geom();
+            if ((edge->getFrom() == node) ^ edge->pl().is_reversed())
             {
-                const double distance_between_points = webMercMeterDist(last, *hop.start->pl().get_geom());
-                time += 3.6f * distance_between_points / last_speed;
-                dist += distance_between_points;
+                for (const auto& p : line)
+                    geom.add(p, last_speed);
             }
             else
             {
-                dist = 0;
-                time = 0;
+                for (auto p = line.rbegin(); p != line.rend(); ++p)
+                    geom.add(*p, last_speed);
             }
+            node = edge->getOtherNd(node);
+        }
 
-            last = *hop.start->pl().get_geom();
+        geom.hop_ends.push_back(geom.x.size());
+    }
 
-            if (dist - lastDist > 0.01)
+    const size_t n = geom.x.size();
+    std::vector<double> lat(n);
+    std::vector<double> step(n);
+    web_merc_latitudes(geom.y.data(), lat.data(), n);
+    web_merc_steps(geom.x.data(), geom.y.data(), lat.data(), step.data(), n);
+
+    // Points closer than a centimeter to the last one are dropped.
+    size_t seq = 0;
+    double time = 0;
+    double lastTime = 0;
+    double dist = 0;
+    double lastDist = -1;
+
+    hopDists.push_back(0);
+    costs.push_back(0);
+    ret.points.reserve(n);
+    size_t i = 0;
+    for (size_t h = 0; h < shp.hops.size(); h++)
+    {
+        for (; i < geom.hop_ends[h]; i++)
+        {
+            if (i > 0)
             {
-                gtfs::shape_point point{ret.shape_id, ll.getY(), ll.getX(), seq, dist};
-                ret.points.push_back(point);
-                seq++;
-                lastDist = dist;
-                lastTime = time;
+                time += 3.6f * step[i] / geom.speed[i];
+                dist += step[i];
             }
 
-            const double distance_between_points = webMercMeterDist(last, *hop.end->pl().get_geom());
-            time += 3.6f * distance_between_points / last_speed;
-            dist += distance_between_points;
-            last = *hop.end->pl().get_geom();
-
             if (dist - lastDist > 0.01)
             {
-                ll = webMercToLatLng(
-                        hop.end->pl().get_geom()->getX(),
-                        hop.end->pl().get_geom()->getY());
-                gtfs::shape_point point{ret.shape_id, ll.getY(), ll.getX(), seq, dist};
-                ret.points.push_back(point);
+                ret.points.push_back({lat[i] * RAD_TO_DEG, geom.x[i] / METERS_PER_DEGREE, seq, dist});
                 seq++;
                 lastDist = dist;
                 lastTime = time;
             }
         }
 
-        for (auto it = hop.edges.rbegin(); it != hop.edges.rend(); it++)
-        {
-            const auto* edge = *it;
-
-            // time = 3.6f * distance(m) / speed (km/h)
-            last_speed = edge->pl().get_max_speed() - 10.0f;
-
-            if ((edge->getFrom() == node) ^ edge->pl().is_reversed())
-            {
-                for (size_t i = 0; i < edge->pl().get_geom()->size(); i++)
-                {
-                    const POINT& cur = (*edge->pl().get_geom())[i];
-                    if (dist > -0.5)
-                    {
-                        const double distance_between_points = webMercMeterDist(last, cur);
-                        time += 3.6f * distance_between_points / last_speed;
-                        dist += distance_between_points;
-                    }else
-                    {
-                        dist = 0;
-                        time = 0;
-                    }
-
-                    last = cur;
-                    if (dist - lastDist > 0.01)
-                    {
-                        POINT ll = webMercToLatLng(cur.getX(), cur.getY());
-                        gtfs::shape_point point{ret.shape_id, ll.getY(), ll.getX(), seq, dist};
-                        ret.points.push_back(point);
-
-                        seq++;
-                        lastDist = dist;
-                        lastTime = time;
-                    }
-                }
-            }
-            else
-            {
-                for (int64_t i = edge->pl().get_geom()->size() - 1; i >= 0; i--)
-                {
-                    const POINT& cur = (*edge->pl().get_geom())[i];
-                    if (dist > -0.5)
-                    {
-                        const double distance_between_points = webMercMeterDist(last, cur);
-                        time += 3.6f * distance_between_points / last_speed;
-                        dist += distance_between_points;
-                    }else
-                    {
-                        dist = 0;
-                        time = 0;
-                    }
-                    last = cur;
-                    if (dist - lastDist > 0.01)
-                    {
-                        POINT ll = webMercToLatLng(cur.getX(), cur.getY());
-                        gtfs::shape_point point{ret.shape_id, ll.getY(), ll.getX(), seq, dist};
-                        ret.points.push_back(point);
-                        seq++;
-                        lastDist = dist;
-                        lastTime = time;
-                    }
-                }
-            }
-            node = edge->getOtherNd(node);
-        }
-
         hopDists.push_back(lastDist);
         hopTimes.push_back(lastTime);
-        costs.push_back(hop.cost);
+        costs.push_back(shp.hops[h].cost);
     }
 
     return ret;
@@ -528,10 +568,11 @@ pfaedle::gtfs::shape shape_builder::get_gtfs_shape(
 std::string shape_builder::get_free_shapeId(pfaedle::gtfs::trip& t)
 {
     std::string ret;
-    std::lock_guard<std::mutex> guard(_shpMutex);
-    while (ret.empty() || _feed.shapes.count(ret))
+    // ids are unique, they are drawn from an atomic counter and checked
+    // against the (unmodified) shape map and the shapes of earlier runs
+    while (ret.empty() || _feed.shapes.count(ret) || _feed.spilled_shapes.count(ret))
     {
-        _curShpCnt++;
+        const size_t shape_count = ++_curShpCnt;
         ret = "shp_";
         if(t.route().has_value())
         {
@@ -542,7 +583,7 @@ std::string shape_builder::get_free_shapeId(pfaedle::gtfs::trip& t)
         {
             ret += t.trip_id;
         }
-        ret += "_" + std::to_string(_curShpCnt);
+        ret += "_" + std::to_string(shape_count);
     }
 
     return ret;
@@ -571,8 +612,8 @@ const routing_attributes& shape_builder::getRAttrs(const pfaedle::gtfs::trip& tr
             ret.short_name = lnormzer.norm(route.route_long_name);
 
 
-        ret.from = _motCfg.osmBuildOpts.statNormzer.norm(trip.stop_times().begin()->get().stop()->get().stop_name);
-        ret.to = _motCfg.osmBuildOpts.statNormzer.norm((--trip.stop_times().end())->get().stop()->get().stop_name);
+        ret.from = _motCfg.osmBuildOpts.statNormzer.norm(trip.stop_times().front().stop()->get().stop_name);
+        ret.to = _motCfg.osmBuildOpts.statNormzer.norm(trip.stop_times().back().stop()->get().stop_name);
 
         return _rAttrs
                 .insert(std::pair<const gtfs::trip*, routing_attributes>(&trip, ret))
@@ -601,7 +642,7 @@ void shape_builder::get_gtfs_box(const pfaedle::gtfs::feed& feed,
         if (!tid.empty() && t.trip_id != tid)
             continue;
 
-        if (tid.empty() && t.shape().has_value() && !t.shape().value().get().points.empty() && !dropShapes)
+        if (tid.empty() && has_shape(feed, t) && !dropShapes)
             continue;
 
         if (t.stop_times().size() < 2)
@@ -611,9 +652,8 @@ void shape_builder::get_gtfs_box(const pfaedle::gtfs::feed& feed,
         if (route.has_value() && mots.count(route.value().get().route_type))
         {
             DBox cur;
-            for (const auto& st : t.stop_times())
+            for (const auto stop_time : t.stop_times())
             {
-                pfaedle::gtfs::stop_time& stop_time = st;
                 if(stop_time.stop().has_value())
                 {
                     pfaedle::gtfs::stop& s = stop_time.stop().value();
@@ -627,12 +667,12 @@ void shape_builder::get_gtfs_box(const pfaedle::gtfs::feed& feed,
 
 node_candidate_route shape_builder::get_node_candidate_route(pfaedle::gtfs::trip& trip) const
 {
-    const auto& trip_stop_times = trip.stop_times();
+    const auto trip_stop_times = trip.stop_times();
     node_candidate_route ncr(trip_stop_times.size());
 
     size_t i = 0;
 
-    for (const gtfs::stop_time& st : trip_stop_times)
+    for (const gtfs::stop_time st : trip_stop_times)
     {
 
         ncr[i] = get_node_candidates(st.stop().value());
@@ -654,7 +694,7 @@ double shape_builder::get_average_hop_distance(pfaedle::gtfs::trip& trip) const
 
     const pfaedle::gtfs::stop* prev = nullptr;
 
-    for (const gtfs::stop_time& st : trip.stop_times())
+    for (const gtfs::stop_time st : trip.stop_times())
     {
         if (!prev)
         {
@@ -683,7 +723,7 @@ clusters shape_builder::cluster_trips(pfaedle::gtfs::feed& f, const route_type_s
     for (auto& trip_pair : f.trips)
     {
         auto& trip = trip_pair.second;
-        if(trip.shape().has_value() && !trip.shape()->get().empty() && !_cfg.dropShapes)
+        if (has_shape(f, trip) && !_cfg.dropShapes)
             continue;
 
         if (trip.stop_times().size() < 2)
@@ -696,8 +736,8 @@ clusters shape_builder::cluster_trips(pfaedle::gtfs::feed& f, const route_type_s
             continue;
 
         bool found = false;
-        stop_pair pair(&trip.stop_times().begin()->get().stop()->get(),
-                       &trip.stop_times().rbegin()->get().stop()->get());
+        stop_pair pair(&trip.stop_times().front().stop()->get(),
+                       &trip.stop_times().back().stop()->get());
         const auto& c = cluster_idx[pair];
 
         for (auto i : c)
@@ -745,8 +785,8 @@ bool shape_builder::routingEqual(const pfaedle::gtfs::stop& a, const pfaedle::gt
 
 bool shape_builder::routingEqual(pfaedle::gtfs::trip& a, pfaedle::gtfs::trip& b)
 {
-    const auto& ast_list = a.stop_times();
-    const auto& bst_list = b.stop_times();
+    const auto ast_list = a.stop_times();
+    const auto bst_list = b.stop_times();
 
     if (ast_list.size() != bst_list.size())
         return false;
@@ -754,9 +794,9 @@ bool shape_builder::routingEqual(pfaedle::gtfs::trip& a, pfaedle::gtfs::trip& b)
         return false;
 
     auto stb = bst_list.begin();
-    for (const auto& sta : ast_list)
+    for (const auto sta : ast_list)
     {
-        if (!routingEqual(*sta.get().stop(), *stb->get().stop()))
+        if (!routingEqual(*sta.stop(), *(*stb).stop()))
         {
             return false;
         }
@@ -0,0 +1,196 @@
+// Copyright 2018, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include "pfaedle/trgraph/csr_graph.h"
+#include "util/Misc.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+using pfaedle::trgraph::csr_graph;
+
+namespace
+{
+void add_line(util::Fnv1a& h, const pfaedle::trgraph::transit_edge_line* l)
+{
+    h.add(l->shortName);
+    h.add(l->fromStr);
+    h.add(l->toStr);
+}
+
+// hash over an edge, independent of any ids
+uint64_t edge_hash(const pfaedle::trgraph::edge* e)
+{
+    util::Fnv1a h;
+    h.add(e->getTo()->pl().get_geom()->getX());
+    h.add(e->getTo()->pl().get_geom()->getY());
+    h.add(e->pl().get_length());
+    h.add(static_cast<uint64_t>(e->pl().level()));
+    h.add(static_cast<uint64_t>(e->pl().oneWay()));
+    if (e->pl().get_geom())
+    {
+        for (const auto& p : *e->pl().get_geom())
+        {
+            h.add(p.getX());
+            h.add(p.getY());
+        }
+    }
+    for (const auto* l : e->pl().get_lines()) add_line(h, l);
+    return h.get();
+}
+
+// hash over a node and its outgoing edges, independent of any ids and of
+// the order of the edges
+uint64_t node_hash(const pfaedle::trgraph::node* n)
+{
+    util::Fnv1a h;
+    if (n->pl().get_si())
+    {
+        h.add(n->pl().get_si()->get_name());
+        h.add(n->pl().get_si()->get_track());
+    }
+    h.add(static_cast<uint64_t>(n->getAdjListOut().size()));
+    uint64_t edges = 0;
+    for (const auto* e : n->getAdjListOut()) edges += edge_hash(e);
+    h.add(edges);
+    return h.get();
+}
+}  // namespace
+
+// _____________________________________________________________________________
+csr_graph::csr_graph(const graph& g) :
+    _stableIds(true)
+{
+    size_t numEdges = 0;
+    std::unordered_map<const node*, id> nIds;
+    nIds.reserve(g.getNds().size());
+
+    // number the nodes by their position, nodes at the same position by
+    // their surroundings. The node set is ordered by address, which differs
+    // from run to run
+    std::vector<std::pair<uint64_t, node*>> keyed;
+    keyed.reserve(g.getNds().size());
+    for (auto* n : g.getNds())
+    {
+        keyed.emplace_back(node_hash(n), n);
+        numEdges += n->getAdjListOut().size();
+    }
+
+    auto less = [](const std::pair<uint64_t, node*>& a, const std::pair<uint64_t, node*>& b) {
+        const POINT& ga = *a.second->pl().get_geom();
+        const POINT& gb = *b.second->pl().get_geom();
+        if (ga.getX() != gb.getX()) return ga.getX() < gb.getX();
+        if (ga.getY() != gb.getY()) return ga.getY() < gb.getY();
+        return a.first < b.first;
+    };
+    std::sort(keyed.begin(), keyed.end(), less);
+
+    for (const auto& k : keyed)
+    {
+        if (!_nodes.empty() && !less(keyed[_nodes.size() - 1], k)) _stableIds = false;
+        nIds[k.second] = static_cast<id>(_nodes.size());
+        _nodes.push_back(k.second);
+    }
+
+    _geoms.reserve(_nodes.size());
+    _sis.reserve(_nodes.size());
+    _comps.reserve(_nodes.size());
+
+    _edges.reserve(numEdges);
+    _ids.reserve(numEdges);
+    _lengths.reserve(numEdges);
+    _levels.reserve(numEdges);
+    _oneWays.reserve(numEdges);
+    _restricted.reserve(numEdges);
+    _frontHops.reserve(numEdges);
+    _backHops.reserve(numEdges);
+    _lineOffsets.reserve(numEdges + 1);
+    _lineOffsets.push_back(0);
+
+    util::Fnv1a fp;
+    std::unordered_map<const station_group*, uint64_t> groups;
+
+    for (auto* n : _nodes)
+    {
+        _topo.addNd();
+        _geoms.push_back(*n->pl().get_geom());
+        _sis.push_back(n->pl().get_si());
+        _comps.push_back(n->pl().get_component());
+
+        fp.add(_geoms.back().getX());
+        fp.add(_geoms.back().getY());
+
+        // station groups are identified by the order they first appear in
+        const station_info* si = n->pl().get_si();
+        if (si)
+        {
+            auto grp = groups.emplace(si->get_group(), groups.size() + 1).first;
+            fp.add(si->get_group() ? grp->second : 0);
+        }
+        else
+        {
+            fp.add(static_cast<uint64_t>(NONE));
+        }
+        fp.add(static_cast<uint64_t>(n->getAdjListOut().size()));
+
+        // the adjacency lists are in insertion order, which differs from run
+        // to run, so the edges are numbered by their target and their
+        // surroundings
+        std::vector<std::pair<uint64_t, edge*>> out;
+        out.reserve(n->getAdjListOut().size());
+        for (auto* e : n->getAdjListOut()) out.emplace_back(edge_hash(e), e);
+
+        auto eLess = [&nIds](const std::pair<uint64_t, edge*>& a,
+                             const std::pair<uint64_t, edge*>& b) {
+            id ta = nIds.at(a.second->getTo());
+            id tb = nIds.at(b.second->getTo());
+            if (ta != tb) return ta < tb;
+            return a.first < b.first;
+        };
+        std::sort(out.begin(), out.end(), eLess);
+
+        for (size_t i = 0; i < out.size(); i++)
+        {
+            if (i > 0 && !eLess(out[i - 1], out[i])) _stableIds = false;
+            auto* e = out[i].second;
+            _ids[e] = _topo.addEdg(nIds.at(e->getTo()));
+            _edges.push_back(e);
+            _lengths.push_back(static_cast<float>(e->pl().get_length()));
+            _levels.push_back(e->pl().level());
+            _oneWays.push_back(e->pl().oneWay());
+            _restricted.push_back(e->pl().is_restricted());
+
+            // hops are only defined for geometries of at least 2 points
+            if (e->pl().get_geom() && e->pl().get_geom()->size() > 1)
+            {
+                _frontHops.push_back(e->pl().frontHop());
+                _backHops.push_back(e->pl().backHop());
+            }
+            else
+            {
+                _frontHops.emplace_back();
+                _backHops.emplace_back();
+            }
+
+            const auto& lines = e->pl().get_lines();
+            _lines.insert(_lines.end(), lines.begin(), lines.end());
+            _lineOffsets.push_back(static_cast<uint32_t>(_lines.size()));
+
+            fp.add(static_cast<uint64_t>(nIds.at(e->getTo())));
+            fp.add(static_cast<double>(_lengths.back()));
+            fp.add(static_cast<uint64_t>(_levels.back()));
+            fp.add(static_cast<uint64_t>(_oneWays.back()));
+            fp.add(static_cast<uint64_t>(_restricted.back()));
+            fp.add(_frontHops.back().getX());
+            fp.add(_frontHops.back().getY());
+            fp.add(_backHops.back().getX());
+            fp.add(_backHops.back().getY());
+            fp.add(static_cast<uint64_t>(lines.size()));
+            for (const auto* l : lines) add_line(fp, l);
+        }
+    }
+
+    _fingerprint = fp.get();
+}
@@ -3,6 +3,17 @@
 
 namespace pfaedle::trgraph
 {
+namespace
+{
+// the box of l in the packed tree, it must contain the segment the candidates are measured to
+BOX get_tree_box(const LINE& l, const edge* e)
+{
+    BOX box = util::geo::getBoundingBox(l);
+    box = util::geo::extendBox(*e->getFrom()->pl().get_geom(), box);
+    return util::geo::extendBox(*e->getTo()->pl().get_geom(), box);
+}
+}
+
 edge_grid::edge_grid(double w, double h, const util::geo::Box<double>& bbox) :
     Grid(w, h, bbox)
 {}
@@ -18,11 +29,49 @@ edge_grid::edge_grid(bool buildValIdx) :
     Grid(buildValIdx)
 {
 }
+void edge_grid::add(const LINE& l, edge* e)
+{
+    if (_packed)
+        _tree.add(get_tree_box(l, e), e);
+    else
+        Grid::add(l, e);
+}
+void edge_grid::remove(edge* e)
+{
+    if (_packed)
+        _tree.remove(e);
+    else
+        Grid::remove(e);
+}
+void edge_grid::get(const BOX& box, std::vector<edge*>* s) const
+{
+    if (_packed)
+        _tree.get(box, s);
+    else
+        Grid::get(box, s);
+}
 edge_grid::edge_candidate_priority_queue edge_grid::get_edge_candidates(const POINT& s, double d)
 {
     edge_candidate_priority_queue ret;
     double distor = util::geo::webMercDistFactor(s);
-    std::set<edge*> neighs;
+
+    if (_packed)
+    {
+        // reused by the queries of this thread
+        thread_local std::vector<std::pair<double, edge*>> near;
+        _tree.getNearest(s, std::numeric_limits<size_t>::max(), d / distor, [&s](const edge* e) {
+            return util::geo::distToSegment(*e->getFrom()->pl().get_geom(), *e->getTo()->pl().get_geom(), s);
+        }, &near);
+
+        for (const auto& n : near)
+        {
+            ret.emplace(-n.first, n.second);
+        }
+        return ret;
+    }
+
+    // reused by the queries of this thread
+    thread_local std::vector<edge*> neighs;
     BOX box = util::geo::pad(util::geo::getBoundingBox(s), d / distor);
     get(box, &neighs);
 
@@ -39,8 +88,24 @@ edge_grid::edge_candidate_priority_queue edge_grid::get_edge_candidates(const PO
 
     return ret;
 }
-trgraph::edge_grid edge_grid::build_edge_grid(graph& g, size_t size, const BOX& webMercBox)
+trgraph::edge_grid edge_grid::build_edge_grid(graph& g, size_t size, const BOX& webMercBox, bool packed)
 {
+    if (packed)
+    {
+        trgraph::edge_grid ret(false);
+        ret._packed = true;
+        for (auto& n : g.getNds())
+        {
+            for (auto* e : n->getAdjListOut())
+            {
+                assert(e->pl().get_geom());
+                ret._tree.add(get_tree_box(*e->pl().get_geom(), e), e);
+            }
+        }
+        ret._tree.build();
+        return ret;
+    }
+
     trgraph::edge_grid ret(size, size, webMercBox, false);
     for (auto& n : g.getNds())
     {
@@ -50,6 +115,7 @@ trgraph::edge_grid edge_grid::build_edge_grid(graph& g, size_t size, const BOX&
             ret.add(*e->pl().get_geom(), e);
         }
     }
+    ret.build();
     return ret;
 }
 }
@@ -5,6 +5,7 @@
 #include "pfaedle/trgraph/edge_payload.h"
 #include "util/geo/Geo.h"
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -12,6 +13,7 @@ using pfaedle::trgraph::edge_payload;
 using pfaedle::trgraph::transit_edge_line;
 
 
+std::mutex edge_payload::_refMutex;
 std::map<LINE*, size_t> edge_payload::_flines;
 std::map<const transit_edge_line*, size_t> edge_payload::_tlines;
 
@@ -20,6 +22,7 @@ edge_payload::edge_payload() :
     _length(0), _max_speed(50.f), _oneWay(0), _hasRestr(false), _rev(false), _lvl(0)
 {
     _l = new LINE();
+    std::lock_guard<std::mutex> lock(_refMutex);
     _flines[_l] = 1;
 }
 
@@ -44,7 +47,11 @@ edge_payload::edge_payload(const edge_payload& pl, bool geoflat) :
     {
         _l = new LINE(*pl._l);
     }
-    _flines[_l]++;
+
+    {
+        std::lock_guard<std::mutex> lock(_refMutex);
+        _flines[_l]++;
+    }
 
     for (auto l : pl._lines) add_line(l);
 }
@@ -52,6 +59,7 @@ edge_payload::edge_payload(const edge_payload& pl, bool geoflat) :
 // _____________________________________________________________________________
 edge_payload::~edge_payload()
 {
+    std::lock_guard<std::mutex> lock(_refMutex);
     if (_l)
     {
         _flines[_l]--;
@@ -106,6 +114,7 @@ void edge_payload::add_line(const transit_edge_line* l)
     {
         _lines.reserve(_lines.size() + 1);
         _lines.push_back(l);
+        std::lock_guard<std::mutex> lock(_refMutex);
         if (_tlines.count(l))
             _tlines[l]++;
         else
@@ -212,12 +212,12 @@ void graph::writeSelfEdgs()
 void graph::fix_gaps(trgraph::node_grid& ng)
 {
     double meter = 1;
+    std::vector<node*> ret;
     for (auto& n : getNds())
     {
         if (n->getInDeg() + n->getOutDeg() == 1)
         {
             // get all nodes in distance
-            std::set<node*> ret;
             double distor = util::geo::webMercDistFactor(*n->pl().get_geom());
 
             ng.get(util::geo::pad(util::geo::getBoundingBox(*n->pl().get_geom()),
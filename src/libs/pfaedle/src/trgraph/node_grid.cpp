@@ -19,10 +19,54 @@ node_grid::node_grid(bool buildValIdx) :
     Grid(buildValIdx)
 {
 }
+void node_grid::add(const POINT& p, node* n)
+{
+    if (_packed)
+        _tree.add(p, n);
+    else
+        Grid::add(p, n);
+}
+void node_grid::remove(node* n)
+{
+    if (_packed)
+        _tree.remove(n);
+    else
+        Grid::remove(n);
+}
+void node_grid::get(const BOX& box, std::vector<node*>* s) const
+{
+    if (_packed)
+        _tree.get(box, s);
+    else
+        Grid::get(box, s);
+}
+template<typename F>
+node* node_grid::get_nearest_station(const node_payload& s, double d, const F& matches) const
+{
+    double distor = util::geo::webMercDistFactor(*s.get_geom());
+    double max_d = d / distor;
+    // reused by the queries of this thread
+    thread_local std::vector<std::pair<double, node*>> near;
+
+    // the tree measures in web mercator units, the distance in meters is checked afterwards
+    _tree.getNearest(*s.get_geom(), 1, max_d, [&](const node* n) {
+        if (!n->pl().get_si() || !matches(n))
+            return std::numeric_limits<double>::max();
+        return util::geo::dist(*n->pl().get_geom(), *s.get_geom());
+    }, &near);
+
+    if (near.empty() || webMercMeterDist(*near[0].second->pl().get_geom(), *s.get_geom()) >= d)
+        return nullptr;
+    return near[0].second;
+}
 node* node_grid::get_matching_node(const node_payload& s, double d)
 {
+    if (_packed)
+        return get_nearest_station(s, d, [&s](const node* n) { return n->pl().get_si()->simi(s.get_si()) > 0.5; });
+
     double distor = util::geo::webMercDistFactor(*s.get_geom());
-    std::set<node*> neighs;
+    // reused by the queries of this thread
+    thread_local std::vector<node*> neighs;
     BOX box = util::geo::pad(util::geo::getBoundingBox(*s.get_geom()), d / distor);
     get(box, &neighs);
 
@@ -46,8 +90,12 @@ node* node_grid::get_matching_node(const node_payload& s, double d)
 }
 node* node_grid::get_distance_matching_node(const node_payload& s, double d)
 {
+    // name can be different therefore don't enfore name similarities
+    if (_packed)
+        return get_nearest_station(s, d, [](const node*) { return true; });
+
     double distor = util::geo::webMercDistFactor(*s.get_geom());
-    std::set<node*> neighs;
+    thread_local std::vector<node*> neighs;
     BOX box = util::geo::pad(util::geo::getBoundingBox(*s.get_geom()), d / distor);
     get(box, &neighs);
 
@@ -75,7 +123,7 @@ std::set<node*> node_grid::get_matching_nodes(const node_payload& s, double d)
 {
     std::set<node*> ret;
     double distor = util::geo::webMercDistFactor(*s.get_geom());
-    std::set<node*> neighs;
+    thread_local std::vector<node*> neighs;
     BOX box = util::geo::pad(util::geo::getBoundingBox(*s.get_geom()), d / distor);
     get(box, &neighs);
 
@@ -90,9 +138,11 @@ std::set<node*> node_grid::get_matching_nodes(const node_payload& s, double d)
 
     return ret;
 }
-trgraph::node_grid node_grid::build_node_grid(graph& g, size_t size, const BOX& webMercBox, bool which)
+trgraph::node_grid node_grid::build_node_grid(graph& g, size_t size, const BOX& webMercBox, bool which,
+                                              bool packed)
 {
-    trgraph::node_grid ret(size, size, webMercBox, false);
+    trgraph::node_grid ret = packed ? trgraph::node_grid(false) : trgraph::node_grid(size, size, webMercBox, false);
+    ret._packed = packed;
     for (auto* n : g.getNds())
     {
         if (!which && n->getInDeg() + n->getOutDeg() == 1)
@@ -100,6 +150,10 @@ trgraph::node_grid node_grid::build_node_grid(graph& g, size_t size, const BOX&
         else if (which && n->pl().get_si())
             ret.add(*n->pl().get_geom(), n);
     }
+    if (packed)
+        ret._tree.build();
+    else
+        ret.build();
     return ret;
 }
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "pfaedle/trgraph/station_group.h"
 #include "pfaedle/trgraph/station_info.h"
 #include "util/String.h"
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -17,6 +18,7 @@ namespace pfaedle::trgraph
 // saves some memory
 station_info node_payload::_blockerSI = station_info();
 
+std::mutex node_payload::_compsMutex;
 std::unordered_map<const component*, size_t> node_payload::_comps;
 
 node_payload::node_payload() :
@@ -69,6 +71,7 @@ node_payload::~node_payload()
 
     if (_component)
     {
+        std::lock_guard<std::mutex> lock(_compsMutex);
         _comps[_component]--;
         if (_comps[_component] == 0)
         {
@@ -101,7 +104,7 @@ void node_payload::set_component(const component* c)
         return;
     _component = c;
 
-    // NOT thread safe!
+    std::lock_guard<std::mutex> lock(_compsMutex);
     if (!_comps.count(c))
         _comps[c] = 1;
     else
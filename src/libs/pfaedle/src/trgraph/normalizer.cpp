@@ -7,6 +7,7 @@
 #include <cassert>
 #include <iostream>
 #include <mutex>
+#include <shared_mutex>
 #include <regex>
 #include <sstream>
 #include <stdexcept>
@@ -24,11 +25,15 @@ normalizer::normalizer(const ReplRules& rules) :
 
 normalizer::normalizer(const normalizer& other) :
     _rules(other._rules),
-    _rulesOrig(other._rulesOrig),
-    _cache(other._cache) {}
+    _rulesOrig(other._rulesOrig)
+{
+    std::shared_lock<std::shared_mutex> lock(other._mutex);
+    _cache = other._cache;
+}
 
 normalizer& normalizer::operator=(normalizer other)
 {
+    std::unique_lock<std::shared_mutex> lock(_mutex);
     std::swap(this->_rules, other._rules);
     std::swap(this->_rulesOrig, other._rulesOrig);
     std::swap(this->_cache, other._cache);
@@ -43,15 +48,19 @@ std::string normalizer::operator()(std::string sn) const
 
 std::string normalizer::normTS(const std::string& sn) const
 {
-    std::lock_guard<std::mutex> lock(_mutex);
     return norm(sn);
 }
 
 std::string normalizer::norm(const std::string& sn) const
 {
-    auto i = _cache.find(sn);
-    if (i != _cache.end()) return i->second;
+    {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        auto i = _cache.find(sn);
+        if (i != _cache.end()) return i->second;
+    }
 
+    // the regex replacements are done without holding the lock, two threads
+    // normalizing the same string simply compute the same result twice
     std::string ret = sn;
     for (const auto& rule : _rules)
     {
@@ -64,7 +73,8 @@ std::string normalizer::norm(const std::string& sn) const
 
     //std::transform(ret.begin(), ret.end(), ret.begin(), ::tolower);
 
-    _cache[sn] = ret;
+    std::unique_lock<std::shared_mutex> lock(_mutex);
+    _cache.emplace(sn, ret);
 
     return ret;
 }
@@ -74,6 +84,11 @@ bool normalizer::operator==(const normalizer& b) const
     return _rulesOrig == b._rulesOrig;
 }
 
+const pfaedle::trgraph::ReplRules& normalizer::get_rules() const
+{
+    return _rulesOrig;
+}
+
 void normalizer::build_rules(const ReplRules& rules)
 {
     for (const auto& rule : rules)
@@ -57,6 +57,15 @@ void restrictor::add(const trgraph::edge* from, osmid to,
     }
 }
 
+void restrictor::add_rule(const trgraph::edge* from, const trgraph::edge* to,
+                          const trgraph::node* via, bool pos)
+{
+    if (pos)
+        _pos[via].push_back(RulePair(from, to));
+    else
+        _neg[via].push_back(RulePair(from, to));
+}
+
 bool restrictor::may(const trgraph::edge* from,
                      const trgraph::edge* to,
                      const trgraph::node* via) const
@@ -84,6 +93,10 @@ bool restrictor::may(const trgraph::edge* from,
     return true;
 }
 
+const Rules& restrictor::get_pos_rules() const { return _pos; }
+
+const Rules& restrictor::get_neg_rules() const { return _neg; }
+
 void restrictor::replace_edge(const trgraph::edge* old,
                              const trgraph::edge* newA,
                              const trgraph::edge* newB)
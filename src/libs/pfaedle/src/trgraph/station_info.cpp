@@ -9,6 +9,7 @@
 namespace pfaedle::trgraph
 {
 
+std::mutex station_info::_groupsMutex;
 std::unordered_map<const station_group*, size_t> station_info::_groups;
 
 station_info::station_info() :
@@ -35,7 +36,11 @@ station_info::station_info(const std::string& name, const std::string& track,
     _name(name),
     _track(track), _fromOsm(fromOsm), _group(nullptr) {}
 
-station_info::~station_info() { unRefGroup(_group); }
+station_info::~station_info()
+{
+    std::lock_guard<std::mutex> lock(_groupsMutex);
+    unRefGroup(_group);
+}
 
 void station_info::unRefGroup(station_group* g)
 {
@@ -54,11 +59,12 @@ void station_info::unRefGroup(station_group* g)
 void station_info::set_group(station_group* g)
 {
     if (_group == g) return;
+
+    std::lock_guard<std::mutex> lock(_groupsMutex);
     unRefGroup(_group);
 
     _group = g;
 
-    // NOT thread safe!
     if (!_groups.count(g))
         _groups[g] = 1;
     else
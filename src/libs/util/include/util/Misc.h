@@ -9,6 +9,7 @@
 #include <cstring>
 #include <chrono>
 #include <sstream>
+#include <string>
 #include <unistd.h>
 #include <sys/types.h>
 #include <pwd.h>
@@ -140,6 +141,39 @@ inline std::string getTmpDir()
     return getHomeDir();
 }
 
+/*
+ * 64 bit FNV-1a hash, fed value by value. Values are hashed in host byte
+ * order, the result is only stable on a single platform
+ */
+class Fnv1a
+{
+public:
+    void add(const void* data, size_t n)
+    {
+        const auto* c = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < n; i++)
+        {
+            _hash ^= c[i];
+            _hash *= 1099511628211ULL;
+        }
+    }
+
+    void add(uint64_t v) { add(&v, sizeof(v)); }
+
+    void add(double v) { add(&v, sizeof(v)); }
+
+    void add(const std::string& s)
+    {
+        add(static_cast<uint64_t>(s.size()));
+        add(s.data(), s.size());
+    }
+
+    uint64_t get() const { return _hash; }
+
+private:
+    uint64_t _hash = 14695981039346656037ULL;
+};
+
 }  // namespace util
 
 #endif  // UTIL_MISC_H_
@@ -11,8 +11,11 @@
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 #include "util/Misc.h"
 #include "util/String.h"
 #include "util/geo/Box.h"
@@ -1529,14 +1532,19 @@ inline RotatedBox<T> getOrientedEnvelopeAvg(MultiLine<T> ml)
     return rbox;
 }
 
+// l with additional points so that no two consecutive points are more than d
+// apart. If idx is given, it receives the position of every point of l in the
+// result
 template<typename T>
-inline Line<T> densify(const Line<T>& l, double d)
+inline Line<T> densify(const Line<T>& l, double d, std::vector<size_t>* idx)
 {
+    if (idx) idx->clear();
     if (l.empty()) return l;
 
     Line<T> ret;
     ret.reserve(l.size());
     ret.push_back(l.front());
+    if (idx) idx->push_back(0);
 
     for (size_t i = 1; i < l.size(); i++)
     {
@@ -1551,6 +1559,7 @@ inline Line<T> densify(const Line<T>& l, double d)
             curd += d;
         }
 
+        if (idx) idx->push_back(ret.size());
         ret.push_back(l[i]);
     }
 
@@ -1558,30 +1567,71 @@ inline Line<T> densify(const Line<T>& l, double d)
 }
 
 template<typename T>
-inline double frechetDistC(size_t i, size_t j, const Line<T>& p,
-                           const Line<T>& q,
-                           std::vector<std::vector<double>>& ca)
+inline Line<T> densify(const Line<T>& l, double d)
 {
-    // based on Eiter / Mannila
-    // http://www.kr.tuwien.ac.at/staff/eiter/et-archive/cdtr9464.pdf
+    return densify(l, d, nullptr);
+}
 
-    if (ca[i][j] > -1)
-        return ca[i][j];
-    else if (i == 0 && j == 0)
-        ca[i][j] = dist(p[0], q[0]);
-    else if (i > 0 && j == 0)
-        ca[i][j] = std::max(frechetDistC(i - 1, 0, p, q, ca), dist(p[i], q[0]));
-    else if (i == 0 && j > 0)
-        ca[i][j] = std::max(frechetDistC(0, j - 1, p, q, ca), dist(p[0], q[j]));
-    else if (i > 0 && j > 0)
-        ca[i][j] = std::max(std::min(std::min(frechetDistC(i - 1, j, p, q, ca),
-                                              frechetDistC(i - 1, j - 1, p, q, ca)),
-                                     frechetDistC(i, j - 1, p, q, ca)),
-                            dist(p[i], q[j]));
-    else
-        ca[i][j] = std::numeric_limits<double>::infinity();
+// the points of q every point of p may be matched to in the distances below,
+// from the first to the last. Neither end may decrease from one point of p to
+// the next, an empty band does not restrict the matching
+using FrechetBand = std::vector<std::pair<size_t, size_t>>;
+
+// Both distances keep two rows of the cost matrix. A row is computed in two
+// passes: the first one takes the distances to the points of q and the
+// predecessors in the row before, it has no dependencies between columns and is
+// vectorized. The second one adds the predecessor in the same row. Rows are
+// shifted by one column, the first entry is the border left of the band
+
+// discrete Frechet distance between p and q
+template<typename T>
+inline double frechetDist(const Line<T>& p, const Line<T>& q, const FrechetBand& band)
+{
+    if (p.empty() || q.empty()) return 0;
+
+    const double inf = std::numeric_limits<double>::max();
+    const size_t n = q.size();
+
+    std::vector<double> qx(n), qy(n);
+    for (size_t j = 0; j < n; j++)
+    {
+        qx[j] = q[j].getX();
+        qy[j] = q[j].getY();
+    }
+
+    std::vector<double> prev(n + 1, inf), cur(n + 1, inf), d(n + 1);
+    // the only predecessor of the first cell
+    prev[0] = 0;
+
+    for (size_t i = 0; i < p.size(); i++)
+    {
+        const size_t lo = band.empty() ? 0 : band[i].first;
+        const size_t hi = band.empty() ? n - 1 : band[i].second;
+        const double px = p[i].getX();
+        const double py = p[i].getY();
+
+        cur[lo] = inf;
+
+#pragma omp simd
+        for (size_t j = lo; j <= hi; j++)
+        {
+            double dx = px - qx[j];
+            double dy = py - qy[j];
+            d[j + 1] = std::sqrt(dx * dx + dy * dy);
+            cur[j + 1] = std::max(std::min(prev[j + 1], prev[j]), d[j + 1]);
+        }
 
-    return ca[i][j];
+        for (size_t j = lo; j <= hi; j++)
+            cur[j + 1] = std::min(cur[j + 1], std::max(cur[j], d[j + 1]));
+
+        // the next row may read up to the end of its own band
+        const size_t next = i + 1 < p.size() && !band.empty() ? band[i + 1].second : hi;
+        if (next > hi) std::fill(cur.begin() + hi + 2, cur.begin() + next + 2, inf);
+
+        std::swap(prev, cur);
+    }
+
+    return prev[n];
 }
 
 template<typename T>
@@ -1589,41 +1639,65 @@ inline double frechet_distance(const Line<T>& a, const Line<T>& b, double d)
 {
     // based on Eiter / Mannila
     // http://www.kr.tuwien.ac.at/staff/eiter/et-archive/cdtr9464.pdf
-
-    auto p = densify(a, d);
-    auto q = densify(b, d);
-
-    std::vector<std::vector<double>> ca(p.size(), std::vector<double>(q.size(), -1.0));
-    double fd = frechetDistC(p.size() - 1, q.size() - 1, p, q, ca);
-
-    return fd;
+    return frechetDist(densify(a, d), densify(b, d), {});
 }
 
+// sum of the distances to q of the points of p along the best matching,
+// weighted by the length of the step to every point of p. The first point of q
+// is only matched to the first point of p
 template<typename T>
-inline double accFrechetDistC(const Line<T>& a, const Line<T>& b, double d)
+inline double accFrechetDist(const Line<T>& p, const Line<T>& q, const FrechetBand& band)
 {
-    auto p = densify(a, d);
-    auto q = densify(b, d);
+    if (p.empty() || q.empty()) return 0;
 
-    std::vector<std::vector<double>> ca(p.size(), std::vector<double>(q.size(), 0));
+    const double inf = std::numeric_limits<double>::max();
+    const size_t n = q.size();
 
-    for (size_t i = 0; i < p.size(); i++)
-        ca[i][0] = std::numeric_limits<double>::infinity();
-    for (size_t j = 0; j < q.size(); j++)
-        ca[0][j] = std::numeric_limits<double>::infinity();
+    std::vector<double> qx(n), qy(n);
+    for (size_t j = 0; j < n; j++)
+    {
+        qx[j] = q[j].getX();
+        qy[j] = q[j].getY();
+    }
 
-    ca[0][0] = 0;
+    std::vector<double> prev(n + 1, inf), cur(n + 1, inf), d(n + 1);
+    prev[1] = 0;
 
     for (size_t i = 1; i < p.size(); i++)
     {
-        for (size_t j = 1; j < q.size(); j++)
+        const size_t lo = band.empty() ? 1 : std::max<size_t>(1, band[i].first);
+        const size_t hi = band.empty() ? n - 1 : band[i].second;
+        const double px = p[i].getX();
+        const double py = p[i].getY();
+        const double step = dist(p[i], p[i - 1]);
+
+        cur[lo] = inf;
+
+#pragma omp simd
+        for (size_t j = lo; j <= hi; j++)
         {
-            double distance = util::geo::dist(p[i], q[j]) * util::geo::dist(p[i], p[i - 1]);
-            ca[i][j] = distance + std::min(ca[i - 1][j], std::min(ca[i][j - 1], ca[i - 1][j - 1]));
+            double dx = px - qx[j];
+            double dy = py - qy[j];
+            d[j + 1] = std::sqrt(dx * dx + dy * dy) * step;
+            cur[j + 1] = d[j + 1] + std::min(prev[j + 1], prev[j]);
         }
+
+        for (size_t j = lo; j <= hi; j++)
+            cur[j + 1] = std::min(cur[j + 1], d[j + 1] + cur[j]);
+
+        const size_t next = i + 1 < p.size() && !band.empty() ? band[i + 1].second : hi;
+        if (next > hi) std::fill(cur.begin() + hi + 2, cur.begin() + next + 2, inf);
+
+        std::swap(prev, cur);
     }
 
-    return ca[p.size() - 1][q.size() - 1];
+    return prev[n];
+}
+
+template<typename T>
+inline double accFrechetDistC(const Line<T>& a, const Line<T>& b, double d)
+{
+    return accFrechetDist(densify(a, d), densify(b, d), {});
 }
 
 template<typename T>
@@ -5,9 +5,10 @@
 #ifndef UTIL_GEO_GRID_H_
 #define UTIL_GEO_GRID_H_
 
+#include <algorithm>
 #include <set>
+#include <unordered_map>
 #include <vector>
-#include <map>
 #include "util/geo/Geo.h"
 
 namespace util::geo
@@ -20,6 +21,11 @@ public:
         std::runtime_error(msg) {}
 };
 
+// Values are kept in one array, the values of a cell are a contiguous range in it. build() packs
+// the values added so far, values added afterwards are kept per cell until the next build().
+// Removed values are skipped by the queries until then, also if the same value is added again
+// meanwhile: only its cells since the removal are found. Before the first build(), queries scan
+// all values.
 template<typename V, template<typename> class G, typename T>
 class Grid
 {
@@ -54,15 +60,6 @@ public:
 
         _xWidth = ceil(_width / _cellWidth);
         _yHeight = ceil(_height / _cellHeight);
-
-        // resize rows
-        _grid.resize(_xWidth);
-
-        // resize columns
-        for (size_t i = 0; i < _xWidth; i++)
-        {
-            _grid[i].resize(_yHeight);
-        }
     }
 
     // the empty grid
@@ -93,9 +90,9 @@ public:
         size_t neX = getCellXFromX(box.getUpperRight().getX());
         size_t neY = getCellYFromY(box.getUpperRight().getY());
 
-        for (size_t x = swX; x <= neX && x < _grid.size(); x++)
+        for (size_t x = swX; x <= neX && x < _xWidth; x++)
         {
-            for (size_t y = swY; y <= neY && y < _grid[x].size(); y++)
+            for (size_t y = swY; y <= neY && y < _yHeight; y++)
             {
                 if (intersects(geom, getBox(x, y)))
                 {
@@ -106,28 +103,70 @@ public:
     }
     void add(size_t x, size_t y, V val)
     {
-        _grid[x][y].insert(val);
-        if (_hasValIdx) _index[val].insert(std::pair<size_t, size_t>(x, y));
+        const size_t cell = x * _yHeight + y;
+        if (_cellOffsets.empty())
+            _pending.emplace_back(cell, val);
+        else
+            _added[cell].emplace_back(++_numAdded, val);
+        if (_hasValIdx) _index[val].push_back(cell);
     }
 
-    void get(const Box<T>& box, std::set<V>* s) const
+    // packs all values into the cell ranges, without the removed ones
+    void build()
     {
-        size_t swX = getCellXFromX(box.getLowerLeft().getX());
-        size_t swY = getCellYFromY(box.getLowerLeft().getY());
-
-        size_t neX = getCellXFromX(box.getUpperRight().getX());
-        size_t neY = getCellYFromY(box.getUpperRight().getY());
+        const size_t cells = _xWidth * _yHeight;
+        std::vector<size_t> offsets(cells + 1, 0);
+        for (size_t cell = 0; cell < cells; cell++)
+        {
+            size_t n = 0;
+            forEachPacked(cell, [&n](const V&) { n++; });
+            offsets[cell + 1] = n;
+        }
+        for (size_t i = 0; i < _pending.size(); i++)
+        {
+            if (!isRemoved(_pending[i].second, i + 1)) offsets[_pending[i].first + 1]++;
+        }
+        for (size_t cell = 0; cell < cells; cell++)
+        {
+            offsets[cell + 1] += offsets[cell];
+        }
 
-        for (size_t x = swX; x <= neX && x >= 0 && x < _xWidth; x++)
+        std::vector<V> vals(offsets[cells]);
+        std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t cell = 0; cell < cells; cell++)
         {
-            for (size_t y = swY; y <= neY && y >= 0 && y < _yHeight; y++)
-            {
-                get(x, y, s);
-            }
+            forEachPacked(cell, [&](const V& v) { vals[next[cell]++] = v; });
+        }
+        for (size_t i = 0; i < _pending.size(); i++)
+        {
+            if (!isRemoved(_pending[i].second, i + 1)) vals[next[_pending[i].first]++] = _pending[i].second;
         }
+
+        _cellOffsets.swap(offsets);
+        _cellVals.swap(vals);
+        _pending = {};
+        _added.clear();
+        _numAdded = 0;
+        _removed.clear();
     }
 
-    void get(const G<T>& geom, double d, std::set<V>* s) const
+    void get(const Box<T>& box, std::set<V>* s) const
+    {
+        forEachInBox(box, [s](const V& v) { s->insert(v); });
+    }
+
+    // the values in the cells box intersects, sorted and without duplicates. s is cleared
+    // first, so it can be reused for the next query
+    void get(const Box<T>& box, std::vector<V>* s) const
+    {
+        s->clear();
+        forEachInBox(box, [s](const V& v) { s->push_back(v); });
+        std::sort(s->begin(), s->end());
+        s->erase(std::unique(s->begin(), s->end()), s->end());
+    }
+
+    template<typename C>
+    void get(const G<T>& geom, double d, C* s) const
     {
         Box<T> a = getBoundingBox(geom);
         Box<T> b(Point<T>(a.getLowerLeft().getX() - d,
@@ -138,18 +177,7 @@ public:
     }
     void get(size_t x, size_t y, std::set<V>* s) const
     {
-        if (_hasValIdx)
-        {
-            s->insert(_grid[x][y].begin(), _grid[x][y].end());
-        }
-        else
-        {
-            // if we dont have a value index, we have a set of deleted nodes.
-            // in this case, only insert if not deleted
-            std::copy_if(_grid[x][y].begin(), _grid[x][y].end(),
-                         std::inserter(*s, s->end()),
-                         [&](const V& v) { return Grid<V, G, T>::_removed.count(v) == 0; });
-        }
+        forEachInCell(x * _yHeight + y, [s](const V& v) { s->insert(v); });
     }
     void remove(V val)
     {
@@ -157,19 +185,11 @@ public:
         {
             auto i = _index.find(val);
             if (i == _index.end()) return;
-
-            for (auto pair : i->second)
-            {
-                _grid[pair.first][pair.second].erase(
-                        _grid[pair.first][pair.second].find(val));
-            }
-
             _index.erase(i);
         }
-        else
-        {
-            _removed.insert(val);
-        }
+
+        // hides the cells added so far
+        _removed[val] = (_cellOffsets.empty() ? _pending.size() : _numAdded) + 1;
     }
 
     void getNeighbors(const V& val, double d, std::set<V>* s) const
@@ -184,9 +204,9 @@ public:
         size_t xPerm = ceil(d / _cellWidth);
         size_t yPerm = ceil(d / _cellHeight);
 
-        for (auto pair : it->second)
+        for (size_t cell : it->second)
         {
-            getCellNeighbors(pair.first, pair.second, xPerm, yPerm, s);
+            getCellNeighbors(cell / _yHeight, cell % _yHeight, xPerm, yPerm, s);
         }
     }
     void getCellNeighbors(const V& val, size_t d, std::set<V>* s) const
@@ -198,9 +218,9 @@ public:
         if (it == _index.end())
             return;
 
-        for (auto pair : it->second)
+        for (size_t cell : it->second)
         {
-            getCellNeighbors(pair.first, pair.second, d, d, s);
+            getCellNeighbors(cell / _yHeight, cell % _yHeight, d, d, s);
         }
     }
     void getCellNeighbors(size_t cx, size_t cy, size_t xPerm, size_t yPerm, std::set<V>* s) const
@@ -215,7 +235,7 @@ public:
         {
             for (size_t y = swY; y < neY; y++)
             {
-                s->insert(_grid[x][y].begin(), _grid[x][y].end());
+                get(x, y, s);
             }
         }
     }
@@ -224,7 +244,13 @@ public:
     {
         if (!_hasValIdx)
             throw GridException("No value index build!");
-        return _index.find(val)->second;
+
+        std::set<std::pair<size_t, size_t>> ret;
+        for (size_t cell : _index.find(val)->second)
+        {
+            ret.insert(std::pair<size_t, size_t>(cell / _yHeight, cell % _yHeight));
+        }
+        return ret;
     }
 
     size_t getXWidth() const
@@ -246,16 +272,101 @@ private:
 
     Box<T> _bb;
 
-    size_t _counter;
-
     size_t _xWidth;
     size_t _yHeight;
 
     bool _hasValIdx;
 
-    std::vector<std::vector<std::set<V>>> _grid;
-    std::map<V, std::set<std::pair<size_t, size_t>>> _index;
-    std::set<V> _removed;
+    // the values of cell x * _yHeight + y are _cellVals[_cellOffsets[cell]] up to
+    // _cellVals[_cellOffsets[cell + 1]], empty until the first build()
+    std::vector<size_t> _cellOffsets;
+    std::vector<V> _cellVals;
+    // values added before the first build(), with their cell
+    std::vector<std::pair<size_t, V>> _pending;
+    // values added since the last build(), by cell, with the number of their add() call
+    std::unordered_map<size_t, std::vector<std::pair<size_t, V>>> _added;
+    size_t _numAdded = 0;
+    std::unordered_map<V, std::vector<size_t>> _index;
+    // the first entry of a removed value that is found again. Entries in _pending are numbered
+    // from 1 in their order, packed entries are 0
+    std::unordered_map<V, size_t> _removed;
+
+    bool isRemoved(const V& v, size_t seq) const
+    {
+        if (_removed.empty()) return false;
+        auto it = _removed.find(v);
+        return it != _removed.end() && seq < it->second;
+    }
+
+    template<typename F>
+    void forEachInCell(size_t cell, const F& f) const
+    {
+        if (!_cellOffsets.empty())
+        {
+            forEachPacked(cell, f);
+            return;
+        }
+
+        for (size_t i = 0; i < _pending.size(); i++)
+        {
+            if (_pending[i].first == cell && !isRemoved(_pending[i].second, i + 1)) f(_pending[i].second);
+        }
+    }
+
+    // the values of a cell since the first build()
+    template<typename F>
+    void forEachPacked(size_t cell, const F& f) const
+    {
+        if (!_cellOffsets.empty())
+        {
+            for (size_t i = _cellOffsets[cell]; i < _cellOffsets[cell + 1]; i++)
+            {
+                if (!isRemoved(_cellVals[i], 0)) f(_cellVals[i]);
+            }
+        }
+
+        if (!_added.empty())
+        {
+            auto it = _added.find(cell);
+            if (it != _added.end())
+            {
+                for (const auto& p : it->second)
+                {
+                    if (!isRemoved(p.second, p.first)) f(p.second);
+                }
+            }
+        }
+    }
+
+    template<typename F>
+    void forEachInBox(const Box<T>& box, const F& f) const
+    {
+        size_t swX = getCellXFromX(box.getLowerLeft().getX());
+        size_t swY = getCellYFromY(box.getLowerLeft().getY());
+
+        size_t neX = getCellXFromX(box.getUpperRight().getX());
+        size_t neY = getCellYFromY(box.getUpperRight().getY());
+
+        if (_cellOffsets.empty())
+        {
+            for (size_t i = 0; i < _pending.size(); i++)
+            {
+                size_t x = _pending[i].first / _yHeight;
+                size_t y = _pending[i].first % _yHeight;
+                if (x >= swX && x <= neX && y >= swY && y <= neY && !isRemoved(_pending[i].second, i + 1))
+                    f(_pending[i].second);
+            }
+            return;
+        }
+
+        for (size_t x = swX; x <= neX && x < _xWidth; x++)
+        {
+            for (size_t y = swY; y <= neY && y < _yHeight; y++)
+            {
+                forEachInCell(x * _yHeight + y, f);
+            }
+        }
+    }
 
     Box<T> getBox(size_t x, size_t y) const
     {
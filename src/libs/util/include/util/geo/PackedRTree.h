@@ -0,0 +1,305 @@
+// Copyright 2016, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Author: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_GEO_PACKEDRTREE_H_
+#define UTIL_GEO_PACKEDRTREE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "util/geo/Geo.h"
+
+namespace util::geo
+{
+
+/*
+ * Static R-tree over the bounding boxes of values. build() sorts the boxes
+ * along a Hilbert curve through their centers and packs them into nodes of
+ * NODE_SIZE entries, level by level up to the root. Values added after
+ * build() are kept in a list that every query scans, the tree is rebuilt once
+ * that list holds more than a 32th of the values. Removed values are skipped
+ * by the queries until the next build(), also if the same value is added again
+ * before: only the entries added after its removal are found then. Before the
+ * first build(), queries scan all values
+ */
+template<typename V, typename T>
+class PackedRTree
+{
+public:
+    static constexpr size_t NODE_SIZE = 16;
+
+    template<template<typename> class G>
+    void add(const G<T>& geom, V val)
+    {
+        add(getBoundingBox(geom), val);
+    }
+
+    void add(const Box<T>& box, V val)
+    {
+        _added.push_back({box, val});
+
+        if (!_levelEnds.empty() && _added.size() > std::max<size_t>(1024, _vals.size() / 32))
+            build();
+    }
+
+    void remove(V val)
+    {
+        // hides the entries added so far
+        _removed[val] = _added.size() + 1;
+    }
+
+    // packs all values into the tree, without the removed ones
+    void build()
+    {
+        std::vector<Item> items;
+        items.reserve(_vals.size() + _added.size());
+        for (size_t i = 0; i < _vals.size(); i++)
+        {
+            if (!isRemoved(_vals[i], 0)) items.push_back({_boxes[i], _vals[i]});
+        }
+        for (size_t i = 0; i < _added.size(); i++)
+        {
+            if (!isRemoved(_added[i].val, i + 1)) items.push_back(_added[i]);
+        }
+
+        // Hilbert order of the box centers
+        Box<T> ext;
+        for (const auto& it : items) ext = extendBox(centerOf(it.box), ext);
+        double w = ext.getUpperRight().getX() - ext.getLowerLeft().getX();
+        double h = ext.getUpperRight().getY() - ext.getLowerLeft().getY();
+
+        std::vector<std::pair<uint64_t, size_t>> order(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            Point<T> c = centerOf(items[i].box);
+            uint32_t x = w > 0 ? (c.getX() - ext.getLowerLeft().getX()) / w * HILBERT_MAX : 0;
+            uint32_t y = h > 0 ? (c.getY() - ext.getLowerLeft().getY()) / h * HILBERT_MAX : 0;
+            order[i] = {hilbert(x, y), i};
+        }
+        std::sort(order.begin(), order.end());
+
+        _boxes.clear();
+        _vals.clear();
+        _levelEnds.clear();
+        _vals.reserve(items.size());
+        for (const auto& o : order)
+        {
+            _boxes.push_back(items[o.second].box);
+            _vals.push_back(items[o.second].val);
+        }
+        _levelEnds.push_back(_boxes.size());
+
+        // every level but the items has at least one node, the last one is the root
+        size_t start = 0;
+        do
+        {
+            size_t end = _levelEnds.back();
+            for (size_t i = start; i < end; i += NODE_SIZE)
+            {
+                Box<T> b;
+                for (size_t j = i; j < std::min(i + NODE_SIZE, end); j++) b = extendBox(_boxes[j], b);
+                _boxes.push_back(b);
+            }
+            if (start == end) _boxes.push_back(Box<T>());
+            start = end;
+            _levelEnds.push_back(_boxes.size());
+        } while (_levelEnds.back() - start > 1);
+
+        _added.clear();
+        _removed.clear();
+    }
+
+    // the values whose bounding box intersects box, in no particular order and
+    // without duplicates. s is cleared first, so it can be reused for the next
+    // query
+    void get(const Box<T>& box, std::vector<V>* s) const
+    {
+        s->clear();
+
+        if (!_levelEnds.empty())
+        {
+            std::vector<std::pair<size_t, size_t>> stack{{_boxes.size() - 1, _levelEnds.size() - 1}};
+            while (!stack.empty())
+            {
+                auto [n, level] = stack.back();
+                stack.pop_back();
+
+                auto range = children(n, level);
+                for (size_t c = range.first; c < range.second; c++)
+                {
+                    if (!intersects(_boxes[c], box)) continue;
+                    if (level > 1)
+                        stack.push_back({c, level - 1});
+                    else if (!isRemoved(_vals[c], 0))
+                        s->push_back(_vals[c]);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < _added.size(); i++)
+        {
+            if (intersects(_added[i].box, box) && !isRemoved(_added[i].val, i + 1)) s->push_back(_added[i].val);
+        }
+
+        std::sort(s->begin(), s->end());
+        s->erase(std::unique(s->begin(), s->end()), s->end());
+    }
+
+    // the at most k values nearest to p with a distance of at most maxDist,
+    // nearest first. dist(v) is the exact distance of value v to p, it must not
+    // be smaller than the distance of p to the bounding box of v. Returning more
+    // than maxDist skips a value. Every value is returned once. s is cleared
+    // first
+    template<typename F>
+    void getNearest(const Point<T>& p, size_t k, double maxDist, const F& dist,
+                    std::vector<std::pair<double, V>>* s) const
+    {
+        s->clear();
+        if (k == 0) return;
+
+        // a level of 0 marks an item with its exact distance, ITEM one whose
+        // distance still has to be computed. Indices past the tree are values in
+        // _added
+        static constexpr size_t ITEM = std::numeric_limits<size_t>::max();
+        struct Entry
+        {
+            double d;
+            size_t i;
+            size_t level;
+            bool operator>(const Entry& o) const { return d > o.d; }
+        };
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> pq;
+
+        if (!_levelEnds.empty()) pq.push({0, _boxes.size() - 1, _levelEnds.size() - 1});
+        for (size_t i = 0; i < _added.size(); i++)
+        {
+            double d = boxDist(p, _added[i].box);
+            if (d <= maxDist) pq.push({d, _boxes.size() + i, ITEM});
+        }
+
+        while (!pq.empty() && s->size() < k)
+        {
+            Entry e = pq.top();
+            pq.pop();
+
+            if (e.level == 0)
+            {
+                // a value with more than one entry is only returned once
+                const V& v = value(e.i);
+                auto same = [&v](const std::pair<double, V>& r) { return r.second == v; };
+                if (std::find_if(s->begin(), s->end(), same) == s->end()) s->push_back({e.d, v});
+            }
+            else if (e.level == ITEM)
+            {
+                if (isRemoved(value(e.i), seq(e.i))) continue;
+                double d = dist(value(e.i));
+                if (d <= maxDist) pq.push({d, e.i, 0});
+            }
+            else
+            {
+                auto range = children(e.i, e.level);
+                for (size_t c = range.first; c < range.second; c++)
+                {
+                    double d = boxDist(p, _boxes[c]);
+                    if (d <= maxDist) pq.push({d, c, e.level > 1 ? e.level - 1 : ITEM});
+                }
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        return _vals.size() + _added.size();
+    }
+
+private:
+    static constexpr uint32_t HILBERT_MAX = (1 << 16) - 1;
+
+    struct Item
+    {
+        Box<T> box;
+        V val;
+    };
+
+    // item boxes in Hilbert order, followed by the node boxes of every level
+    std::vector<Box<T>> _boxes;
+    std::vector<V> _vals;
+    // one past the last box of every level, the items are level 0
+    std::vector<size_t> _levelEnds;
+
+    // the entries in _added are numbered from 1 in the order they were added,
+    // the packed ones are 0. A removed value maps to the number of its first
+    // entry that is found again
+    std::vector<Item> _added;
+    std::unordered_map<V, size_t> _removed;
+
+    bool isRemoved(const V& v, size_t seq) const
+    {
+        if (_removed.empty()) return false;
+        auto it = _removed.find(v);
+        return it != _removed.end() && seq < it->second;
+    }
+
+    size_t seq(size_t i) const
+    {
+        return i < _vals.size() ? 0 : i - _boxes.size() + 1;
+    }
+
+    const V& value(size_t i) const
+    {
+        return i < _vals.size() ? _vals[i] : _added[i - _boxes.size()].val;
+    }
+
+    // the entries of node n on level level
+    std::pair<size_t, size_t> children(size_t n, size_t level) const
+    {
+        size_t childStart = level > 1 ? _levelEnds[level - 2] : 0;
+        size_t first = childStart + (n - _levelEnds[level - 1]) * NODE_SIZE;
+        return {first, std::min(first + NODE_SIZE, _levelEnds[level - 1])};
+    }
+
+    static Point<T> centerOf(const Box<T>& b)
+    {
+        return Point<T>((b.getLowerLeft().getX() + b.getUpperRight().getX()) / 2,
+                        (b.getLowerLeft().getY() + b.getUpperRight().getY()) / 2);
+    }
+
+    static double boxDist(const Point<T>& p, const Box<T>& b)
+    {
+        double dx = std::max({b.getLowerLeft().getX() - p.getX(), T(0), p.getX() - b.getUpperRight().getX()});
+        double dy = std::max({b.getLowerLeft().getY() - p.getY(), T(0), p.getY() - b.getUpperRight().getY()});
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    // position of (x, y) on a Hilbert curve through a 2^16 x 2^16 grid
+    static uint64_t hilbert(uint32_t x, uint32_t y)
+    {
+        uint64_t d = 0;
+        for (uint32_t s = 1 << 15; s > 0; s /= 2)
+        {
+            uint32_t rx = (x & s) > 0;
+            uint32_t ry = (y & s) > 0;
+            d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = HILBERT_MAX - x;
+                    y = HILBERT_MAX - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+};
+
+}  // namespace util::geo
+
+#endif  // UTIL_GEO_PACKEDRTREE_H_
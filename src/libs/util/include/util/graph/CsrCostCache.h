@@ -0,0 +1,79 @@
+// Copyright 2017, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_GRAPH_CSRCOSTCACHE_H_
+#define UTIL_GRAPH_CSRCOSTCACHE_H_
+
+#include "util/graph/CsrGraph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace util::graph
+{
+
+/*
+ * Memoized costs of a cost functor on a CsrGraph. The costs of all turns
+ * from an edge into the outgoing edges of its target node are evaluated
+ * together the first time one of them is asked for, and are served from
+ * memory for all later searches with the same cost functor. Like
+ * CsrSearchSpace, the dense per edge state is stamped with an epoch, so a
+ * cache can be reused for any number of functors
+ */
+template<typename C>
+class CsrCostCache
+{
+public:
+    // Forget all costs, the cache may be used with another functor now
+    void reset(size_t numEdges)
+    {
+        if (_stamp.size() < numEdges)
+        {
+            _stamp.resize(numEdges, 0);
+            _offset.resize(numEdges);
+        }
+
+        _costs.clear();
+
+        if (++_epoch == 0)
+        {
+            std::fill(_stamp.begin(), _stamp.end(), 0);
+            _epoch = 1;
+        }
+    }
+
+    // Return costFunc(from, n, to) for the functor this cache was reset for
+    template<typename CF>
+    C get(const CsrGraph& g, const CF& costFunc, CsrGraph::Id from,
+          CsrGraph::Id n, CsrGraph::Id to)
+    {
+        // start edges and turns which do not follow the graph are not cached
+        if (from == CsrGraph::NONE || n != g.getTo(from))
+            return costFunc(from, n, to);
+
+        const CsrGraph::Id begin = g.getOutBegin(n);
+
+        if (_stamp[from] != _epoch)
+        {
+            _stamp[from] = _epoch;
+            _offset[from] = static_cast<uint32_t>(_costs.size());
+            for (CsrGraph::Id e = begin; e < g.getOutEnd(n); e++)
+            {
+                _costs.push_back(e == from ? costFunc.inf() : costFunc(from, n, e));
+            }
+        }
+
+        return _costs[_offset[from] + (to - begin)];
+    }
+
+private:
+    std::vector<uint32_t> _stamp;
+    std::vector<uint32_t> _offset;
+    std::vector<C> _costs;
+    uint32_t _epoch = 0;
+};
+}  // namespace util::graph
+
+#endif  // UTIL_GRAPH_CSRCOSTCACHE_H_
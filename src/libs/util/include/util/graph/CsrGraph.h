@@ -0,0 +1,69 @@
+// Copyright 2017, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_GRAPH_CSRGRAPH_H_
+#define UTIL_GRAPH_CSRGRAPH_H_
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace util::graph
+{
+
+/*
+ * Read-only directed graph topology in compressed sparse row layout. Nodes
+ * and edges are identified by consecutive ids, the outgoing edges of a node
+ * have consecutive ids as well. Payloads are kept by the user in arrays
+ * indexed by these ids
+ */
+class CsrGraph
+{
+public:
+    using Id = uint32_t;
+
+    static constexpr Id NONE = std::numeric_limits<Id>::max();
+
+    CsrGraph() :
+        _out(1, 0) {}
+
+    // Add a node and return its id. All outgoing edges of a node have to be
+    // added directly after the node itself
+    Id addNd()
+    {
+        _out.push_back(_out.back());
+        return static_cast<Id>(_out.size() - 2);
+    }
+
+    // Add an edge from the last added node to the node with id to, which
+    // may not have been added yet, and return its id
+    Id addEdg(Id to)
+    {
+        _from.push_back(static_cast<Id>(_out.size() - 2));
+        _to.push_back(to);
+        _out.back()++;
+        return static_cast<Id>(_to.size() - 1);
+    }
+
+    size_t getNumNds() const { return _out.size() - 1; }
+    size_t getNumEdgs() const { return _to.size(); }
+
+    Id getFrom(Id e) const { return _from[e]; }
+    Id getTo(Id e) const { return _to[e]; }
+
+    // The outgoing edges of node n are [getOutBegin(n), getOutEnd(n))
+    Id getOutBegin(Id n) const { return _out[n]; }
+    Id getOutEnd(Id n) const { return _out[n + 1]; }
+
+    // Return the number of outgoing edges of node n, as DirNode::getDeg()
+    size_t getDeg(Id n) const { return _out[n + 1] - _out[n]; }
+
+private:
+    std::vector<Id> _out;
+    std::vector<Id> _from;
+    std::vector<Id> _to;
+};
+}  // namespace util::graph
+
+#endif  // UTIL_GRAPH_CSRGRAPH_H_
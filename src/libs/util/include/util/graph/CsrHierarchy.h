@@ -0,0 +1,415 @@
+// Copyright 2017, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_GRAPH_CSRHIERARCHY_H_
+#define UTIL_GRAPH_CSRHIERARCHY_H_
+
+#include "util/graph/CsrGraph.h"
+#include "util/graph/CsrSearchSpace.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace util::graph
+{
+
+/*
+ * Contraction hierarchy over the turns of a CsrGraph. Its vertices are the
+ * edges of the graph, its arcs are the turns between them and the shortcuts
+ * added while contracting. Edges marked as core are never contracted, and
+ * neither are edges which would need too many shortcuts. Afterwards, the
+ * shortest paths between two core edges only run over core edges, so
+ * searches between them only have to look at the core.
+ *
+ * Only shortcuts have fixed costs. Turns between core edges are evaluated
+ * by the cost functor of each search, so they may be cheaper than the
+ * weights the hierarchy was built with. All other turns must cost exactly
+ * their weight
+ */
+class CsrHierarchy
+{
+public:
+    using Id = CsrGraph::Id;
+
+    template<typename CF>
+    using CostOf = decltype(std::declval<const CF&>().inf());
+
+    // Contract all edges of g not marked in core. weight(from, n, to) is the
+    // weight of the turn from edge from into edge to at node n
+    template<typename WF>
+    CsrHierarchy(const CsrGraph& g, const std::vector<bool>& core, const WF& weight);
+
+    // True if e was not contracted
+    bool isCore(Id e) const { return _core[e]; }
+
+    size_t getNumCoreEdgs() const { return _numCore; }
+    size_t getNumShortcuts() const { return _numShortcuts; }
+
+    // Search from the core edge from to the core edges in to, like the
+    // searches of EDijkstra on a CsrGraph. costFunc is called for turns
+    // between core edges, the cost of a shortcut is its weight. The costs
+    // of all targets are returned, their paths are unpacked into resEdges,
+    // reversed
+    template<typename CF, typename HF>
+    std::unordered_map<Id, CostOf<CF>> shortestPath(
+            Id from, const std::vector<Id>& to, const CF& costFunc,
+            const HF& heurFunc,
+            const std::unordered_map<Id, std::vector<Id>*>& resEdges) const;
+
+private:
+    // an arc is a turn of the graph if first is NONE, otherwise a shortcut
+    // for the arcs first and second
+    struct Arc
+    {
+        Id from;
+        Id to;
+        double w;
+        uint32_t first;
+        uint32_t second;
+    };
+
+    // state of the witness searches during contraction
+    struct Witness
+    {
+        std::vector<double> dist;
+        std::vector<uint32_t> stamp;
+        uint32_t epoch = 0;
+    };
+
+    // witness searches give up after settling this many edges
+    static const size_t WITNESS_SETTLE_LIMIT = 16;
+
+    // edges needing more shortcuts stay in the core
+    static const size_t MAX_SHORTCUTS = 32;
+
+    const CsrGraph& _g;
+    std::vector<Arc> _arcs;
+    std::vector<uint8_t> _core;
+    std::vector<uint32_t> _coreOut;
+    std::vector<uint32_t> _coreArcs;
+    size_t _numCore;
+    size_t _numShortcuts;
+
+    void findShortcuts(Id v, const std::vector<std::vector<uint32_t>>& out,
+                       const std::vector<std::vector<uint32_t>>& in, Witness& ws,
+                       std::vector<Arc>* ret) const;
+
+    void witness(Id from, Id avoid, double maxW,
+                 const std::vector<std::vector<uint32_t>>& out, Witness& ws) const;
+
+    void unpack(uint32_t arc, std::vector<Id>* resEdges) const;
+};
+
+// _____________________________________________________________________________
+template<typename WF>
+CsrHierarchy::CsrHierarchy(const CsrGraph& g, const std::vector<bool>& core,
+                           const WF& weight) :
+    _g(g),
+    _core(g.getNumEdgs(), 1),
+    _numCore(0),
+    _numShortcuts(0)
+{
+    const size_t n = g.getNumEdgs();
+    std::vector<std::vector<uint32_t>> out(n), in(n);
+
+    auto addArc = [&](Id from, Id to, double w, uint32_t first, uint32_t second) {
+        auto id = static_cast<uint32_t>(_arcs.size());
+        _arcs.push_back(Arc{from, to, w, first, second});
+        out[from].push_back(id);
+        in[to].push_back(id);
+    };
+
+    for (Id e = 0; e < n; e++)
+    {
+        const Id nd = g.getTo(e);
+        for (Id f = g.getOutBegin(nd); f < g.getOutEnd(nd); f++)
+        {
+            if (f == e) continue;
+            addArc(e, f, weight(e, nd, f), CsrGraph::NONE, CsrGraph::NONE);
+        }
+    }
+
+    Witness ws;
+    ws.dist.resize(n);
+    ws.stamp.resize(n, 0);
+
+    // edges are contracted by the number of shortcuts they need minus the
+    // arcs they remove, plus the number of their contracted neighbours to
+    // spread contraction evenly over the graph. The priorities of the
+    // neighbours of an edge are updated once it is contracted, the priority
+    // of an edge is checked again once it is taken from the queue
+    std::vector<int64_t> deleted(n, 0);
+    std::vector<int64_t> prio(n, 0);
+    std::vector<uint8_t> queued(n, 0);
+    std::vector<Arc> shortcuts;
+
+    auto priority = [&](Id v) {
+        findShortcuts(v, out, in, ws, &shortcuts);
+        return static_cast<int64_t>(shortcuts.size()) -
+               static_cast<int64_t>(out[v].size() + in[v].size()) + deleted[v];
+    };
+
+    using QEntry = std::pair<int64_t, Id>;
+    std::priority_queue<QEntry, std::vector<QEntry>, std::greater<QEntry>> pq;
+    for (Id e = 0; e < n; e++)
+    {
+        if (core[e]) continue;
+        prio[e] = priority(e);
+        queued[e] = 1;
+        pq.emplace(prio[e], e);
+    }
+
+    std::vector<Id> neighbours;
+
+    while (!pq.empty())
+    {
+        const QEntry top = pq.top();
+        pq.pop();
+        const Id v = top.second;
+
+        // outdated entries
+        if (!queued[v] || top.first != prio[v]) continue;
+
+        prio[v] = priority(v);
+        if (!pq.empty() && prio[v] > pq.top().first)
+        {
+            pq.emplace(prio[v], v);
+            continue;
+        }
+
+        queued[v] = 0;
+        if (shortcuts.size() > MAX_SHORTCUTS) continue;
+
+        _core[v] = 0;
+
+        for (const auto& s : shortcuts) addArc(s.from, s.to, s.w, s.first, s.second);
+        _numShortcuts += shortcuts.size();
+
+        // v is gone, drop its arcs from the lists of its neighbours
+        neighbours.clear();
+        for (auto a : in[v])
+        {
+            const Id u = _arcs[a].from;
+            auto& l = out[u];
+            l.erase(std::remove(l.begin(), l.end(), a), l.end());
+            deleted[u]++;
+            neighbours.push_back(u);
+        }
+        for (auto a : out[v])
+        {
+            const Id x = _arcs[a].to;
+            auto& l = in[x];
+            l.erase(std::remove(l.begin(), l.end(), a), l.end());
+            deleted[x]++;
+            neighbours.push_back(x);
+        }
+        std::vector<uint32_t>().swap(in[v]);
+        std::vector<uint32_t>().swap(out[v]);
+
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for (auto u : neighbours)
+        {
+            if (!queued[u]) continue;
+            prio[u] = priority(u);
+            pq.emplace(prio[u], u);
+        }
+    }
+
+    // the arcs between core edges, the only ones searches have to look at
+    _coreOut.reserve(n + 1);
+    _coreOut.push_back(0);
+    for (Id e = 0; e < n; e++)
+    {
+        if (_core[e])
+        {
+            _numCore++;
+            _coreArcs.insert(_coreArcs.end(), out[e].begin(), out[e].end());
+        }
+        _coreOut.push_back(static_cast<uint32_t>(_coreArcs.size()));
+    }
+}
+
+// _____________________________________________________________________________
+inline void CsrHierarchy::findShortcuts(Id v, const std::vector<std::vector<uint32_t>>& out,
+                                        const std::vector<std::vector<uint32_t>>& in,
+                                        Witness& ws, std::vector<Arc>* ret) const
+{
+    ret->clear();
+
+    // the cheapest arc from every predecessor and to every successor
+    std::vector<uint32_t> ins, outs;
+    auto keepBest = [this](std::vector<uint32_t>& l, uint32_t a, bool byFrom) {
+        for (auto& b : l)
+        {
+            if ((byFrom ? _arcs[b].from == _arcs[a].from : _arcs[b].to == _arcs[a].to))
+            {
+                if (_arcs[a].w < _arcs[b].w) b = a;
+                return;
+            }
+        }
+        l.push_back(a);
+    };
+    for (auto a : in[v]) keepBest(ins, a, true);
+    for (auto a : out[v]) keepBest(outs, a, false);
+
+    for (auto ai : ins)
+    {
+        const Arc& aIn = _arcs[ai];
+        double maxW = 0;
+        for (auto ao : outs)
+        {
+            if (_arcs[ao].to == aIn.from) continue;
+            maxW = std::max(maxW, aIn.w + _arcs[ao].w);
+        }
+
+        witness(aIn.from, v, maxW, out, ws);
+
+        for (auto ao : outs)
+        {
+            const Arc& aOut = _arcs[ao];
+            if (aOut.to == aIn.from) continue;
+
+            const double w = aIn.w + aOut.w;
+            if (ws.stamp[aOut.to] == ws.epoch && ws.dist[aOut.to] <= w) continue;
+            ret->push_back(Arc{aIn.from, aOut.to, w, ai, ao});
+        }
+    }
+}
+
+// _____________________________________________________________________________
+inline void CsrHierarchy::witness(Id from, Id avoid, double maxW,
+                                  const std::vector<std::vector<uint32_t>>& out,
+                                  Witness& ws) const
+{
+    if (++ws.epoch == 0)
+    {
+        std::fill(ws.stamp.begin(), ws.stamp.end(), 0);
+        ws.epoch = 1;
+    }
+
+    using QEntry = std::pair<double, Id>;
+    std::priority_queue<QEntry, std::vector<QEntry>, std::greater<QEntry>> pq;
+
+    ws.stamp[from] = ws.epoch;
+    ws.dist[from] = 0;
+    pq.emplace(0, from);
+
+    size_t settled = 0;
+    while (!pq.empty() && settled < WITNESS_SETTLE_LIMIT)
+    {
+        const auto cur = pq.top();
+        pq.pop();
+        if (cur.first > ws.dist[cur.second]) continue;
+        if (cur.first > maxW) break;
+        settled++;
+
+        for (auto a : out[cur.second])
+        {
+            const Arc& arc = _arcs[a];
+            if (arc.to == avoid) continue;
+            const double d = cur.first + arc.w;
+            if (ws.stamp[arc.to] == ws.epoch && ws.dist[arc.to] <= d) continue;
+            ws.stamp[arc.to] = ws.epoch;
+            ws.dist[arc.to] = d;
+            pq.emplace(d, arc.to);
+        }
+    }
+}
+
+// _____________________________________________________________________________
+inline void CsrHierarchy::unpack(uint32_t arc, std::vector<Id>* resEdges) const
+{
+    // shortcuts may be nested deeply, so they are unpacked without recursion
+    std::vector<uint32_t> stack{arc};
+    while (!stack.empty())
+    {
+        const Arc& a = _arcs[stack.back()];
+        stack.pop_back();
+        if (a.first == CsrGraph::NONE)
+        {
+            resEdges->push_back(a.to);
+        }
+        else
+        {
+            stack.push_back(a.first);
+            stack.push_back(a.second);
+        }
+    }
+}
+
+// _____________________________________________________________________________
+template<typename CF, typename HF>
+std::unordered_map<CsrGraph::Id, CsrHierarchy::CostOf<CF>> CsrHierarchy::shortestPath(
+        Id from, const std::vector<Id>& to, const CF& costFunc, const HF& heurFunc,
+        const std::unordered_map<Id, std::vector<Id>*>& resEdges) const
+{
+    using C = CostOf<CF>;
+    std::unordered_map<Id, C> costs;
+    if (to.empty()) return costs;
+
+    static thread_local CsrSearchSpace<C> space;
+    space.reset(_g.getNumEdgs());
+
+    size_t numTo = 0;
+    for (auto e : to)
+    {
+        if (space.addTarget(e)) numTo++;
+        costs[e] = costFunc.inf();
+    }
+
+    size_t found = 0;
+
+    // the parents in the search space are arcs, not edges
+    C c = costFunc(CsrGraph::NONE, CsrGraph::NONE, from);
+    space.push(from, CsrGraph::NONE, c, c + heurFunc(from));
+
+    while (!space.empty())
+    {
+        const auto cur = space.pop();
+
+        if (space.isTarget(cur.e))
+        {
+            found++;
+            costs[cur.e] = cur.d;
+            auto res = resEdges.find(cur.e);
+            if (res != resEdges.end() && res->second)
+            {
+                for (Id e = cur.e; space.getParent(e) != CsrGraph::NONE;)
+                {
+                    const uint32_t arc = space.getParent(e);
+                    unpack(arc, res->second);
+                    e = _arcs[arc].from;
+                }
+                res->second->push_back(from);
+            }
+        }
+
+        if (found == numTo) break;
+
+        const Id n = _g.getTo(cur.e);
+        for (uint32_t i = _coreOut[cur.e]; i < _coreOut[cur.e + 1]; i++)
+        {
+            const Arc& a = _arcs[_coreArcs[i]];
+            if (space.isSettled(a.to)) continue;
+
+            C newC = a.first == CsrGraph::NONE ? costFunc(cur.e, n, a.to) : C(a.w);
+            newC = cur.d + newC;
+            if (costFunc.inf() <= newC) continue;
+
+            space.push(a.to, _coreArcs[i], newC, newC + heurFunc(a.to));
+        }
+    }
+
+    return costs;
+}
+}  // namespace util::graph
+
+#endif  // UTIL_GRAPH_CSRHIERARCHY_H_
@@ -0,0 +1,184 @@
+// Copyright 2017, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_GRAPH_CSRSEARCHSPACE_H_
+#define UTIL_GRAPH_CSRSEARCHSPACE_H_
+
+#include "util/graph/CsrGraph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace util::graph
+{
+
+/*
+ * Queue and settled set of a search on a CsrGraph. The queue is an indexed
+ * 4-ary heap with decrease-key, every edge is in it at most once. All per
+ * edge state lives in dense arrays which are stamped with the epoch of the
+ * search they belong to, so a space can be reused for any number of
+ * searches without clearing or reallocating it
+ */
+template<typename C>
+class CsrSearchSpace
+{
+public:
+    struct Entry
+    {
+        CsrGraph::Id e;
+        CsrGraph::Id parent;
+        C d;
+        C h;
+    };
+
+    // Start a new search on a graph with numEdges edges
+    void reset(size_t numEdges)
+    {
+        if (_stamp.size() < numEdges)
+        {
+            _stamp.resize(numEdges, 0);
+            _target.resize(numEdges, 0);
+            _pos.resize(numEdges);
+            _parent.resize(numEdges);
+        }
+
+        _heap.clear();
+
+        if (++_epoch == 0)
+        {
+            // the stamps wrapped around, old stamps could be taken as valid
+            std::fill(_stamp.begin(), _stamp.end(), 0);
+            std::fill(_target.begin(), _target.end(), 0);
+            _epoch = 1;
+        }
+    }
+
+    // Mark e as a target of the current search, return false if it already
+    // was one
+    bool addTarget(CsrGraph::Id e)
+    {
+        if (_target[e] == _epoch) return false;
+        _target[e] = _epoch;
+        return true;
+    }
+
+    bool isTarget(CsrGraph::Id e) const { return _target[e] == _epoch; }
+
+    bool isSettled(CsrGraph::Id e) const
+    {
+        return _stamp[e] == _epoch && _pos[e] == SETTLED;
+    }
+
+    // Return the edge e was settled from, CsrGraph::NONE for start edges
+    CsrGraph::Id getParent(CsrGraph::Id e) const { return _parent[e]; }
+
+    bool empty() const { return _heap.empty(); }
+
+    // Queue e, or lower its key if it is already queued with a worse one.
+    // Settled edges are ignored
+    void push(CsrGraph::Id e, CsrGraph::Id parent, const C& d, const C& h)
+    {
+        if (_stamp[e] != _epoch)
+        {
+            _stamp[e] = _epoch;
+            _heap.push_back(Entry{e, parent, d, h});
+            up(_heap.size() - 1);
+            return;
+        }
+
+        if (_pos[e] == SETTLED) return;
+
+        Entry& cur = _heap[_pos[e]];
+        if (!before(h, d, cur.h, cur.d)) return;
+        cur.parent = parent;
+        cur.d = d;
+        cur.h = h;
+        up(_pos[e]);
+    }
+
+    // Remove the entry with the smallest key from the queue and settle it
+    Entry pop()
+    {
+        Entry top = _heap.front();
+        _pos[top.e] = SETTLED;
+        _parent[top.e] = top.parent;
+
+        if (_heap.size() > 1)
+        {
+            _heap.front() = _heap.back();
+            _heap.pop_back();
+            down(0);
+        }
+        else
+        {
+            _heap.pop_back();
+        }
+
+        return top;
+    }
+
+private:
+    static constexpr uint32_t SETTLED = CsrGraph::NONE;
+    static constexpr size_t ARITY = 4;
+
+    std::vector<Entry> _heap;
+    std::vector<uint32_t> _stamp;
+    std::vector<uint32_t> _target;
+    std::vector<uint32_t> _pos;
+    std::vector<CsrGraph::Id> _parent;
+    uint32_t _epoch = 0;
+
+    // same order as EDijkstra::RouteEdge: by h, ties broken by d
+    static bool before(const C& ha, const C& da, const C& hb, const C& db)
+    {
+        return hb > ha || (ha == hb && db > da);
+    }
+
+    static bool before(const Entry& a, const Entry& b)
+    {
+        return before(a.h, a.d, b.h, b.d);
+    }
+
+    void up(size_t i)
+    {
+        Entry cur = _heap[i];
+        while (i > 0)
+        {
+            size_t p = (i - 1) / ARITY;
+            if (!before(cur, _heap[p])) break;
+            _heap[i] = _heap[p];
+            _pos[_heap[i].e] = static_cast<uint32_t>(i);
+            i = p;
+        }
+        _heap[i] = cur;
+        _pos[cur.e] = static_cast<uint32_t>(i);
+    }
+
+    void down(size_t i)
+    {
+        Entry cur = _heap[i];
+        const size_t n = _heap.size();
+        while (true)
+        {
+            size_t first = i * ARITY + 1;
+            if (first >= n) break;
+            size_t best = first;
+            size_t last = std::min(first + ARITY, n);
+            for (size_t c = first + 1; c < last; c++)
+            {
+                if (before(_heap[c], _heap[best])) best = c;
+            }
+            if (!before(_heap[best], cur)) break;
+            _heap[i] = _heap[best];
+            _pos[_heap[i].e] = static_cast<uint32_t>(i);
+            i = best;
+        }
+        _heap[i] = cur;
+        _pos[cur.e] = static_cast<uint32_t>(i);
+    }
+};
+}  // namespace util::graph
+
+#endif  // UTIL_GRAPH_CSRSEARCHSPACE_H_
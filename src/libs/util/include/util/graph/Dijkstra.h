@@ -5,6 +5,7 @@
 #ifndef UTIL_GRAPH_DIJKSTRA_H_
 #define UTIL_GRAPH_DIJKSTRA_H_
 
+#include <atomic>
 #include <limits>
 #include <list>
 #include <queue>
@@ -112,7 +113,9 @@ public:
                           NList<N, E>* resNodes,
                           EList<N, E>* resEdges);
 
-    static size_t ITERS;
+    // total number of queue pops, flushed once per search so that
+    // concurrent searches do not contend on it
+    static std::atomic<size_t> ITERS;
 };
 
 template<typename N, typename E, typename C>
@@ -130,9 +133,10 @@ C Dijkstra::shortestPathImpl(Node<N, E>* from, const std::set<Node<N, E>*>& to,
     pq.emplace(from);
     RouteNode<N, E, C> cur;
 
+    size_t iters = 0;
     while (!pq.empty())
     {
-        Dijkstra::ITERS++;
+        iters++;
 
         if (settled.find(pq.top().n) != settled.end())
         {
@@ -153,6 +157,7 @@ C Dijkstra::shortestPathImpl(Node<N, E>* from, const std::set<Node<N, E>*>& to,
 
         relax(cur, to, costFunc, heurFunc, pq);
     }
+    Dijkstra::ITERS += iters;
 
     if (!found) return costFunc.inf();
 
@@ -177,9 +182,10 @@ C Dijkstra::shortestPathImpl(const std::set<Node<N, E>*> from,
     for (auto n : from) pq.emplace(n);
     RouteNode<N, E, C> cur;
 
+    size_t iters = 0;
     while (!pq.empty())
     {
-        Dijkstra::ITERS++;
+        iters++;
 
         if (settled.find(pq.top().n) != settled.end())
         {
@@ -200,6 +206,7 @@ C Dijkstra::shortestPathImpl(const std::set<Node<N, E>*> from,
 
         relax(cur, to, costFunc, heurFunc, pq);
     }
+    Dijkstra::ITERS += iters;
 
     if (!found) return costFunc.inf();
 
@@ -232,9 +239,10 @@ std::unordered_map<Node<N, E>*, C> Dijkstra::shortestPathImpl(
     pq.emplace(from);
     RouteNode<N, E, C> cur;
 
+    size_t iters = 0;
     while (!pq.empty())
     {
-        Dijkstra::ITERS++;
+        iters++;
 
         if (settled.find(pq.top().n) != settled.end())
         {
@@ -256,6 +264,7 @@ std::unordered_map<Node<N, E>*, C> Dijkstra::shortestPathImpl(
 
         relax(cur, to, costFunc, heurFunc, pq);
     }
+    Dijkstra::ITERS += iters;
 
     for (auto nto : to)
     {
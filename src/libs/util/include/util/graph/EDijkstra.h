@@ -5,16 +5,22 @@
 #ifndef UTIL_GRAPH_EDIJKSTRA_H_
 #define UTIL_GRAPH_EDIJKSTRA_H_
 
+#include "util/graph/CsrCostCache.h"
+#include "util/graph/CsrGraph.h"
+#include "util/graph/CsrSearchSpace.h"
 #include "util/graph/Edge.h"
 #include "util/graph/Graph.h"
 #include "util/graph/Node.h"
 #include "util/graph/ShortestPath.h"
 
+#include <atomic>
 #include <limits>
 #include <list>
 #include <queue>
 #include <set>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace util::graph
 {
@@ -139,7 +145,82 @@ public:
                          const ShortestPath::CostFunc<N, E, C>& costFunc,
                          PQ<N, E, C>& pq);
 
-    static size_t ITERS;
+    using CsrEList = std::vector<CsrGraph::Id>;
+
+    template<typename CF>
+    using CostOf = decltype(std::declval<const CF&>().inf());
+
+    using ShortestPath<EDijkstra>::shortestPath;
+
+    // Searches on a CsrGraph. Instead of virtual cost and heuristic
+    // functions, they take functors which are called as costFunc(from, n, to)
+    // with edge and node ids (from and n being CsrGraph::NONE for the start
+    // edges) and as heurFunc(e). Result edges are reversed, as above. The
+    // queue and the settled edges are kept in a search space per thread that
+    // is reused by all searches of that thread.
+
+    template<typename CF, typename HF>
+    static CostOf<CF> shortestPath(const CsrGraph& g,
+                                   const std::vector<CsrGraph::Id>& from,
+                                   const std::vector<CsrGraph::Id>& to,
+                                   const CF& costFunc, const HF& heurFunc,
+                                   CsrEList* resEdges);
+
+    template<typename CF, typename HF>
+    static std::unordered_map<CsrGraph::Id, CostOf<CF>> shortestPath(
+            const CsrGraph& g, CsrGraph::Id from,
+            const std::vector<CsrGraph::Id>& to, const CF& costFunc,
+            const HF& heurFunc,
+            const std::unordered_map<CsrGraph::Id, CsrEList*>& resEdges);
+
+    // Many-to-many search, from every edge from[i] to the edges in to[i],
+    // with heuristic heurFuncs[i]. The searches share one cost functor, each
+    // turn cost is only evaluated once for all of them. Returns the costs
+    // of every source, the paths are written to resEdges[i] as above
+    template<typename CF, typename HF>
+    static std::vector<std::unordered_map<CsrGraph::Id, CostOf<CF>>> shortestPath(
+            const CsrGraph& g, const std::vector<CsrGraph::Id>& from,
+            const std::vector<std::vector<CsrGraph::Id>>& to, const CF& costFunc,
+            const std::vector<HF>& heurFuncs,
+            const std::vector<std::unordered_map<CsrGraph::Id, CsrEList*>>& resEdges);
+
+    // cost functor served from a CsrCostCache
+    template<typename CF>
+    struct CsrCachedCost
+    {
+        const CsrGraph& g;
+        const CF& costFunc;
+        CsrCostCache<CostOf<CF>>& cache;
+
+        CostOf<CF> operator()(CsrGraph::Id from, CsrGraph::Id n,
+                              CsrGraph::Id to) const
+        {
+            return cache.get(g, costFunc, from, n, to);
+        }
+        CostOf<CF> inf() const { return costFunc.inf(); }
+    };
+
+    template<typename C>
+    static CsrSearchSpace<C>& getSearchSpace(const CsrGraph& g)
+    {
+        static thread_local CsrSearchSpace<C> space;
+        space.reset(g.getNumEdgs());
+        return space;
+    }
+
+    template<typename CF, typename HF, typename C>
+    static inline void relax(const CsrGraph& g,
+                             const typename CsrSearchSpace<C>::Entry& cur,
+                             const CF& costFunc, const HF& heurFunc,
+                             CsrSearchSpace<C>& space);
+
+    template<typename C>
+    static void buildPath(CsrGraph::Id curE, const CsrSearchSpace<C>& space,
+                          CsrEList* resEdges);
+
+    // total number of queue pops, flushed once per search so that
+    // concurrent searches do not contend on it
+    static std::atomic<size_t> ITERS;
 };
 
 template<typename N, typename E, typename C>
@@ -211,9 +292,10 @@ C EDijkstra::shortestPathImpl(const std::set<Edge<N, E>*> from,
 
     RouteEdge<N, E, C> cur;
 
+    size_t iters = 0;
     while (!pq.empty())
     {
-        EDijkstra::ITERS++;
+        iters++;
 
         if (settled.find(pq.top().e) != settled.end())
         {
@@ -234,6 +316,7 @@ C EDijkstra::shortestPathImpl(const std::set<Edge<N, E>*> from,
 
         relax(cur, to, costFunc, heurFunc, pq);
     }
+    EDijkstra::ITERS += iters;
 
     if (!found) return costFunc.inf();
 
@@ -261,9 +344,10 @@ std::unordered_map<Edge<N, E>*, C> EDijkstra::shortestPathImpl(
 
     RouteEdge<N, E, C> cur;
 
+    size_t iters = 0;
     while (!pq.empty())
     {
-        EDijkstra::ITERS++;
+        iters++;
 
         if (settled.find(pq.top().e) != settled.end())
         {
@@ -284,6 +368,7 @@ std::unordered_map<Edge<N, E>*, C> EDijkstra::shortestPathImpl(
         else
             relax(cur, to, costFunc, ZeroHeurFunc<N, E, C>(), pq);
     }
+    EDijkstra::ITERS += iters;
 
     return costs;
 }
@@ -313,9 +398,10 @@ std::unordered_map<Edge<N, E>*, C> EDijkstra::shortestPathImpl(
 
     RouteEdge<N, E, C> cur;
 
+    size_t iters = 0;
     while (!pq.empty())
     {
-        EDijkstra::ITERS++;
+        iters++;
 
         if (settled.find(pq.top().e) != settled.end())
         {
@@ -335,10 +421,11 @@ std::unordered_map<Edge<N, E>*, C> EDijkstra::shortestPathImpl(
             buildPath(cur.e, settled, resNodes[cur.e], resEdges[cur.e]);
         }
 
-        if (found == to.size()) return costs;
+        if (found == to.size()) break;
 
         relax(cur, to, costFunc, heurFunc, pq);
     }
+    EDijkstra::ITERS += iters;
 
     return costs;
 }
@@ -413,6 +500,157 @@ void EDijkstra::buildPath(Edge<N, E>* curE, const Settled<N, E, C>& settled,
         curEdge = &settled.find(curEdge->parent)->second;
     }
 }
+
+template<typename CF, typename HF>
+EDijkstra::CostOf<CF> EDijkstra::shortestPath(const CsrGraph& g,
+                                              const std::vector<CsrGraph::Id>& from,
+                                              const std::vector<CsrGraph::Id>& to,
+                                              const CF& costFunc,
+                                              const HF& heurFunc,
+                                              CsrEList* resEdges)
+{
+    using C = CostOf<CF>;
+    if (from.empty() || to.empty()) return costFunc.inf();
+
+    auto& space = getSearchSpace<C>(g);
+    for (auto e : to) space.addTarget(e);
+
+    for (auto e : from)
+    {
+        C c = costFunc(CsrGraph::NONE, CsrGraph::NONE, e);
+        C h = heurFunc(e);
+        space.push(e, CsrGraph::NONE, c, c + h);
+    }
+
+    size_t iters = 0;
+    while (!space.empty())
+    {
+        iters++;
+
+        const auto cur = space.pop();
+
+        if (space.isTarget(cur.e))
+        {
+            EDijkstra::ITERS += iters;
+            buildPath(cur.e, space, resEdges);
+            return cur.d;
+        }
+
+        relax(g, cur, costFunc, heurFunc, space);
+    }
+    EDijkstra::ITERS += iters;
+
+    return costFunc.inf();
+}
+
+template<typename CF, typename HF>
+std::unordered_map<CsrGraph::Id, EDijkstra::CostOf<CF>> EDijkstra::shortestPath(
+        const CsrGraph& g, CsrGraph::Id from, const std::vector<CsrGraph::Id>& to,
+        const CF& costFunc, const HF& heurFunc,
+        const std::unordered_map<CsrGraph::Id, CsrEList*>& resEdges)
+{
+    using C = CostOf<CF>;
+    std::unordered_map<CsrGraph::Id, C> costs;
+    if (to.empty()) return costs;
+
+    auto& space = getSearchSpace<C>(g);
+
+    // init costs with inf
+    size_t numTo = 0;
+    for (auto e : to)
+    {
+        if (space.addTarget(e)) numTo++;
+        costs[e] = costFunc.inf();
+    }
+
+    size_t found = 0;
+
+    C c = costFunc(CsrGraph::NONE, CsrGraph::NONE, from);
+    C h = heurFunc(from);
+    space.push(from, CsrGraph::NONE, c, c + h);
+
+    size_t iters = 0;
+    while (!space.empty())
+    {
+        iters++;
+
+        const auto cur = space.pop();
+
+        if (space.isTarget(cur.e))
+        {
+            found++;
+            costs[cur.e] = cur.d;
+            auto res = resEdges.find(cur.e);
+            buildPath(cur.e, space, res == resEdges.end() ? nullptr : res->second);
+        }
+
+        if (found == numTo) break;
+
+        relax(g, cur, costFunc, heurFunc, space);
+    }
+    EDijkstra::ITERS += iters;
+
+    return costs;
+}
+
+template<typename CF, typename HF>
+std::vector<std::unordered_map<CsrGraph::Id, EDijkstra::CostOf<CF>>> EDijkstra::shortestPath(
+        const CsrGraph& g, const std::vector<CsrGraph::Id>& from,
+        const std::vector<std::vector<CsrGraph::Id>>& to, const CF& costFunc,
+        const std::vector<HF>& heurFuncs,
+        const std::vector<std::unordered_map<CsrGraph::Id, CsrEList*>>& resEdges)
+{
+    using C = CostOf<CF>;
+    std::vector<std::unordered_map<CsrGraph::Id, C>> costs(from.size());
+
+    static thread_local CsrCostCache<C> cache;
+    cache.reset(g.getNumEdgs());
+    CsrCachedCost<CF> cachedCost{g, costFunc, cache};
+
+    for (size_t i = 0; i < from.size(); i++)
+    {
+        costs[i] = shortestPath(g, from[i], to[i], cachedCost, heurFuncs[i],
+                                resEdges[i]);
+    }
+
+    return costs;
+}
+
+template<typename CF, typename HF, typename C>
+void EDijkstra::relax(const CsrGraph& g,
+                      const typename CsrSearchSpace<C>::Entry& cur,
+                      const CF& costFunc, const HF& heurFunc,
+                      CsrSearchSpace<C>& space)
+{
+    // a CsrGraph is always directed, a self edge is only relaxed once
+    const CsrGraph::Id n = g.getTo(cur.e);
+    const CsrGraph::Id end = g.getOutEnd(n);
+
+    for (CsrGraph::Id edge = g.getOutBegin(n); edge < end; edge++)
+    {
+        if (edge == cur.e || space.isSettled(edge)) continue;
+        C newC = costFunc(cur.e, n, edge);
+        newC = cur.d + newC;
+        if (costFunc.inf() <= newC) continue;
+
+        const C& h = heurFunc(edge);
+        const C& newH = newC + h;
+
+        space.push(edge, cur.e, newC, newH);
+    }
+}
+
+template<typename C>
+void EDijkstra::buildPath(CsrGraph::Id curE, const CsrSearchSpace<C>& space,
+                          CsrEList* resEdges)
+{
+    if (!resEdges) return;
+    while (curE != CsrGraph::NONE)
+    {
+        resEdges->push_back(curE);
+        curE = space.getParent(curE);
+    }
+}
 }
 
 #endif  // UTIL_GRAPH_DIJKSTRA_H_
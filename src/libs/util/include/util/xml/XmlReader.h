@@ -0,0 +1,105 @@
+// Copyright 2016, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#ifndef UTIL_XML_XMLREADER_H_
+#define UTIL_XML_XMLREADER_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace util::xml
+{
+
+class XmlReaderException : public std::exception
+{
+public:
+    XmlReaderException(std::string msg) :
+        _msg(msg) {}
+    ~XmlReaderException() noexcept override = default;
+
+    const char* what() const noexcept override { return _msg.c_str(); };
+
+private:
+    std::string _msg;
+};
+
+// an opening tag, all strings are entity-decoded and only valid until the
+// next call of XmlReader::next()
+struct XmlTag
+{
+    const char* name;
+    std::vector<std::pair<const char*, const char*>> attrs;
+
+    // value of attribute key, or nullptr if the tag does not have it
+    const char* attr(const char* key) const;
+};
+
+// simple streaming XML pull parser. The file is read through a fixed-size
+// buffer, no document tree is built. Text content, comments, processing
+// instructions and doctype declarations are skipped.
+class XmlReader
+{
+public:
+    explicit XmlReader(const std::string& path);
+    ~XmlReader();
+
+    XmlReader(const XmlReader&) = delete;
+    XmlReader& operator=(const XmlReader&) = delete;
+
+    // advance to the next opening tag, return false if the end of the file
+    // has been reached
+    bool next();
+
+    // the current opening tag
+    const XmlTag& get() const;
+
+    // nesting level of the current tag, the root element has level 1
+    size_t level() const;
+
+    // rewind to the beginning of the file
+    void reset();
+
+private:
+    std::string _path;
+    int _file;
+
+    char* _buf;
+    size_t _bufSize;
+    size_t _pos;
+    size_t _end;
+
+    size_t _depth;
+    size_t _level;
+
+    XmlTag _tag;
+    std::string _strs;
+    std::vector<std::pair<size_t, size_t>> _attrOffs;
+
+    // move unread bytes to the buffer start and read more, growing the
+    // buffer if it is full. Return false on EOF
+    bool fill();
+
+    // make sure at least n bytes starting at _pos are buffered
+    bool ensure(size_t n);
+
+    // check whether the buffer at _pos starts with str
+    bool startsWith(const char* str);
+
+    // buffer offset of the '>' closing the markup starting at _pos
+    size_t markupEnd();
+
+    // skip everything up to and including the terminator seq
+    void skipPast(const char* seq);
+
+    // parse the tag in [from, to) into _tag
+    void parseTag(size_t from, size_t to);
+
+    // append the entity-decoded contents of [from, to) to _strs
+    void decode(const char* from, const char* to);
+};
+
+}  // namespace util::xml
+
+#endif  // UTIL_XML_XMLREADER_H_
@@ -4,4 +4,4 @@
 
 #include "util/graph/Dijkstra.h"
 
-size_t util::graph::Dijkstra::ITERS = 0;
+std::atomic<size_t> util::graph::Dijkstra::ITERS{0};
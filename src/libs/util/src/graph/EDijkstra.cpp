@@ -4,4 +4,4 @@
 
 #include "util/graph/EDijkstra.h"
 
-size_t util::graph::EDijkstra::ITERS = 0;
+std::atomic<size_t> util::graph::EDijkstra::ITERS{0};
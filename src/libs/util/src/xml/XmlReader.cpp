@@ -0,0 +1,372 @@
+// Copyright 2016, University of Freiburg,
+// Chair of Algorithms and Data Structures.
+// Authors: Patrick Brosi <brosi@informatik.uni-freiburg.de>
+
+#include "util/xml/XmlReader.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifndef POSIX_FADV_SEQUENTIAL
+#define POSIX_FADV_SEQUENTIAL 2
+#endif
+
+namespace util::xml
+{
+
+static const size_t READ_BUFFER_S = 4 * 1024 * 1024;
+
+// utf-8 bytes of tag values are negative as char, which isspace() does not take
+static bool isSpace(char c) { return isspace(static_cast<unsigned char>(c)); }
+
+// _____________________________________________________________________________
+const char* XmlTag::attr(const char* key) const
+{
+    for (const auto& kv : attrs)
+    {
+        if (strcmp(kv.first, key) == 0) return kv.second;
+    }
+    return nullptr;
+}
+
+// _____________________________________________________________________________
+XmlReader::XmlReader(const std::string& path) :
+    _path(path),
+    _bufSize(READ_BUFFER_S),
+    _pos(0),
+    _end(0),
+    _depth(0),
+    _level(0),
+    _tag{"", {}}
+{
+    _file = open(path.c_str(), O_RDONLY);
+    if (_file < 0)
+    {
+        throw XmlReaderException("Could not open " + path + ": " + strerror(errno));
+    }
+#ifdef __unix__
+    posix_fadvise(_file, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    _buf = static_cast<char*>(malloc(_bufSize));
+}
+
+// _____________________________________________________________________________
+XmlReader::~XmlReader()
+{
+    close(_file);
+    free(_buf);
+}
+
+// _____________________________________________________________________________
+void XmlReader::reset()
+{
+    lseek(_file, 0, SEEK_SET);
+    _pos = 0;
+    _end = 0;
+    _depth = 0;
+    _level = 0;
+    _tag.name = "";
+    _tag.attrs.clear();
+}
+
+// _____________________________________________________________________________
+const XmlTag& XmlReader::get() const { return _tag; }
+
+// _____________________________________________________________________________
+size_t XmlReader::level() const { return _level; }
+
+// _____________________________________________________________________________
+bool XmlReader::fill()
+{
+    if (_pos > 0)
+    {
+        memmove(_buf, _buf + _pos, _end - _pos);
+        _end -= _pos;
+        _pos = 0;
+    }
+
+    if (_end == _bufSize)
+    {
+        // a single construct does not fit into the buffer
+        _bufSize *= 2;
+        _buf = static_cast<char*>(realloc(_buf, _bufSize));
+    }
+
+    ssize_t n = read(_file, _buf + _end, _bufSize - _end);
+    if (n < 0)
+    {
+        throw XmlReaderException("Could not read " + _path + ": " + strerror(errno));
+    }
+    _end += n;
+    return n > 0;
+}
+
+// _____________________________________________________________________________
+bool XmlReader::ensure(size_t n)
+{
+    while (_end - _pos < n)
+    {
+        if (!fill()) return false;
+    }
+    return true;
+}
+
+// _____________________________________________________________________________
+bool XmlReader::startsWith(const char* str)
+{
+    size_t len = strlen(str);
+    return ensure(len) && strncmp(_buf + _pos, str, len) == 0;
+}
+
+// _____________________________________________________________________________
+size_t XmlReader::markupEnd()
+{
+    char quot = 0;
+    size_t brackets = 0;
+    bool decl = _buf[_pos + 1] == '!';
+
+    size_t i = _pos + 1;
+    while (true)
+    {
+        if (i == _end)
+        {
+            size_t off = i - _pos;
+            if (!fill()) throw XmlReaderException("Unexpected end of file in " + _path);
+            i = _pos + off;
+        }
+
+        char c = _buf[i];
+        if (quot)
+        {
+            if (c == quot) quot = 0;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            quot = c;
+        }
+        else if (decl && c == '[')
+        {
+            brackets++;
+        }
+        else if (decl && c == ']' && brackets)
+        {
+            brackets--;
+        }
+        else if (c == '>' && !brackets)
+        {
+            return i;
+        }
+        i++;
+    }
+}
+
+// _____________________________________________________________________________
+void XmlReader::skipPast(const char* seq)
+{
+    size_t len = strlen(seq);
+    size_t i = _pos;
+    while (true)
+    {
+        if (_end - i < len)
+        {
+            size_t off = i - _pos;
+            if (!fill()) throw XmlReaderException("Unexpected end of file in " + _path);
+            i = _pos + off;
+            continue;
+        }
+        if (strncmp(_buf + i, seq, len) == 0)
+        {
+            _pos = i + len;
+            return;
+        }
+        i++;
+    }
+}
+
+// _____________________________________________________________________________
+bool XmlReader::next()
+{
+    while (true)
+    {
+        // skip text content
+        while (true)
+        {
+            const char* lt = static_cast<const char*>(memchr(_buf + _pos, '<', _end - _pos));
+            if (lt)
+            {
+                _pos = lt - _buf;
+                break;
+            }
+            _pos = _end;
+            if (!fill()) return false;
+        }
+
+        if (!ensure(2)) throw XmlReaderException("Unexpected end of file in " + _path);
+
+        if (_buf[_pos + 1] == '?')
+        {
+            skipPast("?>");
+        }
+        else if (startsWith("<!--"))
+        {
+            skipPast("-->");
+        }
+        else if (startsWith("<![CDATA["))
+        {
+            skipPast("]]>");
+        }
+        else if (_buf[_pos + 1] == '!')
+        {
+            _pos = markupEnd() + 1;
+        }
+        else if (_buf[_pos + 1] == '/')
+        {
+            _pos = markupEnd() + 1;
+            if (_depth) _depth--;
+        }
+        else
+        {
+            size_t end = markupEnd();
+            bool selfClosing = _buf[end - 1] == '/';
+
+            parseTag(_pos + 1, selfClosing ? end - 1 : end);
+            _pos = end + 1;
+
+            _level = _depth + 1;
+            if (!selfClosing) _depth++;
+            return true;
+        }
+    }
+}
+
+// _____________________________________________________________________________
+void XmlReader::parseTag(size_t from, size_t to)
+{
+    _strs.clear();
+    _attrOffs.clear();
+
+    size_t i = from;
+    while (i < to && !isSpace(_buf[i])) i++;
+    _strs.append(_buf + from, i - from);
+    _strs.push_back(0);
+
+    while (i < to)
+    {
+        while (i < to && isSpace(_buf[i])) i++;
+        if (i == to) break;
+
+        size_t keyStart = i;
+        while (i < to && _buf[i] != '=' && !isSpace(_buf[i])) i++;
+        size_t keyEnd = i;
+
+        while (i < to && _buf[i] != '"' && _buf[i] != '\'') i++;
+        if (i == to) throw XmlReaderException("Malformed attribute in " + _path);
+        char quot = _buf[i++];
+        size_t valStart = i;
+        while (i < to && _buf[i] != quot) i++;
+        if (i == to) throw XmlReaderException("Unterminated attribute value in " + _path);
+
+        size_t keyOff = _strs.size();
+        _strs.append(_buf + keyStart, keyEnd - keyStart);
+        _strs.push_back(0);
+
+        size_t valOff = _strs.size();
+        decode(_buf + valStart, _buf + i);
+        _strs.push_back(0);
+
+        _attrOffs.emplace_back(keyOff, valOff);
+        i++;
+    }
+
+    // only resolve pointers now, _strs may have been reallocated above
+    _tag.name = _strs.c_str();
+    _tag.attrs.clear();
+    for (const auto& off : _attrOffs)
+    {
+        _tag.attrs.emplace_back(_strs.c_str() + off.first, _strs.c_str() + off.second);
+    }
+}
+
+// _____________________________________________________________________________
+void XmlReader::decode(const char* from, const char* to)
+{
+    while (from < to)
+    {
+        const char* amp = static_cast<const char*>(memchr(from, '&', to - from));
+        if (!amp)
+        {
+            _strs.append(from, to - from);
+            return;
+        }
+
+        _strs.append(from, amp - from);
+        const char* semi = static_cast<const char*>(memchr(amp, ';', to - amp));
+        if (!semi)
+        {
+            _strs.append(amp, to - amp);
+            return;
+        }
+
+        std::string ent(amp + 1, semi - amp - 1);
+        if (ent == "amp")
+        {
+            _strs.push_back('&');
+        }
+        else if (ent == "lt")
+        {
+            _strs.push_back('<');
+        }
+        else if (ent == "gt")
+        {
+            _strs.push_back('>');
+        }
+        else if (ent == "quot")
+        {
+            _strs.push_back('"');
+        }
+        else if (ent == "apos")
+        {
+            _strs.push_back('\'');
+        }
+        else if (ent.size() > 1 && ent[0] == '#')
+        {
+            uint32_t cp = ent[1] == 'x' ? strtoul(ent.c_str() + 2, nullptr, 16)
+                                        : strtoul(ent.c_str() + 1, nullptr, 10);
+            // encode as UTF-8
+            if (cp < 0x80)
+            {
+                _strs.push_back(static_cast<char>(cp));
+            }
+            else if (cp < 0x800)
+            {
+                _strs.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+                _strs.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+            else if (cp < 0x10000)
+            {
+                _strs.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+                _strs.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                _strs.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+            else
+            {
+                _strs.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+                _strs.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+                _strs.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+                _strs.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+            }
+        }
+        else
+        {
+            // unknown entity, keep as is
+            _strs.append(amp, semi - amp + 1);
+        }
+        from = semi + 1;
+    }
+}
+
+}  // namespace util::xml
@@ -180,19 +180,20 @@ void XmlWriter::putEsced(std::ostream& out, const std::string& str, char quot)
 // _____________________________________________________________________________
 void XmlWriter::checkTagName(const std::string& str) const
 {
-    if (!isalpha(str[0]) && str[0] != '_')
+    if (!isalpha(static_cast<unsigned char>(str[0])) && str[0] != '_')
         throw XmlWriterException(
                 "XML elements must start with either a letter "
                 "or an underscore");
 
     std::string begin = str.substr(0, 3);
-    std::transform(begin.begin(), begin.end(), begin.begin(), ::tolower);
+    std::transform(begin.begin(), begin.end(), begin.begin(),
+                   [](unsigned char c) { return static_cast<char>(tolower(c)); });
     if (begin == "xml")
         throw XmlWriterException(
                 "XML elements cannot start with"
                 " XML, xml, Xml etc.");
 
-    for (const char& c : str)
+    for (unsigned char c : str)
     {
         // we allow colons in tag names for primitive namespace support
         if (!isalpha(c) && !isdigit(c) && c != '-' && c != '_' && c != '.' &&
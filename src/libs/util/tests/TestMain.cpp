@@ -7,12 +7,18 @@
 #include "util/String.h"
 #include "util/geo/Geo.h"
 #include "util/geo/Grid.h"
+#include "util/geo/PackedRTree.h"
 #include "util/graph/Algorithm.h"
+#include "util/graph/CsrHierarchy.h"
 #include "util/graph/Dijkstra.h"
 #include "util/graph/DirGraph.h"
 #include "util/graph/EDijkstra.h"
 #include "util/graph/UndirGraph.h"
 #include "util/json/Writer.h"
+#include "util/xml/XmlReader.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 
 using namespace util;
 using namespace util::geo;
@@ -83,6 +89,57 @@ int main(int argc, char** argv)
         // TODO: more test cases
     }
 
+    // ___________________________________________________________________________
+    {
+        std::string path = util::getTmpDir() + "/util_test_xmlreader.xml";
+        {
+            std::ofstream out(path);
+            out << "<?xml version=\"1.0\"?>\n<!-- comment <a> -->\n"
+                << "<osm version='0.6'>\n"
+                << " <node id=\"1\" lat=\"1.5\" lon=\"-2\"/>\n"
+                << " <way id=\"2\">text<nd ref=\"1\" />"
+                << "<tag k=\"name\" v=\"A &amp; B &lt;&#x41;&gt; x>y\"/>"
+                << "<tag k=\"n\xc3\xa4me\" v=\"Z\xc3\xbcrich\xc2\xa0Stra\xc3\x9f" "e\"/></way>\n"
+                << "</osm>\n";
+        }
+
+        util::xml::XmlReader xml(path);
+        for (size_t pass = 0; pass < 2; pass++)
+        {
+            assert(xml.next());
+            assert(strcmp(xml.get().name, "osm") == 0);
+            assert(xml.level() == 1);
+            assert(strcmp(xml.get().attr("version"), "0.6") == 0);
+
+            assert(xml.next());
+            assert(strcmp(xml.get().name, "node") == 0);
+            assert(xml.level() == 2);
+            assert(strcmp(xml.get().attr("lon"), "-2") == 0);
+            assert(xml.get().attr("foo") == nullptr);
+
+            assert(xml.next());
+            assert(strcmp(xml.get().name, "way") == 0);
+            assert(xml.level() == 2);
+
+            assert(xml.next());
+            assert(strcmp(xml.get().name, "nd") == 0);
+            assert(xml.level() == 3);
+
+            assert(xml.next());
+            assert(strcmp(xml.get().name, "tag") == 0);
+            assert(xml.level() == 3);
+            assert(strcmp(xml.get().attr("v"), "A & B <A> x>y") == 0);
+
+            assert(xml.next());
+            assert(strcmp(xml.get().attr("k"), "n\xc3\xa4me") == 0);
+            assert(strcmp(xml.get().attr("v"), "Z\xc3\xbcrich\xc2\xa0Stra\xc3\x9f" "e") == 0);
+
+            assert(!xml.next());
+            xml.reset();
+        }
+        std::remove(path.c_str());
+    }
+
     // ___________________________________________________________________________
     {
         std::stringstream ss;
@@ -255,9 +312,137 @@ int main(int argc, char** argv)
         g.getNeighbors(1, 0.55, &ret);
         assert(ret.size() == (size_t) 2);
 
+        // packed cells, values added and removed afterwards
+        g.build();
+        std::vector<int> vals;
+        g.get(Box<double>(Point<double>(0, 0), Point<double>(3, 3)), &vals);
+        assert(vals == std::vector<int>({1, 2}));
+
+        Line<double> l3;
+        l3.push_back(Point<double>(0.2, 0.2));
+        l3.push_back(Point<double>(0.3, 0.3));
+        g.add(l3, 3);
+        g.remove(1);
+        g.get(Box<double>(Point<double>(0, 0), Point<double>(1, 1)), &vals);
+        assert(vals == std::vector<int>({3}));
+
+        g.build();
+        g.get(Box<double>(Point<double>(0, 0), Point<double>(3, 3)), &vals);
+        assert(vals == std::vector<int>({2, 3}));
+
+        ret.clear();
+        g.get(req, &ret);
+        assert(ret.empty());
+        assert(g.getCells(3).size() == (size_t) 1);
+
+        // a removed value that is added again is only found in its new cells
+        Line<double> l4;
+        l4.push_back(Point<double>(2.2, 2.2));
+        l4.push_back(Point<double>(2.3, 2.3));
+        g.remove(3);
+        g.add(l4, 3);
+        g.get(Box<double>(Point<double>(0, 0), Point<double>(1, 1)), &vals);
+        assert(vals.empty());
+        g.get(Box<double>(Point<double>(2, 2), Point<double>(3, 3)), &vals);
+        assert(vals == std::vector<int>({2, 3}));
+
+        // also for values added after the last build
+        g.remove(3);
+        g.add(l3, 3);
+        g.get(Box<double>(Point<double>(2, 2), Point<double>(3, 3)), &vals);
+        assert(vals == std::vector<int>({2}));
+        g.get(Box<double>(Point<double>(0, 0), Point<double>(1, 1)), &vals);
+        assert(vals == std::vector<int>({3}));
+
+        g.build();
+        g.get(Box<double>(Point<double>(0, 0), Point<double>(3, 3)), &vals);
+        assert(vals == std::vector<int>({2, 3}));
+        g.get(Box<double>(Point<double>(2, 2), Point<double>(3, 3)), &vals);
+        assert(vals == std::vector<int>({2}));
+
         // TODO: more test cases
     }
 
+    // ___________________________________________________________________________
+    {
+        // points on a 50x50 lattice, enough for three levels of nodes
+        PackedRTree<int, double> t;
+        std::vector<Point<double>> pts;
+        for (int i = 0; i < 2500; i++)
+        {
+            pts.push_back(Point<double>(i % 50, i / 50));
+            t.add(pts.back(), i);
+        }
+
+        std::vector<int> vals;
+        Box<double> req(Point<double>(10.5, 20.5), Point<double>(13.5, 22.5));
+        t.get(req, &vals);
+        assert(vals.size() == (size_t) 6);
+
+        t.build();
+        t.get(req, &vals);
+        std::sort(vals.begin(), vals.end());
+        assert(vals == std::vector<int>({1061, 1062, 1063, 1111, 1112, 1113}));
+
+        auto d = [&](const Point<double>& p) {
+            return [&pts, p](int v) { return dist(pts[v], p); };
+        };
+
+        std::vector<std::pair<double, int>> near;
+        t.getNearest(Point<double>(7.1, 3.2), 3, 10, d(Point<double>(7.1, 3.2)), &near);
+        assert(near.size() == (size_t) 3);
+        assert(near[0].second == 157);
+        assert(near[0].first == approx(dist(Point<double>(7.1, 3.2), pts[157])));
+        assert(near[1].first <= near[2].first);
+
+        // all within a radius, nearest first
+        t.getNearest(Point<double>(0, 0), 100, 1.5, d(Point<double>(0, 0)), &near);
+        assert(near.size() == (size_t) 4);
+        assert(near[0].second == 0);
+        assert(near[3].second == 51);
+
+        // removed and added values are seen before the next build
+        t.remove(157);
+        t.add(Point<double>(7.1, 3.3), 2500);
+        t.getNearest(Point<double>(7.1, 3.2), 1, 10, [](int v) {
+            return v == 2500 ? 0.1 : 1.0;
+        }, &near);
+        assert(near.size() == (size_t) 1 && near[0].second == 2500);
+
+        t.build();
+        assert(t.size() == (size_t) 2500);
+        t.get(Box<double>(Point<double>(6.9, 2.9), Point<double>(7.2, 3.4)), &vals);
+        assert(vals == std::vector<int>({2500}));
+
+        // a removed value that is added again is only found at its new box
+        Box<double> oldBox(Point<double>(11.9, 21.9), Point<double>(12.1, 22.1));
+        Box<double> newBox(Point<double>(59.9, 59.9), Point<double>(60.1, 60.1));
+        pts[1112] = Point<double>(60, 60);
+        t.remove(1112);
+        t.add(pts[1112], 1112);
+        t.get(oldBox, &vals);
+        assert(vals.empty());
+        t.get(newBox, &vals);
+        assert(vals == std::vector<int>({1112}));
+        t.getNearest(Point<double>(12, 22), 100, 2, d(Point<double>(12, 22)), &near);
+        for (const auto& n : near) assert(n.second != 1112);
+
+        // removed once more before a build, and a value with two entries
+        t.remove(1112);
+        t.add(pts[1112], 1112);
+        t.add(pts[1112], 1112);
+        t.get(newBox, &vals);
+        assert(vals == std::vector<int>({1112}));
+        t.getNearest(Point<double>(60, 60), 100, 1, d(Point<double>(60, 60)), &near);
+        assert(near.size() == (size_t) 1 && near[0].second == 1112);
+
+        t.build();
+        t.get(oldBox, &vals);
+        assert(vals.empty());
+        t.get(newBox, &vals);
+        assert(vals == std::vector<int>({1112}));
+    }
+
     // ___________________________________________________________________________
     {
         Line<double> a;
@@ -375,6 +560,44 @@ int main(int argc, char** argv)
         assert(fd == approx(1));
     }
 
+    // ___________________________________________________________________________
+    {
+        Line<double> a;
+        a.push_back(Point<double>(1, 1));
+        a.push_back(Point<double>(10, 1));
+
+        Line<double> b;
+        b.push_back(Point<double>(1, 2));
+        b.push_back(Point<double>(10, 2));
+
+        std::vector<size_t> idx;
+        auto p = util::geo::densify(a, 1, &idx);
+        auto q = util::geo::densify(b, 1);
+        assert(p.size() == (size_t) 10);
+        assert(idx == std::vector<size_t>({0, 9}));
+
+        FrechetBand full(p.size(), {0, q.size() - 1});
+        assert(frechetDist(p, q, {}) == approx(1));
+        assert(frechetDist(p, q, full) == approx(1));
+
+        // every step of p has a length of 1 and is matched at a distance of 1
+        assert(accFrechetDist(p, q, {}) == approx(9));
+        assert(accFrechetDist(p, q, full) == approx(9));
+
+        // a band along the diagonal keeps the best matching
+        FrechetBand diag;
+        for (size_t i = 0; i < p.size(); i++)
+            diag.push_back({i > 0 ? i - 1 : 0, std::min(i + 1, q.size() - 1)});
+        assert(frechetDist(p, q, diag) == approx(1));
+        assert(accFrechetDist(p, q, diag) == approx(9));
+
+        // one that keeps p at the start of q until its last point does not
+        FrechetBand start(p.size(), {0, 0});
+        start.back() = {0, q.size() - 1};
+        assert(frechetDist(p, q, start) > 8);
+        assert(accFrechetDist(p, q, start) > 9);
+    }
+
     // ___________________________________________________________________________
     {
         Line<double> a;
@@ -628,6 +851,215 @@ int main(int argc, char** argv)
         }
     }
 
+    // ___________________________________________________________________________
+    {
+        // A -> C -> D, A -> B, D -> B, B -> E
+        CsrGraph g;
+
+        auto a = g.addNd();
+        auto eAC = g.addEdg(2);
+        auto eAB = g.addEdg(1);
+        auto b = g.addNd();
+        auto eBE = g.addEdg(4);
+        auto c = g.addNd();
+        auto eCD = g.addEdg(3);
+        auto d = g.addNd();
+        auto eDB = g.addEdg(1);
+        g.addNd();
+
+        assert(g.getNumNds() == (size_t) 5);
+        assert(g.getNumEdgs() == (size_t) 5);
+        assert(g.getFrom(eAB) == a);
+        assert(g.getTo(eAB) == b);
+        assert(g.getDeg(a) == (size_t) 2);
+        assert(g.getDeg(c) == (size_t) 1);
+        assert(g.getOutBegin(d) == eDB);
+        assert(g.getOutEnd(d) == eDB + 1);
+
+        std::vector<int> w = {1, 5, 1, 1, 1};
+
+        struct CostFunc
+        {
+            const std::vector<int>& w;
+            int operator()(CsrGraph::Id from, CsrGraph::Id n, CsrGraph::Id to) const
+            {
+                // dont count cost of start edge
+                if (n != CsrGraph::NONE) return w[to];
+                UNUSED(from);
+                return 0;
+            }
+            int inf() const { return 999; }
+        };
+
+        struct HeurFunc
+        {
+            int operator()(CsrGraph::Id e) const
+            {
+                UNUSED(e);
+                return 0;
+            }
+        };
+
+        CostFunc cFunc{w};
+
+        EDijkstra::CsrEList resE;
+        int cost = EDijkstra::shortestPath(g, {eAC}, {eBE}, cFunc, HeurFunc(), &resE);
+
+        assert(cost == 3);
+        assert(resE.size() == (size_t) 4);
+        assert(resE[0] == eBE);
+        assert(resE[1] == eDB);
+        assert(resE[2] == eCD);
+        assert(resE[3] == eAC);
+
+        EDijkstra::CsrEList resB, resE2;
+        auto costs = EDijkstra::shortestPath(g, eAB, {eBE, eCD}, cFunc, HeurFunc(),
+                                             {{eBE, &resB}, {eCD, &resE2}});
+        assert(costs[eBE] == 1);
+        assert(costs[eCD] == 999);
+        assert(resB.size() == (size_t) 2);
+        assert(resE2.empty());
+
+        EDijkstra::CsrEList resM;
+        auto costsM = EDijkstra::shortestPath(g, {eAC, eAB}, {{eBE, eDB}, {eBE}}, cFunc,
+                                              std::vector<HeurFunc>(2),
+                                              {{{eBE, &resM}}, {}});
+        assert(costsM.size() == (size_t) 2);
+        assert(costsM[0][eBE] == 3);
+        assert(costsM[0][eDB] == 2);
+        assert(costsM[1][eBE] == 1);
+        assert(resM.size() == (size_t) 4);
+        assert(resM.back() == eAC);
+    }
+
+    // ___________________________________________________________________________
+    {
+        CsrSearchSpace<int> space;
+
+        for (int run = 0; run < 3; run++)
+        {
+            space.reset(6);
+            assert(space.empty());
+            assert(!space.isTarget(4));
+            assert(space.addTarget(4));
+            assert(!space.addTarget(4));
+
+            space.push(0, CsrGraph::NONE, 5, 5);
+            space.push(1, 0, 3, 3);
+            space.push(2, 0, 7, 7);
+            space.push(3, 0, 4, 4);
+
+            // decrease-key, a worse key is ignored
+            space.push(2, 1, 1, 1);
+            space.push(3, 1, 9, 9);
+
+            auto e = space.pop();
+            assert(e.e == 2);
+            assert(e.d == 1);
+            assert(space.isSettled(2));
+            assert(space.getParent(2) == 1);
+
+            // settled edges are not queued again
+            space.push(2, 0, 0, 0);
+
+            assert(space.pop().e == 1);
+            assert(space.pop().e == 3);
+            assert(space.getParent(3) == 0);
+            assert(space.pop().e == 0);
+            assert(space.empty());
+            assert(!space.isSettled(5));
+        }
+    }
+
+    // ___________________________________________________________________________
+    {
+        // 5x5 grid, edges in both directions
+        CsrGraph g;
+        const CsrGraph::Id N = 5;
+        for (CsrGraph::Id i = 0; i < N; i++)
+        {
+            for (CsrGraph::Id j = 0; j < N; j++)
+            {
+                g.addNd();
+                if (i > 0) g.addEdg((i - 1) * N + j);
+                if (i + 1 < N) g.addEdg((i + 1) * N + j);
+                if (j > 0) g.addEdg(i * N + j - 1);
+                if (j + 1 < N) g.addEdg(i * N + j + 1);
+            }
+        }
+
+        std::vector<int> w;
+        std::vector<bool> core;
+        for (CsrGraph::Id e = 0; e < g.getNumEdgs(); e++)
+        {
+            w.push_back(static_cast<int>((e * 7) % 5 + 1));
+            core.push_back(e % 6 == 0);
+        }
+
+        struct CostFunc
+        {
+            const std::vector<int>& w;
+            int operator()(CsrGraph::Id from, CsrGraph::Id n, CsrGraph::Id to) const
+            {
+                if (n != CsrGraph::NONE) return w[to];
+                UNUSED(from);
+                return 0;
+            }
+            int inf() const { return 999; }
+        };
+
+        struct HeurFunc
+        {
+            int operator()(CsrGraph::Id e) const
+            {
+                UNUSED(e);
+                return 0;
+            }
+        };
+
+        CostFunc cFunc{w};
+        CsrHierarchy h(g, core, [&](CsrGraph::Id from, CsrGraph::Id n, CsrGraph::Id to) {
+            return static_cast<double>(cFunc(from, n, to));
+        });
+
+        std::vector<CsrGraph::Id> coreEdgs;
+        for (CsrGraph::Id e = 0; e < g.getNumEdgs(); e++)
+        {
+            assert(h.isCore(e) || !core[e]);
+            if (core[e]) coreEdgs.push_back(e);
+        }
+        assert(h.getNumCoreEdgs() < g.getNumEdgs());
+
+        for (auto from : coreEdgs)
+        {
+            std::unordered_map<CsrGraph::Id, EDijkstra::CsrEList> res;
+            std::unordered_map<CsrGraph::Id, EDijkstra::CsrEList*> resP;
+            for (auto to : coreEdgs) resP[to] = &res[to];
+
+            auto costs = h.shortestPath(from, coreEdgs, cFunc, HeurFunc(), resP);
+            auto ref = EDijkstra::shortestPath(
+                    g, from, coreEdgs, cFunc, HeurFunc(),
+                    std::unordered_map<CsrGraph::Id, EDijkstra::CsrEList*>());
+
+            for (auto to : coreEdgs)
+            {
+                assert(costs[to] == ref[to]);
+
+                // the unpacked path is a path of the graph with that cost
+                const auto& p = res[to];
+                assert(p.front() == to);
+                assert(p.back() == from);
+                int sum = 0;
+                for (size_t i = 0; i + 1 < p.size(); i++)
+                {
+                    assert(g.getTo(p[i + 1]) == g.getFrom(p[i]));
+                    sum += w[p[i]];
+                }
+                assert(sum == costs[to]);
+            }
+        }
+    }
+
     // ___________________________________________________________________________
     {
         UndirGraph<std::string, int> g;